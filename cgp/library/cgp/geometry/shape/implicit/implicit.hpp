@@ -1,3 +1,4 @@
 #pragma once
 
-#include "marching_cube/marching_cube.hpp"
\ No newline at end of file
+#include "marching_cube/marching_cube.hpp"
+#include "marching_cube/marching_cube_incremental.hpp"
\ No newline at end of file
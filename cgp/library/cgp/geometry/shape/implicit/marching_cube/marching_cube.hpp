@@ -7,7 +7,7 @@
 namespace cgp {
 
 	/** A simple-to-use marching cube that takes as input a discrete field, a 3D domain, and the iso-value, and returns a mesh without duplicating the vertices at the same position. 
-	* A new mesh is created at each call which is good for single call, but not ideal for efficiency if used in the animation loop. */
+	* A new mesh is created at each call which is good for single call, but not ideal for efficiency if used in the animation loop (see marching_cube_incremental). */
 	mesh marching_cube(grid_3D<float> const& field, spatial_domain_grid_3D const& domain, float iso);
 
 
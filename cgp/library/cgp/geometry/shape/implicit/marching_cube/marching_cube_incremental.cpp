@@ -0,0 +1,312 @@
+#include "marching_cube_incremental.hpp"
+
+#include "helper/marching_cubes_lut.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace cgp
+{
+	// Blocks resolved or merged in the mesh per parallel job (meshing a block is long enough to be a job alone)
+	static int const marching_cube_merge_blocks_per_job = 8;
+	// Bits of the owner block in triangle_vertex
+	static int const marching_cube_owner_shift = 29;
+
+	namespace
+	{
+		// Corners of a cell, in the order of the look-up tables
+		int const cube_corner[8][3] = { {0,0,0}, {1,0,0}, {1,1,0}, {0,1,0}, {0,0,1}, {1,0,1}, {1,1,1}, {0,1,1} };
+
+		struct marching_cube_tables {
+			std::array<std::array<int, 16>, 256> triangle;
+			int edge_corner[12]; // Corner of the edge with the lowest coordinates
+			int edge_axis[12];
+		};
+
+		marching_cube_tables const& tables()
+		{
+			static marching_cube_tables const t = []() {
+				marching_cube_tables t;
+				t.triangle = marching_cube_lut_triTable();
+				std::array<std::pair<int, int>, 12> const edge_order = marching_cube_lut_edge_order();
+				for (int e = 0; e < 12; ++e) {
+					int const a = edge_order[e].first;
+					int const b = edge_order[e].second;
+					int axis = 0;
+					while (cube_corner[a][axis] == cube_corner[b][axis])
+						++axis;
+					t.edge_axis[e] = axis;
+					t.edge_corner[e] = cube_corner[a][axis] < cube_corner[b][axis] ? a : b;
+				}
+				return t;
+			}();
+			return t;
+		}
+
+		// Central differences (one sided on the border of the grid)
+		vec3 field_gradient(float const* f, int3 const& N, size_t const stride[3], int const sample[3], vec3 const& voxel)
+		{
+			size_t const k = sample[0] + N.x * (sample[1] + size_t(N.y) * sample[2]);
+			int const size[3] = { N.x, N.y, N.z };
+			float const length[3] = { voxel.x, voxel.y, voxel.z };
+
+			float g[3];
+			for (int axis = 0; axis < 3; ++axis) {
+				bool const previous = sample[axis] > 0;
+				bool const next = sample[axis] < size[axis] - 1;
+				size_t const k0 = previous ? k - stride[axis] : k;
+				size_t const k1 = next ? k + stride[axis] : k;
+				g[axis] = (f[k1] - f[k0]) / ((int(previous) + int(next)) * length[axis]);
+			}
+			return { g[0], g[1], g[2] };
+		}
+
+		void mesh_block(marching_cube_block& block, float const* f, int3 const& N, float iso, vec3 const& domain_min, vec3 const& voxel)
+		{
+			marching_cube_tables const& lut = tables();
+			size_t const stride[3] = { 1, size_t(N.x), size_t(N.x) * N.y };
+			int const size[3] = { N.x, N.y, N.z };
+
+			block.position.clear();
+			block.normal.clear();
+			block.triangle_edge.clear();
+			std::fill(block.edge_vertex.begin(), block.edge_vertex.end(), -1);
+
+			// Vertices of the owned edges
+			int local = 0;
+			for (int z = 0; z < block.sample_count.z; ++z) {
+				for (int y = 0; y < block.sample_count.y; ++y) {
+					for (int x = 0; x < block.sample_count.x; ++x, ++local) {
+						int const sample[3] = { block.cell_min.x + x, block.cell_min.y + y, block.cell_min.z + z };
+						size_t const k = sample[0] + stride[1] * sample[1] + stride[2] * sample[2];
+						float const v0 = f[k];
+
+						for (int axis = 0; axis < 3; ++axis) {
+							if (sample[axis] + 1 >= size[axis])
+								continue;
+							float const v1 = f[k + stride[axis]];
+							if ((v0 < iso) == (v1 < iso))
+								continue;
+
+							float const alpha = (iso - v0) / (v1 - v0);
+							float p[3] = { float(sample[0]), float(sample[1]), float(sample[2]) };
+							p[axis] += alpha;
+
+							int next[3] = { sample[0], sample[1], sample[2] };
+							next[axis]++;
+							// The triangles of the tables face the decreasing values
+							vec3 const n = (alpha - 1) * field_gradient(f, N, stride, sample, voxel) - alpha * field_gradient(f, N, stride, next, voxel);
+							float const n_norm = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+
+							block.edge_vertex[3 * local + axis] = block.position.size();
+							block.position.push_back({ domain_min.x + p[0] * voxel.x, domain_min.y + p[1] * voxel.y, domain_min.z + p[2] * voxel.z });
+							block.normal.push_back(n_norm > 1e-12f ? n / n_norm : vec3{ 0, 0, 1 });
+						}
+					}
+				}
+			}
+
+			// Triangles of the cells, as edge keys
+			size_t corner_offset[8];
+			for (int c = 0; c < 8; ++c)
+				corner_offset[c] = cube_corner[c][0] * stride[0] + cube_corner[c][1] * stride[1] + cube_corner[c][2] * stride[2];
+
+			for (int cz = block.cell_min.z; cz < block.cell_max.z; ++cz) {
+				for (int cy = block.cell_min.y; cy < block.cell_max.y; ++cy) {
+					for (int cx = block.cell_min.x; cx < block.cell_max.x; ++cx) {
+						size_t const k = cx + stride[1] * cy + stride[2] * cz;
+
+						int type = 0;
+						for (int c = 0; c < 8; ++c)
+							if (f[k + corner_offset[c]] < iso)
+								type |= 1 << c;
+						if (type == 0 || type == 255)
+							continue;
+
+						for (int t = 0; lut.triangle[type][t] != -1; ++t) {
+							int const e = lut.triangle[type][t];
+							block.triangle_edge.push_back(3 * (k + corner_offset[lut.edge_corner[e]]) + lut.edge_axis[e]);
+						}
+					}
+				}
+			}
+		}
+	}
+
+
+	void marching_cube_incremental::initialize(spatial_domain_grid_3D const& domain_arg, float iso_arg, int block_cells_arg)
+	{
+		assert_cgp(domain_arg.samples.x > 1 && domain_arg.samples.y > 1 && domain_arg.samples.z > 1, "The grid needs at least 2 samples along each axis");
+		assert_cgp(block_cells_arg > 0, "Blocks need at least one cell");
+
+		domain = domain_arg;
+		iso = iso_arg;
+		block_cells = block_cells_arg;
+
+		int3 const cells = domain.samples - int3{ 1, 1, 1 };
+		block_count = (cells + int3{ block_cells - 1, block_cells - 1, block_cells - 1 }) / block_cells;
+
+		blocks.clear();
+		blocks.resize(size_t(block_count.x) * block_count.y * block_count.z);
+		for (int bz = 0; bz < block_count.z; ++bz) {
+			for (int by = 0; by < block_count.y; ++by) {
+				for (int bx = 0; bx < block_count.x; ++bx) {
+					marching_cube_block& block = blocks[bx + block_count.x * (by + block_count.y * bz)];
+					block.cell_min = int3{ bx, by, bz } * block_cells;
+					block.cell_max = int3{ std::min((bx + 1) * block_cells, cells.x), std::min((by + 1) * block_cells, cells.y), std::min((bz + 1) * block_cells, cells.z) };
+
+					// The last blocks also own the edges starting on the last samples
+					block.sample_count = block.cell_max - block.cell_min;
+					for (int axis = 0; axis < 3; ++axis)
+						if (block.cell_max[axis] == cells[axis])
+							block.sample_count[axis]++;
+
+					block.edge_vertex.resize(3 * size_t(block.sample_count.x) * block.sample_count.y * block.sample_count.z);
+					block.modified = true;
+				}
+			}
+		}
+
+		m = mesh();
+		updated_blocks = 0;
+	}
+
+	void marching_cube_incremental::set_modified(int3 const& sample_min, int3 const& sample_max)
+	{
+		// The cells touching the sample s are [s-1, s], but the normals of the edges starting at a use the gradients at a and a+1,
+		// which read the samples [a-1, a+2]: the vertices changed by s are on the edges owned by the cells [s-2, s+1]
+		int3 const cells = domain.samples - int3{ 1, 1, 1 };
+		int3 b0, b1;
+		for (int axis = 0; axis < 3; ++axis) {
+			b0[axis] = std::clamp(sample_min[axis] - 2, 0, cells[axis] - 1) / block_cells;
+			b1[axis] = std::clamp(sample_max[axis] + 1, 0, cells[axis] - 1) / block_cells;
+		}
+
+		for (int bz = b0.z; bz <= b1.z; ++bz)
+			for (int by = b0.y; by <= b1.y; ++by)
+				for (int bx = b0.x; bx <= b1.x; ++bx)
+					blocks[bx + block_count.x * (by + block_count.y * bz)].modified = true;
+	}
+
+	void marching_cube_incremental::set_modified_all()
+	{
+		for (marching_cube_block& block : blocks)
+			block.modified = true;
+	}
+
+	void marching_cube_incremental::resolve_block(marching_cube_block& block) const
+	{
+		int3 const& N = domain.samples;
+		int3 const cells = N - int3{ 1, 1, 1 };
+		int3 const b = block.cell_min / block_cells;
+
+		block.triangle_vertex.resize(block.triangle_edge.size());
+		for (size_t t = 0; t < block.triangle_edge.size(); ++t) {
+			size_t const key = block.triangle_edge[t];
+			size_t const sample = key / 3;
+			int const axis = int(key % 3);
+			int const x = int(sample % N.x);
+			int const y = int((sample / N.x) % N.y);
+			int const z = int(sample / (size_t(N.x) * N.y));
+
+			int const ox = std::min(x, cells.x - 1) / block_cells;
+			int const oy = std::min(y, cells.y - 1) / block_cells;
+			int const oz = std::min(z, cells.z - 1) / block_cells;
+			marching_cube_block const& owner = blocks[ox + block_count.x * (oy + block_count.y * oz)];
+			size_t const local = (x - owner.cell_min.x) + owner.sample_count.x * ((y - owner.cell_min.y) + size_t(owner.sample_count.y) * (z - owner.cell_min.z));
+			int const vertex = owner.edge_vertex[3 * local + axis];
+			assert_cgp_no_msg(vertex >= 0 && vertex < (1 << marching_cube_owner_shift));
+
+			unsigned int const code = (ox - b.x) + 2 * (oy - b.y) + 4 * (oz - b.z);
+			block.triangle_vertex[t] = unsigned(vertex) | (code << marching_cube_owner_shift);
+		}
+	}
+
+	bool marching_cube_incremental::update(grid_3D<float> const& field)
+	{
+		assert_cgp(is_equal(field.dimension, domain.samples), "The field doesn't match the domain: call initialize first");
+
+		std::vector<int> modified;
+		for (int k = 0; k < int(blocks.size()); ++k)
+			if (blocks[k].modified)
+				modified.push_back(k);
+		updated_blocks = int(modified.size());
+		if (modified.empty())
+			return false;
+
+		// Mesh the modified blocks
+		float const* f = field.data.data.data();
+		vec3 const domain_min = domain.corner_min();
+		vec3 const voxel = domain.voxel_length();
+		mesh_for(int(modified.size()), [&](int begin, int end) {
+			for (int k = begin; k < end; ++k) {
+				marching_cube_block& block = blocks[modified[k]];
+				mesh_block(block, f, domain.samples, iso, domain_min, voxel);
+				block.modified = false;
+			}
+		}, 1);
+
+		// The vertex indices of these blocks changed: resolve again the triangles of the blocks using them (the 7 blocks before)
+		std::vector<int> to_resolve;
+		std::vector<char> queued(blocks.size(), 0);
+		for (int k : modified) {
+			int3 const b = blocks[k].cell_min / block_cells;
+			for (int d = 0; d < 8; ++d) {
+				int3 const n = b - int3{ d & 1, (d >> 1) & 1, d >> 2 };
+				int const index = n.x + block_count.x * (n.y + block_count.y * n.z);
+				if (n.x >= 0 && n.y >= 0 && n.z >= 0 && !queued[index]) {
+					queued[index] = 1;
+					to_resolve.push_back(index);
+				}
+			}
+		}
+		mesh_for(int(to_resolve.size()), [&](int begin, int end) {
+			for (int k = begin; k < end; ++k)
+				resolve_block(blocks[to_resolve[k]]);
+		}, marching_cube_merge_blocks_per_job);
+
+		// Place of each block in the mesh (prefix sum of the counts)
+		int const N_block = int(blocks.size());
+		std::vector<int> vertex_offset(N_block + 1, 0);
+		std::vector<int> triangle_offset(N_block + 1, 0);
+		for (int k = 0; k < N_block; ++k) {
+			vertex_offset[k + 1] = vertex_offset[k] + blocks[k].position.size();
+			triangle_offset[k + 1] = triangle_offset[k] + int(blocks[k].triangle_vertex.size() / 3);
+		}
+
+		int const N_vertex = vertex_offset[N_block];
+		int const N_triangle = triangle_offset[N_block];
+		m.position.resize(N_vertex);
+		m.normal.resize(N_vertex);
+		m.connectivity.resize(N_triangle);
+
+		// Copy the vertices, and offset the indices by the place of their owner block
+		vec3* position = m.position.data.data();
+		vec3* normal = m.normal.data.data();
+		uint3* connectivity = m.connectivity.data.data();
+		unsigned int const index_mask = (1u << marching_cube_owner_shift) - 1;
+		mesh_for(N_block, [&](int begin, int end) {
+			for (int k = begin; k < end; ++k) {
+				marching_cube_block const& block = blocks[k];
+				std::copy(block.position.data.begin(), block.position.data.end(), position + vertex_offset[k]);
+				std::copy(block.normal.data.begin(), block.normal.data.end(), normal + vertex_offset[k]);
+
+				// Offset of the 8 possible owners (the blocks past the grid are never used)
+				unsigned int owner_offset[8];
+				for (int d = 0; d < 8; ++d) {
+					int const owner = std::min(k + (d & 1) + block_count.x * (((d >> 1) & 1) + block_count.y * (d >> 2)), N_block - 1);
+					owner_offset[d] = vertex_offset[owner];
+				}
+
+				unsigned int const* v = block.triangle_vertex.data();
+				int const count = int(block.triangle_vertex.size() / 3);
+				uint3* triangle = connectivity + triangle_offset[k];
+				for (int t = 0; t < count; ++t, v += 3)
+					triangle[t] = { owner_offset[v[0] >> marching_cube_owner_shift] + (v[0] & index_mask), owner_offset[v[1] >> marching_cube_owner_shift] + (v[1] & index_mask), owner_offset[v[2] >> marching_cube_owner_shift] + (v[2] & index_mask) };
+			}
+		}, marching_cube_merge_blocks_per_job);
+
+		m.color.resize(N_vertex).fill(vec3{ 1.0f, 1.0f, 1.0f });
+		m.uv.resize(N_vertex).fill(vec2{ 0.0f, 0.0f });
+		return true;
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "cgp/core/containers/grid/grid.hpp"
+#include "cgp/geometry/shape/mesh/mesh.hpp"
+#include "cgp/geometry/shape/spatial_domain/spatial_domain.hpp"
+
+#include <vector>
+
+namespace cgp {
+
+	/** Cells of the grid meshed together, with the vertices of the edges they own.
+	* The block owning the edge starting at sample s (along x, y or z) is the one of the cell min(s, N_cell-1). */
+	struct marching_cube_block {
+		int3 cell_min;  // Cells [cell_min, cell_max[
+		int3 cell_max;
+		int3 sample_count; // Size of the box of the samples starting the owned edges
+
+		numarray<vec3> position; // Vertices on the owned edges crossing the iso-value
+		numarray<vec3> normal;   // Opposite of the normalized gradient of the field (the side the triangles face)
+		std::vector<int> edge_vertex; // 3 per owned sample (x, y, z edge): index in position, -1 if not crossing
+		std::vector<size_t> triangle_edge; // 3 per triangle: edge key 3*sample_offset+axis
+		std::vector<unsigned int> triangle_vertex; // 3 per triangle: index in the owner block | (owner << 29), owner = dx+2dy+4dz the offset of the owner block
+
+		bool modified = true; // The field changed: mesh it again
+	};
+
+	/** Marching cube split in blocks of cells, meshed in parallel and again only where the field changed.
+	* - The blocks are meshed with the parallel_for set by set_mesh_parallel_for (serially otherwise).
+	* - Each block keeps its own vertices: the mesh is merged from them using a prefix sum of their counts, and the vertices on the edges shared by blocks are not duplicated.
+	*   The triangles only refer to the vertices of their block and of the 7 blocks after it, so the merge is a copy plus an offset per index.
+	* - The normals come from the gradient of the field, so the modified parts don't need a normal computation on the whole mesh.
+	* Usage: initialize once; after changing field values, call set_modified on the changed samples, then update. */
+	struct marching_cube_incremental {
+
+		/** Current surface. Only valid after the first update */
+		mesh m;
+		/** Number of blocks meshed again during the last update */
+		int updated_blocks = 0;
+
+		/** Set the grid and the iso-value. Every block is meshed at the next update */
+		void initialize(spatial_domain_grid_3D const& domain, float iso, int block_cells = 16);
+
+		/** Mark the samples of index in [sample_min, sample_max] (included) as changed */
+		void set_modified(int3 const& sample_min, int3 const& sample_max);
+		void set_modified_all();
+
+		/** Mesh again the modified blocks and merge the surface in m. Returns false if there was nothing to update */
+		bool update(grid_3D<float> const& field);
+
+		spatial_domain_grid_3D domain;
+		float iso = 0.0f;
+		int block_cells = 16;
+		int3 block_count;
+		std::vector<marching_cube_block> blocks;
+
+	private:
+		void resolve_block(marching_cube_block& block) const;
+	};
+}
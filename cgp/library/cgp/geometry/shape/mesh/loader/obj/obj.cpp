@@ -10,11 +10,22 @@
 #include "cgp/core/base/base.hpp"
 #include "cgp/core/files/files.hpp"
 
-#include <map>
-
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <sstream>
 
+#if defined(__linux__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CGP_OBJ_MMAP
+#endif
+
 namespace cgp
 {
 
@@ -69,32 +80,228 @@ namespace cgp
     }
 
 
-// Comparator of triplet of integer for std::map
-struct comparator_int3 {
-    long int N; // number of vertices
+// The file is split in chunks of about this size (at line ends), parsed in parallel
+static size_t const obj_chunk_bytes = size_t(1) << 20;
 
-    comparator_int3(int N_arg=0) :N(N_arg) {}
+// Content of a file, memory mapped when the system allows it (read in memory otherwise)
+class obj_file_view
+{
+public:
+    explicit obj_file_view(std::string const& filename)
+    {
+#ifdef CGP_OBJ_MMAP
+        int const fd = open(filename.c_str(), O_RDONLY);
+        struct stat info;
+        if (fd >= 0 && fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* const mapped = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                data = static_cast<char const*>(mapped);
+                size = size_t(info.st_size);
+            }
+        }
+        if (fd >= 0)
+            close(fd);
+        if (data != nullptr)
+            return;
+#endif
+        buffer = read_from_file_binary(filename);
+        data = buffer.data();
+        size = buffer.size();
+    }
 
-    // compute a<b
-    bool operator()(int3 const& a, int3 const& b) const
+    ~obj_file_view()
     {
-        long int const offset_a = long(a[0]) + N*(long(a[1]) + N*long(a[2]));
-        long int const offset_b = long(b[0]) + N*(long(b[1]) + N*long(b[2]));
-        return offset_a < offset_b;
+#ifdef CGP_OBJ_MMAP
+        if (buffer.empty() && data != nullptr)
+            munmap(const_cast<char*>(data), size);
+#endif
     }
+
+    obj_file_view(obj_file_view const&) = delete;
+    obj_file_view& operator=(obj_file_view const&) = delete;
+
+    char const* data = nullptr;
+    size_t size = 0;
+
+private:
+    std::vector<char> buffer;
 };
 
+// Attributes and faces of a chunk of lines. Negative (relative) OBJ indices are resolved with the counts of the
+// chunk: the corners listed in relative need the counts of the previous chunks
+struct obj_chunk
+{
+    std::vector<vec3> position;
+    std::vector<vec2> uv;
+    std::vector<vec3> normal;
+    std::vector<int3> corner; // position/uv/normal indices from 0, -1 if absent
+    std::vector<int> face_size;
+    std::vector<std::pair<size_t, int>> relative; // (corner, component)
+};
+
+static bool obj_is_space(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+static char const* obj_skip_spaces(char const* it, char const* end)
+{
+    while (it < end && obj_is_space(*it))
+        ++it;
+    return it;
+}
+
+static char const* obj_parse_int(char const* it, char const* end, int& value, bool& valid)
+{
+    bool const negative = it < end && *it == '-';
+    if (negative || (it < end && *it == '+'))
+        ++it;
+    valid = it < end && *it >= '0' && *it <= '9';
+    long long v = 0;
+    while (it < end && *it >= '0' && *it <= '9')
+        v = 10 * v + (*it++ - '0');
+    value = int(negative ? -v : v);
+    return it;
+}
+
+static char const* obj_parse_float(char const* it, char const* end, float& value)
+{
+    it = obj_skip_spaces(it, end);
+    bool const negative = it < end && *it == '-';
+    if (negative || (it < end && *it == '+'))
+        ++it;
+
+    double v = 0;
+    while (it < end && *it >= '0' && *it <= '9')
+        v = 10 * v + (*it++ - '0');
+    if (it < end && *it == '.') {
+        ++it;
+        double scale = 0.1;
+        while (it < end && *it >= '0' && *it <= '9') {
+            v += scale * (*it++ - '0');
+            scale *= 0.1;
+        }
+    }
+    if (it < end && (*it == 'e' || *it == 'E')) {
+        int exponent = 0;
+        bool valid = false;
+        char const* const after = obj_parse_int(it + 1, end, exponent, valid);
+        if (valid) {
+            v *= std::pow(10.0, exponent);
+            it = after;
+        }
+    }
+    value = float(negative ? -v : v);
+    return it;
+}
+
+// Parse the lines of [begin, end[. Only v, vt, vn and f are read
+static void obj_parse_chunk(char const* begin, char const* end, obj_chunk& chunk)
+{
+    char const* it = begin;
+    while (it < end)
+    {
+        it = obj_skip_spaces(it, end);
+        char const* const line_end = std::find(it, end, '\n');
+
+        if (line_end - it >= 2 && it[0] == 'v' && obj_is_space(it[1])) {
+            vec3 p;
+            it = obj_parse_float(it + 1, line_end, p.x);
+            it = obj_parse_float(it, line_end, p.y);
+            obj_parse_float(it, line_end, p.z);
+            chunk.position.push_back(p);
+        }
+        else if (line_end - it >= 3 && it[0] == 'v' && it[1] == 't' && obj_is_space(it[2])) {
+            vec2 uv;
+            it = obj_parse_float(it + 2, line_end, uv.x);
+            obj_parse_float(it, line_end, uv.y);
+            chunk.uv.push_back(uv);
+        }
+        else if (line_end - it >= 3 && it[0] == 'v' && it[1] == 'n' && obj_is_space(it[2])) {
+            vec3 n;
+            it = obj_parse_float(it + 2, line_end, n.x);
+            it = obj_parse_float(it, line_end, n.y);
+            obj_parse_float(it, line_end, n.z);
+            chunk.normal.push_back(n);
+        }
+        else if (line_end - it >= 2 && it[0] == 'f' && obj_is_space(it[1])) {
+            // Corners p, p/t, p//n or p/t/n
+            int size = 0;
+            it = obj_skip_spaces(it + 1, line_end);
+            while (it < line_end)
+            {
+                int3 corner = { -1, -1, -1 };
+                int const counts[3] = { int(chunk.position.size()), int(chunk.uv.size()), int(chunk.normal.size()) };
+                for (int component = 0; component < 3 && it < line_end && !obj_is_space(*it); ++component)
+                {
+                    if (component > 0) {
+                        if (*it != '/')
+                            break;
+                        ++it;
+                    }
+                    int value = 0;
+                    bool valid = false;
+                    it = obj_parse_int(it, line_end, value, valid);
+                    if (!valid)
+                        continue;
+
+                    int& index = component == 0 ? corner.x : (component == 1 ? corner.y : corner.z);
+                    if (value < 0) {
+                        index = counts[component] + value;
+                        chunk.relative.push_back({ chunk.corner.size(), component });
+                    }
+                    else
+                        index = value - 1; // obj indices starts at 1
+                }
+                while (it < line_end && !obj_is_space(*it))
+                    ++it; // Unexpected characters
+                it = obj_skip_spaces(it, line_end);
+
+                chunk.corner.push_back(corner);
+                size++;
+            }
+            chunk.face_size.push_back(size);
+        }
+
+        it = line_end + 1;
+    }
+}
 
-static numarray<numarray_stack<int3,3>> triangulate_faces(numarray<numarray<int3>> faces);
+// Open addressing table from the (position, uv, normal) indices of a corner to the vertex created for it
+class obj_vertex_table
+{
+public:
+    explicit obj_vertex_table(size_t expected_count)
+    {
+        size_t capacity = 16;
+        while (capacity < 2 * expected_count)
+            capacity *= 2;
+        slots.assign(capacity, -1);
+    }
 
+    // Vertex of the key, or -1 after inserting it as vertex new_vertex
+    int find_or_insert(int3 const& key, int new_vertex)
+    {
+        size_t const mask = slots.size() - 1;
+        uint64_t h = uint64_t(uint32_t(key.x)) * 0x9E3779B97F4A7C15ull;
+        h ^= uint64_t(uint32_t(key.y)) * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+        h ^= uint64_t(uint32_t(key.z)) * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+        for (size_t slot = size_t(h ^ (h >> 32)) & mask;; slot = (slot + 1) & mask)
+        {
+            int const vertex = slots[slot];
+            if (vertex < 0) {
+                slots[slot] = new_vertex;
+                keys.push_back(key);
+                return -1;
+            }
+            int3 const& k = keys[vertex];
+            if (k.x == key.x && k.y == key.y && k.z == key.z)
+                return vertex;
+        }
+    }
 
-static std::pair<mesh, std::map<int3, int, comparator_int3>>
-    make_unique_parameter_per_value(numarray<vec3> const& positions,
-                                    numarray<vec2> const& texture_uv,
-                                    numarray<vec3> const& normals,
-                                    numarray<numarray_stack<int3,3>> const& faces,
-                                    loader::obj_type const type);
+    std::vector<int3> keys; // Key of each vertex
 
+private:
+    std::vector<int> slots;
+};
 
 mesh mesh_load_file_obj(const std::string& filename)
 {
@@ -106,117 +313,187 @@ mesh mesh_load_file_obj(const std::string& filename)
 mesh mesh_load_file_obj(const std::string& filename, numarray<numarray<int> >& vertex_correspondance)
 {
     assert_file_exist(filename);
-
-    // Load parameters
-    numarray<vec3> positions = loader::obj_read_positions(filename);
-    numarray<vec2> texture_uv = loader::obj_read_texture_uv(filename);
-    numarray<vec3> normals = loader::obj_read_normals(filename);
+    obj_file_view const file(filename);
+
+    // Chunks ending at line ends, parsed in parallel
+    std::vector<char const*> bounds = { file.data };
+    size_t const N_chunk_max = std::max(size_t(1), file.size / obj_chunk_bytes);
+    for (size_t k = 1; k < N_chunk_max; ++k) {
+        char const* const target = file.data + k * file.size / N_chunk_max;
+        char const* const line_end = std::find(std::max(target, bounds.back()), file.data + file.size, '\n');
+        if (line_end < file.data + file.size)
+            bounds.push_back(line_end + 1);
+    }
+    bounds.push_back(file.data + file.size);
+
+    int const N_chunk = int(bounds.size()) - 1;
+    std::vector<obj_chunk> chunks(N_chunk);
+    mesh_for(N_chunk, [&](int begin, int end) {
+        for (int k = begin; k < end; ++k)
+            obj_parse_chunk(bounds[k], bounds[k + 1], chunks[k]);
+    }, 1);
+
+    // Concatenate the attributes, and make the relative indices absolute
+    numarray<vec3> positions;
+    numarray<vec2> texture_uv;
+    numarray<vec3> normals;
+    size_t N_corner = 0;
+    for (obj_chunk& chunk : chunks)
+    {
+        int const base[3] = { int(positions.size()), int(texture_uv.size()), int(normals.size()) };
+        for (auto const& r : chunk.relative) {
+            int3& corner = chunk.corner[r.first];
+            (r.second == 0 ? corner.x : (r.second == 1 ? corner.y : corner.z)) += base[r.second];
+        }
+        positions.data.insert(positions.data.end(), chunk.position.begin(), chunk.position.end());
+        texture_uv.data.insert(texture_uv.data.end(), chunk.uv.begin(), chunk.uv.end());
+        normals.data.insert(normals.data.end(), chunk.normal.begin(), chunk.normal.end());
+        N_corner += chunk.corner.size();
+    }
 
     assert_cgp(positions.size()>0, str("File ")+filename+" has 0 vertices");
+    bool const has_uv = texture_uv.size() > 0;
+    bool const has_normal = normals.size() > 0;
 
-    // set obj type
-    loader::obj_type type = loader::obj_type::vertex;
-    if(texture_uv.size()>0 && normals.size()>0)
-        type = loader::obj_type::vertex_texture_normal;
-    else if( texture_uv.size()>0 )
-        type = loader::obj_type::vertex_texture;
-    else if( normals.size()>0 )
-        type = loader::obj_type::vertex_normal;
-
-    // Load connectivity and triangulate
-    numarray<numarray_stack<int3,3>> faces = triangulate_faces( loader::obj_read_faces(filename, type) );
-
-    // Set unique per-vertex value for texture and normals (duplicate vertices if necessary)
+    // Triangulate the faces (fans), and create one vertex per distinct position/uv/normal triplet
     mesh m;
-    std::map<int3, int, comparator_int3> connectivity_map;
-    std::tie(m,connectivity_map) = make_unique_parameter_per_value(positions, texture_uv, normals, faces, type);
-
-    // Retrieve correspondance between initial vertices in files and new ones
-    vertex_correspondance.resize(positions.size());
-    for(auto const& it : connectivity_map)
+    obj_vertex_table table(N_corner);
+    for (obj_chunk const& chunk : chunks)
     {
-        int const vertex_in = it.first[0];
-        int const vertex_out = it.second;
+        size_t first = 0;
+        for (int size : chunk.face_size)
+        {
+            int fan_center = 0;
+            int previous = 0;
+            for (int k = 0; k < size; ++k)
+            {
+                int3 key = chunk.corner[first + k];
+                key.y = has_uv ? key.y : -1;
+                key.z = has_normal ? key.z : -1;
+
+                int const N_vertex = int(m.position.size());
+                int index = table.find_or_insert(key, N_vertex);
+                if (index < 0) {
+                    index = N_vertex;
+                    assert_cgp(key.x >= 0 && key.x < int(positions.size()), "Invalid position index in file " + filename);
+                    m.position.push_back(positions.data[key.x]);
+                    if (has_uv) {
+                        assert_cgp(key.y < int(texture_uv.size()), "Invalid uv index in file " + filename);
+                        m.uv.push_back(key.y >= 0 ? texture_uv.data[key.y] : vec2{ 0, 0 });
+                    }
+                    if (has_normal) {
+                        assert_cgp(key.z < int(normals.size()), "Invalid normal index in file " + filename);
+                        m.normal.push_back(key.z >= 0 ? normals.data[key.z] : vec3{ 0, 0, 0 });
+                    }
+                }
 
-        vertex_correspondance[vertex_in].push_back(vertex_out);
+                if (k == 0)
+                    fan_center = index;
+                else if (k >= 2)
+                    m.connectivity.push_back(uint3{ unsigned(fan_center), unsigned(previous), unsigned(index) });
+                previous = index;
+            }
+            first += size;
+        }
     }
 
+    // Retrieve correspondance between initial vertices in files and new ones
+    vertex_correspondance.resize(positions.size());
+    for (size_t k = 0; k < table.keys.size(); ++k)
+        vertex_correspondance[table.keys[k].x].push_back(int(k));
+
     return m;
 }
 
+// Binary cache of mesh_load_file_obj: header, then the position, normal, color, uv and connectivity buffers
+static uint32_t const obj_cache_version = 1;
 
-numarray<numarray_stack<int3,3>> triangulate_faces(numarray<numarray<int3>> faces)
+struct obj_cache_header
 {
-    numarray<numarray_stack<int3,3>> faces_triangulation;
-    size_t const N_face = faces.size();
-    for(size_t k_face=0; k_face<N_face; ++k_face)
-    {
-        numarray<int3> const& current_polygon = faces[k_face];
-        int const N_polygon = int(current_polygon.size());
-
-        for(int k=0; k<N_polygon-2; ++k) {
-            // triangulation
-            int3 const& f0 = current_polygon[0];
-            int3 const& f1 = current_polygon[k+1];
-            int3 const& f2 = current_polygon[k+2];
+    char magic[4] = { 'C', 'G', 'P', 'M' };
+    uint32_t version = obj_cache_version;
+    uint64_t source_size = 0; // Identify the .obj file the cache was built from
+    int64_t source_time = 0;
+    uint32_t N_vertex = 0;
+    uint32_t N_triangle = 0;
+};
 
-            faces_triangulation.push_back({f0,f1,f2});
-        }
-    }
-    return faces_triangulation;
+static bool obj_source_identity(std::string const& filename, uint64_t& size, int64_t& time)
+{
+    std::error_code error;
+    size = uint64_t(std::filesystem::file_size(filename, error));
+    if (error)
+        return false;
+    time = int64_t(std::filesystem::last_write_time(filename, error).time_since_epoch().count());
+    return !error;
 }
 
-std::pair<mesh, std::map<int3, int, comparator_int3>>
-    make_unique_parameter_per_value(numarray<vec3> const& positions,
-                                    numarray<vec2> const& texture_uv,
-                                    numarray<vec3> const& normals,
-                                    numarray<numarray_stack<int3,3>> const& faces,
-                                    loader::obj_type const type)
+static size_t obj_cache_size(obj_cache_header const& header)
 {
-    mesh m;
-    comparator_int3 comparator(int(positions.size()));
-    std::map<int3, int, comparator_int3> connectivity_map(comparator); // stores map between original face index and final offset
-
+    return sizeof(obj_cache_header) + size_t(header.N_vertex) * (3 * sizeof(vec3) + sizeof(vec2)) + size_t(header.N_triangle) * sizeof(uint3);
+}
 
-    size_t const N_triangle = faces.size();
-    for(size_t k_triangle=0; k_triangle<N_triangle; ++k_triangle)
-    {
-        numarray_stack<int3,3> const& tri = faces[k_triangle];
-        uint3 new_triangle_index;
-        for(int k=0; k<3; ++k)
-        {
-            int3 const& index = tri[k];
-            auto const it = connectivity_map.find( index );
-            if( it==connectivity_map.end() ) {
+static bool obj_cache_read(std::string const& cache_filename, obj_cache_header const& expected, mesh& m)
+{
+    if (!check_file_exist(cache_filename) || file_get_size(cache_filename) < sizeof(obj_cache_header))
+        return false;
+
+    std::vector<char> const buffer = read_from_file_binary(cache_filename);
+    obj_cache_header header;
+    std::memcpy(&header, buffer.data(), sizeof(header));
+    if (std::memcmp(header.magic, expected.magic, 4) != 0 || header.version != expected.version
+        || header.source_size != expected.source_size || header.source_time != expected.source_time
+        || buffer.size() != obj_cache_size(header))
+        return false;
+
+    char const* it = buffer.data() + sizeof(header);
+    auto read = [&it](auto& attribute, size_t count) {
+        attribute.resize(count);
+        std::memcpy(attribute.data.data(), it, count * sizeof(attribute.data[0]));
+        it += count * sizeof(attribute.data[0]);
+    };
+    read(m.position, header.N_vertex);
+    read(m.normal, header.N_vertex);
+    read(m.color, header.N_vertex);
+    read(m.uv, header.N_vertex);
+    read(m.connectivity, header.N_triangle);
+    return true;
+}
 
-                size_t const offset = m.position.size();
-                connectivity_map[index] = int(offset);
-                new_triangle_index[k] = int(offset);
+static void obj_cache_write(std::string const& cache_filename, obj_cache_header header, mesh const& m)
+{
+    header.N_vertex = uint32_t(m.position.size());
+    header.N_triangle = uint32_t(m.connectivity.size());
 
-                int const idx_position = index[0];
+    std::ofstream stream(cache_filename, std::ios::out | std::ios::binary);
+    if (!stream.is_open()) {
+        warning_cgp("Cannot write the mesh cache " + cache_filename, "");
+        return;
+    }
+    stream.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    stream.write(reinterpret_cast<char const*>(m.position.data.data()), m.position.size() * sizeof(vec3));
+    stream.write(reinterpret_cast<char const*>(m.normal.data.data()), m.normal.size() * sizeof(vec3));
+    stream.write(reinterpret_cast<char const*>(m.color.data.data()), m.color.size() * sizeof(vec3));
+    stream.write(reinterpret_cast<char const*>(m.uv.data.data()), m.uv.size() * sizeof(vec2));
+    stream.write(reinterpret_cast<char const*>(m.connectivity.data.data()), m.connectivity.size() * sizeof(uint3));
+}
 
-                assert_cgp_no_msg( idx_position<int(positions.size()));
-                m.position.push_back( positions[idx_position] );
+mesh mesh_load_file_obj_cached(std::string const& filename)
+{
+    assert_file_exist(filename);
+    std::string const cache_filename = filename + ".cache";
 
-                if(type==loader::obj_type::vertex_texture_normal || type==loader::obj_type::vertex_texture) {
-                    int const idx_uv = index[1];
-                    assert_cgp_no_msg( idx_uv<int(texture_uv.size()) );
-                    m.uv.push_back( texture_uv[ idx_uv ] );
-                }
-                if(type==loader::obj_type::vertex_texture_normal || type==loader::obj_type::vertex_normal) {
-                    int const idx_normal = index[2];
-                    assert_cgp_no_msg( idx_normal<int(normals.size()) );
-                    m.normal.push_back( normals[idx_normal] );
-                }
+    obj_cache_header header;
+    bool const identified = obj_source_identity(filename, header.source_size, header.source_time);
 
-            }
-            else
-                new_triangle_index[k] = it->second;
-        }
-        m.connectivity.push_back(new_triangle_index);
-    }
+    mesh m;
+    if (identified && obj_cache_read(cache_filename, header, m))
+        return m;
 
-    return {m, connectivity_map};
+    m = mesh_load_file_obj(filename);
+    if (identified)
+        obj_cache_write(cache_filename, header, m);
+    return m;
 }
 
 
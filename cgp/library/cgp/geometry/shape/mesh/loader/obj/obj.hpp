@@ -13,6 +13,7 @@ namespace cgp
     void save_file_obj(std::string const& filename, std::vector<vec3> const& position, std::vector<vec3> const& normal);
 
     /** Load a mesh stored as .obj in the filename.
+    * The file is memory mapped and its chunks are parsed with the function set by set_mesh_parallel_for
     * Notes: 
     *  - Normals and UV are read, and vertices are duplicated if needed
     *  - .mtl files are not read with this loader (cannot read shading and color)
@@ -25,6 +26,10 @@ namespace cgp
     * Outputs the correspondance between the vertex index in the file, and the loaded one */
     mesh mesh_load_file_obj(std::string const& filename, numarray<numarray<int>>& vertex_correspondance);
 
+    /** Load a mesh stored as .obj through a binary cache stored next to it (filename.cache), read in a single pass
+    * The cache is rebuilt when it is missing, from another version of the format, or from another state of the .obj file */
+    mesh mesh_load_file_obj_cached(std::string const& filename);
+
 
 
 namespace loader{
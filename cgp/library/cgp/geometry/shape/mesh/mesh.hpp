@@ -2,4 +2,6 @@
 
 #include "structure/mesh.hpp"
 #include "primitive/mesh_primitive.hpp"
+#include "optimization/mesh_optimization.hpp"
+#include "simplification/mesh_simplification.hpp"
 #include "loader/loader.hpp"
\ No newline at end of file
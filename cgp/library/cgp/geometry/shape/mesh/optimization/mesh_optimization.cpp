@@ -0,0 +1,245 @@
+#include "mesh_optimization.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <vector>
+
+namespace cgp
+{
+	// Cache simulated by the reordering (larger than the real FIFO caches: the order stays good for them)
+	static int const forsyth_cache_size = 32;
+	static int const forsyth_max_valence = 32;
+
+	/** Score tables of the Forsyth algorithm
+	* - The vertices of the last triangle have a fixed score (a triangle sharing all of them would be a strip step)
+	* - Then the score decreases with the position in the LRU cache
+	* - Vertices with few remaining triangles are favored, to avoid leaving isolated triangles behind */
+	struct forsyth_scores
+	{
+		float cache[forsyth_cache_size];
+		float valence[forsyth_max_valence + 1];
+
+		forsyth_scores()
+		{
+			for (int k = 0; k < forsyth_cache_size; ++k)
+				cache[k] = k < 3 ? 0.75f : std::pow(1.0f - (k - 3) / float(forsyth_cache_size - 3), 1.5f);
+			valence[0] = -1.0f; // No triangle left: never a candidate
+			for (int k = 1; k <= forsyth_max_valence; ++k)
+				valence[k] = 2.0f / std::sqrt(float(k));
+		}
+
+		float operator()(int cache_position, int remaining_triangles) const
+		{
+			if (remaining_triangles == 0)
+				return valence[0];
+			float const cache_score = (cache_position >= 0 && cache_position < forsyth_cache_size) ? cache[cache_position] : 0.0f;
+			return cache_score + valence[std::min(remaining_triangles, forsyth_max_valence)];
+		}
+	};
+
+	float mesh_acmr(numarray<uint3> const& connectivity, int cache_size)
+	{
+		size_t const N_triangle = connectivity.size();
+		if (N_triangle == 0)
+			return 0.0f;
+
+		uint3 const* triangles = connectivity.data.data();
+		unsigned int N_vertex = 0;
+		for (size_t t = 0; t < N_triangle; ++t)
+			N_vertex = std::max({ N_vertex, triangles[t].x + 1, triangles[t].y + 1, triangles[t].z + 1 });
+
+		// A vertex is in the FIFO if less than cache_size misses happened since it entered it
+		std::vector<size_t> entry(N_vertex, 0);
+		std::vector<unsigned char> loaded(N_vertex, 0);
+		size_t misses = 0;
+		for (size_t t = 0; t < N_triangle; ++t)
+		{
+			unsigned int const corners[3] = { triangles[t].x, triangles[t].y, triangles[t].z };
+			for (unsigned int v : corners)
+			{
+				if (!loaded[v] || misses - entry[v] >= size_t(cache_size))
+				{
+					entry[v] = misses++;
+					loaded[v] = 1;
+				}
+			}
+		}
+
+		return float(misses) / float(N_triangle);
+	}
+
+	void mesh_optimize_vertex_cache(numarray<uint3>& connectivity, size_t N_vertex)
+	{
+		int const N_triangle = int(connectivity.size());
+		if (N_triangle == 0)
+			return;
+
+		static forsyth_scores const score;
+		uint3 const* triangles = connectivity.data.data();
+
+		// Triangles not emitted yet around each vertex: the first remaining[v] entries of its adjacency row
+		mesh_vertex_triangles adjacency = connectivity_vertex_triangles(connectivity, N_vertex);
+		int const* offset = adjacency.offset.data.data();
+		int* vertex_triangles = adjacency.triangle.data.data();
+
+		std::vector<int> remaining(N_vertex);
+		std::vector<int> cache_position(N_vertex, -1);
+		std::vector<float> vertex_score(N_vertex);
+		for (size_t v = 0; v < N_vertex; ++v)
+		{
+			remaining[v] = offset[v + 1] - offset[v];
+			vertex_score[v] = score(-1, remaining[v]);
+		}
+
+		auto triangle_score = [&](int t)
+		{
+			return vertex_score[triangles[t].x] + vertex_score[triangles[t].y] + vertex_score[triangles[t].z];
+		};
+
+		std::vector<unsigned char> emitted(N_triangle, 0);
+		std::vector<unsigned int> cache, next_cache;
+		cache.reserve(forsyth_cache_size + 3);
+		next_cache.reserve(forsyth_cache_size + 3);
+
+		numarray<uint3> reordered;
+		reordered.resize(N_triangle);
+
+		int best = 0;
+		float best_score = triangle_score(0);
+		for (int t = 1; t < N_triangle; ++t)
+		{
+			float const s = triangle_score(t);
+			if (s > best_score)
+			{
+				best = t;
+				best_score = s;
+			}
+		}
+
+		int cursor = 0; // Next triangle taken when no cached vertex has triangles left
+		for (int n = 0; n < N_triangle; ++n)
+		{
+			if (best < 0)
+			{
+				while (emitted[cursor])
+					++cursor;
+				best = cursor;
+			}
+
+			uint3 const& triangle = triangles[best];
+			reordered.data[n] = triangle;
+			emitted[best] = 1;
+
+			unsigned int const corners[3] = { triangle.x, triangle.y, triangle.z };
+			for (unsigned int v : corners)
+			{
+				int* row = vertex_triangles + offset[v];
+				int* found = std::find(row, row + remaining[v], best);
+				if (found != row + remaining[v])
+				{
+					std::swap(*found, row[remaining[v] - 1]);
+					--remaining[v];
+				}
+			}
+
+			// LRU update: the vertices of the triangle come first
+			next_cache.clear();
+			for (unsigned int v : corners)
+				if (std::find(next_cache.begin(), next_cache.end(), v) == next_cache.end())
+					next_cache.push_back(v);
+			for (unsigned int v : cache)
+				if (v != triangle.x && v != triangle.y && v != triangle.z)
+					next_cache.push_back(v);
+
+			for (size_t k = 0; k < next_cache.size(); ++k)
+			{
+				unsigned int const v = next_cache[k];
+				cache_position[v] = k < size_t(forsyth_cache_size) ? int(k) : -1;
+				vertex_score[v] = score(cache_position[v], remaining[v]);
+			}
+			if (next_cache.size() > size_t(forsyth_cache_size))
+				next_cache.resize(forsyth_cache_size);
+			std::swap(cache, next_cache);
+
+			// Best remaining triangle around the cached vertices
+			best = -1;
+			best_score = -1.0f;
+			for (unsigned int v : cache)
+			{
+				for (int k = 0; k < remaining[v]; ++k)
+				{
+					int const t = vertex_triangles[offset[v] + k];
+					float const s = triangle_score(t);
+					if (s > best_score)
+					{
+						best = t;
+						best_score = s;
+					}
+				}
+			}
+		}
+
+		connectivity = reordered;
+	}
+
+	template <typename T>
+	static void remap_vertex_attribute(numarray<T>& attribute, std::vector<unsigned int> const& remap)
+	{
+		if (attribute.size() != remap.size())
+			return; // Empty (or incoherent) field: left as is
+
+		std::vector<T> reordered(remap.size());
+		for (size_t k = 0; k < remap.size(); ++k)
+			reordered[remap[k]] = attribute.data[k];
+		attribute.data.swap(reordered);
+	}
+
+	void mesh_optimize_vertex_fetch(mesh& m)
+	{
+		size_t const N_vertex = m.position.size();
+		unsigned int const unused = ~0u;
+		std::vector<unsigned int> remap(N_vertex, unused);
+
+		unsigned int next = 0;
+		uint3* triangles = m.connectivity.data.data();
+		for (size_t t = 0; t < m.connectivity.size(); ++t)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				unsigned int& v = triangles[t][c];
+				if (remap[v] == unused)
+					remap[v] = next++;
+				v = remap[v];
+			}
+		}
+		for (unsigned int& r : remap)
+			if (r == unused)
+				r = next++;
+
+		remap_vertex_attribute(m.position, remap);
+		remap_vertex_attribute(m.normal, remap);
+		remap_vertex_attribute(m.color, remap);
+		remap_vertex_attribute(m.uv, remap);
+	}
+
+	mesh_optimization_report mesh_optimize(mesh& m)
+	{
+		mesh_optimization_report report;
+		report.acmr_before = mesh_acmr(m.connectivity);
+
+		mesh_optimize_vertex_cache(m.connectivity, m.position.size());
+		mesh_optimize_vertex_fetch(m);
+
+		report.acmr_after = mesh_acmr(m.connectivity);
+		report.index_bytes = m.position.size() <= 65536 ? 2 : 4;
+		return report;
+	}
+
+	std::string str(mesh_optimization_report const& report)
+	{
+		std::ostringstream s;
+		s << "ACMR " << report.acmr_before << " -> " << report.acmr_after << ", " << 8 * report.index_bytes << "-bit indices";
+		return s.str();
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "../structure/mesh.hpp"
+
+#include <string>
+
+namespace cgp
+{
+	/** Average Cache Miss Ratio: vertex shader invocations per triangle with a FIFO post-transform cache of the given size
+	* 3 for a triangle soup, 0.5 at best for a large regular grid */
+	float mesh_acmr(numarray<uint3> const& connectivity, int cache_size=16);
+
+	/** Reorder the triangles to reuse the vertices still in the post-transform cache (Forsyth linear-speed algorithm)
+	* The triangles keep their orientation. The vertices are not modified */
+	void mesh_optimize_vertex_cache(numarray<uint3>& connectivity, size_t N_vertex);
+
+	/** Reorder the vertices in the order of their first use by the triangles (sequential memory reads for the GPU)
+	* Every per-vertex attribute of the mesh is reordered. Unused vertices are kept at the end */
+	void mesh_optimize_vertex_fetch(mesh& m);
+
+	struct mesh_optimization_report
+	{
+		float acmr_before = 0.0f;
+		float acmr_after = 0.0f;
+		int index_bytes = 4; // Size of an index on the GPU: 2 when the vertex count allows 16-bit indices
+	};
+
+	/** Vertex cache then vertex fetch optimization. Call it on static meshes, before creating their mesh_drawable */
+	mesh_optimization_report mesh_optimize(mesh& m);
+
+	std::string str(mesh_optimization_report const& report);
+}
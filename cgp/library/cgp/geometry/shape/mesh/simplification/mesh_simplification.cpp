@@ -0,0 +1,480 @@
+#include "mesh_simplification.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace cgp
+{
+	namespace
+	{
+		// Weight of the planes that keep the seams and borders in place, relative to the surface planes
+		static double const simplification_border_weight = 10.0;
+
+		/** Sum of squared distances to planes: Q(p) = p^T A p + 2 b.p + c, with the sum of the plane weights */
+		struct simplification_quadric
+		{
+			double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+			double b0 = 0, b1 = 0, b2 = 0;
+			double c = 0;
+			double weight = 0;
+
+			void add_plane(double nx, double ny, double nz, double d, double w)
+			{
+				a00 += w * nx * nx; a01 += w * nx * ny; a02 += w * nx * nz;
+				a11 += w * ny * ny; a12 += w * ny * nz; a22 += w * nz * nz;
+				b0 += w * nx * d; b1 += w * ny * d; b2 += w * nz * d;
+				c += w * d * d;
+				weight += w;
+			}
+
+			void add(simplification_quadric const& q)
+			{
+				a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+				b0 += q.b0; b1 += q.b1; b2 += q.b2;
+				c += q.c;
+				weight += q.weight;
+			}
+
+			// Mean squared distance of p to the planes
+			double error(vec3 const& p) const
+			{
+				double const x = p.x, y = p.y, z = p.z;
+				double const q = a00 * x * x + a11 * y * y + a22 * z * z + 2 * (a01 * x * y + a02 * x * z + a12 * y * z) + 2 * (b0 * x + b1 * y + b2 * z) + c;
+				return weight > 0 ? std::max(q, 0.0) / weight : 0.0;
+			}
+		};
+
+		// Positions closer than this fraction of the mesh size are welded (seams built with cos/sin of -Pi and Pi differ by rounding)
+		static float const simplification_weld_tolerance = 1e-5f;
+
+		struct simplification_weld_key
+		{
+			long long x, y, z;
+			bool operator<(simplification_weld_key const& k) const { return x != k.x ? x < k.x : y != k.y ? y < k.y : z < k.z; }
+			bool operator!=(simplification_weld_key const& k) const { return x != k.x || y != k.y || z != k.z; }
+		};
+
+		/** State of a simplification. Triangles index the vertices of the input ("wedges"); the collapses work on
+		* the welded vertices (one per distinct position), and remap the wedges of the removed vertex */
+		class mesh_simplifier
+		{
+		public:
+			explicit mesh_simplifier(mesh const& m);
+
+			// Collapse edges until target_triangles remain, or the next collapse exceeds max_error (if >= 0)
+			void simplify(size_t target_triangles, float max_error);
+
+			mesh extract() const;
+			size_t triangle_count() const { return corners.size() / 3; }
+			float error() const { return float(std::sqrt(max_error2)); }
+
+		private:
+			struct candidate
+			{
+				double cost;
+				unsigned int from, to; // Welded vertices: from moves onto to
+			};
+
+			static unsigned int next_corner(unsigned int k) { return k - k % 3 + (k + 1) % 3; }
+
+			// Corners whose edge (to the next corner of the triangle) is on an open border, or on a seam: the wedges
+			// of both of its vertices differ across it. Wedges differing at one vertex only are a singular point (pole of
+			// a sphere) and don't constrain the edge
+			std::vector<unsigned int> seam_corners() const;
+
+			// One collapse pass on the current triangles, at most max_collapses. Returns the number of collapses done
+			size_t pass(size_t max_collapses, double max_cost);
+
+			vec3 welded_position(unsigned int w) const { return source.position[wedge_of[w]]; }
+
+			mesh const& source;
+			std::vector<unsigned int> weld;       // Welded vertex of each wedge
+			std::vector<unsigned int> wedge_of;   // One wedge of each welded vertex
+			std::vector<unsigned int> corners;    // 3 wedges per remaining triangle
+			std::vector<simplification_quadric> quadrics; // Per welded vertex
+			double max_error2 = 0;
+		};
+
+		mesh_simplifier::mesh_simplifier(mesh const& m) : source(m)
+		{
+			size_t const N_wedge = m.position.size();
+			vec3 const* p = m.position.data.data();
+
+			// Weld the wedges by quantized position
+			vec3 p_min, p_max;
+			m.get_bounding_box_position(p_min, p_max);
+			float const cell = std::max(simplification_weld_tolerance * norm(p_max - p_min), 1e-20f);
+			std::vector<simplification_weld_key> keys(N_wedge);
+			for (size_t k = 0; k < N_wedge; ++k)
+				keys[k] = { std::llround(p[k].x / cell), std::llround(p[k].y / cell), std::llround(p[k].z / cell) };
+
+			std::vector<unsigned int> order(N_wedge);
+			for (size_t k = 0; k < N_wedge; ++k)
+				order[k] = (unsigned int)k;
+			std::sort(order.begin(), order.end(), [&keys](unsigned int a, unsigned int b) { return keys[a] < keys[b]; });
+
+			weld.resize(N_wedge);
+			for (size_t k = 0; k < N_wedge; ++k)
+			{
+				if (k == 0 || keys[order[k - 1]] != keys[order[k]])
+					wedge_of.push_back(order[k]);
+				weld[order[k]] = (unsigned int)(wedge_of.size() - 1);
+			}
+
+			// Triangles degenerate once welded (poles of spheres) are dropped
+			corners.reserve(3 * m.connectivity.size());
+			for (uint3 const& t : m.connectivity.data)
+			{
+				if (weld[t.x] == weld[t.y] || weld[t.y] == weld[t.z] || weld[t.z] == weld[t.x])
+					continue;
+				corners.push_back(t.x);
+				corners.push_back(t.y);
+				corners.push_back(t.z);
+			}
+
+			// Area weighted planes of the triangles
+			quadrics.resize(wedge_of.size());
+			for (size_t t = 0; t < corners.size() / 3; ++t)
+			{
+				vec3 const& p0 = p[corners[3 * t]];
+				vec3 const& p1 = p[corners[3 * t + 1]];
+				vec3 const& p2 = p[corners[3 * t + 2]];
+				vec3 const n = cross(p1 - p0, p2 - p0);
+				double const length = std::sqrt(double(n.x) * n.x + double(n.y) * n.y + double(n.z) * n.z);
+				if (length <= 0)
+					continue;
+				double const nx = n.x / length, ny = n.y / length, nz = n.z / length;
+				double const d = -(nx * p0.x + ny * p0.y + nz * p0.z);
+				for (int c = 0; c < 3; ++c)
+					quadrics[weld[corners[3 * t + c]]].add_plane(nx, ny, nz, d, 0.5 * length);
+			}
+
+			// Planes orthogonal to the triangles along the seams and borders (one per side of a seam)
+			for (unsigned int corner : seam_corners())
+			{
+				unsigned int const t = corner / 3;
+				vec3 const& pa = p[corners[corner]];
+				vec3 const& pb = p[corners[3 * t + (corner % 3 + 1) % 3]];
+				vec3 const& pc = p[corners[3 * t + (corner % 3 + 2) % 3]];
+				vec3 const e = pb - pa;
+				vec3 const n = cross(cross(e, pc - pa), e);
+				double const length = std::sqrt(double(n.x) * n.x + double(n.y) * n.y + double(n.z) * n.z);
+				if (length <= 0)
+					continue;
+				double const nx = n.x / length, ny = n.y / length, nz = n.z / length;
+				double const d = -(nx * pa.x + ny * pa.y + nz * pa.z);
+				double const w = simplification_border_weight * dot(e, e);
+				quadrics[weld[corners[corner]]].add_plane(nx, ny, nz, d, w);
+				quadrics[weld[corners[3 * t + (corner % 3 + 1) % 3]]].add_plane(nx, ny, nz, d, w);
+			}
+		}
+
+		std::vector<unsigned int> mesh_simplifier::seam_corners() const
+		{
+			std::vector<std::pair<unsigned long long, unsigned int> > edges(corners.size());
+			for (size_t k = 0; k < corners.size(); ++k)
+			{
+				unsigned long long const a = weld[corners[k]], b = weld[corners[next_corner((unsigned int)k)]];
+				edges[k] = { std::min(a, b) << 32 | std::max(a, b), (unsigned int)k };
+			}
+			std::sort(edges.begin(), edges.end());
+
+			std::vector<unsigned int> result;
+			for (size_t begin = 0, end = 0; begin < edges.size(); begin = end)
+			{
+				while (end < edges.size() && edges[end].first == edges[begin].first)
+					++end;
+				unsigned int const low = (unsigned int)(edges[begin].first >> 32);
+
+				bool seam = end - begin == 1;
+				for (size_t x = begin; x < end && !seam; ++x)
+				{
+					for (size_t y = x + 1; y < end && !seam; ++y)
+					{
+						unsigned int const cx = edges[x].second, cy = edges[y].second;
+						unsigned int const x_low = weld[corners[cx]] == low ? corners[cx] : corners[next_corner(cx)];
+						unsigned int const x_high = weld[corners[cx]] == low ? corners[next_corner(cx)] : corners[cx];
+						unsigned int const y_low = weld[corners[cy]] == low ? corners[cy] : corners[next_corner(cy)];
+						unsigned int const y_high = weld[corners[cy]] == low ? corners[next_corner(cy)] : corners[cy];
+						seam = x_low != y_low && x_high != y_high;
+					}
+				}
+				if (seam)
+					for (size_t k = begin; k < end; ++k)
+						result.push_back(edges[k].second);
+			}
+			return result;
+		}
+
+		size_t mesh_simplifier::pass(size_t max_collapses, double max_cost)
+		{
+			size_t const N_triangle = corners.size() / 3;
+			size_t const N_welded = wedge_of.size();
+			vec3 const* p = source.position.data.data();
+			bool const has_uv = source.uv.size() == source.position.size();
+
+			// Triangles around each welded vertex (compressed rows)
+			std::vector<int> offset(N_welded + 1, 0);
+			for (unsigned int corner : corners)
+				offset[weld[corner] + 1]++;
+			for (size_t v = 0; v < N_welded; ++v)
+				offset[v + 1] += offset[v];
+			std::vector<int> around(corners.size());
+			{
+				std::vector<int> fill(offset.begin(), offset.end() - 1);
+				for (size_t k = 0; k < corners.size(); ++k)
+					around[fill[weld[corners[k]]]++] = int(k / 3);
+			}
+
+			// Welded edges on a seam or a border
+			std::vector<unsigned long long> seam_edges;
+			for (unsigned int corner : seam_corners())
+			{
+				unsigned long long const a = weld[corners[corner]], b = weld[corners[next_corner(corner)]];
+				seam_edges.push_back(std::min(a, b) << 32 | std::max(a, b));
+			}
+			std::sort(seam_edges.begin(), seam_edges.end());
+			seam_edges.erase(std::unique(seam_edges.begin(), seam_edges.end()), seam_edges.end());
+
+			// Seam vertices slide along their seam: more than 2 seam neighbors (corner of a seam) is locked
+			std::vector<unsigned char> seam_neighbors(N_welded, 0);
+			for (unsigned long long e : seam_edges)
+			{
+				seam_neighbors[e >> 32] = (unsigned char)std::min(seam_neighbors[e >> 32] + 1, 3);
+				seam_neighbors[e & 0xFFFFFFFFull] = (unsigned char)std::min(seam_neighbors[e & 0xFFFFFFFFull] + 1, 3);
+			}
+			auto is_seam_edge = [&](unsigned long long a, unsigned long long b) {
+				return std::binary_search(seam_edges.begin(), seam_edges.end(), std::min(a, b) << 32 | std::max(a, b));
+			};
+			auto can_move = [&](unsigned int from, unsigned int to) {
+				if (seam_neighbors[from] == 0)
+					return true;
+				return seam_neighbors[from] < 3 && is_seam_edge(from, to);
+			};
+
+			// Cheapest direction of every welded edge
+			std::vector<candidate> candidates;
+			candidates.reserve(corners.size() / 2);
+			for (size_t k = 0; k < corners.size(); ++k)
+			{
+				// Inner edges are seen from both triangles: the second one is skipped when its vertices are touched
+				unsigned int const a = std::min(weld[corners[k]], weld[corners[next_corner((unsigned int)k)]]);
+				unsigned int const b = std::max(weld[corners[k]], weld[corners[next_corner((unsigned int)k)]]);
+				simplification_quadric q = quadrics[a];
+				q.add(quadrics[b]);
+
+				candidate best = { -1.0, 0, 0 };
+				if (can_move(a, b))
+					best = { q.error(welded_position(b)), a, b };
+				if (can_move(b, a))
+				{
+					double const cost = q.error(welded_position(a));
+					if (best.cost < 0 || cost < best.cost)
+						best = { cost, b, a };
+				}
+				if (best.cost >= 0 && (max_cost < 0 || best.cost <= max_cost))
+					candidates.push_back(best);
+			}
+			std::sort(candidates.begin(), candidates.end(), [](candidate const& x, candidate const& y) {
+				return x.cost != y.cost ? x.cost < y.cost : x.from != y.from ? x.from < y.from : x.to < y.to;
+			});
+
+			std::vector<unsigned char> touched(N_welded, 0);
+			std::vector<unsigned int> wedge_remap(source.position.size());
+			for (size_t k = 0; k < wedge_remap.size(); ++k)
+				wedge_remap[k] = (unsigned int)k;
+
+			std::vector<std::pair<unsigned int, unsigned int> > wedge_pairs; // (wedge of from, wedge of to) sharing a triangle
+			std::vector<unsigned int> from_wedges;
+			size_t collapses = 0;
+			for (candidate const& edge : candidates)
+			{
+				if (collapses >= max_collapses)
+					break;
+				unsigned int const a = edge.from, b = edge.to;
+				if (touched[a] || touched[b])
+					continue;
+
+				// The triangles that remain around a must not flip
+				vec3 const& pb = welded_position(b);
+				bool flip = false;
+				wedge_pairs.clear();
+				from_wedges.clear();
+				for (int k = offset[a]; k < offset[a + 1] && !flip; ++k)
+				{
+					unsigned int const* t = &corners[3 * around[k]];
+					int c_from = 0, c_to = -1;
+					for (int c = 0; c < 3; ++c)
+					{
+						if (weld[t[c]] == a) c_from = c;
+						if (weld[t[c]] == b) c_to = c;
+					}
+					from_wedges.push_back(t[c_from]);
+					if (c_to >= 0)
+					{
+						wedge_pairs.push_back({ t[c_from], t[c_to] });
+						continue; // Removed by the collapse
+					}
+
+					vec3 const& p1 = p[t[(c_from + 1) % 3]];
+					vec3 const& p2 = p[t[(c_from + 2) % 3]];
+					vec3 const n_before = cross(p1 - p[t[c_from]], p2 - p[t[c_from]]);
+					vec3 const n_after = cross(p1 - pb, p2 - pb);
+					flip = dot(n_before, n_after) <= 0.25f * norm(n_before) * norm(n_after);
+				}
+				if (flip)
+					continue;
+
+				// Each wedge of a takes the wedge of b on its side of the seams (closest uv at singular points like the poles)
+				bool mapped = true;
+				std::sort(from_wedges.begin(), from_wedges.end());
+				from_wedges.erase(std::unique(from_wedges.begin(), from_wedges.end()), from_wedges.end());
+				for (unsigned int w : from_wedges)
+				{
+					int target = -1;
+					float best_distance = 0;
+					for (auto const& pair : wedge_pairs)
+					{
+						if (pair.first != w)
+							continue;
+						float const distance = has_uv ? norm(source.uv[pair.second] - source.uv[w]) : 0.0f;
+						if (target < 0 || distance < best_distance)
+						{
+							target = int(pair.second);
+							best_distance = distance;
+						}
+					}
+					if (target < 0)
+					{
+						mapped = false;
+						break;
+					}
+					wedge_remap[w] = (unsigned int)target;
+				}
+				if (!mapped)
+				{
+					for (unsigned int w : from_wedges)
+						wedge_remap[w] = w;
+					continue;
+				}
+
+				// The one ring of a changes: its vertices wait for the next pass
+				for (int k = offset[a]; k < offset[a + 1]; ++k)
+					for (int c = 0; c < 3; ++c)
+						touched[weld[corners[3 * around[k] + c]]] = 1;
+
+				quadrics[b].add(quadrics[a]);
+				max_error2 = std::max(max_error2, edge.cost);
+				collapses++;
+			}
+
+			// Apply the wedge remap and drop the collapsed triangles
+			size_t kept = 0;
+			for (size_t t = 0; t < N_triangle; ++t)
+			{
+				unsigned int const w0 = wedge_remap[corners[3 * t]], w1 = wedge_remap[corners[3 * t + 1]], w2 = wedge_remap[corners[3 * t + 2]];
+				if (weld[w0] == weld[w1] || weld[w1] == weld[w2] || weld[w2] == weld[w0])
+					continue;
+				corners[3 * kept] = w0;
+				corners[3 * kept + 1] = w1;
+				corners[3 * kept + 2] = w2;
+				kept++;
+			}
+			corners.resize(3 * kept);
+
+			return collapses;
+		}
+
+		void mesh_simplifier::simplify(size_t target_triangles, float max_error)
+		{
+			double const max_cost = max_error < 0 ? -1.0 : double(max_error) * max_error;
+			while (triangle_count() > target_triangles)
+			{
+				// A collapse removes 2 triangles in general
+				size_t const max_collapses = (triangle_count() - target_triangles + 1) / 2;
+				if (pass(max_collapses, max_cost) == 0)
+					break;
+			}
+		}
+
+		mesh mesh_simplifier::extract() const
+		{
+			size_t const N_wedge = source.position.size();
+			std::vector<unsigned int> index(N_wedge, ~0u);
+			std::vector<unsigned int> used;
+			for (unsigned int w : corners)
+			{
+				if (index[w] == ~0u)
+				{
+					index[w] = (unsigned int)used.size();
+					used.push_back(w);
+				}
+			}
+
+			mesh result;
+			result.position.resize(used.size());
+			for (size_t k = 0; k < used.size(); ++k)
+				result.position.data[k] = source.position.data[used[k]];
+			if (size_t(source.normal.size()) == N_wedge) {
+				result.normal.resize(used.size());
+				for (size_t k = 0; k < used.size(); ++k)
+					result.normal.data[k] = source.normal.data[used[k]];
+			}
+			if (size_t(source.color.size()) == N_wedge) {
+				result.color.resize(used.size());
+				for (size_t k = 0; k < used.size(); ++k)
+					result.color.data[k] = source.color.data[used[k]];
+			}
+			if (size_t(source.uv.size()) == N_wedge) {
+				result.uv.resize(used.size());
+				for (size_t k = 0; k < used.size(); ++k)
+					result.uv.data[k] = source.uv.data[used[k]];
+			}
+
+			result.connectivity.resize(corners.size() / 3);
+			for (size_t t = 0; t < corners.size() / 3; ++t)
+				result.connectivity.data[t] = { index[corners[3 * t]], index[corners[3 * t + 1]], index[corners[3 * t + 2]] };
+			return result;
+		}
+	}
+
+	mesh mesh_simplify(mesh const& m, float target_ratio, float max_error, float* error)
+	{
+		if (error != nullptr)
+			*error = 0.0f;
+		if (m.position.size() == 0 || m.connectivity.size() == 0)
+			return m;
+
+		mesh_simplifier simplifier(m);
+		simplifier.simplify(size_t(target_ratio * m.connectivity.size()), max_error);
+		if (error != nullptr)
+			*error = simplifier.error();
+		return simplifier.extract();
+	}
+
+	numarray<mesh> mesh_lod_chain(mesh const& m, int level_count, float ratio, numarray<float>* errors)
+	{
+		numarray<mesh> levels;
+		if (errors != nullptr)
+			errors->clear();
+		if (level_count <= 0 || m.position.size() == 0 || m.connectivity.size() == 0)
+			return levels;
+
+		levels.push_back(m);
+		if (errors != nullptr)
+			errors->push_back(0.0f);
+
+		mesh_simplifier simplifier(m);
+		float target = float(m.connectivity.size());
+		for (int level = 1; level < level_count; ++level)
+		{
+			target *= ratio;
+			simplifier.simplify(size_t(target), -1.0f);
+			levels.push_back(simplifier.extract());
+			if (errors != nullptr)
+				errors->push_back(simplifier.error());
+		}
+		return levels;
+	}
+}
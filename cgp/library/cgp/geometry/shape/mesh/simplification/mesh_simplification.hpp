@@ -0,0 +1,19 @@
+#pragma once
+
+#include "../structure/mesh.hpp"
+
+namespace cgp
+{
+	/** Simplified copy of a mesh, by edge collapses ordered by their quadric error (Garland-Heckbert)
+	* Each collapse moves a vertex onto one of its neighbors, so the attributes of the remaining vertices are unchanged.
+	* Vertices at the same position are handled as one: UV seams and open borders are kept, their vertices only slide along them.
+	* @target_ratio: fraction of the triangles to keep
+	* @max_error: stop before a collapse farther than this distance to the original surface (negative: no limit)
+	* @error: if not null, receives the error of the result (distance, in the units of the positions) */
+	mesh mesh_simplify(mesh const& m, float target_ratio, float max_error=-1.0f, float* error=nullptr);
+
+	/** Chain of levels of detail: level k keeps about ratio^k of the triangles, level 0 is the input mesh
+	* The levels are successive stages of the same simplification, so their errors are all relative to the input
+	* @errors: if not null, receives the error of each level (0 for level 0) */
+	numarray<mesh> mesh_lod_chain(mesh const& m, int level_count, float ratio=0.25f, numarray<float>* errors=nullptr);
+}
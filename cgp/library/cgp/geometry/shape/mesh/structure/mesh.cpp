@@ -2,7 +2,14 @@
 
 
 
-#include <set>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CGP_MESH_SSE
+#endif
 
 namespace cgp
 {
@@ -45,67 +52,250 @@ namespace cgp
 	}
 
 
-	void normal_per_vertex(numarray<vec3> const& position, numarray<uint3> const& connectivity, numarray<vec3>& normals, bool invert)
+	static mesh_parallel_for_function mesh_parallel_for;
+
+	void set_mesh_parallel_for(mesh_parallel_for_function const& parallel_for)
 	{
-		size_t const N = position.size();
-		if(normals.size()!=N)
-			normals.resize(N);
-		else
-			normals.fill(vec3{0,0,0});
+		mesh_parallel_for = parallel_for;
+	}
 
-		size_t const N_tri = connectivity.size();
-		for (size_t k_tri = 0; k_tri < N_tri; ++k_tri)
+	// Run func(begin, end) over [0, count[, in parallel if a parallel_for was set
+	void mesh_for(int count, std::function<void(int, int)> const& func, int min_chunk_size)
+	{
+		if (mesh_parallel_for && count > min_chunk_size)
+			mesh_parallel_for(count, func, min_chunk_size);
+		else if (count > 0)
+			func(0, count);
+	}
+
+	// Below this number of triangles, the normals are accumulated directly (no adjacency)
+	static int const normal_gather_min_triangles = 8192;
+	// Triangles / vertices per parallel job
+	static int const normal_chunk_size = 4096;
+	// Triangles computed together: the loops over a block have a fixed size and are vectorized by the compiler
+	static int const normal_block_size = 8;
+
+	// Unit normal of the triangles [begin, end[ (0 for degenerate triangles: edges of length 0 or aligned)
+	static void triangle_normals(vec3 const* position, uint3 const* connectivity, vec3* triangle_normal, int begin, int end)
+	{
+		for (int k0 = begin; k0 < end; k0 += normal_block_size)
 		{
-			uint3 const& face = connectivity.at(k_tri);
+			int const block = std::min(normal_block_size, end - k0);
 
-			//sanity check
-			assert_cgp_no_msg(get<0>(face)<N);
-			assert_cgp_no_msg(get<1>(face)<N);
-			assert_cgp_no_msg(get<2>(face)<N);
+			// Edges of the block, as structure of arrays
+			float e1x[normal_block_size] = {}, e1y[normal_block_size] = {}, e1z[normal_block_size] = {};
+			float e2x[normal_block_size] = {}, e2y[normal_block_size] = {}, e2z[normal_block_size] = {};
+			for (int b = 0; b < block; ++b)
+			{
+				uint3 const& face = connectivity[k0 + b];
+				vec3 const& p0 = position[face.x];
+				vec3 const& p1 = position[face.y];
+				vec3 const& p2 = position[face.z];
+				e1x[b] = p1.x - p0.x; e1y[b] = p1.y - p0.y; e1z[b] = p1.z - p0.z;
+				e2x[b] = p2.x - p0.x; e2y[b] = p2.y - p0.y; e2z[b] = p2.z - p0.z;
+			}
 
-			vec3 const& p0 = position.at(get<0>(face));
-			vec3 const& p1 = position.at(get<1>(face));
-			vec3 const& p2 = position.at(get<2>(face));
+			float nx[normal_block_size], ny[normal_block_size], nz[normal_block_size];
+#ifdef CGP_MESH_SSE
+			// 4 triangles at a time. Same operations as the scalar version: the result is identical
+			for (int b = 0; b < normal_block_size; b += 4)
+			{
+				__m128 const ax = _mm_loadu_ps(e1x + b), ay = _mm_loadu_ps(e1y + b), az = _mm_loadu_ps(e1z + b);
+				__m128 const bx = _mm_loadu_ps(e2x + b), by = _mm_loadu_ps(e2y + b), bz = _mm_loadu_ps(e2z + b);
+				__m128 const epsilon = _mm_set1_ps(1e-6f);
+				__m128 const one = _mm_set1_ps(1.0f);
+
+				__m128 const L1 = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, ax), _mm_mul_ps(ay, ay)), _mm_mul_ps(az, az)));
+				__m128 const L2 = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(bx, bx), _mm_mul_ps(by, by)), _mm_mul_ps(bz, bz)));
+				__m128 const s1 = _mm_and_ps(_mm_cmpgt_ps(L1, epsilon), _mm_div_ps(one, L1));
+				__m128 const s2 = _mm_and_ps(_mm_cmpgt_ps(L2, epsilon), _mm_div_ps(one, L2));
+
+				__m128 const cx = _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by)), s1), s2);
+				__m128 const cy = _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(ax, bz)), s1), s2);
+				__m128 const cz = _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(ay, bx)), s1), s2);
+				__m128 const Ln = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, cx), _mm_mul_ps(cy, cy)), _mm_mul_ps(cz, cz)));
+				__m128 const sn = _mm_and_ps(_mm_cmpgt_ps(Ln, epsilon), _mm_div_ps(one, Ln));
+
+				_mm_storeu_ps(nx + b, _mm_mul_ps(cx, sn));
+				_mm_storeu_ps(ny + b, _mm_mul_ps(cy, sn));
+				_mm_storeu_ps(nz + b, _mm_mul_ps(cz, sn));
+			}
+#else
+			for (int b = 0; b < normal_block_size; ++b)
+			{
+				float const L1 = std::sqrt(e1x[b] * e1x[b] + e1y[b] * e1y[b] + e1z[b] * e1z[b]);
+				float const L2 = std::sqrt(e2x[b] * e2x[b] + e2y[b] * e2y[b] + e2z[b] * e2z[b]);
+				float const s1 = L1 > 1e-6f ? 1.0f / L1 : 0.0f;
+				float const s2 = L2 > 1e-6f ? 1.0f / L2 : 0.0f;
+
+				// Cross product of the unit edges
+				float const cx = (e1y[b] * e2z[b] - e1z[b] * e2y[b]) * s1 * s2;
+				float const cy = (e1z[b] * e2x[b] - e1x[b] * e2z[b]) * s1 * s2;
+				float const cz = (e1x[b] * e2y[b] - e1y[b] * e2x[b]) * s1 * s2;
+				float const Ln = std::sqrt(cx * cx + cy * cy + cz * cz);
+				float const sn = Ln > 1e-6f ? 1.0f / Ln : 0.0f;
+
+				nx[b] = cx * sn; ny[b] = cy * sn; nz[b] = cz * sn;
+			}
+#endif
 
-			// compute normal of the triangle
-			vec3 const p10 = p1-p0;
-			vec3 const p20 = p2-p0;
+			for (int b = 0; b < block; ++b)
+				triangle_normal[k0 + b] = {nx[b], ny[b], nz[b]};
+		}
+	}
 
-			float const L10 = norm(p10);
-			float const L20 = norm(p20);
+	// Normal of a vertex: normalized sum of the normals of its triangles
+	static vec3 gather_normal(mesh_normal_cache const& cache, int vertex)
+	{
+		vec3 n = {0, 0, 0};
+		int const* offset = cache.adjacency.offset.data.data();
+		int const* triangle = cache.adjacency.triangle.data.data();
+		vec3 const* triangle_normal = cache.triangle_normal.data.data();
+		for (int k = offset[vertex]; k < offset[vertex + 1]; ++k)
+		{
+			vec3 const& t = triangle_normal[triangle[k]];
+			n.x += t.x; n.y += t.y; n.z += t.z;
+		}
+
+		float const L = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+		if (L > 1e-6f)
+			n /= L;
+		return cache.invert ? -n : n;
+	}
 
-			// Add the normal direction to all vertices of this triangle
-			//  (only if the triangle is not degenerated: norm of edges>0, edges not aligned)
-			if (L10 > 1e-6f && L20 > 1e-6f)
+	void normal_per_vertex(numarray<vec3> const& position, numarray<uint3> const& connectivity, numarray<vec3>& normals, mesh_normal_cache& cache, bool invert)
+	{
+		int const N = int(position.size());
+		int const N_tri = int(connectivity.size());
+		normals.resize(N);
+
+		cache.adjacency = connectivity_vertex_triangles(connectivity, N);
+		cache.triangle_normal.resize(N_tri);
+		cache.invert = invert;
+		cache.triangle_mark.clear();
+		cache.vertex_mark.clear();
+		cache.mark = 0;
+
+		vec3 const* p = position.data.data();
+		uint3 const* tri = connectivity.data.data();
+		vec3* tn = cache.triangle_normal.data.data();
+		mesh_for(N_tri, [&](int begin, int end) { triangle_normals(p, tri, tn, begin, end); }, normal_chunk_size);
+
+		vec3* n = normals.data.data();
+		mesh_for(N, [&](int begin, int end) {
+			for (int k = begin; k < end; ++k)
+				n[k] = gather_normal(cache, k);
+		}, normal_chunk_size);
+	}
+
+	void normal_per_vertex_update(numarray<vec3> const& position, numarray<uint3> const& connectivity, numarray<vec3>& normals, mesh_normal_cache& cache, numarray<unsigned int> const& moved_vertices)
+	{
+		assert_cgp(cache.triangle_normal.size() == connectivity.size() && cache.adjacency.offset.size() == position.size() + 1, "The normal cache doesn't match the mesh: call normal_per_vertex first");
+
+		if (cache.triangle_mark.size() != connectivity.size())
+			cache.triangle_mark.resize(connectivity.size()).fill(0);
+		if (cache.vertex_mark.size() != position.size())
+			cache.vertex_mark.resize(position.size()).fill(0);
+		cache.mark++;
+
+		// Triangles around the moved vertices, then the vertices of these triangles (the one ring of the moved vertices)
+		int const* offset = cache.adjacency.offset.data.data();
+		int const* adjacent = cache.adjacency.triangle.data.data();
+		unsigned int* triangle_mark = cache.triangle_mark.data.data();
+		unsigned int* vertex_mark = cache.vertex_mark.data.data();
+		std::vector<int> triangles;
+		std::vector<int> vertices;
+		for (unsigned int vertex : moved_vertices)
+		{
+			for (int k = offset[vertex]; k < offset[vertex + 1]; ++k)
 			{
-				vec3 const n = cross(p10/L10, p20/L20);
-				float const Ln = norm(n);
+				int const t = adjacent[k];
+				if (triangle_mark[t] == cache.mark)
+					continue;
+				triangle_mark[t] = cache.mark;
+				triangles.push_back(t);
 
-				if (Ln > 1e-6f)
+				for (unsigned int v : connectivity.data[t])
 				{
-					vec3 const n_unit = n/Ln;
-					for(unsigned int idx : face)
-						normals.at(idx) += n_unit;
+					if (vertex_mark[v] != cache.mark)
+					{
+						vertex_mark[v] = cache.mark;
+						vertices.push_back(v);
+					}
 				}
+			}
+		}
 
+		vec3 const* p = position.data.data();
+		uint3 const* tri = connectivity.data.data();
+		vec3* tn = cache.triangle_normal.data.data();
+		mesh_for(int(triangles.size()), [&](int begin, int end) {
+			for (int k = begin; k < end; ++k)
+				triangle_normals(p, tri, tn, triangles[k], triangles[k] + 1);
+		}, normal_chunk_size);
+
+		vec3* n = normals.data.data();
+		mesh_for(int(vertices.size()), [&](int begin, int end) {
+			for (int k = begin; k < end; ++k)
+				n[vertices[k]] = gather_normal(cache, vertices[k]);
+		}, normal_chunk_size);
+	}
 
+	void normal_per_vertex(numarray<vec3> const& position, numarray<uint3> const& connectivity, numarray<vec3>& normals, bool invert)
+	{
+		size_t const N = position.size();
+		size_t const N_tri = connectivity.size();
+
+		// Large meshes, with threads: gather per vertex, in parallel
+		if (mesh_parallel_for && N_tri >= size_t(normal_gather_min_triangles))
+		{
+			mesh_normal_cache cache;
+			normal_per_vertex(position, connectivity, normals, cache, invert);
+			return;
+		}
+
+		if(normals.size()!=N)
+			normals.resize(N);
+		normals.fill(vec3{0,0,0});
+
+		// Add the normal direction to all vertices of each triangle, computed by blocks
+		vec3* n = normals.data.data();
+		uint3 const* tri = connectivity.data.data();
+		for (size_t k0 = 0; k0 < N_tri; k0 += normal_block_size)
+		{
+			int const block = int(std::min(size_t(normal_block_size), N_tri - k0));
+			vec3 triangle_normal[normal_block_size];
+			triangle_normals(position.data.data(), tri + k0, triangle_normal, 0, block);
+
+			for (int b = 0; b < block; ++b)
+			{
+				uint3 const& face = tri[k0 + b];
+
+				//sanity check
+				assert_cgp_no_msg(get<0>(face)<N);
+				assert_cgp_no_msg(get<1>(face)<N);
+				assert_cgp_no_msg(get<2>(face)<N);
+
+				vec3 const& t = triangle_normal[b];
+				for(unsigned int idx : face)
+				{
+					n[idx].x += t.x; n[idx].y += t.y; n[idx].z += t.z;
+				}
 			}
 		}
 
 		// Normalize all normals
 		for (size_t k = 0; k < N; ++k)
 		{
-			vec3& n = normals.at(k);
-			float const L = norm(n);
+			float const L = std::sqrt(n[k].x * n[k].x + n[k].y * n[k].y + n[k].z * n[k].z);
 			if(L>1e-6f)
-				n /= L;
+				n[k] /= L;
 		}
 
 		// Invert normals if asked
 		if(invert) for(auto& n : normals) n = -n;
-
-			
 	}
+
 	numarray<vec3> normal_per_vertex(numarray<vec3> const& position, numarray<uint3> const& connectivity, bool invert)
 	{
 		numarray<vec3> normals;
@@ -261,29 +451,55 @@ namespace cgp
 	}
 
 
-	numarray<numarray<int> > connectivity_one_ring(numarray<uint3> const& connectivity)
+	mesh_vertex_triangles connectivity_vertex_triangles(numarray<uint3> const& connectivity, size_t N_vertex)
 	{
-		size_t const N = connectivity.size();
-		numarray<std::set<int> > one_ring;
-		one_ring.resize(N);
-		for (size_t k = 0; k < N; ++k)
-		{
-			uint3 const& tri = connectivity[k];
-			one_ring[ get<0>(tri) ].insert( get<1>(tri) );
-			one_ring[ get<0>(tri) ].insert( get<2>(tri) );
+		size_t const N_tri = connectivity.size();
+		mesh_vertex_triangles adjacency;
+		adjacency.offset.resize(N_vertex + 1).fill(0);
+		adjacency.triangle.resize(3 * N_tri);
 
-			one_ring[ get<1>(tri) ].insert( get<0>(tri) );
-			one_ring[ get<1>(tri) ].insert( get<2>(tri) );
+		unsigned int const* index = &connectivity.data.data()->x;
+		int* offset = adjacency.offset.data.data();
+		int* triangle = adjacency.triangle.data.data();
 
-			one_ring[ get<2>(tri) ].insert( get<0>(tri) );
-			one_ring[ get<2>(tri) ].insert( get<1>(tri) );
+		// Count the triangles of each vertex, then fill the rows
+		for (size_t k = 0; k < 3 * N_tri; ++k)
+		{
+			assert_cgp_no_msg(index[k] < N_vertex);
+			offset[index[k] + 1]++;
 		}
+		for (size_t k = 0; k < N_vertex; ++k)
+			offset[k + 1] += offset[k];
+
+		std::vector<int> fill(offset, offset + N_vertex);
+		for (size_t k = 0; k < 3 * N_tri; ++k)
+			triangle[fill[index[k]]++] = int(k / 3);
+
+		return adjacency;
+	}
+
+	numarray<numarray<int> > connectivity_one_ring(numarray<uint3> const& connectivity)
+	{
+		// One entry per vertex
+		size_t N = 0;
+		for (uint3 const& tri : connectivity)
+			N = std::max(N, size_t(std::max({get<0>(tri), get<1>(tri), get<2>(tri)})) + 1);
+
+		mesh_vertex_triangles const adjacency = connectivity_vertex_triangles(connectivity, N);
 
 		numarray<numarray<int> > one_ring_buffer;
 		one_ring_buffer.resize(N);
-		for(int k=0; k<N; ++k)
-			for(int idx : one_ring[k])
-				one_ring_buffer[k].push_back(idx);
+		for (size_t k = 0; k < N; ++k)
+		{
+			std::vector<int>& ring = one_ring_buffer[k].data;
+			for (int j = adjacency.offset[k]; j < adjacency.offset[k + 1]; ++j)
+				for (unsigned int idx : connectivity[adjacency.triangle[j]])
+					if (idx != k)
+						ring.push_back(int(idx));
+
+			std::sort(ring.begin(), ring.end());
+			ring.erase(std::unique(ring.begin(), ring.end()), ring.end());
+		}
 		return one_ring_buffer;
 	}
 
@@ -5,6 +5,8 @@
 #include "cgp/geometry/vec/vec.hpp"
 #include "cgp/geometry/transform/transform.hpp"
 
+#include <functional>
+
 namespace cgp
 {
 
@@ -53,10 +55,44 @@ namespace cgp
 	/** Compute automaticaly a per-vertex normal given a set of positions and their connectivity */
 	numarray<vec3> normal_per_vertex(numarray<vec3> const& position, numarray<uint3> const& connectivity, bool invert=false);
 
+	/** Triangles around each vertex, stored in compressed rows: the triangles of vertex k are triangle[offset[k]] to triangle[offset[k+1]-1] */
+	struct mesh_vertex_triangles
+	{
+		numarray<int> offset;
+		numarray<int> triangle;
+	};
+
+	/** Normals stored with the data needed for their incremental update (deforming meshes)
+	* Filled by normal_per_vertex, then used by normal_per_vertex_update as long as the connectivity doesn't change */
+	struct mesh_normal_cache
+	{
+		mesh_vertex_triangles adjacency;
+		numarray<vec3> triangle_normal; // Unit normal of each triangle (0 for degenerate ones)
+		bool invert = false;
+
+		// Marks of the last update (avoid to process twice the same element)
+		numarray<unsigned int> triangle_mark;
+		numarray<unsigned int> vertex_mark;
+		unsigned int mark = 0;
+	};
+
+	/** Version filling the cache for the incremental updates. The normals are gathered per vertex (can run in parallel) */
+	void normal_per_vertex(numarray<vec3> const& position, numarray<uint3> const& connectivity, numarray<vec3>& normals_to_fill, mesh_normal_cache& cache, bool invert=false);
+	/** Update the normals after some vertices moved: only the triangles around them and the normals of their one ring are recomputed */
+	void normal_per_vertex_update(numarray<vec3> const& position, numarray<uint3> const& connectivity, numarray<vec3>& normals, mesh_normal_cache& cache, numarray<unsigned int> const& moved_vertices);
+
+	/** Function called to run the loops of the normal computation in parallel: parallel_for(count, func(begin, end), min_chunk_size)
+	* Serial by default. The application can set its own thread pool */
+	using mesh_parallel_for_function = std::function<void(int, std::function<void(int, int)> const&, int)>;
+	void set_mesh_parallel_for(mesh_parallel_for_function const& parallel_for);
+	/** Run func(begin, end) on chunks covering [0, count[, with the parallel_for set (serially otherwise) */
+	void mesh_for(int count, std::function<void(int, int)> const& func, int min_chunk_size);
+
 	/** Check if the mesh looks coherent (correct indexing and size of buffer, no degenerate triangle, etc) */
 	bool mesh_check(mesh const& m);
 
 
+	mesh_vertex_triangles connectivity_vertex_triangles(numarray<uint3> const& connectivity, size_t N_vertex);
 	numarray<numarray<int> > connectivity_one_ring(numarray<uint3> const& connectivity);
 
 	std::string str(mesh const& m);
@@ -12,6 +12,7 @@ namespace cgp
 	opengl_texture_image_structure mesh_drawable::default_texture;
 
 	static void warning_initialize_non_empty();
+	static void initialize_interleaved_vbo(mesh const& data, opengl_vbo_structure& vbo_position, opengl_vbo_structure& vbo_normal, opengl_vbo_structure& vbo_color, opengl_vbo_structure& vbo_uv);
 
 	void mesh_drawable::initialize_data_on_gpu(mesh const& data, opengl_shader_structure const& shader_arg, opengl_texture_image_structure const& texture_arg)
 	{
@@ -46,10 +47,14 @@ namespace cgp
 		// Send the data to the GPU
 		// ******************************************** //
 
-		vbo_position.initialize_data_on_gpu(data.position);
-		vbo_normal.initialize_data_on_gpu(data.normal);
-		vbo_color.initialize_data_on_gpu(data.color);
-		vbo_uv.initialize_data_on_gpu(data.uv);
+		if (interleaved)
+			initialize_interleaved_vbo(data, vbo_position, vbo_normal, vbo_color, vbo_uv);
+		else {
+			vbo_position.initialize_data_on_gpu(data.position);
+			vbo_normal.initialize_data_on_gpu(data.normal);
+			vbo_color.initialize_data_on_gpu(data.color);
+			vbo_uv.initialize_data_on_gpu(data.uv);
+		}
 
 		ebo_connectivity.initialize_data_on_gpu(data.connectivity);
 
@@ -89,9 +94,17 @@ namespace cgp
 	void mesh_drawable::clear()
 	{
 		vbo_position.clear();
-		vbo_normal.clear();
-		vbo_color.clear();
-		vbo_uv.clear();
+		if (interleaved) {
+			// Same buffer as vbo_position
+			vbo_normal = opengl_vbo_structure();
+			vbo_color = opengl_vbo_structure();
+			vbo_uv = opengl_vbo_structure();
+		}
+		else {
+			vbo_normal.clear();
+			vbo_color.clear();
+			vbo_uv.clear();
+		}
 		for(int k=0; k<supplementary_vbo.size(); ++k)
 			supplementary_vbo[k].clear();
 		ebo_connectivity.clear();
@@ -110,6 +123,49 @@ namespace cgp
 	}
 
 
+	static void initialize_interleaved_vbo(mesh const& data, opengl_vbo_structure& vbo_position, opengl_vbo_structure& vbo_normal, opengl_vbo_structure& vbo_color, opengl_vbo_structure& vbo_uv)
+	{
+		// Per vertex: position (3), normal (3), color (3), uv (2)
+		size_t const N = data.position.size();
+		size_t const stride = 11;
+		std::vector<float> vertices(stride * N);
+		for (size_t k = 0; k < N; ++k) {
+			float* v = &vertices[stride * k];
+			vec3 const& p = data.position.data[k];
+			vec3 const& n = data.normal.data[k];
+			vec3 const& c = data.color.data[k];
+			vec2 const& uv = data.uv.data[k];
+			v[0] = p.x; v[1] = p.y; v[2] = p.z;
+			v[3] = n.x; v[4] = n.y; v[5] = n.z;
+			v[6] = c.x; v[7] = c.y; v[8] = c.z;
+			v[9] = uv.x; v[10] = uv.y;
+		}
+
+		GLuint id = 0;
+		glGenBuffers(1, &id);                                                                                        opengl_check;
+		glBindBuffer(GL_ARRAY_BUFFER, id);                                                                           opengl_check;
+		glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(vertices.size() * sizeof(float)), vertices.data(), GL_DYNAMIC_DRAW); opengl_check;
+		glBindBuffer(GL_ARRAY_BUFFER, 0);                                                                            opengl_check;
+
+		// The 4 attributes are views of the same buffer
+		opengl_vbo_structure* attributes[4] = { &vbo_position, &vbo_normal, &vbo_color, &vbo_uv };
+		GLuint const components[4] = { 3, 3, 3, 2 };
+		GLuint offset = 0;
+		for (int k = 0; k < 4; ++k) {
+			opengl_vbo_structure& vbo = *attributes[k];
+			vbo.id = id;
+			vbo.size = GLuint(N);
+			vbo.type = GL_ARRAY_BUFFER;
+			vbo.divisor = 0;
+			vbo.details.size_byte = GLuint(vertices.size() * sizeof(float));
+			vbo.details.size_element = components[k];
+			vbo.details.type_element = GL_FLOAT;
+			vbo.details.stride = GLsizei(stride * sizeof(float));
+			vbo.details.offset = offset;
+			offset += components[k] * sizeof(float);
+		}
+	}
+
 	static void warning_initialize_non_empty()
 	{
 		std::string warning = "\n";
@@ -183,10 +239,10 @@ namespace cgp
 		// Draw call
 		// ********************************** //
 		if (instance_count <= 1) {
-			glDrawElements(draw_mode, GLsizei(drawable.ebo_connectivity.size * 3), GL_UNSIGNED_INT, nullptr); opengl_check;
+			glDrawElements(draw_mode, GLsizei(drawable.ebo_connectivity.size * 3), drawable.ebo_connectivity.details.type_element, nullptr); opengl_check;
 		}
 		else {
-			glDrawElementsInstanced(draw_mode, GLsizei(drawable.ebo_connectivity.size * 3), GL_UNSIGNED_INT, nullptr, instance_count); opengl_check;
+			glDrawElementsInstanced(draw_mode, GLsizei(drawable.ebo_connectivity.size * 3), drawable.ebo_connectivity.details.type_element, nullptr, instance_count); opengl_check;
 		}
 
 
@@ -29,6 +29,11 @@ namespace cgp
 		opengl_vbo_structure vbo_uv;
 		std::vector<opengl_vbo_structure> supplementary_vbo; // optional supplementary vbo (per-vertex or per-instance)
 
+		// Set before initialize_data_on_gpu: position, normal, color and uv are packed per vertex in a single VBO
+		//  (one stream to fetch per vertex). vbo_position, vbo_normal, vbo_color and vbo_uv then share the same buffer
+		//  and cannot be updated separately
+		bool interleaved = false;
+
 		// Indexed connectivity
 		opengl_ebo_structure ebo_connectivity;
 
@@ -124,7 +124,7 @@ namespace cgp {
 		// ********************************** //
 		glBindVertexArray(drawable.vao);   opengl_check;
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, drawable.ebo_connectivity.id); opengl_check;
-		glDrawElements(GL_TRIANGLES, GLsizei(drawable.ebo_connectivity.size * 3), GL_UNSIGNED_INT, nullptr); opengl_check;
+		glDrawElements(GL_TRIANGLES, GLsizei(drawable.ebo_connectivity.size * 3), drawable.ebo_connectivity.details.type_element, nullptr); opengl_check;
 
 
 
@@ -1,24 +1,71 @@
 #include "ebo.hpp"
 #include "../../debug/debug.hpp"
+#include "cgp/core/core.hpp"
+
+#include <vector>
 
 namespace cgp
 {
+	static bool fits_16bit_index(numarray<uint3> const& data)
+	{
+		for (uint3 const& triangle : data.data)
+			if (triangle.x > 0xFFFF || triangle.y > 0xFFFF || triangle.z > 0xFFFF)
+				return false;
+		return true;
+	}
+
+	static std::vector<GLushort> to_16bit_index(numarray<uint3> const& data)
+	{
+		std::vector<GLushort> indices(3 * data.size());
+		for (size_t k = 0; k < data.size(); ++k)
+		{
+			indices[3 * k + 0] = GLushort(data.data[k].x);
+			indices[3 * k + 1] = GLushort(data.data[k].y);
+			indices[3 * k + 2] = GLushort(data.data[k].z);
+		}
+		return indices;
+	}
 
 	void opengl_ebo_structure::initialize_data_on_gpu(numarray<uint3> const& data)
 	{
+		bool const short_index = fits_16bit_index(data);
 
 		glGenBuffers(1, &id); opengl_check;
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, id); opengl_check;
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(size_in_memory(data)), ptr(data), GL_DYNAMIC_DRAW); opengl_check;
+		if (short_index) {
+			std::vector<GLushort> const indices = to_16bit_index(data);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(indices.size() * sizeof(GLushort)), indices.data(), GL_DYNAMIC_DRAW); opengl_check;
+		}
+		else {
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(size_in_memory(data)), ptr(data), GL_DYNAMIC_DRAW); opengl_check;
+		}
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); opengl_check;
 
 		size = data.size();
 		type = GL_ELEMENT_ARRAY_BUFFER;
 
-		details.size_byte = size_in_memory(data);
+		details.size_byte = GLuint(3 * data.size() * (short_index ? sizeof(GLushort) : sizeof(GLuint)));
 		details.size_element = 3;
-		details.type_element = GL_UNSIGNED_INT;
+		details.type_element = short_index ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+	}
+
+	void opengl_ebo_structure::update(numarray<uint3> const& data)
+	{
+		bool const short_index = details.type_element == GL_UNSIGNED_SHORT;
+		assert_cgp(data.size() <= size, "Cannot update an EBO with more triangles than its initialization");
+		assert_cgp(!short_index || fits_16bit_index(data), "Index larger than the 16-bit indices of this EBO");
 
+		// Bound as a copy target: the element array binding is part of the state of the current VAO
+		glBindBuffer(GL_COPY_WRITE_BUFFER, id); opengl_check;
+		if (short_index) {
+			std::vector<GLushort> const indices = to_16bit_index(data);
+			glBufferSubData(GL_COPY_WRITE_BUFFER, 0, GLsizeiptr(indices.size() * sizeof(GLushort)), indices.data()); opengl_check;
+		}
+		else {
+			glBufferSubData(GL_COPY_WRITE_BUFFER, 0, GLsizeiptr(size_in_memory(data)), ptr(data)); opengl_check;
+		}
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0); opengl_check;
 	}
 
 }
\ No newline at end of file
@@ -9,7 +9,12 @@ namespace cgp
 
 	struct opengl_ebo_structure : opengl_gpu_buffer
 	{
+		/** Send the triangles to the GPU. The indices are stored on 16 bits when every vertex index fits (details.type_element is then GL_UNSIGNED_SHORT)
+		* Draw calls must use details.type_element as the index type */
 		void initialize_data_on_gpu(numarray<uint3> const& data);
+
+		/** Overwrite the first triangles of the buffer, with the index type chosen at initialization */
+		void update(numarray<uint3> const& data);
 	};
 
 
@@ -11,7 +11,10 @@ namespace cgp
 		// How to read the content of the buffer
 		GLuint size_element = 0; // The number of sub-element for 1 element (ex. 3 for a vec3, 2 for a vec2, etc)
 		GLenum type_element = 0; // The type of each component of the buffer (ex. GL_FLOAT, GL_UNSIGNED_INT, etc)
-		// Note: assume offset=0, and stride=0
+
+		// Layout of interleaved buffers (several attributes per element). 0 for tightly packed buffers
+		GLsizei stride = 0;  // Bytes between two consecutive elements
+		GLuint offset = 0;   // Byte offset of the first element
 	};
 	struct opengl_gpu_buffer {
 
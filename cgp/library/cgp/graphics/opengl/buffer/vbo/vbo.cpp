@@ -52,6 +52,7 @@ namespace cgp
 	void opengl_vbo_structure::update(numarray<vec2> const& data, int size_elements_update)
 	{
 		assert_cgp(size_elements_update <= data.size(), "Cannot update VBO with more elements than data");
+		assert_cgp(details.stride == 0, "Cannot update a single attribute of an interleaved VBO");
 		glBindBuffer(GL_ARRAY_BUFFER, id); opengl_check;
 		if (size_elements_update == -1) {
 			glBufferSubData(GL_ARRAY_BUFFER, 0, size_in_memory(data), ptr(data));  opengl_check;
@@ -63,6 +64,7 @@ namespace cgp
 	void opengl_vbo_structure::update(numarray<vec3> const& data, int size_elements_update)
 	{
 		assert_cgp(size_elements_update <= data.size(), "Cannot update VBO with more elements than data");
+		assert_cgp(details.stride == 0, "Cannot update a single attribute of an interleaved VBO");
 		glBindBuffer(GL_ARRAY_BUFFER, id); opengl_check;
 		if (size_elements_update == -1) {
 			glBufferSubData(GL_ARRAY_BUFFER, 0, size_in_memory(data), ptr(data));  opengl_check;
@@ -74,6 +76,7 @@ namespace cgp
 	void opengl_vbo_structure::update(numarray<vec4> const& data, int size_elements_update)
 	{
 		assert_cgp(size_elements_update <= data.size(), "Cannot update VBO with more elements than data");
+		assert_cgp(details.stride == 0, "Cannot update a single attribute of an interleaved VBO");
 		glBindBuffer(GL_ARRAY_BUFFER, id); opengl_check;
 		if (size_elements_update == -1) {
 			glBufferSubData(GL_ARRAY_BUFFER, 0, size_in_memory(data), ptr(data));  opengl_check;
@@ -88,7 +91,7 @@ namespace cgp
 	{
 		vbo.bind();
 		glEnableVertexAttribArray(location_index); opengl_check
-		glVertexAttribPointer(location_index, vbo.details.size_element, vbo.details.type_element, GL_FALSE, 0, nullptr); opengl_check
+		glVertexAttribPointer(location_index, vbo.details.size_element, vbo.details.type_element, GL_FALSE, vbo.details.stride, reinterpret_cast<void*>(size_t(vbo.details.offset))); opengl_check
 		vbo.unbind();
 		if (vbo.divisor>0) { glVertexAttribDivisor(location_index, vbo.divisor);                                         opengl_check; }
 	}
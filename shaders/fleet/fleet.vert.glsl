@@ -0,0 +1,55 @@
+#version 330 core
+
+// Vertex shader for fleet rendering : one instance per ship
+// The world matrix of each (ship, bone) pair is read from a texture buffer
+
+// Inputs coming from VBOs
+layout(location = 0) in vec3 vertex_position; // vertex position in local space (x,y,z)
+layout(location = 1) in vec3 vertex_normal;   // vertex normal in local space   (nx,ny,nz)
+layout(location = 2) in vec3 vertex_color;    // vertex color      (r,g,b)
+layout(location = 3) in vec2 vertex_uv;       // vertex uv-texture (u,v)
+
+// Output variables sent to the fragment shader
+out struct fragment_data
+{
+    vec3 position; // vertex position in world space
+    vec3 normal;   // normal position in world space
+    vec3 color;    // vertex color
+    vec2 uv;       // vertex uv
+} fragment;
+
+// Uniform variables expected to receive from the C++ program
+uniform mat4 view;       // View matrix (rigid transform) of the camera
+uniform mat4 projection; // Projection (perspective or orthogonal) matrix of the camera
+
+uniform samplerBuffer fleet_matrices; // 4 texels (matrix rows) per matrix, bone_count matrices per ship
+uniform int bone_index;               // Bone carrying the current mesh
+uniform int bone_count;               // Number of bones per ship
+
+mat4 fetch_model_matrix(int matrix_index)
+{
+    int base = 4 * matrix_index;
+    return transpose(mat4(texelFetch(fleet_matrices, base),
+                          texelFetch(fleet_matrices, base + 1),
+                          texelFetch(fleet_matrices, base + 2),
+                          texelFetch(fleet_matrices, base + 3)));
+}
+
+void main()
+{
+    mat4 model = fetch_model_matrix(gl_InstanceID * bone_count + bone_index);
+
+    // The position of the vertex in the world space
+    vec4 position = model * vec4(vertex_position, 1.0);
+
+    // Ship transforms are rigid with a uniform scale : the linear part is enough for the normal (renormalized in the fragment shader)
+    vec3 normal = mat3(model) * vertex_normal;
+
+    // Fill the parameters sent to the fragment shader
+    fragment.position = position.xyz;
+    fragment.normal = normal;
+    fragment.color = vertex_color;
+    fragment.uv = vertex_uv;
+
+    gl_Position = projection * view * position;
+}
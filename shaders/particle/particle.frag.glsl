@@ -0,0 +1,20 @@
+#version 330 core
+
+// Fragment shader for CPU particles : round sprite with a soft edge
+
+in vec4 color;
+
+layout(location = 0) out vec4 FragColor;
+
+uniform float softness; // 0 : hard disc, 1 : smooth blob
+
+void main()
+{
+    // Distance to the sprite center, 1 on the inscribed circle
+    float r = length(2.0 * gl_PointCoord - 1.0);
+    if (r > 1.0)
+        discard;
+
+    float falloff = 1.0 - smoothstep(1.0 - softness, 1.0, r);
+    FragColor = vec4(color.rgb, color.a * falloff);
+}
@@ -0,0 +1,24 @@
+#version 330 core
+
+// Vertex shader for CPU particles : one point sprite per particle
+
+layout(location = 0) in vec4 particle_position_size; // world position (x,y,z), world size (w)
+layout(location = 1) in vec4 particle_color;         // color (r,g,b), alpha (a)
+
+out vec4 color;
+
+uniform mat4 view;       // View matrix (rigid transform) of the camera
+uniform mat4 projection; // Projection (perspective or orthogonal) matrix of the camera
+
+uniform float viewport_height; // In pixels, to convert the world size into a point size
+
+void main()
+{
+    vec4 position_projected = projection * view * vec4(particle_position_size.xyz, 1.0);
+
+    // projection[1][1] = 1 / tan(fov / 2) : world size at distance w, in pixels
+    gl_PointSize = max(1.0, particle_position_size.w * projection[1][1] * viewport_height / position_projected.w);
+
+    color = particle_color;
+    gl_Position = position_projected;
+}
@@ -0,0 +1,43 @@
+#include "ai_benchmark.hpp"
+#include "ai/ship_agents.hpp"
+#include "utils/random/random.hpp"
+#include "utils/threads/job_system.hpp"
+#include <chrono>
+#include <iostream>
+
+int runAIBenchmark(int agent_count, int step_count)
+{
+    constexpr float DT = 1.0f / 60;
+
+    ShipAgents agents;
+    agents.setFormationCenter({0, 0, 0});
+    agents.resize(agent_count);
+
+    // Asteroid-like obstacles spread over the formation area, and one planet
+    std::vector<cgp::vec4> obstacles;
+    float const extent = agents.parameters.formation_spacing * (agent_count / 16 + 16);
+    for (int i = 0; i < agent_count; i++)
+    {
+        obstacles.push_back({random_float(-extent, 0), random_float(-extent / 2, extent / 2), random_float(-5, 5), random_float(0.1f, 1.0f)});
+    }
+    obstacles.push_back({-extent / 2, 0, 40, 30});
+    agents.setObstacles(obstacles);
+
+    std::cout << "AI benchmark : " << agent_count << " agents, " << obstacles.size() << " obstacles, " << step_count << " steps, "
+              << global_job_system.getWorkerCount() + 1 << " threads" << std::endl;
+
+    auto const start = std::chrono::high_resolution_clock::now();
+    for (int step = 0; step < step_count; step++)
+    {
+        // Move the formation so the agents keep steering
+        agents.setFormationCenter({step * 0.5f, 0, 0});
+        agents.update(DT);
+    }
+    auto const end = std::chrono::high_resolution_clock::now();
+
+    double const seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << "Total " << seconds * 1000 << " ms, " << seconds * 1000 / step_count << " ms / step, "
+              << (double)agent_count * step_count / seconds << " agents / second" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+// Headless AI benchmark : simulate agent_count ship agents among random obstacles for step_count steps,
+// without any window or OpenGL context, and print the agents updated per second.
+// Usage : ./program --benchmark-ai <agent_count> [step_count]
+int runAIBenchmark(int agent_count, int step_count = 200);
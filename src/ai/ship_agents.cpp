@@ -0,0 +1,151 @@
+#include "ship_agents.hpp"
+#include "utils/threads/job_system.hpp"
+#include <algorithm>
+#include <cmath>
+
+// Obstacles bigger than this (display units) are not put in the obstacle grid
+constexpr float LARGE_OBSTACLE_RADIUS = 5.0f;
+
+static cgp::vec3 clampNorm(cgp::vec3 const &v, float max_norm)
+{
+    float const n = cgp::norm(v);
+    return n > max_norm ? v * (max_norm / n) : v;
+}
+
+cgp::vec3 ShipAgents::formationSlot(int i) const
+{
+    // Square layers around the center, 16 ships per row
+    constexpr int ROW_SIZE = 16;
+    int const row = i / ROW_SIZE;
+    int const column = i % ROW_SIZE;
+
+    return parameters.formation_spacing * cgp::vec3{-(float)row, (float)column - ROW_SIZE / 2, 0};
+}
+
+void ShipAgents::resize(int count)
+{
+    int const previous = size();
+
+    px.resize(count);
+    py.resize(count);
+    pz.resize(count);
+    vx.resize(count, 0);
+    vy.resize(count, 0);
+    vz.resize(count, 0);
+
+    for (int i = previous; i < count; i++)
+    {
+        cgp::vec3 const p = formation_center + formationSlot(i);
+        px[i] = p.x;
+        py[i] = p.y;
+        pz[i] = p.z;
+    }
+
+    next_px.resize(count);
+    next_py.resize(count);
+    next_pz.resize(count);
+    next_vx.resize(count);
+    next_vy.resize(count);
+    next_vz.resize(count);
+}
+
+void ShipAgents::setObstacles(std::vector<cgp::vec4> const &obstacles)
+{
+    obstacle_x.clear();
+    obstacle_y.clear();
+    obstacle_z.clear();
+    obstacle_radius.clear();
+    large_obstacles.clear();
+    max_small_obstacle_radius = 0;
+
+    for (auto const &obstacle : obstacles)
+    {
+        if (obstacle.w > LARGE_OBSTACLE_RADIUS)
+        {
+            large_obstacles.push_back(obstacle);
+        }
+        else
+        {
+            obstacle_x.push_back(obstacle.x);
+            obstacle_y.push_back(obstacle.y);
+            obstacle_z.push_back(obstacle.z);
+            obstacle_radius.push_back(obstacle.w);
+            max_small_obstacle_radius = std::max(max_small_obstacle_radius, obstacle.w);
+        }
+    }
+
+    obstacle_grid.build(obstacle_x.data(), obstacle_y.data(), obstacle_z.data(), obstacle_x.size(), parameters.obstacle_margin + max_small_obstacle_radius);
+}
+
+void ShipAgents::update(float dt)
+{
+    int const count = size();
+    if (count == 0)
+        return;
+
+    SteeringParameters const p = parameters;
+    agent_grid.build(px.data(), py.data(), pz.data(), count, p.neighbor_radius);
+
+    global_job_system.parallelFor(count, [&](int begin, int end)
+                                  {
+        for (int i = begin; i < end; i++)
+        {
+            cgp::vec3 const position = {px[i], py[i], pz[i]};
+            cgp::vec3 const velocity = {vx[i], vy[i], vz[i]};
+
+            // Seek / arrive on the formation slot
+            cgp::vec3 const to_slot = formation_center + formationSlot(i) - position;
+            float const slot_distance = cgp::norm(to_slot);
+            cgp::vec3 seek = -velocity;
+            if (slot_distance > 1e-4f)
+            {
+                float const desired_speed = p.max_speed * std::min(1.0f, slot_distance / p.arrival_radius);
+                seek = to_slot * (desired_speed / slot_distance) - velocity;
+            }
+
+            // Separation from the neighbors, stronger when closer
+            cgp::vec3 separation = {0, 0, 0};
+            agent_grid.forEachNear(position, p.neighbor_radius, [&](int j)
+                                   {
+                if (j == i)
+                    return;
+                cgp::vec3 const away = position - cgp::vec3{px[j], py[j], pz[j]};
+                float const d2 = cgp::dot(away, away);
+                if (d2 > 1e-8f && d2 < p.neighbor_radius * p.neighbor_radius)
+                    separation += away / d2; });
+
+            // Obstacle avoidance : push away from the surfaces closer than the margin
+            cgp::vec3 avoidance = {0, 0, 0};
+            auto avoid = [&](cgp::vec3 const &center, float radius)
+            {
+                cgp::vec3 const away = position - center;
+                float const d = cgp::norm(away);
+                float const surface_distance = d - radius;
+                if (d > 1e-6f && surface_distance < p.obstacle_margin)
+                    avoidance += away / d * (1.0f - std::max(surface_distance, 0.0f) / p.obstacle_margin);
+            };
+            for (auto const &obstacle : large_obstacles)
+                avoid({obstacle.x, obstacle.y, obstacle.z}, obstacle.w);
+            obstacle_grid.forEachNear(position, p.obstacle_margin + max_small_obstacle_radius, [&](int j)
+                                      { avoid({obstacle_x[j], obstacle_y[j], obstacle_z[j]}, obstacle_radius[j]); });
+
+            cgp::vec3 const force = clampNorm(p.seek_weight * seek + p.separation_weight * p.max_force * separation + p.avoidance_weight * p.max_force * avoidance, p.max_force);
+
+            cgp::vec3 const new_velocity = clampNorm(velocity + dt * force, p.max_speed);
+            cgp::vec3 const new_position = position + dt * new_velocity;
+
+            next_px[i] = new_position.x;
+            next_py[i] = new_position.y;
+            next_pz[i] = new_position.z;
+            next_vx[i] = new_velocity.x;
+            next_vy[i] = new_velocity.y;
+            next_vz[i] = new_velocity.z;
+        } }, 128);
+
+    px.swap(next_px);
+    py.swap(next_py);
+    pz.swap(next_pz);
+    vx.swap(next_vx);
+    vy.swap(next_vy);
+    vz.swap(next_vz);
+}
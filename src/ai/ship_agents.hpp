@@ -0,0 +1,71 @@
+#pragma once
+
+#include "ai/spatial_grid.hpp"
+#include "cgp/geometry/vec/vec3/vec3.hpp"
+#include "cgp/geometry/vec/vec4/vec4.hpp"
+#include <vector>
+
+// Steering behaviour tuning (display units and seconds)
+struct SteeringParameters
+{
+    float max_speed = 40.0f;
+    float max_force = 60.0f;
+    float arrival_radius = 10.0f;  // Slow down when closer than this to the formation slot
+    float neighbor_radius = 3.0f;  // Separation range between ships
+    float obstacle_margin = 5.0f;  // Avoidance range around obstacle surfaces
+    float formation_spacing = 3.0f;
+
+    float seek_weight = 1.0f;
+    float separation_weight = 2.0f;
+    float avoidance_weight = 4.0f;
+};
+
+/**
+ * AI ship agents stored as structure of arrays.
+ * Each agent steers toward its slot of a grid formation (seek / arrive), away from its neighbors (separation)
+ * and away from obstacle spheres (planets, asteroids). Neighbors are found through uniform grids rebuilt
+ * each step, and the agents are updated in parallel on the shared job system.
+ */
+class ShipAgents
+{
+public:
+    // Resize the agent store. New agents start on their formation slot
+    void resize(int count);
+    int size() const { return (int)px.size(); };
+
+    // The formation slots are placed around this point
+    void setFormationCenter(cgp::vec3 const &center) { formation_center = center; };
+
+    // Obstacle spheres : xyz = center, w = radius
+    void setObstacles(std::vector<cgp::vec4> const &obstacles);
+
+    // Simulate one step
+    void update(float dt);
+
+    cgp::vec3 getPosition(int i) const { return {px[i], py[i], pz[i]}; };
+    cgp::vec3 getVelocity(int i) const { return {vx[i], vy[i], vz[i]}; };
+
+    // Offset of the i-th formation slot relatively to the formation center
+    cgp::vec3 formationSlot(int i) const;
+
+    SteeringParameters parameters;
+
+private:
+    cgp::vec3 formation_center = {0, 0, 0};
+
+    // Current state (SoA)
+    std::vector<float> px, py, pz;
+    std::vector<float> vx, vy, vz;
+
+    // Next state, written by the parallel update then swapped
+    std::vector<float> next_px, next_py, next_pz;
+    std::vector<float> next_vx, next_vy, next_vz;
+
+    SpatialGrid agent_grid;
+
+    // Small obstacles are stored in a grid, the large ones (planets) are tested linearly
+    std::vector<float> obstacle_x, obstacle_y, obstacle_z, obstacle_radius;
+    std::vector<cgp::vec4> large_obstacles;
+    SpatialGrid obstacle_grid;
+    float max_small_obstacle_radius = 0;
+};
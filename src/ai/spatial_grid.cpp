@@ -0,0 +1,31 @@
+#include "spatial_grid.hpp"
+
+void SpatialGrid::build(float const *x, float const *y, float const *z, int count, float cell_size)
+{
+    this->cell_size = cell_size;
+    inv_cell_size = 1.0f / cell_size;
+
+    // Power of two slot count, about 2 slots per point to keep collisions rare
+    unsigned int slot_count = 64;
+    while (slot_count < 2 * (unsigned int)count)
+        slot_count *= 2;
+    slot_mask = slot_count - 1;
+
+    slot_start.assign(slot_count + 1, 0);
+    point_slot.resize(count);
+    sorted_indices.resize(count);
+
+    // Counting sort by slot
+    for (int i = 0; i < count; i++)
+    {
+        int const slot = slotOf(cellCoordinate(x[i]), cellCoordinate(y[i]), cellCoordinate(z[i]));
+        point_slot[i] = slot;
+        slot_start[slot + 1]++;
+    }
+    for (unsigned int s = 0; s < slot_count; s++)
+        slot_start[s + 1] += slot_start[s];
+
+    std::vector<int> fill(slot_start.begin(), slot_start.end() - 1);
+    for (int i = 0; i < count; i++)
+        sorted_indices[fill[point_slot[i]]++] = i;
+}
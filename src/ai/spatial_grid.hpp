@@ -0,0 +1,74 @@
+#pragma once
+
+#include "cgp/geometry/vec/vec3/vec3.hpp"
+#include <cmath>
+#include <vector>
+
+/**
+ * Hashed uniform grid for fixed-radius neighbor queries.
+ * Rebuilt from scratch every frame with a counting sort (O(N)), the cells are hashed so the grid
+ * has no bounds. Cells sharing a hash slot only add false positives : the caller filters by distance.
+ */
+class SpatialGrid
+{
+public:
+    // Insert count points (SoA coordinates). Queries with a radius <= cell_size visit at most 27 cells
+    void build(float const *x, float const *y, float const *z, int count, float cell_size);
+
+    // Call func(index) for every point stored in the cells overlapping the sphere (center, radius)
+    template <typename TFunction>
+    void forEachNear(cgp::vec3 const &center, float radius, TFunction &&func) const;
+
+    float getCellSize() const { return cell_size; };
+
+private:
+    int slotOf(int cx, int cy, int cz) const
+    {
+        // Large primes hash (Teschner et al.)
+        unsigned int h = ((unsigned int)cx * 73856093u) ^ ((unsigned int)cy * 19349663u) ^ ((unsigned int)cz * 83492791u);
+        return h & slot_mask;
+    }
+    int cellCoordinate(float value) const { return (int)std::floor(value * inv_cell_size); }
+
+    float cell_size = 1;
+    float inv_cell_size = 1;
+    unsigned int slot_mask = 0;
+
+    std::vector<int> slot_start;     // First sorted index of each slot (size : slot count + 1)
+    std::vector<int> sorted_indices; // Point indices sorted by slot
+    std::vector<int> point_slot;     // Slot of each point (build temporary)
+};
+
+template <typename TFunction>
+void SpatialGrid::forEachNear(cgp::vec3 const &center, float radius, TFunction &&func) const
+{
+    if (sorted_indices.empty())
+        return;
+
+    int const x0 = cellCoordinate(center.x - radius), x1 = cellCoordinate(center.x + radius);
+    int const y0 = cellCoordinate(center.y - radius), y1 = cellCoordinate(center.y + radius);
+    int const z0 = cellCoordinate(center.z - radius), z1 = cellCoordinate(center.z + radius);
+
+    // Several cells can share a slot : remember the visited ones to report each point once
+    constexpr int MAX_TRACKED_SLOTS = 64;
+    int visited[MAX_TRACKED_SLOTS];
+    int visited_count = 0;
+
+    for (int cx = x0; cx <= x1; cx++)
+        for (int cy = y0; cy <= y1; cy++)
+            for (int cz = z0; cz <= z1; cz++)
+            {
+                int const slot = slotOf(cx, cy, cz);
+
+                bool already_visited = false;
+                for (int k = 0; k < visited_count; k++)
+                    already_visited = already_visited || visited[k] == slot;
+                if (already_visited)
+                    continue;
+                if (visited_count < MAX_TRACKED_SLOTS)
+                    visited[visited_count++] = slot;
+
+                for (int k = slot_start[slot]; k < slot_start[slot + 1]; k++)
+                    func(sorted_indices[k]);
+            }
+}
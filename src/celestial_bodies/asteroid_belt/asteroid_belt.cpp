@@ -1,9 +1,12 @@
 #include "asteroid_belt.hpp"
 #include "celestial_bodies/asteroid_belt/asteroid_thread_pool.hpp"
+#include "cgp/geometry/shape/mesh/optimization/mesh_optimization.hpp"
 #include "cgp/geometry/transform/rotation_transform/rotation_transform.hpp"
 #include "cgp/graphics/drawable/mesh_drawable/mesh_drawable.hpp"
 #include "cgp/graphics/opengl/texture/texture.hpp"
 #include "utils/display/display_constants.hpp"
+#include "utils/display/lod_chain.hpp"
+#include "utils/display/lod_manager.hpp"
 #include "utils/display/low_poly.hpp"
 #include "utils/noise/perlin.hpp"
 #include "utils/opengl/instancing.hpp"
@@ -11,6 +14,8 @@
 #include "utils/physics/object.hpp"
 #include "utils/random/random.hpp"
 #include "utils/shaders/shader_loader.hpp"
+#include "utils/threads/job_system.hpp"
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 
@@ -32,13 +37,21 @@ void AsteroidBelt::initialize()
     cgp::vec3 asteroid_mean_colors[] = {{102.0f / 255, 102.0f / 255, 102.0f / 255}, {84.0f / 255, 84.0f / 255, 84.0f / 255}, {132.0f / 255, 124.0f / 255, 116.0f / 255}};
     std::vector<DistanceMeshHandler> distance_mesh_handlers;
 
+    // The low poly meshes are simplified from the high poly ones : same silhouette
+    std::vector<cgp::mesh> high_poly_meshes;
+    for (int i = 0; i < n_base_asteroids; i++)
+        high_poly_meshes.push_back(mesh_primitive_perlin_sphere(ASTEROID_DISPLAY_RADIUS, {0, 0, 0}, 50, 25, ASTEROID_NOISE_PARAMS));
+    std::vector<LodChain> const asteroid_lods = generate_lod_chains(high_poly_meshes, 2, ASTEROID_LOW_POLY_RATIO);
+
     for (int i = 0; i < n_base_asteroids; i++)
     {
         // Generate high poly mesh
-        cgp::mesh high_poly_asteroid_mesh = mesh_primitive_perlin_sphere(ASTEROID_DISPLAY_RADIUS, {0, 0, 0}, 50, 25, ASTEROID_NOISE_PARAMS);
+        cgp::mesh high_poly_asteroid_mesh = asteroid_lods[i].levels[0];
+        cgp::mesh_optimize(high_poly_asteroid_mesh); // Drawn for every asteroid of the belt
 
         // Generate mesh drawable
         cgp::mesh_drawable high_poly_asteroid_mesh_drawable;
+        high_poly_asteroid_mesh_drawable.interleaved = true;
         high_poly_asteroid_mesh_drawable.initialize_data_on_gpu(high_poly_asteroid_mesh);
 
         // Set mesh drawable parameters
@@ -60,10 +73,12 @@ void AsteroidBelt::initialize()
         high_poly_asteroid_mesh_drawable.shader = ShaderLoader::getShader("instanced");
 
         // Generate low poly mesh
-        cgp::mesh low_poly_asteroid_mesh = mesh_primitive_perlin_sphere(ASTEROID_DISPLAY_RADIUS, {0, 0, 0}, 10, 5, ASTEROID_NOISE_PARAMS);
+        cgp::mesh low_poly_asteroid_mesh = asteroid_lods[i].levels[1];
+        cgp::mesh_optimize(low_poly_asteroid_mesh);
 
         // Generate mesh drawable
         cgp::mesh_drawable low_poly_asteroid_mesh_drawable;
+        low_poly_asteroid_mesh_drawable.interleaved = true;
         low_poly_asteroid_mesh_drawable.initialize_data_on_gpu(low_poly_asteroid_mesh);
 
         // Set mesh drawable parameters
@@ -82,6 +97,7 @@ void AsteroidBelt::initialize()
         // Generate low poly disk
         cgp::mesh low_poly_disk_mesh = cgp::mesh_primitive_disc(ASTEROID_DISPLAY_RADIUS, {0, 0, 0}, {0, 0, 1}, LOW_POLY_RESOLUTION);
         cgp::mesh_drawable low_poly_disk_mesh_drawable;
+        low_poly_disk_mesh_drawable.interleaved = true;
         low_poly_disk_mesh_drawable.initialize_data_on_gpu(low_poly_disk_mesh);
         low_poly_disk_mesh_drawable.material.phong.specular = 0; // No reflection for the low poly display
         low_poly_asteroid_mesh_drawable.material.phong.ambient = ASTEROID_PHONG_AMBIENT;
@@ -96,9 +112,9 @@ void AsteroidBelt::initialize()
         asteroid_mesh_drawables.push_back(low_poly_disk_mesh_drawable);
 
         // Add the mesh data for each shader
-        asteroid_instances_data.push_back({3 * i, 0, {}, {}, {}});
-        asteroid_instances_data.push_back({3 * i + 1, 0, {}, {}, {}});
-        asteroid_instances_data.push_back({3 * i + 2, 0, {}, {}, {}});
+        asteroid_instances_data.push_back({3 * i, 0, 0, {}, {}, {}, {}});
+        asteroid_instances_data.push_back({3 * i + 1, 0, 0, {}, {}, {}, {}});
+        asteroid_instances_data.push_back({3 * i + 2, 0, 0, {}, {}, {}, {}});
 
         // Add the mesh handler for the 3 meshes
         distance_mesh_handlers.push_back({3 * i, 3 * i + 1, 3 * i + 2});
@@ -127,12 +143,6 @@ void AsteroidBelt::initialize()
 
     std::vector<Asteroid> asteroids = generateRandomAsteroids(n_asteroids, distance_mesh_handlers);
 
-    // Preallocate memory for the instancing
-    for (auto &mesh_data : asteroid_instances_data)
-    {
-        mesh_data.allocate(n_asteroids);
-    }
-
     // Initialize thread pool data
     pool.setAttractor(attractors[0]);
     pool.setDistanceMeshHandlers(distance_mesh_handlers);
@@ -140,6 +150,12 @@ void AsteroidBelt::initialize()
     pool.setOrbitFactor(orbit_factor);
     pool.allocateBuffers();
 
+    // Preallocate memory for the instancing (asteroids and fragment slots : no allocation while fragments are created)
+    for (auto &mesh_data : asteroid_instances_data)
+    {
+        mesh_data.allocate(pool.getSlotCount());
+    }
+
     // Start pool
     pool.start();
 
@@ -212,14 +228,14 @@ std::vector<Asteroid> AsteroidBelt::generateRandomAsteroids(int n, const std::ve
     return asteroids;
 }
 
-void AsteroidBelt::draw(environment_structure const &environment, cgp::vec3 &position, cgp::rotation_transform &, bool)
+void AsteroidBelt::prepareInstances(cgp::vec3 const &position)
 {
     pool.updateCameraPosition(position); // Update camera position for the next iteration computation
 
     // Communicate with the threads to get the data.
     pool.swapBuffers();
 
-    auto data_from_worker_threads = pool.getGPUData();
+    auto &data_from_worker_threads = pool.getGPUData(); // Only swapBuffers (this thread) writes it : no copy needed
     pool.awaitAndLaunchNextFrameComputation(); // Unlock all threads in order to enable them to compute the next frame data into the buffer (not the one we just got)
 
     // Reset structs data
@@ -228,19 +244,114 @@ void AsteroidBelt::draw(environment_structure const &environment, cgp::vec3 &pos
         mesh_data.resetData();
     }
 
+    // Visibility tests in parallel : occlusion behind the sun and planets, then far away impostors too small on screen
+    int const count = data_from_worker_threads.size();
+    hidden.assign(count, ASTEROID_VISIBLE);
+    projected_sizes.resize(count);
+    bool const use_occluders = occluders != nullptr && occluders->size() > 0;
+
+    global_job_system.parallelFor(
+        count, [&](int begin, int end)
+        {
+            for (int i = begin; i < end; i++)
+            {
+                AsteroidGPUData const &data = data_from_worker_threads[i];
+                if (data.mesh_index == -1)
+                    continue;
+
+                float const radius = data.scale * ASTEROID_DISPLAY_RADIUS;
+                projected_sizes[i] = global_lod_manager.projectedSize(radius, cgp::norm(data.position - position));
+
+                bool const is_low_poly_disk = data.mesh_index % 3 == 2;
+                if (use_occluders && occluders->isOccluded(data.position, radius * OCCLUDEE_RADIUS_MARGIN))
+                    hidden[i] = ASTEROID_OCCLUDED;
+                else if (is_low_poly_disk && projected_sizes[i] < impostor_cutoff)
+                    hidden[i] = ASTEROID_SKIPPED;
+            }
+        },
+        ASTEROID_OCCLUSION_MIN_CHUNK);
+
+    // Instance budget : keep the largest asteroids on screen
+    budget_sizes.clear();
+    for (int i = 0; i < count; i++)
+    {
+        if (data_from_worker_threads[i].mesh_index != -1 && hidden[i] == ASTEROID_VISIBLE)
+            budget_sizes.push_back(projected_sizes[i]);
+    }
+    if ((int)budget_sizes.size() > max_instances)
+    {
+        auto const threshold = budget_sizes.begin() + (budget_sizes.size() - max_instances);
+        std::nth_element(budget_sizes.begin(), threshold, budget_sizes.end());
+        float const min_size = *threshold;
+
+        for (int i = 0; i < count; i++)
+        {
+            if (hidden[i] == ASTEROID_VISIBLE && projected_sizes[i] < min_size)
+                hidden[i] = ASTEROID_SKIPPED;
+        }
+    }
+
     // Iterate with i in order to join GPU data and config data
-    for (int i = 0; i < data_from_worker_threads.size(); i++)
+    occluded_count = 0;
+    skipped_count = 0;
+    for (int i = 0; i < count; i++)
     {
-        // Remove if mesh was deactivated (= -1)
+        // Remove if mesh was deactivated (= -1). Hidden asteroids are kept for collisions, but not drawn
         if (data_from_worker_threads[i].mesh_index != -1)
-            asteroid_instances_data[data_from_worker_threads[i].mesh_index].addData(data_from_worker_threads[i].position, data_from_worker_threads[i].rotation, data_from_worker_threads[i].scale);
+        {
+            asteroid_instances_data[data_from_worker_threads[i].mesh_index].addData(data_from_worker_threads[i].position, data_from_worker_threads[i].rotation, data_from_worker_threads[i].scale, i, hidden[i] == ASTEROID_VISIBLE);
+            occluded_count += hidden[i] == ASTEROID_OCCLUDED;
+            skipped_count += hidden[i] == ASTEROID_SKIPPED;
+        }
     }
+}
+
+void AsteroidBelt::draw(environment_structure const &environment, cgp::vec3 &position, cgp::rotation_transform &, bool)
+{
+    prepareInstances(position);
 
     // Call instanced drawing function for each dataset
     for (const auto &mesh_data : asteroid_instances_data)
     {
         bool is_low_poly = mesh_data.mesh_index % 3 == 2;
         // Note : no GL_DYNAMIC instancing, as for each mesh the data size can change between each frame
-        draw_instanced(asteroid_mesh_drawables[mesh_data.mesh_index], environment, mesh_data.positions, mesh_data.rotations, mesh_data.scales, mesh_data.data_count, !is_low_poly);
+        draw_instanced(asteroid_mesh_drawables[mesh_data.mesh_index], environment, mesh_data.positions, mesh_data.rotations, mesh_data.scales, mesh_data.visible_count, !is_low_poly);
+    }
+}
+
+bool AsteroidBelt::record(CommandList &list, cgp::vec3 const &position, cgp::rotation_transform const &)
+{
+    prepareInstances(position);
+
+    // The instance arrays are kept until the next frame, the command list only references them
+    for (const auto &mesh_data : asteroid_instances_data)
+    {
+        bool is_low_poly = mesh_data.mesh_index % 3 == 2;
+        list.submitInstanced(asteroid_mesh_drawables[mesh_data.mesh_index], mesh_data.positions, mesh_data.rotations, mesh_data.scales, mesh_data.visible_count, !is_low_poly);
+    }
+    return true;
+}
+
+void AsteroidBelt::appendObstacles(cgp::vec3 const &center, float range, std::vector<cgp::vec4> &obstacles) const
+{
+    for (const auto &mesh_data : asteroid_instances_data)
+    {
+        for (int i = 0; i < mesh_data.data_count; i++)
+        {
+            if (cgp::norm(mesh_data.positions[i] - center) < range)
+                obstacles.push_back({mesh_data.positions[i], mesh_data.scales[i] * ASTEROID_DISPLAY_RADIUS});
+        }
+    }
+}
+
+void AsteroidBelt::appendProjectileTargets(cgp::vec3 const &center, float range, int owner, std::vector<ProjectileTarget> &targets) const
+{
+    for (const auto &mesh_data : asteroid_instances_data)
+    {
+        for (int i = 0; i < mesh_data.data_count; i++)
+        {
+            if (cgp::norm(mesh_data.positions[i] - center) < range)
+                targets.push_back({{mesh_data.positions[i], mesh_data.scales[i] * ASTEROID_DISPLAY_RADIUS}, owner, mesh_data.indices[i]});
+        }
     }
 }
@@ -5,9 +5,12 @@
 
 #include "celestial_bodies/asteroid_belt/asteroid_thread_pool.hpp"
 #include "utils/display/drawable.hpp"
+#include "utils/display/sphere_occluders.hpp"
 #include "utils/noise/perlin.hpp"
 #include "utils/physics/constants.hpp"
 #include "utils/physics/object.hpp"
+#include "weapons/projectile_pool.hpp"
+#include <limits>
 #include <memory>
 #include <vector>
 
@@ -17,6 +20,8 @@
 constexpr float ASTEROID_MASS = 1e22;
 constexpr float DISTANCE = SATURN_RADIUS * 2500; // Orbit distance : 1 billion meters, for saturn. TODO : update this for generic use
 constexpr float ASTEROID_ORBIT_FACTOR = 10;      // Accelerate asteroids orbit for visual purposes
+constexpr int ASTEROID_OCCLUSION_MIN_CHUNK = 4096; // Asteroids per occlusion job
+constexpr float ASTEROID_LOW_POLY_RATIO = 0.04f;   // Triangles of the low poly mesh, relatively to the high poly one (about a 10 x 5 sphere)
 
 constexpr perlin_noise_parameters ASTEROID_NOISE_PARAMS{
     0.1f,
@@ -26,6 +31,14 @@ constexpr perlin_noise_parameters ASTEROID_NOISE_PARAMS{
     1.0f, // Global noise scale
 };
 
+// Why an asteroid is not drawn
+enum AsteroidVisibility : char
+{
+    ASTEROID_VISIBLE = 0,
+    ASTEROID_OCCLUDED, // Behind the sun or a planet
+    ASTEROID_SKIPPED,  // Impostor too small on screen, or over the instance budget
+};
+
 enum BeltPresets
 {
     SATURN,
@@ -41,9 +54,11 @@ struct MeshInstancesData
 {
     int mesh_index;
     int data_count;
+    int visible_count; // The visible instances come first, the occluded ones are only kept for collisions
     std::vector<cgp::vec3> positions;
     std::vector<cgp::mat3> rotations;
     std::vector<float> scales;
+    std::vector<int> indices; // Asteroid index in the thread pool
 
     // Initial size allocation
     void allocate(int n)
@@ -51,18 +66,32 @@ struct MeshInstancesData
         positions.resize(n);
         rotations.resize(n);
         scales.resize(n);
+        indices.resize(n);
     }
 
     void resetData()
     {
         data_count = 0;
+        visible_count = 0;
     }
 
-    void addData(const cgp::vec3 &position, const cgp::mat3 &rotation, float scale)
+    void addData(const cgp::vec3 &position, const cgp::mat3 &rotation, float scale, int index, bool visible = true)
     {
-        positions[data_count] = position;
-        rotations[data_count] = rotation;
-        scales[data_count] = scale;
+        // Visible : move the first occluded instance to the end to make room
+        int slot = data_count;
+        if (visible)
+        {
+            slot = visible_count++;
+            positions[data_count] = positions[slot];
+            rotations[data_count] = rotations[slot];
+            scales[data_count] = scales[slot];
+            indices[data_count] = indices[slot];
+        }
+
+        positions[slot] = position;
+        rotations[slot] = rotation;
+        scales[slot] = scale;
+        indices[slot] = index;
         data_count++;
     }
 };
@@ -84,6 +113,7 @@ public:
 
     // Draw function
     virtual void draw(environment_structure const &environment, cgp::vec3 &position, cgp::rotation_transform &rotation, bool show_wireframe = true) override;
+    virtual bool record(CommandList &list, cgp::vec3 const &position, cgp::rotation_transform const &rotation) override;
 
     // Simulation : NO NEED : done in the pool !
     // void simulateStep(float step = 24.0f * 3600 / 60);
@@ -96,7 +126,32 @@ public:
     // void setAttractor(Object *attractor) { this->attractor = attractor; };
     void addAttractor(Object *attractor) { this->attractors.push_back(attractor); };
 
+    // Add the asteroids of the last drawn frame closer than range to center, as spheres (xyz = display position, w = radius)
+    void appendObstacles(cgp::vec3 const &center, float range, std::vector<cgp::vec4> &obstacles) const;
+
+    // Same as appendObstacles, tagged with owner and the asteroid index for projectile collisions
+    void appendProjectileTargets(cgp::vec3 const &center, float range, int owner, std::vector<ProjectileTarget> &targets) const;
+
+    // Ask the worker threads to remove an asteroid (applied on their next step)
+    void destroyAsteroid(int index) { pool.requestDestruction(index); };
+
+    // Asteroids hidden by these spheres are not drawn. Must stay valid while drawing (nullptr : no culling)
+    void setOccluders(SphereOccluders const *occluders) { this->occluders = occluders; };
+    int getOccludedCount() const { return occluded_count; }; // Asteroids culled in the last drawn frame
+
+    // Disk impostors with a smaller radius on screen (pixels) are not drawn, and at most max_instances asteroids are drawn
+    // (the largest on screen). Set by the frame time governor
+    void setRenderLimits(float impostor_cutoff, int max_instances)
+    {
+        this->impostor_cutoff = impostor_cutoff;
+        this->max_instances = max_instances;
+    };
+    int getSkippedCount() const { return skipped_count; }; // Asteroids skipped by the render limits in the last drawn frame
+
 private:
+    // Get the worker threads data, restart them and sort the instances per mesh
+    void prepareInstances(cgp::vec3 const &position);
+
     std::vector<Asteroid> generateRandomAsteroids(int n, const std::vector<DistanceMeshHandler> &distance_mesh_handlers);
 
     std::vector<Object *> attractors; // Pointer to the attractor object of the simulation
@@ -112,4 +167,14 @@ private:
 
     // Use an asteroid thread pool to handle the asteroid display and simulation
     AsteroidThreadPool pool;
+
+    // Occlusion culling and render limits
+    SphereOccluders const *occluders = nullptr;
+    float impostor_cutoff = 0;
+    int max_instances = std::numeric_limits<int>::max();
+    std::vector<char> hidden;           // AsteroidVisibility of each slot, for the last drawn frame
+    std::vector<float> projected_sizes; // Radius on screen of each slot (pixels)
+    std::vector<float> budget_sizes;    // Sizes of the visible asteroids, to find the budget threshold
+    int occluded_count = 0;
+    int skipped_count = 0;
 };
\ No newline at end of file
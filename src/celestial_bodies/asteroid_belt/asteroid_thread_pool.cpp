@@ -19,6 +19,7 @@ AsteroidThreadPool::AsteroidThreadPool(const AsteroidThreadPool &other)
     // Copy the data
     asteroids = other.asteroids;
     collision_timeout = other.collision_timeout;
+    hit_immunity = other.hit_immunity;
     distance_mesh_handlers = other.distance_mesh_handlers;
 }
 
@@ -31,8 +32,8 @@ void AsteroidThreadPool::start()
     threads.clear();
     isRunning = true;
 
-    // Compute number of threads to use according to the number of asteroids to simulate
-    int n_threads = std::ceil((float)asteroids.size() / ASTEROIDS_PER_THREAD);
+    // One thread per range computed in loadAsteroids
+    int n_threads = worker_ranges.size();
 
     // Initialize thread sync
     sync_util.setThreadCount(n_threads);
@@ -40,7 +41,7 @@ void AsteroidThreadPool::start()
     // Launch threads
     for (int i = 0; i < n_threads; i++)
     {
-        threads.push_back(std::thread(&AsteroidThreadPool::worker, this, i * ASTEROIDS_PER_THREAD, std::min(((i + 1) * ASTEROIDS_PER_THREAD), (int)asteroids.size())));
+        threads.push_back(std::thread(&AsteroidThreadPool::worker, this, i));
     }
 
     if (threads.size() > 0)
@@ -85,6 +86,12 @@ void AsteroidThreadPool::awaitAndLaunchNextFrameComputation()
     sync_util.start(); // Restart the threads
 }
 
+void AsteroidThreadPool::requestDestruction(int index)
+{
+    std::lock_guard<std::mutex> lock(destruction_mutex);
+    destruction_requests.push_back(index);
+}
+
 // Get data to send to the GPU
 std::vector<AsteroidGPUData> &AsteroidThreadPool::getGPUData()
 {
@@ -107,15 +114,22 @@ cgp::vec3 AsteroidThreadPool::getCameraPosition()
 }
 
 // Worker thread function
-void AsteroidThreadPool::worker(int start_index, int end_index)
+void AsteroidThreadPool::worker(int worker_index)
 {
+    AsteroidWorkerRange &range = worker_ranges[worker_index];
+
     while (isRunning)
     {
-        // Update physics positions
-        simulateStepForIndexes(Timer::dt * 24.0f * 3600, start_index, end_index);
+        range.fragments_this_step = 0;
+        applyDestructionRequests(range);
+
+        // Update physics positions. Fragments created by the asteroid step are simulated right away
+        simulateStepForIndexes(Timer::dt * 24.0f * 3600, range.start, range.end, range);
+        simulateStepForIndexes(Timer::dt * 24.0f * 3600, range.fragment_start, range.fragment_end, range);
 
         // Compute & add the mesh index data to the buffers to be sent to the GPU
-        computeGPUDataForIndexes(start_index, end_index);
+        computeGPUDataForIndexes(range.start, range.end);
+        computeGPUDataForIndexes(range.fragment_start, range.fragment_end);
 
         // Wait for the launch signal to be given for the next iteration.
         sync_util.markDone();
@@ -125,7 +139,7 @@ void AsteroidThreadPool::worker(int start_index, int end_index)
 
 // Simulate a step for asteroids ranging from start to end indexes.
 // Helper for the worker thread function
-void AsteroidThreadPool::simulateStepForIndexes(float step, int start, int end)
+void AsteroidThreadPool::simulateStepForIndexes(float step, int start, int end, AsteroidWorkerRange &range)
 {
     // BEFORRER SIMULATION !
     // Deactivate asteroids on collision with the attractor
@@ -179,6 +193,8 @@ void AsteroidThreadPool::simulateStepForIndexes(float step, int start, int end)
     {
         if (collision_timeout[i] > 0)
             collision_timeout[i] -= Timer::dt;
+        if (hit_immunity[i] > 0)
+            hit_immunity[i] -= Timer::dt;
     }
 
     // Take collisions into account if shield or laser are activated
@@ -191,6 +207,10 @@ void AsteroidThreadPool::simulateStepForIndexes(float step, int start, int end)
 
         for (int i = start; i < end; i++)
         {
+            // Fragments just created are not hit : they would be destroyed again in cascade by the same laser
+            if (hit_immunity[i] > 0)
+                continue;
+
             // First : check collision with shield
             if (check_shield && !deactivated_asteroids[i] && collision_timeout[i] <= 0)
             {
@@ -227,11 +247,10 @@ void AsteroidThreadPool::simulateStepForIndexes(float step, int start, int end)
                 float t;
                 float distance = distance_to_line(asteroids[i].getPhysicsPosition(), collision_data.position, collision_data.direction, t);
 
-                // If distance to laser is short enough, deactivate the asteroid
+                // If distance to laser is short enough, break the asteroid
                 if (0 < t && t < MAX_DESTRUCTION_DISTANCE && distance < LASER_DESTRUCTION_RADIUS + asteroid_config_data[i].scale * ASTEROID_DISPLAY_RADIUS / PHYSICS_SCALE)
                 {
-                    // Deactivate asteroid
-                    deactivated_asteroids[i] = true;
+                    destroyAsteroid(i, range);
                 }
             }
         }
@@ -243,21 +262,26 @@ void AsteroidThreadPool::computeGPUDataForIndexes(int start, int end)
     // Get camera position for distance computation
     cgp::vec3 camera_position = getCameraPosition();
     cgp::mat3 rotation;
+    int switches = 0;
 
     for (int i = start; i < end; i++)
     {
         if (!deactivated_asteroids[i])
         {
-            // Compute the asteroid size to camera distance ratio. The higher, the lesser poly count is required
-            float ratio = cgp::norm(Object::scaleDownDistanceForDisplay(asteroids[i].getPhysicsPosition()) - camera_position) / (asteroid_config_data[i].scale * ASTEROID_DISPLAY_RADIUS);
+            // Select the mesh from the projected size of the asteroid
+            float distance = cgp::norm(Object::scaleDownDistanceForDisplay(asteroids[i].getPhysicsPosition()) - camera_position);
+            int level = global_lod_manager.select(LOD_ASTEROID, asteroid_config_data[i].scale * ASTEROID_DISPLAY_RADIUS, distance, ASTEROID_LOD_ERRORS, 3, lod_levels[i]);
+            if (lod_levels[i] != LOD_UNSET && level != lod_levels[i])
+                switches++;
+            lod_levels[i] = level;
 
             int mesh_index;
             bool is_low_poly_disk = false;
-            if (ratio < 100) // Maybe lower
+            if (level == 0)
             {
                 mesh_index = distance_mesh_handlers[asteroid_config_data[i].mesh_handler_index].high_poly;
             }
-            else if (ratio < 200) // Maybe higher
+            else if (level == 1)
             {
                 mesh_index = distance_mesh_handlers[asteroid_config_data[i].mesh_handler_index].low_poly;
             }
@@ -278,18 +302,101 @@ void AsteroidThreadPool::computeGPUDataForIndexes(int start, int end)
             gpu_data_buffer[i] = {cgp::vec3(0, 0, 0), cgp::mat3(), -1, asteroid_config_data[i].scale};
         }
     }
+
+    global_lod_manager.countSwitches(LOD_ASTEROID, switches);
+}
+
+// Apply the destruction requests (projectile hits) that belong to this worker
+void AsteroidThreadPool::applyDestructionRequests(AsteroidWorkerRange &range)
+{
+    std::lock_guard<std::mutex> lock(destruction_mutex);
+    auto consumed = std::remove_if(destruction_requests.begin(), destruction_requests.end(), [&](int index)
+                                   {
+        bool const owned = (range.start <= index && index < range.end) || (range.fragment_start <= index && index < range.fragment_end);
+        if (owned && !deactivated_asteroids[index])
+            destroyAsteroid(index, range);
+        return owned; });
+    destruction_requests.erase(consumed, destruction_requests.end());
+}
+
+void AsteroidThreadPool::destroyAsteroid(int index, AsteroidWorkerRange &range)
+{
+    deactivated_asteroids[index] = true;
+
+    float const fragment_scale = asteroid_config_data[index].scale * ASTEROID_FRAGMENT_SCALE_RATIO;
+    if (fragment_scale < ASTEROID_FRAGMENT_MIN_SCALE || range.fragment_end == range.fragment_start)
+        return;
+
+    // Tetrahedron directions, turned with the asteroid : deterministic and no random generator shared between threads
+    static const cgp::vec3 directions[ASTEROID_FRAGMENTS_PER_SPLIT] = {
+        cgp::normalize(cgp::vec3{1, 1, 1}),
+        cgp::normalize(cgp::vec3{1, -1, -1}),
+        cgp::normalize(cgp::vec3{-1, 1, -1}),
+        cgp::normalize(cgp::vec3{-1, -1, 1}),
+    };
+
+    // Copies : a destroyed fragment may be recycled as one of its own fragments
+    Object const parent = asteroids[index];
+    int const mesh_handler_index = asteroid_config_data[index].mesh_handler_index;
+    cgp::vec3 const parent_position = parent.getPhysicsPosition();
+    cgp::vec3 const parent_velocity = parent.getPhysicsVelocity();
+
+    cgp::mat3 const rotation = parent.getPhysicsRotation().matrix();
+    float const offset = fragment_scale * ASTEROID_DISPLAY_RADIUS / PHYSICS_SCALE;
+    float const ejection_speed = cgp::norm(parent_velocity) * ASTEROID_FRAGMENT_SPREAD;
+    int const capacity = range.fragment_end - range.fragment_start;
+
+    for (int k = 0; k < ASTEROID_FRAGMENTS_PER_SPLIT && range.fragments_this_step < ASTEROID_FRAGMENT_STEP_BUDGET; k++)
+    {
+        // Reuse the oldest slot : the fragment count is bounded by the pool size. The parent slot itself stays destroyed
+        int slot = range.fragment_start + range.fragment_cursor;
+        range.fragment_cursor = (range.fragment_cursor + 1) % capacity;
+        if (slot == index)
+        {
+            if (capacity == 1)
+                return;
+            slot = range.fragment_start + range.fragment_cursor;
+            range.fragment_cursor = (range.fragment_cursor + 1) % capacity;
+        }
+        range.fragments_this_step++;
+
+        cgp::vec3 const direction = rotation * directions[k];
+        asteroids[slot] = parent;
+        asteroids[slot].setPhysicsPosition(parent_position + offset * direction);
+        asteroids[slot].setVelocity(parent_velocity + ejection_speed * direction);
+
+        asteroid_config_data[slot] = {fragment_scale, mesh_handler_index};
+        collision_timeout[slot] = 0;
+        hit_immunity[slot] = ASTEROID_FRAGMENT_IMMUNITY;
+        asteroid_offsets[slot] = {0, 0, 0}; // Free fragment, no longer bound to the artificial orbit
+        deactivated_asteroids[slot] = false;
+        lod_levels[slot] = LOD_UNSET; // New object : its first selection is not a switch
+    }
 }
 
 void AsteroidThreadPool::loadAsteroids(const std::vector<Asteroid> &asteroids)
 {
     int n_asteroids = asteroids.size();
 
+    // Split the asteroids between the worker threads, each one owning a fragment pool after all the asteroids
+    int n_threads = std::ceil((float)n_asteroids / ASTEROIDS_PER_THREAD);
+    int n_slots = n_asteroids + n_threads * ASTEROID_FRAGMENTS_PER_THREAD;
+
+    worker_ranges.clear();
+    for (int i = 0; i < n_threads; i++)
+    {
+        int fragment_start = n_asteroids + i * ASTEROID_FRAGMENTS_PER_THREAD;
+        worker_ranges.push_back({i * ASTEROIDS_PER_THREAD, std::min((i + 1) * ASTEROIDS_PER_THREAD, n_asteroids), fragment_start, fragment_start + ASTEROID_FRAGMENTS_PER_THREAD});
+    }
+
     // Prepare data vectors
     this->asteroids.clear(); // Abstract class : cannot be preallocated
-    this->asteroid_config_data.resize(n_asteroids);
-    this->collision_timeout.resize(n_asteroids);
-    this->deactivated_asteroids.resize(n_asteroids);
-    this->asteroid_offsets.resize(n_asteroids);
+    this->asteroid_config_data.resize(n_slots);
+    this->collision_timeout.resize(n_slots);
+    this->hit_immunity.assign(n_slots, 0);
+    this->deactivated_asteroids.resize(n_slots);
+    this->lod_levels.assign(n_slots, LOD_UNSET);
+    this->asteroid_offsets.resize(n_slots);
 
     // Unpack and load data
     for (int i = 0; i < n_asteroids; i++)
@@ -301,4 +408,14 @@ void AsteroidThreadPool::loadAsteroids(const std::vector<Asteroid> &asteroids)
         this->deactivated_asteroids[i] = false;
         this->asteroid_offsets[i] = asteroids[i].asteroid_offset;
     }
+
+    // Fragment slots start deactivated. Their objects are overwritten by destroyAsteroid
+    for (int i = n_asteroids; i < n_slots; i++)
+    {
+        this->asteroids.push_back(asteroids[0].object);
+        this->asteroid_config_data[i] = {0, 0};
+        this->collision_timeout[i] = 0;
+        this->deactivated_asteroids[i] = true;
+        this->asteroid_offsets[i] = {0, 0, 0};
+    }
 }
\ No newline at end of file
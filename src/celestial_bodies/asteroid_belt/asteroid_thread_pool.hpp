@@ -1,4 +1,5 @@
 #pragma once
+#include "utils/display/lod_manager.hpp"
 #include "utils/physics/object.hpp"
 #include "utils/threads/threads.hpp"
 #include <algorithm>
@@ -12,6 +13,19 @@
 constexpr int ASTEROIDS_PER_THREAD = 40000;
 const float ASTEROID_DISPLAY_RADIUS = Object::scaleRadiusForDisplay(58232e3 / 40);
 
+// Relative geometric error of the high poly, low poly and disk meshes.
+// At 1080p with a 50 degrees field of view and a 1 pixel error, the low poly mesh is used beyond 100 radii and the disk beyond 200
+constexpr float ASTEROID_LOD_ERRORS[] = {0, 0.086f, 0.173f};
+
+// Destroyed asteroids split into fragments, allocated from a fixed pool owned by each worker thread
+constexpr int ASTEROID_FRAGMENTS_PER_THREAD = 4096;    // Fragment slots per worker. The oldest fragments are recycled when full
+constexpr int ASTEROID_FRAGMENTS_PER_SPLIT = 4;        // Fragments created by one destruction
+constexpr int ASTEROID_FRAGMENT_STEP_BUDGET = 256;     // Max fragments created per worker and per step (no spikes during heavy firing)
+constexpr float ASTEROID_FRAGMENT_SCALE_RATIO = 0.55f; // Fragment scale relatively to its parent (4 * 0.55^3 ~ parent volume)
+constexpr float ASTEROID_FRAGMENT_MIN_SCALE = 0.08f;   // Asteroids smaller than this are destroyed without fragments
+constexpr float ASTEROID_FRAGMENT_SPREAD = 0.02f;      // Fragment ejection speed, relatively to the parent speed
+constexpr float ASTEROID_FRAGMENT_IMMUNITY = 0.5f;     // Seconds before a fragment can be hit by the laser or the shield : it is still on the laser line when created
+
 // Data that is computed by the worker threads, and then directly passed on to the GPU using instancing
 struct AsteroidGPUData
 {
@@ -37,13 +51,24 @@ struct DistanceMeshHandler
     int low_poly_disk;
 };
 
-// Asteroid configuration data (does never change !)
+// Asteroid configuration data (does never change, except for fragment slots which are rewritten by their worker)
 struct AsteroidConfigData
 {
     float scale;
     int mesh_handler_index;
 };
 
+// Slots owned by one worker thread : its asteroids, then its fragment pool
+struct AsteroidWorkerRange
+{
+    int start;
+    int end;
+    int fragment_start;
+    int fragment_end;
+    int fragment_cursor = 0; // Next fragment slot to (re)use
+    int fragments_this_step = 0;
+};
+
 class AsteroidThreadPool
 {
 public:
@@ -69,6 +94,7 @@ public:
         gpu_data_buffer.resize(asteroids.size());
         current_gpu_data.resize(asteroids.size());
     };
+    int getSlotCount() const { return asteroids.size(); }; // Asteroids + fragment slots : size of the GPU data
     void setTimeStep(float time_step) { this->time_step = time_step; };
 
     // Base functions
@@ -76,10 +102,10 @@ public:
     void stop();  // Stop threads
 
     // Worker thread utility functions
-    void simulateStepForIndexes(float step, int start, int end);
+    void simulateStepForIndexes(float step, int start, int end, AsteroidWorkerRange &range);
     void computeGPUDataForIndexes(int start, int end);
 
-    void worker(int start_index, int end_index); // Worker thread function
+    void worker(int worker_index); // Worker thread function
 
     // Utility functions
     void updateCameraPosition(cgp::vec3 camera_position); // Update the camera position in an atomic variable in order for all the threads to be able to access it safely
@@ -87,6 +113,7 @@ public:
     std::vector<AsteroidGPUData> &getGPUData();           // Get data to send to the GPU
     void swapBuffers();
     void awaitAndLaunchNextFrameComputation(); // Unlock the sync mutex to enable the next computation for all threads
+    void requestDestruction(int index);        // Deactivate an asteroid from another thread. Applied by its worker on the next step
 
 private:
     // Atomic variables shared between threads
@@ -103,20 +130,31 @@ private:
     // Mutex for buffer swapping
     std::mutex swap_buffer_mutex;
 
+    // Asteroid indexes to deactivate, consumed by the worker owning each index
+    std::mutex destruction_mutex;
+    std::vector<int> destruction_requests;
+
     // Note : we do not need mutexes for the gpu_data_buffer, as each thread only writes to a specific section of it, so it is thread safe
     std::vector<AsteroidGPUData> gpu_data_buffer;
     std::vector<AsteroidGPUData> current_gpu_data;
 
     std::vector<Object> asteroids; // Asteroid physical objects
     std::vector<float> collision_timeout;
-    std::vector<bool> deactivated_asteroids; // Keep track of deactivated asteroids to avoid unnecessary computations
+    std::vector<float> hit_immunity; // Time left before a new fragment can be hit
+    std::vector<signed char> lod_levels;     // Current LOD of each slot (hysteresis state), written by its worker only
+    std::vector<char> deactivated_asteroids; // Keep track of deactivated asteroids to avoid unnecessary computations (char : each worker writes its own slots)
     std::vector<cgp::vec3> asteroid_offsets; // Asteroid offsets for gravity computation (display a "fluffy" belt while all asteroids are in theory on the same circular orbit)
 
     // Configuration data for asteroids and meshes. They are initialized and then never changed (read only operations by worke threads)
     std::vector<DistanceMeshHandler> distance_mesh_handlers;
     std::vector<AsteroidConfigData> asteroid_config_data;
 
+    // Deactivate an asteroid and split it into fragments taken from the worker pool
+    void destroyAsteroid(int index, AsteroidWorkerRange &range);
+    void applyDestructionRequests(AsteroidWorkerRange &range);
+
     // Threads
+    std::vector<AsteroidWorkerRange> worker_ranges;
     std::vector<std::thread> threads;
     ThreadsSync sync_util;
 };
\ No newline at end of file
@@ -24,4 +24,11 @@ void Billboard::drawBillboards(const environment_structure &environment, cgp::ve
 
     // Draw the billboard
     cgp::draw(billboard_mesh_drawable, environment);
+}
+
+bool Billboard::gatherBillboards(TransparentPass &pass, cgp::vec3 const &, cgp::rotation_transform const &rotation)
+{
+    cgp::mat3 const orientation = faceCamera ? rotation.matrix() : billboard_mesh_drawable.model.rotation.matrix();
+    pass.submit(billboard_mesh_drawable, billboard_mesh_drawable.model.translation, orientation, billboard_mesh_drawable.model.scaling);
+    return true;
 }
\ No newline at end of file
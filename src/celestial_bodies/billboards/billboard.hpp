@@ -21,6 +21,7 @@ public:
     };
 
     virtual void drawBillboards(environment_structure const &environment, cgp::vec3 &position, cgp::rotation_transform &rotation, bool show_wireframe = true) override;
+    virtual bool gatherBillboards(TransparentPass &pass, cgp::vec3 const &position, cgp::rotation_transform const &rotation) override;
 
     // Setters
     void setFaceCamera(bool faceCamera) { this->faceCamera = faceCamera; };
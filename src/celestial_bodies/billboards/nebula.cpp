@@ -0,0 +1,86 @@
+#include "nebula.hpp"
+#include "cgp/core/containers/image/image.hpp"
+#include "cgp/geometry/shape/mesh/primitive/mesh_primitive.hpp"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+void Nebula::initialize()
+{
+    // Soft round sprite : white, the tint comes from the material color
+    int const size = NEBULA_TEXTURE_SIZE;
+    cgp::numarray<unsigned char> pixels;
+    pixels.resize(4 * size * size);
+    for (int j = 0; j < size; j++)
+    {
+        for (int i = 0; i < size; i++)
+        {
+            float const u = 2 * (i + 0.5f) / size - 1;
+            float const v = 2 * (j + 0.5f) / size - 1;
+            float const alpha = std::exp(-4 * (u * u + v * v)) * std::max(0.0f, 1 - std::sqrt(u * u + v * v));
+
+            int const k = 4 * (j * size + i);
+            pixels[k] = pixels[k + 1] = pixels[k + 2] = 255;
+            pixels[k + 3] = (unsigned char)(255 * alpha);
+        }
+    }
+    cgp::image_structure const image(size, size, cgp::image_color_type::rgba, pixels);
+
+    cgp::vec3 const tint_colors[NEBULA_TINT_COUNT] = {{0.9f, 0.4f, 0.7f}, {0.5f, 0.4f, 1.0f}, {0.3f, 0.7f, 1.0f}, {1.0f, 0.6f, 0.4f}};
+
+    float const r = NEBULA_SPRITE_RADIUS;
+    cgp::mesh const sprite_mesh = cgp::mesh_primitive_quadrangle({-r, -r, 0}, {r, -r, 0}, {r, r, 0}, {-r, r, 0});
+    for (int t = 0; t < NEBULA_TINT_COUNT; t++)
+    {
+        sprite_mesh_drawables[t].initialize_data_on_gpu(sprite_mesh);
+        sprite_mesh_drawables[t].texture.initialize_texture_2d_on_gpu(image);
+        sprite_mesh_drawables[t].material.color = tint_colors[t];
+        sprite_mesh_drawables[t].material.alpha = 0.25f;
+        sprite_mesh_drawables[t].material.phong.ambient = 1; // Emissive gas : ignore the light direction
+        sprite_mesh_drawables[t].material.phong.diffuse = 0;
+        sprite_mesh_drawables[t].material.phong.specular = 0;
+        sprite_mesh_drawables[t].material.texture_settings.two_sided = true;
+    }
+
+    // Denser at the center : gaussian distribution, with a few large sprites
+    std::mt19937 generator(443);
+    std::normal_distribution<float> spread(0, radius / 2);
+    std::uniform_real_distribution<float> scale(0.5f, 2.5f);
+    std::uniform_int_distribution<int> tint(0, NEBULA_TINT_COUNT - 1);
+
+    offsets.resize(sprite_count);
+    scales.resize(sprite_count);
+    tints.resize(sprite_count);
+    for (int i = 0; i < sprite_count; i++)
+    {
+        offsets[i] = {spread(generator), spread(generator), spread(generator) / 3}; // Flattened cloud
+        scales[i] = scale(generator);
+        tints[i] = tint(generator);
+    }
+}
+
+void Nebula::setPosition(cgp::vec3 position)
+{
+    this->position = position;
+}
+
+void Nebula::drawBillboards(environment_structure const &environment, cgp::vec3 &, cgp::rotation_transform &rotation, bool)
+{
+    // Unsorted fallback, one draw call per sprite
+    for (int i = 0; i < sprite_count; i++)
+    {
+        cgp::mesh_drawable &drawable = sprite_mesh_drawables[tints[i]];
+        drawable.model.translation = position + offsets[i];
+        drawable.model.rotation = rotation;
+        drawable.model.scaling = scales[i];
+        cgp::draw(drawable, environment);
+    }
+}
+
+bool Nebula::gatherBillboards(TransparentPass &pass, cgp::vec3 const &, cgp::rotation_transform const &rotation)
+{
+    cgp::mat3 const orientation = rotation.matrix();
+    for (int i = 0; i < sprite_count; i++)
+        pass.submit(sprite_mesh_drawables[tints[i]], position + offsets[i], orientation, scales[i]);
+    return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "cgp/graphics/drawable/mesh_drawable/mesh_drawable.hpp"
+#include "utils/display/billboard_drawable.hpp"
+#include <vector>
+
+// ************************************************** //
+//                  NEBULA CONSTANTS                  //
+// ************************************************** //
+constexpr int NEBULA_TINT_COUNT = 4;        // One quad mesh (and one instanced run at most) per tint
+constexpr int NEBULA_TEXTURE_SIZE = 64;     // Procedural sprite texture resolution
+constexpr float NEBULA_SPRITE_RADIUS = 1.5; // Display radius of one sprite
+
+/**
+ * Gas cloud made of many camera facing sprites.
+ * The sprites are submitted to the transparent pass, which sorts them with the other billboards
+ */
+class Nebula : public BillboardDrawable
+{
+public:
+    Nebula(cgp::vec3 position, float radius, int sprite_count) : position(position), radius(radius), sprite_count(sprite_count){};
+
+    virtual void initialize() override;
+
+    virtual void setPosition(cgp::vec3 position) override;
+
+    virtual void drawBillboards(environment_structure const &environment, cgp::vec3 &position, cgp::rotation_transform &rotation, bool show_wireframe = true) override;
+    virtual bool gatherBillboards(TransparentPass &pass, cgp::vec3 const &position, cgp::rotation_transform const &rotation) override;
+
+private:
+    cgp::vec3 position; // Display position of the cloud center
+    float radius;
+    int sprite_count;
+
+    // Sprites, relative to the cloud center
+    std::vector<cgp::vec3> offsets;
+    std::vector<float> scales;
+    std::vector<int> tints;
+
+    cgp::mesh_drawable sprite_mesh_drawables[NEBULA_TINT_COUNT];
+};
@@ -1,5 +1,6 @@
 #include "planet.hpp"
 #include "cgp/core/array/numarray_stack/implementation/numarray_stack.hpp"
+#include "cgp/geometry/shape/mesh/optimization/mesh_optimization.hpp"
 #include "cgp/geometry/shape/noise/noise.hpp"
 #include "cgp/geometry/transform/rotation_transform/rotation_transform.hpp"
 #include "cgp/geometry/vec/vec3/vec3.hpp"
@@ -42,25 +43,87 @@ void Planet::initialize()
     LowPolyDrawable::initialize(); // Call base class initialize function
     // Initialize CGP elements
     planet_mesh = mesh_primitive_perlin_sphere(radius, {0, 0, 0}, Nu, Nv, parameters);
+    cgp::mesh_optimize(planet_mesh);
+    planet_mesh_drawable.interleaved = true; // Never updated : one vertex stream
     planet_mesh_drawable.initialize_data_on_gpu(planet_mesh);
 
-    // Add texture
+    // Add texture. Repeated horizontally : the quadtree chunk u coordinates may go past [0, 1]
     planet_mesh_drawable.texture.load_and_initialize_texture_2d_on_gpu(project::path + texture_path,
-                                                                       GL_CLAMP_TO_EDGE,
+                                                                       GL_REPEAT,
                                                                        GL_CLAMP_TO_EDGE);
 
     planet_mesh_drawable.material.phong.specular = 0; // No reflection for the planet display
+
+    quadtree = std::make_shared<PlanetQuadtree>(PlanetSurface{(float)radius, parameters});
+    quadtree->initialize();
+
+    height_cache = std::make_shared<PlanetHeightCache>();
+    height_cache->bake(PlanetSurface{(float)radius, parameters});
+}
+
+bool Planet::shouldUseQuadtree(cgp::vec3 const &position)
+{
+    if (quadtree == nullptr)
+        return false;
+
+    float distance = cgp::norm(position - planet_mesh_drawable.model.translation);
+    global_lod_manager.update(LOD_PLANET, radius, distance, PLANET_QUADTREE_LOD_ERRORS, 2, quadtree_lod_level);
+
+    return quadtree_lod_level == 0;
 }
 
 /**
  * Draw the planet in the given environment
  */
-void Planet::draw_real(const environment_structure &environment, cgp::vec3 &, cgp::rotation_transform &, bool show_wireframe)
+void Planet::draw_real(const environment_structure &environment, cgp::vec3 &position, cgp::rotation_transform &, bool show_wireframe)
 {
-    cgp::draw(planet_mesh_drawable, environment);
+    if (!shouldUseQuadtree(position))
+    {
+        drawMesh(planet_mesh_drawable, environment);
 
-    if (show_wireframe)
-        cgp::draw_wireframe(planet_mesh_drawable, environment);
+        if (show_wireframe)
+            cgp::draw_wireframe(planet_mesh_drawable, environment);
+        return;
+    }
+
+    // Camera in the planet frame
+    cgp::affine const &model = planet_mesh_drawable.model;
+    quadtree->update(cgp::inverse(model) * position);
+
+    for (cgp::mesh_drawable *chunk : quadtree->getVisibleChunks())
+    {
+        chunk->model = model;
+        chunk->shader = planet_mesh_drawable.shader;
+        chunk->texture = planet_mesh_drawable.texture;
+        chunk->material = planet_mesh_drawable.material;
+        drawMesh(*chunk, environment);
+
+        if (show_wireframe)
+            cgp::draw_wireframe(*chunk, environment);
+    }
+}
+
+bool Planet::record_real(CommandList &list, cgp::vec3 const &position, cgp::rotation_transform const &)
+{
+    // The quadtree uploads chunks : it is drawn on the OpenGL thread
+    if (shouldUseQuadtree(position))
+        return false;
+
+    list.submit(planet_mesh_drawable);
+    return true;
+}
+
+PlanetQuadtreeStats Planet::getQuadtreeStats() const
+{
+    if (quadtree == nullptr || quadtree_lod_level != 0)
+        return {};
+    return quadtree->getStats();
+}
+
+void Planet::clearQuadtree()
+{
+    if (quadtree != nullptr)
+        quadtree->clear();
 }
 
 /**
@@ -80,8 +143,27 @@ void Planet::setPosition(vec3 position)
  */
 double Planet::getHeightAt(vec3 position) const
 {
-    // Call noise function with normalized position
-    return cgp::noise_perlin(cgp::normalize(position) * parameters.scale, parameters.octave, parameters.persistency, parameters.frequency_gain);
+    if (height_cache != nullptr)
+        return height_cache->getHeight(position);
+
+    // Not initialized yet : evaluate the surface
+    cgp::vec3 const direction = cgp::normalize(position);
+    float height;
+    PlanetSurface{(float)radius, parameters}.heights(&direction, &height, 1);
+    return height;
+}
+
+void Planet::getHeightBoundsAt(vec3 position, float angle, float &min_height, float &max_height) const
+{
+    if (height_cache != nullptr)
+    {
+        height_cache->getHeightBounds(position, angle, min_height, max_height);
+        return;
+    }
+
+    // Not initialized yet : the noise moves the surface by a sixth of the radius at most
+    min_height = radius * (1 - 1.0f / 6);
+    max_height = radius * (1 + 1.0f / 6);
 }
 
 // Update models based on physics members
@@ -3,9 +3,12 @@
 #include "cgp/geometry/shape/mesh/structure/mesh.hpp"
 #include "cgp/graphics/drawable/mesh_drawable/mesh_drawable.hpp"
 #include "environment.hpp"
+#include "planet_height_cache.hpp"
+#include "planet_quadtree.hpp"
 #include "utils/display/low_poly.hpp"
 #include "utils/noise/perlin.hpp"
 #include "utils/physics/object.hpp"
+#include <memory>
 #include <string>
 
 /**
@@ -21,6 +24,7 @@ public:
     // Draw function
     virtual void initialize() override;
     virtual void draw_real(environment_structure const &environment, cgp::vec3 &position, cgp::rotation_transform &rotation, bool show_wireframe = true) override;
+    virtual bool record_real(CommandList &list, cgp::vec3 const &position, cgp::rotation_transform const &rotation) override;
 
     // Setters
     virtual void setPosition(vec3 position) override;
@@ -29,10 +33,21 @@ public:
     virtual cgp::mesh_drawable getMeshDrawable() const { return planet_mesh_drawable; };
 
     // Utility physics functions
-    double getHeightAt(vec3 position) const; // TODO for collisions
+    // Distance from the center to the surface in the direction of position (planet frame, display units)
+    double getHeightAt(vec3 position) const;
+    // Min and max of the surface height within an angle (radians) around the direction of position
+    void getHeightBoundsAt(vec3 position, float angle, float &min_height, float &max_height) const;
     virtual void updateModels() override;
 
+    // Quadtree terrain stats (empty if the quadtree is not used)
+    PlanetQuadtreeStats getQuadtreeStats() const;
+
+    // Free the quadtree chunks (OpenGL thread)
+    void clearQuadtree();
+
 private:
+    bool shouldUseQuadtree(cgp::vec3 const &position); // Selects the level through the LOD manager (counts the switches)
+
     // Perlin noise properties
     perlin_noise_parameters parameters;
 
@@ -44,6 +59,14 @@ private:
     int Nu = 50;
     int Nv = 25;
 
+    // Chunked terrain, used instead of the single mesh when the planet is large on screen.
+    // Shared : the planet is copied when added to the simulation
+    std::shared_ptr<PlanetQuadtree> quadtree;
+    int quadtree_lod_level = LOD_UNSET;
+
+    // Surface heights baked at initialization, for the collision queries. Shared for the same reason
+    std::shared_ptr<PlanetHeightCache> height_cache;
+
 protected:
     // CGP elements
     cgp::mesh planet_mesh;
@@ -0,0 +1,146 @@
+#include "planet_height_cache.hpp"
+#include "utils/threads/job_system.hpp"
+#include <algorithm>
+#include <cmath>
+
+void PlanetHeightCache::bake(PlanetSurface const &surface, int cells)
+{
+    this->cells = cells;
+    int const side = cells + 1;
+    samples.resize(6 * side * side);
+
+    // One row of a face per sample line, evaluated in batch
+    global_job_system.parallelFor(6 * side, [&](int begin, int end)
+                                  {
+        std::vector<cgp::vec3> directions((end - begin) * side);
+        for (int row = begin; row < end; row++)
+        {
+            int const face = row / side;
+            int const axis = face / 2;
+            float const t = -1 + 2.0f * (row % side) / cells;
+            for (int i = 0; i < side; i++)
+            {
+                cgp::vec3 direction;
+                direction[axis] = face % 2 == 0 ? 1.0f : -1.0f;
+                direction[(axis + 1) % 3] = -1 + 2.0f * i / cells;
+                direction[(axis + 2) % 3] = t;
+                directions[(row - begin) * side + i] = cgp::normalize(direction);
+            }
+        }
+        surface.heights(directions.data(), samples.data() + begin * side, directions.size()); }, PLANET_HEIGHT_CACHE_ROWS_PER_JOB);
+
+    // Bounds pyramid : the bilinear surface of a cell stays between its 4 samples
+    pyramid_min.assign(1, std::vector<float>(6 * cells * cells));
+    pyramid_max.assign(1, std::vector<float>(6 * cells * cells));
+    for (int face = 0; face < 6; face++)
+    {
+        for (int j = 0; j < cells; j++)
+        {
+            for (int i = 0; i < cells; i++)
+            {
+                float const corners[4] = {sample(face, i, j), sample(face, i + 1, j), sample(face, i, j + 1), sample(face, i + 1, j + 1)};
+                int const index = (face * cells + j) * cells + i;
+                pyramid_min[0][index] = *std::min_element(corners, corners + 4);
+                pyramid_max[0][index] = *std::max_element(corners, corners + 4);
+            }
+        }
+    }
+
+    for (int level_cells = cells / 2; level_cells >= 1; level_cells /= 2)
+    {
+        std::vector<float> const &finer_min = pyramid_min.back();
+        std::vector<float> const &finer_max = pyramid_max.back();
+        std::vector<float> level_min(6 * level_cells * level_cells);
+        std::vector<float> level_max(6 * level_cells * level_cells);
+        int const finer_cells = 2 * level_cells;
+
+        for (int face = 0; face < 6; face++)
+        {
+            for (int j = 0; j < level_cells; j++)
+            {
+                for (int i = 0; i < level_cells; i++)
+                {
+                    int const index = (face * level_cells + j) * level_cells + i;
+                    int const child = (face * finer_cells + 2 * j) * finer_cells + 2 * i;
+                    level_min[index] = std::min({finer_min[child], finer_min[child + 1], finer_min[child + finer_cells], finer_min[child + finer_cells + 1]});
+                    level_max[index] = std::max({finer_max[child], finer_max[child + 1], finer_max[child + finer_cells], finer_max[child + finer_cells + 1]});
+                }
+            }
+        }
+
+        pyramid_min.push_back(std::move(level_min));
+        pyramid_max.push_back(std::move(level_max));
+    }
+
+    // The last level is one cell per face
+    min_height = *std::min_element(pyramid_min.back().begin(), pyramid_min.back().end());
+    max_height = *std::max_element(pyramid_max.back().begin(), pyramid_max.back().end());
+}
+
+PlanetHeightCache::FaceCoordinates PlanetHeightCache::toFace(cgp::vec3 const &direction) const
+{
+    int axis = 0;
+    for (int k = 1; k < 3; k++)
+    {
+        if (std::abs(direction[k]) > std::abs(direction[axis]))
+            axis = k;
+    }
+
+    float const m = std::abs(direction[axis]);
+    FaceCoordinates coordinates;
+    coordinates.face = 2 * axis + (direction[axis] < 0 ? 1 : 0);
+    coordinates.s = std::clamp((direction[(axis + 1) % 3] / m + 1) * 0.5f * cells, 0.0f, (float)cells);
+    coordinates.t = std::clamp((direction[(axis + 2) % 3] / m + 1) * 0.5f * cells, 0.0f, (float)cells);
+    return coordinates;
+}
+
+float PlanetHeightCache::getHeight(cgp::vec3 const &direction) const
+{
+    FaceCoordinates const c = toFace(direction);
+    int const i = std::min((int)c.s, cells - 1);
+    int const j = std::min((int)c.t, cells - 1);
+    float const u = c.s - i;
+    float const v = c.t - j;
+
+    float const bottom = (1 - u) * sample(c.face, i, j) + u * sample(c.face, i + 1, j);
+    float const top = (1 - u) * sample(c.face, i, j + 1) + u * sample(c.face, i + 1, j + 1);
+    return (1 - v) * bottom + v * top;
+}
+
+void PlanetHeightCache::getHeightBounds(cgp::vec3 const &direction, float angle, float &min_height, float &max_height) const
+{
+    // An angle moves the face coordinates by at most 2 * sqrt(3) * angle (the largest coordinate is over 1 / sqrt(3)),
+    // that is sqrt(3) * angle * cells cells. Rounded up for the second order terms
+    float const reach = 2 * angle * cells;
+    FaceCoordinates const c = toFace(direction);
+    if (angle > 0.25f || c.s - reach < 0 || c.t - reach < 0 || c.s + reach > cells || c.t + reach > cells)
+    {
+        // Wide or across a face border
+        min_height = this->min_height;
+        max_height = this->max_height;
+        return;
+    }
+
+    // Coarsest level whose cells are larger than the footprint : it covers 2 x 2 cells at most
+    int level = 0;
+    while (level + 1 < (int)pyramid_min.size() && (1 << level) < 2 * reach)
+        level++;
+
+    int const level_cells = cells >> level;
+    int const i0 = std::max((int)(c.s - reach) >> level, 0);
+    int const i1 = std::min((int)(c.s + reach) >> level, level_cells - 1);
+    int const j0 = std::max((int)(c.t - reach) >> level, 0);
+    int const j1 = std::min((int)(c.t + reach) >> level, level_cells - 1);
+
+    min_height = this->max_height;
+    max_height = this->min_height;
+    for (int j = j0; j <= j1; j++)
+    {
+        for (int i = i0; i <= i1; i++)
+        {
+            int const index = (c.face * level_cells + j) * level_cells + i;
+            min_height = std::min(min_height, pyramid_min[level][index]);
+            max_height = std::max(max_height, pyramid_max[level][index]);
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "planet_quadtree.hpp"
+#include <vector>
+
+// ************************************************** //
+//               HEIGHT CACHE CONSTANTS               //
+// ************************************************** //
+constexpr int PLANET_HEIGHT_CACHE_CELLS = 256; // Cells per cube face side (power of 2 : the bounds pyramid halves it)
+constexpr int PLANET_HEIGHT_CACHE_ROWS_PER_JOB = 16;
+
+/**
+ * Surface height of a planet baked on the 6 faces of a cube, for collision queries.
+ * Face (axis, sign) holds the directions whose largest coordinate is along axis : the samples are on a regular
+ * (s, t) grid of the face, with s and t the 2 other coordinates divided by the largest one. The samples of the face
+ * borders are shared by the faces, so a lookup never reads another face.
+ * A query is a bilinear interpolation of 4 samples. A min / max pyramid of the cells gives bounds of the heights
+ * around a direction, to reject far objects before the exact test.
+ */
+class PlanetHeightCache
+{
+public:
+    // Evaluate the surface on every sample, in parallel on the job system
+    void bake(PlanetSurface const &surface, int cells = PLANET_HEIGHT_CACHE_CELLS);
+
+    bool isBaked() const { return !samples.empty(); };
+
+    // Distance from the center to the surface in this direction (need not be normalized)
+    float getHeight(cgp::vec3 const &direction) const;
+
+    // Min and max of the cached surface within an angle (radians) around the direction
+    void getHeightBounds(cgp::vec3 const &direction, float angle, float &min_height, float &max_height) const;
+
+    // Extreme heights of the whole planet
+    float getMinHeight() const { return min_height; };
+    float getMaxHeight() const { return max_height; };
+
+private:
+    struct FaceCoordinates
+    {
+        int face;
+        float s, t; // In [0, cells]
+    };
+
+    FaceCoordinates toFace(cgp::vec3 const &direction) const;
+    float sample(int face, int i, int j) const { return samples[(face * (cells + 1) + j) * (cells + 1) + i]; };
+
+    int cells = 0;
+    std::vector<float> samples; // 6 faces of (cells + 1)^2 heights
+
+    // Level l : 6 faces of (cells >> l)^2 cells with the min and max of the samples they cover
+    std::vector<std::vector<float>> pyramid_min;
+    std::vector<std::vector<float>> pyramid_max;
+
+    float min_height = 0;
+    float max_height = 0;
+};
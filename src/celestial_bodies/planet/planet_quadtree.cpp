@@ -0,0 +1,422 @@
+#include "planet_quadtree.hpp"
+#include "utils/display/lod_manager.hpp"
+#include "utils/noise/noise_batch.hpp"
+#include "utils/threads/job_system.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// Cube faces : the (s, t) axes are chosen so that s_axis x t_axis = normal, which keeps the triangles outward facing
+struct CubeFace
+{
+    cgp::vec3 normal;
+    cgp::vec3 s_axis;
+    cgp::vec3 t_axis;
+};
+
+// Ordered as +X, -X, +Y, -Y, +Z, -Z : the face of an axis k with sign is 2 * k + (negative)
+static const CubeFace CUBE_FACES[6] = {
+    {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}},
+    {{-1, 0, 0}, {0, 0, 1}, {0, 1, 0}},
+    {{0, 1, 0}, {0, 0, 1}, {1, 0, 0}},
+    {{0, -1, 0}, {1, 0, 0}, {0, 0, 1}},
+    {{0, 0, 1}, {1, 0, 0}, {0, 1, 0}},
+    {{0, 0, -1}, {0, 1, 0}, {1, 0, 0}},
+};
+
+// Triangles of a chunk for each edge mask. All the variants have the same size : the stitched edges produce degenerate
+// triangles, so the index buffer of a chunk can be rewritten in place when its neighbors change
+static std::vector<cgp::numarray<cgp::uint3>> const &stitchedConnectivities()
+{
+    static std::vector<cgp::numarray<cgp::uint3>> const variants = []
+    {
+        int const N = PLANET_CHUNK_RESOLUTION;
+        std::vector<cgp::numarray<cgp::uint3>> result(16);
+
+        for (int mask = 0; mask < 16; mask++)
+        {
+            // Odd vertices of a stitched edge are replaced by the previous even one : the edge matches the coarser neighbor
+            auto index = [&](int i, int j) -> unsigned int
+            {
+                if ((j == 0 && (mask & CHUNK_EDGE_T_MIN)) || (j == N && (mask & CHUNK_EDGE_T_MAX)))
+                    i -= i % 2;
+                if ((i == 0 && (mask & CHUNK_EDGE_S_MIN)) || (i == N && (mask & CHUNK_EDGE_S_MAX)))
+                    j -= j % 2;
+                return i + (N + 1) * j;
+            };
+
+            for (int j = 0; j < N; j++)
+            {
+                for (int i = 0; i < N; i++)
+                {
+                    result[mask].push_back({index(i, j), index(i + 1, j), index(i + 1, j + 1)});
+                    result[mask].push_back({index(i, j), index(i + 1, j + 1), index(i, j + 1)});
+                }
+            }
+        }
+        return result;
+    }();
+
+    return variants;
+}
+
+void PlanetSurface::heights(cgp::vec3 const *directions, float *output, int count) const
+{
+    bool useNoise = parameters.frequency_gain != 0 || parameters.octave != 0 || parameters.persistency != 0 || parameters.scale != 0;
+    if (!useNoise)
+    {
+        std::fill(output, output + count, radius);
+        return;
+    }
+
+    std::vector<cgp::vec3> noise_points(count);
+    for (int k = 0; k < count; k++)
+        noise_points[k] = directions[k] * parameters.scale;
+    noise_perlin_batch(noise_points.data(), output, count, parameters.octave, parameters.persistency, parameters.frequency_gain);
+
+    for (int k = 0; k < count; k++)
+        output[k] = radius * (1 + (output[k] - 0.5f) / 3);
+}
+
+void PlanetSurface::positions(cgp::vec3 const *directions, cgp::vec3 *output, int count) const
+{
+    std::vector<float> distances(count);
+    heights(directions, distances.data(), count);
+
+    for (int k = 0; k < count; k++)
+        output[k] = distances[k] * directions[k];
+}
+
+PlanetQuadtree::~PlanetQuadtree()
+{
+    // The jobs write into the chunks
+    for (auto &entry : chunks)
+    {
+        if (entry.second->job.valid())
+            entry.second->job.wait();
+    }
+}
+
+void PlanetQuadtree::clear()
+{
+    for (auto &entry : chunks)
+    {
+        Chunk &chunk = *entry.second;
+        if (chunk.job.valid())
+            chunk.job.wait();
+        if (chunk.uploaded)
+            chunk.drawable.clear();
+    }
+    chunks.clear();
+    nodes.clear();
+    visible_chunks.clear();
+    stats = PlanetQuadtreeStats();
+}
+
+void PlanetQuadtree::initialize()
+{
+    // The roots are always ready : the surface can always be drawn
+    for (int face = 0; face < 6; face++)
+    {
+        auto chunk = std::make_unique<Chunk>();
+        generateChunk(surface, face, 0, 0, 0, chunk->mesh);
+        chunk->drawable.interleaved = true;
+        chunk->drawable.initialize_data_on_gpu(chunk->mesh);
+        chunk->mesh = cgp::mesh();
+        chunk->uploaded = true;
+        chunks[chunkKey(face, 0, 0, 0)] = std::move(chunk);
+    }
+}
+
+uint64_t PlanetQuadtree::chunkKey(int face, int level, int x, int y)
+{
+    return (uint64_t)face | ((uint64_t)level << 3) | ((uint64_t)x << 8) | ((uint64_t)y << 32);
+}
+
+void PlanetQuadtree::generateChunk(PlanetSurface surface, int face, int level, int x, int y, cgp::mesh &mesh)
+{
+    CubeFace const &cube_face = CUBE_FACES[face];
+    int const N = PLANET_CHUNK_RESOLUTION;
+    int const E = N + 3; // Grid with a one vertex border, for the normals
+    float const cells = float(N << level);
+
+    // The coordinates are exact in float (integer over a power of 2) : chunks sharing an edge compute the same vertices
+    std::vector<cgp::vec3> grid(E * E);
+    std::vector<cgp::vec3> directions(E * E);
+    for (int j = -1; j <= N + 1; j++)
+    {
+        for (int i = -1; i <= N + 1; i++)
+        {
+            float const s = -1 + 2 * (x * N + i) / cells;
+            float const t = -1 + 2 * (y * N + j) / cells;
+            cgp::vec3 const direction = cgp::normalize(cube_face.normal + s * cube_face.s_axis + t * cube_face.t_axis);
+
+            directions[(i + 1) + E * (j + 1)] = direction;
+        }
+    }
+    surface.positions(directions.data(), grid.data(), E * E);
+
+    mesh.position.resize((N + 1) * (N + 1));
+    mesh.normal.resize((N + 1) * (N + 1));
+    mesh.uv.resize((N + 1) * (N + 1));
+
+    // Longitude of the chunk center : the u coordinates are unwrapped around it, so they are continuous across the
+    // texture seam (the planet texture repeats). Chunks containing a pole still have one seam, away from their center
+    float const center_s = -1 + 2 * (x * N + N / 2) / cells;
+    float const center_t = -1 + 2 * (y * N + N / 2) / cells;
+    cgp::vec3 const center = cube_face.normal + center_s * cube_face.s_axis + center_t * cube_face.t_axis;
+    float const u_center = std::atan2(center.y, center.x) / (2 * cgp::Pi) + 0.5f;
+
+    for (int j = 0; j <= N; j++)
+    {
+        for (int i = 0; i <= N; i++)
+        {
+            int const g = (i + 1) + E * (j + 1);
+            int const k = i + (N + 1) * j;
+
+            mesh.position[k] = grid[g];
+            mesh.normal[k] = cgp::normalize(cgp::cross(grid[g + 1] - grid[g - 1], grid[g + E] - grid[g - E]));
+
+            // Same equirectangular mapping as mesh_primitive_perlin_sphere
+            cgp::vec3 const &d = directions[g];
+            float u = u_center; // The longitude of a pole vertex is undefined
+            if (d.x * d.x + d.y * d.y > 1e-12f)
+            {
+                u = std::atan2(d.y, d.x) / (2 * cgp::Pi) + 0.5f;
+                u -= std::round(u - u_center);
+            }
+            float const v = std::asin(std::clamp(d.z, -1.0f, 1.0f)) / cgp::Pi + 0.5f;
+            mesh.uv[k] = {u, v};
+        }
+    }
+
+    mesh.connectivity = stitchedConnectivities()[0];
+    mesh.fill_empty_field();
+}
+
+PlanetQuadtree::Chunk *PlanetQuadtree::getReadyChunk(Node const &node)
+{
+    uint64_t const key = chunkKey(node.face, node.level, node.x, node.y);
+    auto it = chunks.find(key);
+
+    // Unknown chunk : generate it on a worker
+    if (it == chunks.end())
+    {
+        if (requests_this_frame >= PLANET_CHUNK_REQUESTS_PER_FRAME)
+            return nullptr;
+        requests_this_frame++;
+
+        auto chunk = std::make_unique<Chunk>();
+        Chunk *target = chunk.get();
+        target->last_used_frame = frame;
+        target->job = global_job_system.submit([surface = surface, node, target]()
+                                               { generateChunk(surface, node.face, node.level, node.x, node.y, target->mesh); });
+        chunks[key] = std::move(chunk);
+        return nullptr;
+    }
+
+    Chunk &chunk = *it->second;
+    chunk.last_used_frame = frame;
+    if (chunk.uploaded)
+        return &chunk;
+
+    // Upload the generated mesh, if the job is done
+    if (uploads_this_frame >= PLANET_CHUNK_UPLOADS_PER_FRAME || chunk.job.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return nullptr;
+    uploads_this_frame++;
+
+    chunk.job.get();
+    chunk.drawable.interleaved = true;
+    chunk.drawable.initialize_data_on_gpu(chunk.mesh);
+    chunk.mesh = cgp::mesh();
+    chunk.uploaded = true;
+    return &chunk;
+}
+
+float PlanetQuadtree::screenError(Node const &node) const
+{
+    CubeFace const &cube_face = CUBE_FACES[node.face];
+    float const size = 2.0f / (1 << node.level); // Chunk side on the cube
+    float const s = -1 + size * (node.x + 0.5f);
+    float const t = -1 + size * (node.y + 0.5f);
+    cgp::vec3 const center = surface.radius * cgp::normalize(cube_face.normal + s * cube_face.s_axis + t * cube_face.t_axis);
+
+    // Distance to the chunk bounding sphere, including the terrain height
+    float const bounding_radius = surface.radius * (0.75f * size + 1.0f / 6);
+    float const distance = std::max(cgp::norm(camera - center) - bounding_radius, surface.radius * 1e-4f);
+
+    // Quad size on screen
+    return global_lod_manager.projectedSize(surface.radius * size / PLANET_CHUNK_RESOLUTION, distance);
+}
+
+int PlanetQuadtree::findLeaf(cgp::vec3 const &point)
+{
+    // The face is given by the largest coordinate, then (s, t) are the coordinates on the cube
+    int axis = 0;
+    for (int k = 1; k < 3; k++)
+    {
+        if (std::abs(point[k]) > std::abs(point[axis]))
+            axis = k;
+    }
+    int const face = 2 * axis + (point[axis] < 0 ? 1 : 0);
+    float const m = std::abs(point[axis]);
+    float const s = cgp::dot(point, CUBE_FACES[face].s_axis) / m;
+    float const t = cgp::dot(point, CUBE_FACES[face].t_axis) / m;
+
+    int index = face; // The roots are the first 6 nodes
+    while (nodes[index].children != -1)
+    {
+        Node const &node = nodes[index];
+        int const cells = 2 << node.level;
+        int const cx = std::clamp((int)((s + 1) / 2 * cells), 2 * node.x, 2 * node.x + 1);
+        int const cy = std::clamp((int)((t + 1) / 2 * cells), 2 * node.y, 2 * node.y + 1);
+        index = node.children + (cx - 2 * node.x) + 2 * (cy - 2 * node.y);
+    }
+    return index;
+}
+
+int PlanetQuadtree::neighborLeaf(Node const &node, int edge)
+{
+    // Probe a quarter of a chunk past the middle of the edge (possibly on another face)
+    float const size = 2.0f / (1 << node.level);
+    float s = -1 + size * (node.x + 0.5f);
+    float t = -1 + size * (node.y + 0.5f);
+    float const offset = 0.75f * size;
+    if (edge == CHUNK_EDGE_S_MIN)
+        s -= offset;
+    else if (edge == CHUNK_EDGE_S_MAX)
+        s += offset;
+    else if (edge == CHUNK_EDGE_T_MIN)
+        t -= offset;
+    else
+        t += offset;
+
+    CubeFace const &cube_face = CUBE_FACES[node.face];
+    return findLeaf(cube_face.normal + s * cube_face.s_axis + t * cube_face.t_axis);
+}
+
+bool PlanetQuadtree::split(int index)
+{
+    Node const node = nodes[index]; // Copy : nodes grows below
+    if (node.children != -1)
+        return true;
+    if (node.level >= PLANET_CHUNK_MAX_LEVEL)
+        return false;
+
+    // The 4 children must be ready (all of them are requested)
+    Node children[4];
+    bool ready = true;
+    for (int k = 0; k < 4; k++)
+    {
+        children[k] = {node.face, node.level + 1, 2 * node.x + (k & 1), 2 * node.y + (k >> 1)};
+        ready = getReadyChunk(children[k]) != nullptr && ready;
+    }
+    if (!ready)
+        return false;
+
+    // Restricted quadtree : coarser neighbors are split first, so that the children differ by one level at most
+    for (int edge : {CHUNK_EDGE_S_MIN, CHUNK_EDGE_S_MAX, CHUNK_EDGE_T_MIN, CHUNK_EDGE_T_MAX})
+    {
+        int const neighbor = neighborLeaf(node, edge);
+        if (nodes[neighbor].level < node.level && !split(neighbor))
+            return false;
+    }
+
+    nodes[index].children = nodes.size();
+    for (int k = 0; k < 4; k++)
+    {
+        nodes.push_back(children[k]);
+        candidates.push({screenError(children[k]), (int)nodes.size() - 1});
+    }
+    leaf_count += 3;
+    return true;
+}
+
+void PlanetQuadtree::update(cgp::vec3 const &local_camera)
+{
+    camera = local_camera;
+    frame++;
+    requests_this_frame = 0;
+    uploads_this_frame = 0;
+
+    // Rebuild the tree from the roots, splitting the largest errors first
+    nodes.clear();
+    candidates = std::priority_queue<Candidate>();
+    for (int face = 0; face < 6; face++)
+    {
+        nodes.push_back({face, 0, 0, 0});
+        candidates.push({screenError(nodes.back()), face});
+    }
+    leaf_count = 6;
+
+    int const max_leaves = PLANET_TRIANGLE_BUDGET / (2 * PLANET_CHUNK_RESOLUTION * PLANET_CHUNK_RESOLUTION);
+    float const max_error = PLANET_CHUNK_QUAD_ERRORS * global_lod_manager.getPixelError(LOD_TERRAIN); // GUI pixel error, scaled by the frame governor
+    while (!candidates.empty())
+    {
+        Candidate const candidate = candidates.top();
+        candidates.pop();
+
+        if (candidate.error < max_error || leaf_count + 3 > max_leaves)
+            break;
+        split(candidate.node); // Not ready : the chunk stays a leaf this frame
+    }
+
+    // Leaves : stitch the edges next to coarser chunks
+    visible_chunks.clear();
+    for (auto const &node : nodes)
+    {
+        if (node.children != -1)
+            continue;
+
+        Chunk *chunk = getReadyChunk(node); // Always ready : only ready chunks are split into
+        if (chunk == nullptr)
+            continue;
+
+        int mask = 0;
+        for (int edge : {CHUNK_EDGE_S_MIN, CHUNK_EDGE_S_MAX, CHUNK_EDGE_T_MIN, CHUNK_EDGE_T_MAX})
+        {
+            if (nodes[neighborLeaf(node, edge)].level < node.level)
+                mask |= edge;
+        }
+
+        if (mask != chunk->edge_mask)
+        {
+            cgp::numarray<cgp::uint3> const &connectivity = stitchedConnectivities()[mask];
+            chunk->drawable.ebo_connectivity.update(connectivity);
+            chunk->edge_mask = mask;
+        }
+
+        visible_chunks.push_back(&chunk->drawable);
+    }
+
+    stats.chunks = visible_chunks.size();
+    stats.triangles = stats.chunks * 2 * PLANET_CHUNK_RESOLUTION * PLANET_CHUNK_RESOLUTION;
+
+    // Free the chunks unused for a while, from time to time
+    if (frame % 60 == 0)
+        evict();
+}
+
+void PlanetQuadtree::evict()
+{
+    stats.pending = 0;
+    for (auto it = chunks.begin(); it != chunks.end();)
+    {
+        Chunk &chunk = *it->second;
+        bool const is_root = ((it->first >> 3) & 0x1F) == 0;
+        bool const generating = !chunk.uploaded && chunk.job.valid() && chunk.job.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+        stats.pending += generating;
+
+        if (!is_root && !generating && frame - chunk.last_used_frame > PLANET_CHUNK_CACHE_FRAMES)
+        {
+            if (chunk.uploaded)
+                chunk.drawable.clear();
+            it = chunks.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    stats.cached = chunks.size();
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "cgp/geometry/shape/mesh/structure/mesh.hpp"
+#include "cgp/graphics/drawable/mesh_drawable/mesh_drawable.hpp"
+#include "utils/noise/perlin.hpp"
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+// ************************************************** //
+//                 QUADTREE CONSTANTS                 //
+// ************************************************** //
+constexpr int PLANET_CHUNK_RESOLUTION = 16;          // Quads per chunk side (even : stitched edges skip every other vertex)
+constexpr int PLANET_CHUNK_MAX_LEVEL = 14;           // Deepest quadtree level
+constexpr int PLANET_TRIANGLE_BUDGET = 262144;       // Max triangles drawn per planet
+constexpr float PLANET_CHUNK_QUAD_ERRORS = 6.0f;     // Chunks are split while their quads are larger on screen than this many LOD pixel errors
+constexpr int PLANET_CHUNK_REQUESTS_PER_FRAME = 32;  // Chunk generations started per frame and per planet
+constexpr int PLANET_CHUNK_UPLOADS_PER_FRAME = 16;   // Generated chunks sent to the GPU per frame and per planet
+constexpr int PLANET_CHUNK_CACHE_FRAMES = 600;       // Chunks unused for this many frames are freed
+
+// Relative error of the quadtree and of the single planet mesh : the quadtree is used above a 150 pixels radius (1 pixel error)
+constexpr float PLANET_QUADTREE_LOD_ERRORS[] = {0, 1.0f / 150};
+
+// Chunk edges, in the face (s, t) coordinates. A set bit means the neighbor is coarser : the edge is stitched
+enum PlanetChunkEdge
+{
+    CHUNK_EDGE_S_MIN = 1,
+    CHUNK_EDGE_S_MAX = 2,
+    CHUNK_EDGE_T_MIN = 4,
+    CHUNK_EDGE_T_MAX = 8,
+};
+
+// Planet surface : same displacement as mesh_primitive_perlin_sphere
+struct PlanetSurface
+{
+    float radius;
+    perlin_noise_parameters parameters;
+
+    // Distance from the center to the surface in the given directions (normalized), with the noise evaluated in batch
+    void heights(cgp::vec3 const *directions, float *output, int count) const;
+
+    // Surface points in the given directions (normalized)
+    void positions(cgp::vec3 const *directions, cgp::vec3 *output, int count) const;
+};
+
+struct PlanetQuadtreeStats
+{
+    int chunks = 0;    // Drawn chunks
+    int triangles = 0; // Drawn triangles
+    int pending = 0;   // Chunks being generated
+    int cached = 0;    // Chunks in memory
+};
+
+/**
+ * Cube sphere terrain of a planet.
+ * Each face of the cube is a quadtree of square chunks, projected on the sphere. Every frame, the chunks are refined
+ * by decreasing screen space error until the pixel error or the triangle budget is reached. The tree is kept
+ * restricted (neighbor leaves differ by one level at most), so the edges next to coarser chunks are stitched by
+ * skipping every other vertex : there are no cracks.
+ * Chunk meshes are generated on the job system and uploaded on the OpenGL thread. A chunk is only split when its
+ * 4 children are ready, so the surface is always complete.
+ */
+class PlanetQuadtree
+{
+public:
+    PlanetQuadtree(PlanetSurface surface) : surface(surface){};
+    ~PlanetQuadtree();
+
+    void initialize(); // Generate the root chunks (OpenGL thread)
+    void clear();      // Wait for the jobs and free every chunk (OpenGL thread). initialize must be called again before update
+
+    // Select the chunks for this camera position in the planet local frame (OpenGL thread)
+    void update(cgp::vec3 const &local_camera);
+
+    // Chunks selected by the last update. Their model, shader, texture and material must be set by the caller
+    std::vector<cgp::mesh_drawable *> const &getVisibleChunks() const { return visible_chunks; };
+
+    PlanetQuadtreeStats const &getStats() const { return stats; };
+
+private:
+    struct Chunk
+    {
+        std::future<void> job; // Mesh generation
+        cgp::mesh mesh;        // Written by the job, released after the upload
+        cgp::mesh_drawable drawable;
+        bool uploaded = false;
+        int edge_mask = 0;
+        int last_used_frame = 0;
+    };
+
+    // Node of the quadtree selected for this frame
+    struct Node
+    {
+        int face;
+        int level;
+        int x, y;
+        int children = -1; // Index of the first of the 4 children
+    };
+
+    // Chunk to split, by decreasing screen space error
+    struct Candidate
+    {
+        float error;
+        int node;
+        bool operator<(Candidate const &other) const { return error < other.error; };
+    };
+
+    static uint64_t chunkKey(int face, int level, int x, int y);
+    static void generateChunk(PlanetSurface surface, int face, int level, int x, int y, cgp::mesh &mesh);
+
+    Chunk *getReadyChunk(Node const &node); // Request or upload the chunk if needed. nullptr if it is not ready yet
+    float screenError(Node const &node) const;
+    bool split(int node);                 // Split a leaf, after its coarser neighbors. false if a chunk is not ready
+    int findLeaf(cgp::vec3 const &point); // Leaf containing the direction of a point (any face)
+    int neighborLeaf(Node const &node, int edge); // Leaf across an edge of a node
+    void evict();
+
+    PlanetSurface surface;
+
+    std::unordered_map<uint64_t, std::unique_ptr<Chunk>> chunks;
+    std::vector<Node> nodes;
+    std::priority_queue<Candidate> candidates;
+    std::vector<cgp::mesh_drawable *> visible_chunks;
+
+    cgp::vec3 camera;
+    int frame = 0;
+    int leaf_count = 0;
+    int requests_this_frame = 0;
+    int uploads_this_frame = 0;
+
+    PlanetQuadtreeStats stats;
+};
@@ -37,12 +37,27 @@ void RingPlanet::initialize()
 
 void RingPlanet::drawBillboards(const environment_structure &environment, cgp::vec3 &position, cgp::rotation_transform &, bool)
 {
-    if (!shouldDrawLowPoly(position))
+    if (shouldDrawRing(position))
     {
         cgp::draw(ring_mesh_drawable, environment);
     }
 }
 
+bool RingPlanet::gatherBillboards(TransparentPass &pass, cgp::vec3 const &position, cgp::rotation_transform const &)
+{
+    if (shouldDrawRing(position))
+        pass.submit(ring_mesh_drawable, ring_mesh_drawable.model.translation, ring_mesh_drawable.model.rotation.matrix());
+    return true;
+}
+
+bool RingPlanet::shouldDrawRing(cgp::vec3 const &position)
+{
+    float distance = cgp::norm(position - ring_mesh_drawable.model.translation);
+    global_lod_manager.update(LOD_RING, ring_radius, distance, RING_LOD_ERRORS, 2, ring_lod_level);
+
+    return ring_lod_level == 0;
+}
+
 void RingPlanet::setPosition(vec3 position)
 {
     Planet::setPosition(position);
@@ -2,6 +2,10 @@
 
 #include "celestial_bodies/planet/planet.hpp"
 #include "utils/display/billboard_drawable.hpp"
+#include "utils/display/lod_manager.hpp"
+
+// Relative error of the drawn ring and of no ring at all : the ring is hidden when its radius is under 4 pixels (1 pixel error)
+constexpr float RING_LOD_ERRORS[] = {0, 0.25f};
 
 // Planet with a ring image billboard (Saturn, etc)
 class RingPlanet : public Planet, public BillboardDrawable
@@ -13,14 +17,19 @@ public:
     // Draw functions
     virtual void initialize() override;
     void drawBillboards(const environment_structure &environment, cgp::vec3 &position, cgp::rotation_transform &rotation, bool show_wireframe = true) override;
+    bool gatherBillboards(TransparentPass &pass, cgp::vec3 const &position, cgp::rotation_transform const &rotation) override;
 
     virtual void setPosition(vec3 position) override;
     virtual void updateModels() override;
 
 private:
+    // Whether the ring is visible, with its own LOD state
+    bool shouldDrawRing(cgp::vec3 const &position);
+
     // Ring data
     std::string ring_texture_path;
     double ring_radius;
+    int ring_lod_level = LOD_UNSET;
 
     // CGP elements
     cgp::mesh ring_quad_mesh;
@@ -2,11 +2,18 @@
 
 #include "cgp/cgp.hpp"     // Give access to the complete CGP library
 #include "environment.hpp" // The general scene environment + project variable
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
 #include <iostream>
+#include <string>
 
 // Custom scene of this code
 #include "scene.hpp"
 
+#include "ai/ai_benchmark.hpp"
+#include "utils/threads/job_system.hpp"
+
 // *************************** //
 // Custom Scene defined in "scene.hpp"
 // *************************** //
@@ -24,10 +31,38 @@ void animation_loop();
 
 timer_fps fps_record;
 
-int main(int, char *argv[])
+constexpr int MESH_NORMALS_MIN_WORKERS = 3; // Workers needed to compute the mesh normals in parallel
+
+// Strictly positive integer command line argument. Returns false if the whole text is not one
+static bool parse_count_argument(char const *text, int &value)
+{
+    char *end = nullptr;
+    errno = 0;
+    long const parsed = std::strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno == ERANGE || parsed <= 0 || parsed > INT_MAX)
+        return false;
+
+    value = (int)parsed;
+    return true;
+}
+
+int main(int argc, char *argv[])
 {
     std::cout << "Run " << argv[0] << std::endl;
 
+    // Headless benchmark mode (no window) : --benchmark-ai <agent_count> [step_count]
+    if (argc >= 2 && std::string(argv[1]) == "--benchmark-ai")
+    {
+        int agent_count = 0;
+        int step_count = 200;
+        if (argc > 4 || argc < 3 || !parse_count_argument(argv[2], agent_count) || (argc == 4 && !parse_count_argument(argv[3], step_count)))
+        {
+            std::cerr << "Usage : " << argv[0] << " --benchmark-ai <agent_count> [step_count] (positive integers)" << std::endl;
+            return 1;
+        }
+        return runAIBenchmark(agent_count, step_count);
+    }
+
     // ************************ //
     //     INITIALISATION
     // ************************ //
@@ -41,6 +76,14 @@ int main(int, char *argv[])
     // Initialize default shaders
     initialize_default_shaders();
 
+    // The mesh normals of large meshes are gathered per vertex on the job system. The gather builds the vertex
+    // adjacency first : it only pays off with a few workers
+    if (global_job_system.getWorkerCount() >= MESH_NORMALS_MIN_WORKERS)
+    {
+        cgp::set_mesh_parallel_for([](int count, std::function<void(int, int)> const &func, int min_chunk_size)
+                                   { global_job_system.parallelFor(count, func, min_chunk_size); });
+    }
+
     // Custom scene initialization
     std::cout << "Initialize data of the scene ..." << std::endl;
     scene.initialize();
@@ -70,6 +113,7 @@ int main(int, char *argv[])
     std::cout << "\nAnimation loop stopped" << std::endl;
 
     // Cleanup
+    scene.clear();
     cgp::imgui_cleanup();
     glfwDestroyWindow(scene.window.glfw_window);
     glfwTerminate();
@@ -82,6 +126,9 @@ void animation_loop()
 
     emscripten_update_window_size(scene.window.width, scene.window.height); // update window size in case of use of emscripten (not used by default)
 
+    // Measure the CPU and GPU time of the frame, up to the buffer swap
+    global_frame_governor.beginFrame();
+
     scene.camera_projection.aspect_ratio = scene.window.aspect_ratio();
     scene.environment.camera_projection = scene.camera_projection.matrix();
     glViewport(0, 0, scene.window.width, scene.window.height);
@@ -117,6 +164,7 @@ void animation_loop()
     // End of ImGui display and handle GLFW events
     ImGui::End();
     imgui_render_frame(scene.window.glfw_window);
+    global_frame_governor.endFrame();
     glfwSwapBuffers(scene.window.glfw_window);
     glfwPollEvents();
 }
@@ -0,0 +1,141 @@
+#include "fleet.hpp"
+#include "cgp/graphics/opengl/uniform/uniform.hpp"
+#include "utils/shaders/shader_loader.hpp"
+#include "utils/threads/job_system.hpp"
+#include <algorithm>
+#include <cmath>
+
+void Fleet::initialize(BakedHierarchy const &model, int capacity)
+{
+    this->model = &model;
+    this->capacity = capacity;
+    bone_count = model.getBones().size();
+
+    ships.reserve(capacity);
+    bone_matrices.resize(capacity * bone_count);
+
+    // Texture buffer : each texel is one row of a matrix (RGBA32F)
+    glGenBuffers(1, &matrices_buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, matrices_buffer);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(cgp::mat4) * capacity * bone_count, nullptr, GL_STREAM_DRAW);
+
+    glGenTextures(1, &matrices_texture);
+    glBindTexture(GL_TEXTURE_BUFFER, matrices_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, matrices_buffer);
+
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    opengl_check;
+}
+
+cgp::vec3 Fleet::formationPosition(int index)
+{
+    // Square grid in the (x, y) plane, filled row by row
+    int side = (int)std::ceil(std::sqrt((float)FLEET_MAX_SHIPS));
+    int row = index / side;
+    int column = index % side;
+
+    return FLEET_FORMATION_CENTER + FLEET_SPACING * cgp::vec3{(float)column - side / 2, (float)row - side / 2, 0};
+}
+
+void Fleet::setShipCount(int count)
+{
+    count = std::max(0, std::min(count, capacity));
+
+    while ((int)ships.size() < count)
+    {
+        FleetShip ship;
+        ship.position = formationPosition(ships.size());
+        ships.push_back(ship);
+    }
+    ships.resize(count);
+}
+
+void Fleet::update()
+{
+    if (model == nullptr)
+        return;
+
+    std::vector<BakedBone> const &bones = model->getBones();
+
+    global_job_system.parallelFor(ships.size(), [&](int begin, int end)
+                                  {
+        std::vector<cgp::affine_rts> globals(bone_count);
+
+        for (int i = begin; i < end; i++)
+        {
+            FleetShip const &ship = ships[i];
+            cgp::affine_rts const ship_transform(ship.orientation, ship.position, ship.scale);
+
+            // Same propagation as BakedHierarchy::update, the ship transform replacing the roots
+            for (int b = 0; b < bone_count; b++)
+            {
+                BakedBone const &bone = bones[b];
+                if (bone.parent == -1)
+                    globals[b] = ship_transform;
+                else
+                    globals[b] = globals[bone.parent] * bone.offset * bone.transform_local;
+
+                bone_matrices[i * bone_count + b] = globals[b].matrix();
+            }
+        } }, 64);
+}
+
+void Fleet::draw(environment_structure const &environment)
+{
+    if (model == nullptr || ships.empty())
+        return;
+
+    int const ship_count = ships.size();
+
+    // Orphan the previous storage, then upload this frame matrices
+    glBindBuffer(GL_TEXTURE_BUFFER, matrices_buffer);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(cgp::mat4) * capacity * bone_count, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, sizeof(cgp::mat4) * ship_count * bone_count, bone_matrices.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    cgp::opengl_shader_structure const &shader = ShaderLoader::getShader("fleet");
+    glUseProgram(shader.id);
+    opengl_check;
+
+    environment.send_opengl_uniform(shader, false);
+    cgp::opengl_uniform(shader, "bone_count", bone_count);
+
+    // Unit 0 : mesh texture, unit 1 : matrices
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_BUFFER, matrices_texture);
+    cgp::opengl_uniform(shader, "fleet_matrices", 1);
+    glActiveTexture(GL_TEXTURE0);
+    cgp::opengl_uniform(shader, "image_texture", 0);
+
+    for (auto const &batch : model->getBatches())
+    {
+        cgp::mesh_drawable const &drawable = batch.drawable;
+
+        drawable.texture.bind();
+        drawable.material.send_opengl_uniform(shader, false);
+        cgp::opengl_uniform(shader, "bone_index", batch.bone);
+
+        glBindVertexArray(drawable.vao);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, drawable.ebo_connectivity.id);
+        glDrawElementsInstanced(GL_TRIANGLES, GLsizei(drawable.ebo_connectivity.size * 3), drawable.ebo_connectivity.details.type_element, nullptr, ship_count);
+        opengl_check;
+    }
+
+    // Clean state
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+}
+
+void Fleet::clear()
+{
+    glDeleteTextures(1, &matrices_texture);
+    glDeleteBuffers(1, &matrices_buffer);
+    matrices_texture = 0;
+    matrices_buffer = 0;
+    ships.clear();
+}
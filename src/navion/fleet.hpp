@@ -0,0 +1,73 @@
+#pragma once
+
+#include "cgp/geometry/transform/rotation_transform/rotation_transform.hpp"
+#include "environment.hpp"
+#include "utils/display/baked_hierarchy.hpp"
+#include <vector>
+
+// ************************************************** //
+//                   FLEET CONSTANTS                  //
+// ************************************************** //
+constexpr int FLEET_MAX_SHIPS = 2000;
+constexpr float FLEET_SPACING = 3.0f; // Distance between two ships of the default formation (display units)
+
+// Default formation center, next to the player start position (display coordinates)
+const cgp::vec3 FLEET_FORMATION_CENTER = {-300, 30, 60};
+
+constexpr float FLEET_ESCORT_DISTANCE = 20.0f; // AI formation center, behind the player
+constexpr float FLEET_OBSTACLE_RANGE = 300.0f; // Asteroids farther than this from the player are ignored by the AI
+constexpr float FLEET_EXHAUST_DISTANCE = 150.0f; // Ships farther than this from the player emit no exhaust
+constexpr float FLEET_EXHAUST_PARTICLES = 16384; // Live exhaust particles of the whole fleet : the rest of the pool is left to the player and the impacts
+
+// Root transform of one ship of the fleet
+struct FleetShip
+{
+    cgp::vec3 position;
+    cgp::rotation_transform orientation;
+    float scale = 1;
+};
+
+/**
+ * Instanced renderer for many copies of the same ship.
+ * All the bone world matrices of the fleet are computed in one parallel pass and uploaded to a texture buffer.
+ * Each merged mesh of the baked ship hierarchy is then drawn once for the whole fleet with glDrawElementsInstanced,
+ * the vertex shader fetching its matrix from the ship (instance) index.
+ */
+class Fleet
+{
+public:
+    // The model hierarchy must outlive the fleet (its meshes are used for drawing)
+    void initialize(BakedHierarchy const &model, int capacity = FLEET_MAX_SHIPS);
+
+    // Resize the fleet. New ships are placed on the default formation grid
+    void setShipCount(int count);
+    int getShipCount() const { return (int)ships.size(); };
+
+    std::vector<FleetShip> &getShips() { return ships; };
+
+    // Compute the bone matrices of every ship (parallel)
+    void update();
+
+    // Upload the matrices and draw the fleet (one draw call per merged mesh)
+    void draw(environment_structure const &environment);
+
+    // Free the GPU buffers (OpenGL thread)
+    void clear();
+
+    int getDrawCallCount() const { return ships.empty() ? 0 : (int)model->getBatches().size(); };
+
+    // Position of the i-th ship of the default grid formation
+    static cgp::vec3 formationPosition(int index);
+
+private:
+    BakedHierarchy const *model = nullptr;
+    int capacity = 0;
+    int bone_count = 0;
+
+    std::vector<FleetShip> ships;
+    std::vector<cgp::mat4> bone_matrices; // Ship major : matrix of bone b of ship i at i * bone_count + b
+
+    // Texture buffer holding the matrices
+    GLuint matrices_buffer = 0;
+    GLuint matrices_texture = 0;
+};
@@ -4,6 +4,7 @@
 #include "cgp/graphics/drawable/hierarchy_mesh_drawable/hierarchy_mesh_drawable.hpp"
 #include "cgp/graphics/drawable/triangles_drawable/triangles_drawable.hpp"
 #include "environment.hpp"
+#include "utils/particles/particle_system.hpp"
 #include <cmath>
 
 void Navion::initialize()
@@ -75,20 +76,12 @@ void Navion::initialize()
     milieu3_cocpit.material.color = gris;
     milieu4_cocpit.material.color = gris;
 
-    corps.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture vaisseau.jpg",
-                                                        GL_REPEAT,
-                                                        GL_REPEAT);
+    corps.texture = load_texture("assets/navion/texture vaisseau.jpg");
 
-    cocpit.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture vaisseau.jpg",
-                                                         GL_REPEAT,
-                                                         GL_REPEAT);
+    cocpit.texture = load_texture("assets/navion/texture vaisseau.jpg");
 
-    aile_d.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture vaisseau.jpg",
-                                                         GL_REPEAT,
-                                                         GL_REPEAT);
-    aile_g.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture vaisseau.jpg",
-                                                         GL_REPEAT,
-                                                         GL_REPEAT);
+    aile_d.texture = load_texture("assets/navion/texture vaisseau.jpg");
+    aile_g.texture = load_texture("assets/navion/texture vaisseau.jpg");
 
     // Add the elements in the hierarchy
     //   The syntax is hierarchy.add(mesh_drawable, "name of the parent element", [optional: local translation in the hierarchy])
@@ -123,7 +116,13 @@ void Navion::initialize()
     hierarchie.add(lance_missile, "LM_DB", "reacteurDB", {0.1, 0, 0});
     hierarchie.add(lance_missile, "LM_GB", "reacteurGB", {0.1, 0, 0});
 
-    // return hierarchie;
+    bake_hierarchy();
+
+    // Exhaust behind the four engines, they follow the wings
+    add_engine_emitter("reacteurDH", {-0.2f, 0, 0});
+    add_engine_emitter("reacteurGH", {-0.2f, 0, 0});
+    add_engine_emitter("reacteurDB", {-0.2f, 0, 0});
+    add_engine_emitter("reacteurGB", {-0.2f, 0, 0});
 }
 
 void Navion::draw(environment_structure const &environment)
@@ -134,36 +133,84 @@ void Navion::draw(environment_structure const &environment)
     if (has_wings)
     {
         float langle = Pi / 180 * angle_aile_min + Pi / 180 * nangle_aile * (angle_aile_max - angle_aile_min) / 100;
-        hierarchie["AileDH"].transform_local.rotation = rotation_transform::from_axis_angle({1, 0, 0}, langle);
-        hierarchie["AileGH"].transform_local.rotation = rotation_transform::from_axis_angle({1, 0, 0}, -langle);
-        hierarchie["AileDB"].transform_local.rotation = rotation_transform::from_axis_angle({1, 0, 0}, -langle);
-        hierarchie["AileGB"].transform_local.rotation = rotation_transform::from_axis_angle({1, 0, 0}, langle);
+        baked[handle_ailes[0]].rotation = rotation_transform::from_axis_angle({1, 0, 0}, langle);
+        baked[handle_ailes[1]].rotation = rotation_transform::from_axis_angle({1, 0, 0}, -langle);
+        baked[handle_ailes[2]].rotation = rotation_transform::from_axis_angle({1, 0, 0}, -langle);
+        baked[handle_ailes[3]].rotation = rotation_transform::from_axis_angle({1, 0, 0}, langle);
     }
 
     // This function must be called before the drawing in order to propagate the deformations through the hierarchy
-    hierarchie.update_local_to_global_coordinates();
-
-    // Draw the hierarchy as a single mesh
-    cgp::draw(hierarchie, environment);
+    baked.update();
 
-    // On ajoute ensuite le feu des r�acteurs par l'appel � la classe
-    // � noter : si le vaisseau n'a pas de r�acteur, la liste est vide et rien n'est affich�
-    feu_sa_mere.display_reacteur(position_reacteur, direction_reacteur, environment);
+    // Draw the merged meshes (one draw call per bone and material)
+    baked.draw(environment);
 }
 
 void Navion::set_position(vec3 const &position)
 {
-    hierarchie["Centre"].transform_local.translation = position;
+    baked[handle_centre].translation = position;
 }
 
 void Navion::set_orientation(rotation_transform const &orientation)
 {
-    hierarchie["Centre"].transform_local.rotation = orientation;
+    baked[handle_centre].rotation = orientation;
 }
 
 void Navion::update_hierachy()
 {
-    hierarchie.update_local_to_global_coordinates();
+    baked.update();
+}
+
+void Navion::bake_hierarchy()
+{
+    // Only the root and the wings move : everything else is merged
+    std::vector<std::string> animated_nodes;
+    if (has_wings)
+        animated_nodes = {"AileDH", "AileGH", "AileDB", "AileGB"};
+
+    baked.bake(hierarchie, animated_nodes);
+    engine_emitters.clear(); // Socket indexes of the previous bake are no longer valid
+
+    // Every node is copied in the merged meshes : free the source buffers (the textures are shared, they are kept).
+    // Nodes added from the same drawable share their buffers : deleting them again is ignored by OpenGL
+    for (auto &node : hierarchie.elements)
+        node.drawable.clear();
+
+    handle_centre = baked.getHandle(hierarchie.elements[0].name);
+    if (has_wings)
+    {
+        for (int i = 0; i < 4; i++)
+            handle_ailes[i] = baked.getHandle(animated_nodes[i]);
+    }
+}
+
+void Navion::add_engine_emitter(std::string const &node, vec3 const &offset, vec3 const &direction)
+{
+    engine_emitters.push_back({baked.getSocket(node), offset, cgp::normalize(direction)});
+}
+
+void Navion::emit_exhaust(float dt, vec3 const &ship_velocity, cgp::affine_rts const &parent, float rate_scale) const
+{
+    for (auto const &emitter : engine_emitters)
+    {
+        cgp::affine_rts const frame = parent * baked.socketTransform(emitter.socket);
+        vec3 const position = (frame.matrix() * cgp::vec4(emitter.offset, 1.0f)).xyz();
+        vec3 const direction = frame.rotation * emitter.direction;
+
+        global_particle_system.emit(PARTICLE_ENGINE, position, ship_velocity + ENGINE_PARTICLE_SPEED * direction, ENGINE_PARTICLE_SPREAD, ENGINE_PARTICLE_RATE * rate_scale * dt);
+    }
+}
+
+cgp::opengl_texture_image_structure const &Navion::load_texture(std::string const &path)
+{
+    // Load each image once : the meshes sharing a texture can then be merged by the bake
+    auto it = textures.find(path);
+    if (it == textures.end())
+    {
+        it = textures.insert({path, cgp::opengl_texture_image_structure()}).first;
+        it->second.load_and_initialize_texture_2d_on_gpu(project::path + path, GL_REPEAT, GL_REPEAT);
+    }
+    return it->second;
 }
 
 void Navion::set_angle_aile(float const angle)
@@ -380,19 +427,11 @@ void Navion::create_millennium_falcon(float const &scale)
 
     // Set the color of some elements
 
-    centre.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture vaisseau.jpg",
-                                                         GL_REPEAT,
-                                                         GL_REPEAT);
-    corps.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/Star_Wars_Millenium_Falcon_FSX_P3D_1.jpg",
-                                                        GL_REPEAT,
-                                                        GL_REPEAT);
+    centre.texture = load_texture("assets/navion/texture vaisseau.jpg");
+    corps.texture = load_texture("assets/navion/Star_Wars_Millenium_Falcon_FSX_P3D_1.jpg");
 
-    aile_droite.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/Star_Wars_Millenium_Falcon_FSX_P3D_1.jpg",
-                                                              GL_REPEAT,
-                                                              GL_REPEAT);
-    aile_gauche.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/Star_Wars_Millenium_Falcon_FSX_P3D_1.jpg",
-                                                              GL_REPEAT,
-                                                              GL_REPEAT);
+    aile_droite.texture = load_texture("assets/navion/Star_Wars_Millenium_Falcon_FSX_P3D_1.jpg");
+    aile_gauche.texture = load_texture("assets/navion/Star_Wars_Millenium_Falcon_FSX_P3D_1.jpg");
 
     centre.material.phong.specular = 0.0;
     corps.material.phong.specular = 0.0;
@@ -419,39 +458,17 @@ void Navion::create_millennium_falcon(float const &scale)
     // **************************************
     //        re le cocpit
     // *************************************
-    corps_cocpit.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture vaisseau.jpg",
-                                                               GL_REPEAT,
-                                                               GL_REPEAT);
-    cocpit.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture vaisseau.jpg",
-                                                         GL_REPEAT,
-                                                         GL_REPEAT);
-    bord1_cocpit.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture vaisseau.jpg",
-                                                               GL_REPEAT,
-                                                               GL_REPEAT);
-    bord2_cocpit.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture vaisseau.jpg",
-                                                               GL_REPEAT,
-                                                               GL_REPEAT);
-    bord3_cocpit.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture vaisseau.jpg",
-                                                               GL_REPEAT,
-                                                               GL_REPEAT);
-    bord4_cocpit.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture vaisseau.jpg",
-                                                               GL_REPEAT,
-                                                               GL_REPEAT);
-    bord5_cocpit.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture vaisseau.jpg",
-                                                               GL_REPEAT,
-                                                               GL_REPEAT);
-    milieu1_cocpit.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture vaisseau.jpg",
-                                                                 GL_REPEAT,
-                                                                 GL_REPEAT);
-    milieu2_cocpit.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture vaisseau.jpg",
-                                                                 GL_REPEAT,
-                                                                 GL_REPEAT);
-    milieu3_cocpit.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture vaisseau.jpg",
-                                                                 GL_REPEAT,
-                                                                 GL_REPEAT);
-    milieu4_cocpit.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture vaisseau.jpg",
-                                                                 GL_REPEAT,
-                                                                 GL_REPEAT);
+    corps_cocpit.texture = load_texture("assets/navion/texture vaisseau.jpg");
+    cocpit.texture = load_texture("assets/navion/texture vaisseau.jpg");
+    bord1_cocpit.texture = load_texture("assets/navion/texture vaisseau.jpg");
+    bord2_cocpit.texture = load_texture("assets/navion/texture vaisseau.jpg");
+    bord3_cocpit.texture = load_texture("assets/navion/texture vaisseau.jpg");
+    bord4_cocpit.texture = load_texture("assets/navion/texture vaisseau.jpg");
+    bord5_cocpit.texture = load_texture("assets/navion/texture vaisseau.jpg");
+    milieu1_cocpit.texture = load_texture("assets/navion/texture vaisseau.jpg");
+    milieu2_cocpit.texture = load_texture("assets/navion/texture vaisseau.jpg");
+    milieu3_cocpit.texture = load_texture("assets/navion/texture vaisseau.jpg");
+    milieu4_cocpit.texture = load_texture("assets/navion/texture vaisseau.jpg");
     vitre_cocpit.material.color = {0, 0, 0};
 
     hierarchie.add(corps_cocpit, "Corps_cocpit", "Centre", {scale * 1.7, -1.4 * scale, 0});
@@ -466,6 +483,13 @@ void Navion::create_millennium_falcon(float const &scale)
     hierarchie.add(milieu2_cocpit, "Milieu2", "Cocpit");
     hierarchie.add(milieu3_cocpit, "Milieu3", "Cocpit");
     hierarchie.add(milieu4_cocpit, "Milieu4", "Cocpit");
+
+    bake_hierarchy();
+
+    // Exhaust along the rear edge of the hull
+    add_engine_emitter("Centre", scale * vec3(-2, -0.6f, 0));
+    add_engine_emitter("Centre", scale * vec3(-2, 0, 0));
+    add_engine_emitter("Centre", scale * vec3(-2, 0.6f, 0));
 }
 
 //***************************************************************************
@@ -527,33 +551,15 @@ void Navion::create_vaisseau_vador(float const &scale)
     aile_HD.material.color = {0.3, 0.3, 0.3};
     aile_HG.material.color = {0.3, 0.3, 0.3};
 
-    corps.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture vaisseau.jpg",
-                                                        GL_REPEAT,
-                                                        GL_REPEAT);
-    barre_transversale.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture vaisseau.jpg",
-                                                                     GL_REPEAT,
-                                                                     GL_REPEAT);
-    aile_droite.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture vaisseau.jpg",
-                                                              GL_REPEAT,
-                                                              GL_REPEAT);
-    aile_gauche.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture vaisseau.jpg",
-                                                              GL_REPEAT,
-                                                              GL_REPEAT);
-    aile_HD.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture vaisseau.jpg",
-                                                          GL_REPEAT,
-                                                          GL_REPEAT);
-    aile_HG.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture vaisseau.jpg",
-                                                          GL_REPEAT,
-                                                          GL_REPEAT);
-    aile_BD.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture vaisseau.jpg",
-                                                          GL_REPEAT,
-                                                          GL_REPEAT);
-    aile_BG.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture vaisseau.jpg",
-                                                          GL_REPEAT,
-                                                          GL_REPEAT);
-    arriere.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture vaisseau.jpg",
-                                                          GL_REPEAT,
-                                                          GL_REPEAT);
+    corps.texture = load_texture("assets/navion/texture vaisseau.jpg");
+    barre_transversale.texture = load_texture("assets/navion/texture vaisseau.jpg");
+    aile_droite.texture = load_texture("assets/navion/texture vaisseau.jpg");
+    aile_gauche.texture = load_texture("assets/navion/texture vaisseau.jpg");
+    aile_HD.texture = load_texture("assets/navion/texture vaisseau.jpg");
+    aile_HG.texture = load_texture("assets/navion/texture vaisseau.jpg");
+    aile_BD.texture = load_texture("assets/navion/texture vaisseau.jpg");
+    aile_BG.texture = load_texture("assets/navion/texture vaisseau.jpg");
+    arriere.texture = load_texture("assets/navion/texture vaisseau.jpg");
     avant.material.color = {0.1, 0.1, 0.1};
 
     // add elements to hierarchie
@@ -585,15 +591,9 @@ void Navion::create_vaisseau_vador(float const &scale)
                                                                       {0.02 * scale, radius * cos(Pi / 8) + 0.02 * scale, -sin(Pi / 8) * radius - 0.02 * scale},
                                                                       {0.02 * scale + 0.8 * radius, 0.6 * radius * cos(Pi / 8), -0.6 * radius * sin(Pi / 8)}));
 
-    contours_cocpit.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture vaisseau.jpg",
-                                                                  GL_REPEAT,
-                                                                  GL_REPEAT);
-    hublot.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture vaisseau.jpg",
-                                                         GL_REPEAT,
-                                                         GL_REPEAT);
-    transversal_cocpit.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture vaisseau.jpg",
-                                                                     GL_REPEAT,
-                                                                     GL_REPEAT);
+    contours_cocpit.texture = load_texture("assets/navion/texture vaisseau.jpg");
+    hublot.texture = load_texture("assets/navion/texture vaisseau.jpg");
+    transversal_cocpit.texture = load_texture("assets/navion/texture vaisseau.jpg");
 
     hierarchie.add(contours_cocpit, "Contour1", "Avant");
     hierarchie.add(contours_cocpit, "Contour2", "Avant");
@@ -642,6 +642,11 @@ void Navion::create_vaisseau_vador(float const &scale)
     hierarchie["Trans7"].transform_local.rotation = rotation_transform::from_axis_angle({1, 0, 0}, 6 * Pi / 4);
     hierarchie.add(transversal_cocpit, "Trans8", "Avant");
     hierarchie["Trans8"].transform_local.rotation = rotation_transform::from_axis_angle({1, 0, 0}, 7 * Pi / 4);
+
+    bake_hierarchy();
+
+    add_engine_emitter("Arriere", scale * vec3(-0.5f, -0.2f, 0));
+    add_engine_emitter("Arriere", scale * vec3(-0.5f, 0.2f, 0));
 }
 
 mesh Navion::transversale_vador(float const &scale)
@@ -723,29 +728,17 @@ void Navion::create_star_destroyer(float const &scale)
     command.initialize_data_on_gpu(poste_de_commande_destroyer(scale));
     reacteur.initialize_data_on_gpu(mesh_primitive_cylinder(0.4, {0, 0, 0}, {-0.65, 0, 0}));
 
-    corps.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture_vaisseau_mieux.jpg",
-                                                        GL_REPEAT,
-                                                        GL_REPEAT);
+    corps.texture = load_texture("assets/navion/texture_vaisseau_mieux.jpg");
 
-    batiment1.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture_vaisseau_mieux.jpg",
-                                                            GL_REPEAT,
-                                                            GL_REPEAT);
+    batiment1.texture = load_texture("assets/navion/texture_vaisseau_mieux.jpg");
 
-    batiment2.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture_vaisseau_mieux.jpg",
-                                                            GL_REPEAT,
-                                                            GL_REPEAT);
+    batiment2.texture = load_texture("assets/navion/texture_vaisseau_mieux.jpg");
 
-    tour.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture_vaisseau_mieux.jpg",
-                                                       GL_REPEAT,
-                                                       GL_REPEAT);
+    tour.texture = load_texture("assets/navion/texture_vaisseau_mieux.jpg");
 
-    command.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture_vaisseau_mieux.jpg",
-                                                          GL_REPEAT,
-                                                          GL_REPEAT);
+    command.texture = load_texture("assets/navion/texture_vaisseau_mieux.jpg");
 
-    reacteur.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/navion/texture_vaisseau_mieux.jpg",
-                                                           GL_REPEAT,
-                                                           GL_REPEAT);
+    reacteur.texture = load_texture("assets/navion/texture_vaisseau_mieux.jpg");
 
     hierarchie.add(corps, "Corps");
     hierarchie.add(batiment1, "Bat1", "Corps", scale * vec3(-0.75, 0, 0));
@@ -756,41 +749,6 @@ void Navion::create_star_destroyer(float const &scale)
     hierarchie.add(reacteur, "Reacteur2", "Corps", scale * vec3(-3, -2, 0));
     hierarchie.add(reacteur, "Reacteur3", "Corps", scale * vec3(-3, 2, 0));
 
-    // Pour les flammes des reacteurs, on utilise la classe reacteur : il suffit d'ajouter les positions et directions � la liste
-    feu_sa_mere.initialize();
-
-    rotation_transform angle1 = rotation_transform::from_axis_angle({0, 1, 0}, -Pi / 2);
-    position_reacteur.push_back(scale * vec3(-3, 0, 0));
-    direction_reacteur.push_back(angle1);
-    position_reacteur.push_back(scale * vec3(-3, -2, 0));
-    direction_reacteur.push_back(angle1);
-    position_reacteur.push_back(scale * vec3(-3, 2, 0));
-    direction_reacteur.push_back(angle1);
-
-    rotation_transform angle2 = rotation_transform::from_axis_angle({1, 0, 0}, -Pi / 2) * rotation_transform::from_axis_angle({0, 1, 0}, -Pi / 2);
-    position_reacteur.push_back(scale * vec3(-3, 0, 0));
-    direction_reacteur.push_back(angle2);
-    position_reacteur.push_back(scale * vec3(-3, -2, 0));
-    direction_reacteur.push_back(angle2);
-    position_reacteur.push_back(scale * vec3(-3, 2, 0));
-    direction_reacteur.push_back(angle2);
-
-    rotation_transform angle3 = rotation_transform::from_axis_angle({1, 0, 0}, Pi / 4) * rotation_transform::from_axis_angle({0, 1, 0}, -Pi / 2);
-    position_reacteur.push_back(scale * vec3(-3, 0, 0));
-    direction_reacteur.push_back(angle3);
-    position_reacteur.push_back(scale * vec3(-3, -2, 0));
-    direction_reacteur.push_back(angle3);
-    position_reacteur.push_back(scale * vec3(-3, 2, 0));
-    direction_reacteur.push_back(angle3);
-
-    rotation_transform angle4 = rotation_transform::from_axis_angle({1, 0, 0}, -Pi / 4) * rotation_transform::from_axis_angle({0, 1, 0}, -Pi / 2);
-    position_reacteur.push_back(scale * vec3(-3, 0, 0));
-    direction_reacteur.push_back(angle4);
-    position_reacteur.push_back(scale * vec3(-3, -2, 0));
-    direction_reacteur.push_back(angle4);
-    position_reacteur.push_back(scale * vec3(-3, 2, 0));
-    direction_reacteur.push_back(angle4);
-
     // On ajoute ensuite trois disques pour que les r�acteurs ressemblent � qqch :
     mesh_drawable disque_feu;
     disque_feu.initialize_data_on_gpu(mesh_primitive_disc(0.4, {-0.01, 0, 0}, {1, 0, 0}));
@@ -804,6 +762,13 @@ void Navion::create_star_destroyer(float const &scale)
     hierarchie.add(disque_feu, "Disque1", "Reacteur1");
     hierarchie.add(disque_feu, "Disque2", "Reacteur2");
     hierarchie.add(disque_feu, "Disque3", "Reacteur3");
+
+    bake_hierarchy();
+
+    // Particle flames behind the three engines
+    add_engine_emitter("Reacteur1", scale * vec3(-0.65f, 0, 0));
+    add_engine_emitter("Reacteur2", scale * vec3(-0.65f, 0, 0));
+    add_engine_emitter("Reacteur3", scale * vec3(-0.65f, 0, 0));
 }
 
 mesh Navion::corps_destroyer(float const &scale)
@@ -3,7 +3,9 @@
 #include "cgp/cgp.hpp"
 #include "cgp/geometry/transform/rotation_transform/rotation_transform.hpp"
 #include "environment.hpp"
-#include "reacteur.hpp"
+#include "utils/display/baked_hierarchy.hpp"
+#include <map>
+#include <string>
 #include <vector>
 
 using cgp::mesh;
@@ -11,6 +13,18 @@ using cgp::mesh_drawable;
 using cgp::numarray;
 using cgp::vec3;
 
+constexpr float ENGINE_PARTICLE_RATE = 120.0f; // Particles per second and per emitter
+constexpr float ENGINE_PARTICLE_SPEED = 3.0f;  // Exhaust speed relatively to the ship (display units per second)
+constexpr float ENGINE_PARTICLE_SPREAD = 0.3f;
+
+// Engine exhaust source, attached to a node of the ship hierarchy
+struct EngineEmitter
+{
+    int socket;     // Node in the baked hierarchy
+    vec3 offset;    // Emission point in the node frame
+    vec3 direction; // Exhaust direction in the node frame
+};
+
 class Navion
 {
 public:
@@ -24,11 +38,31 @@ public:
     void create_vaisseau_vador(float const &scale = 1);
     void create_star_destroyer(float const &scale = 1);
 
+    // Spawn this frame engine particles. parent places the ship when it is drawn by another renderer (fleet),
+    // rate_scale thins the exhaust
+    void emit_exhaust(float dt, vec3 const &ship_velocity, cgp::affine_rts const &parent = cgp::affine_rts(), float rate_scale = 1.0f) const;
+    int getEngineEmitterCount() const { return (int)engine_emitters.size(); };
+
+    // Merged meshes of the ship (used by the fleet renderer)
+    BakedHierarchy const &getBakedHierarchy() const { return baked; };
+
 protected:
-    cgp::hierarchy_mesh_drawable hierarchie;
+    cgp::hierarchy_mesh_drawable hierarchie; // Source hierarchy, only used to build the baked one. Its buffers are freed by the bake
+    BakedHierarchy baked;                    // What is actually drawn
+
+    // Bone handles in the baked hierarchy
+    int handle_centre = 0;
+    int handle_ailes[4] = {0, 0, 0, 0}; // AileDH, AileGH, AileDB, AileGB
+
+    void bake_hierarchy(); // To call once the hierarchy is complete. Only once : the source meshes are freed
 
 private:
     float nangle_aile;
+
+    // Textures shared by all the meshes of the ship
+    std::map<std::string, cgp::opengl_texture_image_structure> textures;
+    cgp::opengl_texture_image_structure const &load_texture(std::string const &path);
+
     mesh create_cocpit_coque(float const &radius, float const &length);
     mesh pseudo_cone(float const &radius, float const &length, int const &n);
 
@@ -46,11 +80,9 @@ private:
     float angle_aile_min = 0;
     float angle_aile_max = 90;
 
-    // Pour ajouter des flammes, on d�finit ces variables globales de la classe.
-    // Elles donnent les positions et orientations des flammes des reacteurs, par d�faut il n'y en a pas
-    Reacteur feu_sa_mere;
-    std::vector<vec3> position_reacteur;
-    std::vector<rotation_transform> direction_reacteur;
+    // Engine exhaust, emitted into the global particle system
+    std::vector<EngineEmitter> engine_emitters;
+    void add_engine_emitter(std::string const &node, vec3 const &offset, vec3 const &direction = {-1, 0, 0}); // After bake_hierarchy
 };
 
 // void initialize_navion();
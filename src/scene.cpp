@@ -3,9 +3,12 @@
 #include "cgp/geometry/shape/mesh/primitive/mesh_primitive.hpp"
 #include "simulation_handler/simulation_handler.hpp"
 #include "third_party/src/imgui/imgui.h"
+#include "tree.hpp"
 #include "utils/controls/gui_params.hpp"
 #include "utils/controls/player_object.hpp"
 #include "utils/physics/object.hpp"
+#include "utils/random/poisson_disk.hpp"
+#include "utils/random/random.hpp"
 #include "utils/shaders/shader_loader.hpp"
 #include <GLFW/glfw3.h>
 #include <cmath>
@@ -33,6 +36,8 @@ void scene_structure::initialize()
     ShaderLoader::addShader("lava", "lava/lava");
     ShaderLoader::addShader("instanced", "instanced/instanced");
     ShaderLoader::addShader("shield", "shield/shield");
+    ShaderLoader::addShader("fleet", "fleet/fleet");
+    ShaderLoader::addShader("particle", "particle/particle");
 
     ShaderLoader::initialise();
 
@@ -45,6 +50,26 @@ void scene_structure::initialize()
     keyboard_control_handler.setCameraClipObjects(simulation_handler.getPhysicalObjects());
 
     keyboard_control_handler.initialize_sub_meshes();
+
+    // Initialize the fleet
+    fleet_model.create_vaisseau_vador(0.2);
+    fleet.initialize(fleet_model.getBakedHierarchy());
+
+    projectiles.initialize();
+    global_particle_system.initialize();
+    global_frame_governor.initialize();
+}
+
+void scene_structure::clear()
+{
+    fleet.clear();
+    global_particle_system.clear();
+    simulation_handler.clear();
+    if (landing_zone != nullptr)
+        landing_zone->clear();
+    if (landing_vegetation != nullptr)
+        landing_vegetation->clear();
+    global_frame_governor.clear();
 }
 
 void scene_structure::display_frame()
@@ -69,6 +94,12 @@ void scene_structure::display_frame()
     // Send timer time as uniform to the shader
     environment.uniform_generic.uniform_float["time"] = timer.t;
 
+    // LOD selection for this frame's view, and the quality chosen by the frame time governor
+    global_lod_manager.beginFrame(camera_projection.field_of_view, (float)window.height, gui.lod_pixel_error, gui.lod_hysteresis);
+    global_lod_manager.setErrorScale(LOD_ASTEROID, global_frame_governor.getAsteroidErrorScale());
+    global_lod_manager.setErrorScale(LOD_TERRAIN, global_frame_governor.getTerrainErrorScale());
+    simulation_handler.setAsteroidRenderLimits(global_frame_governor.getImpostorCutoff(), global_frame_governor.getMaxAsteroidInstances());
+
     /*********************************************/
     /*          INPUTS & PLAYER HANDLING         */
     /*********************************************/
@@ -95,15 +126,36 @@ void scene_structure::display_frame()
     cgp::vec3 position = custom_camera.camera_model.position();
     cgp::rotation_transform rotation = custom_camera.camera_model.orientation();
 
+    // Sort the translucent billboards on a worker while the opaque objects are drawn
+    simulation_handler.gatherBillboards(position, rotation);
+
     // This function also restarts the computation threads. Do things on shared data before this, as the computing threads are likely to be stopped at this time
     simulation_handler.drawObjects(environment, position, rotation, false);
 
+    if (gui.display_landing_zone)
+        draw_landing_zone(position);
+
     if (global_gui_params.display_ship_atomic)
+    {
         keyboard_control_handler.getPlayerShip().draw(environment);
 
+        PlayerObject const &player = keyboard_control_handler.getPlayer();
+        cgp::vec3 const ship_velocity = Object::scaleDownDistanceForDisplay(player.get_velocity()) * (float)Timer::timer_multiplier;
+        keyboard_control_handler.getPlayerShip().emit_exhaust(dt, ship_velocity);
+    }
+
     if (global_gui_params.trigger_laser)
         keyboard_control_handler.draw_laser(environment);
 
+    update_fleet(dt);
+    fleet.draw(environment);
+
+    update_projectiles(dt);
+    projectiles.draw(environment);
+
+    // Particles are drawn with the semi transparent elements
+    global_particle_system.update(dt);
+
     display_semiTransparent();
 }
 
@@ -113,6 +165,166 @@ void scene_structure::display_gui()
     ImGui::Checkbox("Enable shield (Z)", &global_gui_params.enable_shield);
     ImGui::Checkbox("Trigger laser (E)", &global_gui_params.trigger_laser);
     ImGui::SliderFloat("Camera distance", &global_gui_params.camera_distance, 1, 20);
+
+    RenderQueueStats const &queue_stats = simulation_handler.getRenderQueueStats();
+    ImGui::Text("Draw packets: %d (program %d, texture %d, vao %d binds, %d avoided)", queue_stats.packets, queue_stats.program_binds, queue_stats.texture_binds, queue_stats.vao_binds, queue_stats.avoided_binds);
+    ImGui::Text("Instanced batches: %d", queue_stats.instance_batches);
+
+    FrameGovernorSettings &governor = global_frame_governor.settings;
+    ImGui::Checkbox("Frame time governor", &governor.enabled);
+    ImGui::SliderFloat("Target frame time (ms)", &governor.target_ms, 4.0f, 50.0f);
+    ImGui::SliderFloat("Governor smoothing", &governor.smoothing, 0.01f, 1.0f);
+    ImGui::SliderFloat("Min quality", &governor.min_quality, 0.0f, 1.0f);
+    ImGui::Text("CPU %.2f ms, GPU %.2f ms, smoothed %.2f ms", global_frame_governor.getCpuMs(), global_frame_governor.getGpuMs(), global_frame_governor.getSmoothedMs());
+    ImGui::Text("Quality %.2f : asteroid error x%.1f, impostor cutoff %.1f px, %d asteroids per belt", global_frame_governor.getQuality(), global_frame_governor.getAsteroidErrorScale(), global_frame_governor.getImpostorCutoff(), global_frame_governor.getMaxAsteroidInstances());
+
+    LodStats const &lod_stats = global_lod_manager.getStats();
+    ImGui::SliderFloat("LOD pixel error", &gui.lod_pixel_error, 0.25f, 8.0f);
+    ImGui::SliderFloat("LOD hysteresis", &gui.lod_hysteresis, 0.0f, 0.5f);
+    ImGui::Text("LOD switches: %d (planets %d, rings %d, asteroids %d)", lod_stats.total, lod_stats.switches[LOD_PLANET], lod_stats.switches[LOD_RING], lod_stats.switches[LOD_ASTEROID]);
+
+    ImGui::Text("Occluded: %d bodies, %d asteroids", simulation_handler.getOccludedObjectCount(), simulation_handler.getOccludedAsteroidCount());
+    ImGui::Text("Asteroids skipped by the governor: %d", simulation_handler.getSkippedAsteroidCount());
+
+    PlanetQuadtreeStats const quadtree_stats = simulation_handler.getPlanetQuadtreeStats();
+    ImGui::Text("Planet chunks: %d (%d triangles), %d generating, %d cached", quadtree_stats.chunks, quadtree_stats.triangles, quadtree_stats.pending, quadtree_stats.cached);
+
+    ImGui::Checkbox("Landing zone", &gui.display_landing_zone);
+    if (landing_zone != nullptr)
+    {
+        StreamingTerrainStats const &terrain_stats = landing_zone->getStats();
+        ImGui::Text("Landing zone tiles: %d, %d generating, %d cached (%.1f MB)", terrain_stats.tiles, terrain_stats.pending, terrain_stats.cached, terrain_stats.bytes / (1024.0f * 1024.0f));
+
+        VegetationStats const &vegetation_stats = landing_vegetation->getStats();
+        ImGui::Text("Trees: %d meshes, %d impostors, %d draw calls", vegetation_stats.meshes, vegetation_stats.impostors, vegetation_stats.draw_calls);
+    }
+
+    TransparentPassStats const &transparent_stats = simulation_handler.getTransparentPassStats();
+    ImGui::Text("Transparent instances: %d, %d draw calls, sorted in %.2f ms", transparent_stats.instances, transparent_stats.draw_calls, transparent_stats.sort_ms);
+
+    ImGui::SliderInt("Fleet size", &global_gui_params.fleet_size, 0, FLEET_MAX_SHIPS);
+    ImGui::Text("Fleet draw calls: %d", fleet.getDrawCallCount());
+
+    ProjectileStats const &projectile_stats = projectiles.getStats();
+    ImGui::SliderInt("Projectiles per shot (R)", &gui.projectile_volley, 1, 64);
+    ImGui::Text("Projectiles: %d / %d (%d dropped), %d targets, %d hits", projectile_stats.alive, PROJECTILE_CAPACITY, projectile_stats.dropped, projectile_stats.targets, projectile_stats.hits);
+    ImGui::Text("Projectile update: %.2f ms", projectile_stats.update_ms);
+
+    ImGui::Text("Particles: %d / %d, %d draw calls", global_particle_system.size(), PARTICLE_CAPACITY, global_particle_system.getDrawCallCount());
+}
+
+void scene_structure::draw_landing_zone(cgp::vec3 const &camera_position)
+{
+    if (landing_zone == nullptr)
+    {
+        StreamingTerrainSettings settings;
+        settings.center = {0, 0, LANDING_ZONE_ALTITUDE};
+        landing_zone = std::make_unique<StreamingTerrain>(perlin_noise_parameters{0.4f, 2.0f, 6, 20.0f, 0.01f}, settings);
+        landing_zone->initialize(camera_position);
+
+        // Trees on the terrain heights, around the center
+        VegetationSettings vegetation_settings;
+        vegetation_settings.tile_length = 32.0f;
+        vegetation_settings.full_density_distance = 60.0f;
+        vegetation_settings.impostor_distance = 120.0f;
+        vegetation_settings.max_distance = 400.0f;
+        landing_vegetation = std::make_unique<Vegetation>(vegetation_settings);
+
+        std::vector<cgp::vec3> trees;
+        for (cgp::vec2 const &p : poisson_disk_sampling({-LANDING_ZONE_FOREST, -LANDING_ZONE_FOREST}, {LANDING_ZONE_FOREST, LANDING_ZONE_FOREST}, LANDING_ZONE_TREE_SPACING))
+            trees.push_back(settings.center + cgp::vec3(p.x, p.y, landing_zone->getHeightAt(p.x, p.y)));
+
+        int const species = landing_vegetation->addSpecies(create_tree());
+        landing_vegetation->addPlants(species, trees, 2.0f, 4.0f);
+        landing_vegetation->upload();
+    }
+
+    landing_zone->update(camera_position);
+    for (cgp::mesh_drawable *tile : landing_zone->getVisibleTiles())
+    {
+        tile->material.color = {0.55f, 0.45f, 0.35f};
+        tile->material.phong.specular = 0;
+        cgp::draw(*tile, environment);
+    }
+    landing_vegetation->draw(environment);
+}
+
+void scene_structure::update_fleet(float dt)
+{
+    // The fleet escorts the player, a bit behind it
+    PlayerObject const &player = keyboard_control_handler.getPlayer();
+    cgp::vec3 const player_position = Object::scaleDownDistanceForDisplay(player.get_position());
+    fleet_agents.setFormationCenter(player_position - FLEET_ESCORT_DISTANCE * player.get_direction());
+
+    fleet_agents.resize(global_gui_params.fleet_size);
+    fleet_agents.setObstacles(simulation_handler.getObstacleSpheres(player_position, FLEET_OBSTACLE_RANGE));
+    fleet_agents.update(dt);
+
+    // Ships look where they go
+    fleet.setShipCount(fleet_agents.size());
+    std::vector<FleetShip> &ships = fleet.getShips();
+    for (int i = 0; i < fleet.getShipCount(); i++)
+    {
+        ships[i].position = fleet_agents.getPosition(i);
+
+        cgp::vec3 const velocity = fleet_agents.getVelocity(i);
+        if (cgp::norm(velocity) > 1e-3f)
+            ships[i].orientation = rotation_transform::from_vector_transform({1, 0, 0}, cgp::normalize(velocity));
+    }
+
+    // Exhaust of the close ships only, thinned so that the fleet stays within its share of the particle pool
+    int emitting = 0;
+    for (auto const &ship : ships)
+        emitting += cgp::norm(ship.position - player_position) < FLEET_EXHAUST_DISTANCE;
+
+    float const lifetime = global_particle_system.materials[PARTICLE_ENGINE].lifetime;
+    float const live = emitting * fleet_model.getEngineEmitterCount() * ENGINE_PARTICLE_RATE * lifetime;
+    float const rate_scale = live > FLEET_EXHAUST_PARTICLES ? FLEET_EXHAUST_PARTICLES / live : 1.0f;
+    for (int i = 0; i < fleet.getShipCount(); i++)
+    {
+        if (cgp::norm(ships[i].position - player_position) < FLEET_EXHAUST_DISTANCE)
+            fleet_model.emit_exhaust(dt, fleet_agents.getVelocity(i), cgp::affine_rts(ships[i].orientation, ships[i].position, ships[i].scale), rate_scale);
+    }
+
+    fleet.update();
+}
+
+void scene_structure::update_projectiles(float dt)
+{
+    PlayerObject const &player = keyboard_control_handler.getPlayer();
+    cgp::vec3 const player_position = Object::scaleDownDistanceForDisplay(player.get_position());
+    cgp::vec3 const direction = player.get_direction();
+
+    // Fire volleys at a fixed rate while the key is held
+    projectile_cooldown = std::max(projectile_cooldown - dt, 0.0f);
+    if (keyboard_control_handler.isFiring() && projectile_cooldown <= 0)
+    {
+        projectile_cooldown = 1.0f / PROJECTILE_FIRE_RATE;
+
+        // Bolts inherit the ship velocity (display units per real second)
+        cgp::vec3 const ship_velocity = Object::scaleDownDistanceForDisplay(player.get_velocity()) * (float)Timer::timer_multiplier;
+
+        for (int k = 0; k < gui.projectile_volley; k++)
+        {
+            cgp::vec3 const spread = k == 0 ? cgp::vec3{0, 0, 0} : 0.05f * random_normalized_axis();
+            cgp::vec3 const shot_direction = cgp::normalize(direction + spread);
+            projectiles.fire(player_position + direction, ship_velocity + PROJECTILE_SPEED * shot_direction);
+        }
+    }
+
+    if (projectiles.size() > 0)
+        projectiles.setTargets(simulation_handler.getProjectileTargets(player_position, PROJECTILE_TARGET_RANGE));
+
+    projectiles.update(dt);
+    simulation_handler.applyProjectileHits(projectiles.getHits());
+
+    // Impact bursts : sparks, and dust when an asteroid was hit
+    for (auto const &hit : projectiles.getHits())
+    {
+        global_particle_system.emit(PARTICLE_IMPACT, hit.position, -0.05f * hit.velocity, 8.0f, 24);
+        if (hit.owner >= 0)
+            global_particle_system.emit(PARTICLE_DEBRIS, hit.position, {0, 0, 0}, 1.5f, 12);
+    }
 }
 
 void scene_structure::mouse_move_event()
@@ -156,10 +368,14 @@ void scene_structure::display_semiTransparent()
 
     simulation_handler.drawBillboards(environment, position, rotation, false);
 
+    // The shield uses its own shader : drawn after the sorted billboards
     if (global_gui_params.enable_shield)
         keyboard_control_handler.draw_shield(environment);
 
     // Don't forget to re-activate the depth-buffer write
     glDepthMask(true);
     glDisable(GL_BLEND);
+
+    // One draw call per particle material, blending handled by the particle system
+    global_particle_system.draw(environment);
 }
\ No newline at end of file
@@ -5,15 +5,30 @@
 #include "simulation_handler/simulation_handler.hpp"
 #include "utils/camera/custom_camera_controller.hpp"
 #include "utils/controls/controls.hpp"
+#include "utils/display/frame_governor.hpp"
+#include "utils/display/lod_manager.hpp"
 
+#include "ai/ship_agents.hpp"
+#include "streaming_terrain.hpp"
+#include "vegetation.hpp"
+#include "navion/fleet.hpp"
 #include "navion/navion.hpp"
-#include "navion/reacteur.hpp"
+#include "utils/particles/particle_system.hpp"
+#include "weapons/projectile_pool.hpp"
+#include <memory>
 
 // This definitions allow to use the structures: mesh, mesh_drawable, etc. without mentionning explicitly cgp::
 using cgp::mesh_drawable;
 using cgp::timer_basic;
 using cgp::vec3;
 
+// ************************************************** //
+//               LANDING ZONE CONSTANTS               //
+// ************************************************** //
+constexpr float LANDING_ZONE_ALTITUDE = -200.0f; // Height of the landing zone terrain, under the orbital plane
+constexpr float LANDING_ZONE_FOREST = 300.0f;    // Half side of the forested square around the landing zone center
+constexpr float LANDING_ZONE_TREE_SPACING = 6.0f; // Min distance between two trees
+
 // Variables associated to the GUI
 struct gui_parameters
 {
@@ -21,6 +36,10 @@ struct gui_parameters
     bool display_frame = false;
     bool display_wireframe = false;
     float angle_aile_vaisseau;
+    int projectile_volley = 1; // Projectiles per shot, spread in a cone
+    float lod_pixel_error = LOD_DEFAULT_PIXEL_ERROR;
+    float lod_hysteresis = LOD_DEFAULT_HYSTERESIS;
+    bool display_landing_zone = false; // Streamed terrain under the solar system
 };
 
 // The structure of the custom scene
@@ -49,6 +68,7 @@ struct scene_structure : cgp::scene_inputs_generic
     void initialize();    // Standard initialization to be called before the animation loop
     void display_frame(); // The frame display to be called within the animation loop
     void display_gui();   // The display of the GUI, also called within the animation loop
+    void clear();         // Free the GPU objects not owned by a drawable, before the window is destroyed
 
     void mouse_move_event();
     void mouse_click_event();
@@ -60,4 +80,26 @@ struct scene_structure : cgp::scene_inputs_generic
 
     SimulationHandler simulation_handler;
     Controls keyboard_control_handler;
+
+    // Fleet of instanced ships, all copies of fleet_model
+    Navion fleet_model;
+    Fleet fleet;
+    ShipAgents fleet_agents; // AI driving the fleet ships
+
+    // Move the AI agents and copy their state to the fleet
+    void update_fleet(float dt);
+
+    // Player projectiles (fire with R)
+    ProjectilePool projectiles;
+    float projectile_cooldown = 0;
+
+    // Fire, move the projectiles and destroy the asteroids they hit
+    void update_projectiles(float dt);
+
+    // Open world terrain and its forest, created the first time they are shown
+    std::unique_ptr<StreamingTerrain> landing_zone;
+    std::unique_ptr<Vegetation> landing_vegetation;
+
+    // Stream the landing zone tiles around the camera and draw them with the forest
+    void draw_landing_zone(cgp::vec3 const &camera_position);
 };
@@ -21,6 +21,8 @@ void OptimizedSimulationHandler::addObject(TExtendsBaseDrawable drawable, bool a
     if (dynamic_cast<Drawable *>(ptr))
     {
         drawable_objects.push_back(dynamic_cast<Drawable *>(ptr));
+        drawable_objects.back()->setRenderQueue(&render_queue);
+        occluder_of.push_back(dynamic_cast<Object *>(ptr) ? (int)physical_objects.size() : -1); // Pushed to physical_objects below
     }
     if (dynamic_cast<BillboardDrawable *>(ptr))
     {
@@ -1,12 +1,14 @@
 #include "simulation_handler.hpp"
 #include "background/galaxy.hpp"
 #include "celestial_bodies/asteroid_belt/asteroid_belt.hpp"
+#include "celestial_bodies/billboards/nebula.hpp"
 #include "celestial_bodies/overrides/star.hpp"
 #include "celestial_bodies/planet/planet.hpp"
 #include "utils/display/base_drawable.hpp"
 #include "utils/noise/perlin.hpp"
 #include "utils/physics/constants.hpp"
 #include "utils/physics/object.hpp"
+#include "utils/threads/job_system.hpp"
 #include <iostream>
 #include <iterator>
 #include <memory>
@@ -27,6 +29,8 @@ void SimulationHandler::addObject(TExtendsBaseDrawable drawable)
     if (dynamic_cast<Drawable *>(ptr))
     {
         drawable_objects.push_back(dynamic_cast<Drawable *>(ptr));
+        drawable_objects.back()->setRenderQueue(&render_queue);
+        occluder_of.push_back(dynamic_cast<Object *>(ptr) ? (int)physical_objects.size() : -1); // Pushed to physical_objects below
     }
     if (dynamic_cast<BillboardDrawable *>(ptr))
     {
@@ -40,23 +44,137 @@ void SimulationHandler::addObject(TExtendsBaseDrawable drawable)
 
 void SimulationHandler::drawObjects(environment_structure const &environment, cgp::vec3 &position, cgp::rotation_transform &rotation, bool show_wireframe)
 {
-    for (auto &drawable : drawable_objects)
+    // The sun and planets hide what is behind them
+    std::vector<cgp::vec4> spheres;
+    for (auto const &object : physical_objects)
+        spheres.push_back({Object::scaleDownDistanceForDisplay(object->getPhysicsPosition()), object->getPhysicsRadius() * (float)PHYSICS_SCALE});
+    occluders.setup(position, spheres);
+
+    for (auto &belt : asteroid_belts)
+        belt.setOccluders(&occluders);
+
+    // Wireframe debug display is only available with direct drawing
+    if (show_wireframe)
+    {
+        for (auto &drawable : drawable_objects)
+        {
+            drawable->draw(environment, position, rotation, show_wireframe);
+        }
+        render_queue.flush(environment);
+
+        for (auto &belt : asteroid_belts)
+        {
+            belt.draw(environment, position, rotation, show_wireframe);
+        }
+        return;
+    }
+
+    // Record the draw commands of every object in parallel (occlusion and distance tests, matrices, instance sorting)
+    int object_count = drawable_objects.size();
+    int list_count = object_count + asteroid_belts.size();
+    command_lists.resize(list_count);
+    recorded.resize(list_count);
+    occluded.assign(object_count, 0);
+
+    global_job_system.parallelFor(list_count, [&](int begin, int end)
+                                  {
+        for (int i = begin; i < end; i++)
+        {
+            command_lists[i].clear();
+            if (i < object_count)
+            {
+                // Occluded bodies are recorded as empty lists
+                int const sphere = occluder_of[i];
+                if (sphere >= 0)
+                    occluded[i] = occluders.isOccluded({spheres[sphere].x, spheres[sphere].y, spheres[sphere].z}, spheres[sphere].w * OCCLUDEE_RADIUS_MARGIN, sphere);
+
+                recorded[i] = occluded[i] || drawable_objects[i]->record(command_lists[i], position, rotation);
+            }
+            else
+                recorded[i] = asteroid_belts[i - object_count].record(command_lists[i], position, rotation);
+        } });
+
+    occluded_object_count = 0;
+    for (char object_occluded : occluded)
+        occluded_object_count += object_occluded;
+
+    // OpenGL thread : objects that cannot be recorded (galaxy background) are drawn first, in order
+    for (int i = 0; i < object_count; i++)
     {
-        drawable->draw(environment, position, rotation, show_wireframe);
+        if (!recorded[i])
+            drawable_objects[i]->draw(environment, position, rotation, show_wireframe);
     }
 
+    // Replay the command lists, sorted by shader / texture / vao
+    for (int i = 0; i < list_count; i++)
+    {
+        if (recorded[i])
+            render_queue.replay(command_lists[i]);
+    }
+    render_queue.flush(environment);
+}
+
+int SimulationHandler::getOccludedAsteroidCount() const
+{
+    int count = 0;
+    for (auto const &belt : asteroid_belts)
+        count += belt.getOccludedCount();
+    return count;
+}
+
+void SimulationHandler::setAsteroidRenderLimits(float impostor_cutoff, int max_instances)
+{
     for (auto &belt : asteroid_belts)
+        belt.setRenderLimits(impostor_cutoff, max_instances);
+}
+
+int SimulationHandler::getSkippedAsteroidCount() const
+{
+    int count = 0;
+    for (auto const &belt : asteroid_belts)
+        count += belt.getSkippedCount();
+    return count;
+}
+
+PlanetQuadtreeStats SimulationHandler::getPlanetQuadtreeStats() const
+{
+    PlanetQuadtreeStats total;
+    for (auto const *drawable : drawable_objects)
     {
-        belt.draw(environment, position, rotation, show_wireframe);
+        if (auto const *planet = dynamic_cast<Planet const *>(drawable))
+        {
+            PlanetQuadtreeStats const stats = planet->getQuadtreeStats();
+            total.chunks += stats.chunks;
+            total.triangles += stats.triangles;
+            total.pending += stats.pending;
+            total.cached += stats.cached;
+        }
     }
+    return total;
+}
+
+void SimulationHandler::gatherBillboards(cgp::vec3 const &position, cgp::rotation_transform const &rotation)
+{
+    transparent_pass.beginFrame();
+
+    billboard_gathered.resize(billboard_drawable_objects.size());
+    for (size_t i = 0; i < billboard_drawable_objects.size(); i++)
+        billboard_gathered[i] = billboard_drawable_objects[i]->gatherBillboards(transparent_pass, position, rotation);
+
+    // The camera looks along its local -z axis
+    transparent_pass.sortAsync(position, rotation * cgp::vec3{0, 0, -1});
 }
 
 void SimulationHandler::drawBillboards(environment_structure const &environment, cgp::vec3 &position, cgp::rotation_transform &rotation, bool show_wireframe)
 {
-    for (auto &drawable : billboard_drawable_objects)
+    // Billboards that do not support the transparent pass are drawn first, unsorted
+    for (size_t i = 0; i < billboard_drawable_objects.size(); i++)
     {
-        drawable->drawBillboards(environment, position, rotation, show_wireframe);
+        if (i >= billboard_gathered.size() || !billboard_gathered[i])
+            billboard_drawable_objects[i]->drawBillboards(environment, position, rotation, show_wireframe);
     }
+
+    transparent_pass.flush(environment);
 }
 
 void SimulationHandler::simulateStep(float time_step)
@@ -86,6 +204,50 @@ void SimulationHandler::simulateStep(float time_step)
     }
 }
 
+std::vector<cgp::vec4> SimulationHandler::getObstacleSpheres(cgp::vec3 const &center, float range) const
+{
+    std::vector<cgp::vec4> obstacles;
+
+    for (auto const &object : physical_objects)
+    {
+        obstacles.push_back({Object::scaleDownDistanceForDisplay(object->getPhysicsPosition()), object->getPhysicsRadius() * (float)PHYSICS_SCALE});
+    }
+
+    for (auto const &belt : asteroid_belts)
+    {
+        belt.appendObstacles(center, range, obstacles);
+    }
+
+    return obstacles;
+}
+
+std::vector<ProjectileTarget> SimulationHandler::getProjectileTargets(cgp::vec3 const &center, float range) const
+{
+    std::vector<ProjectileTarget> targets;
+
+    for (int i = 0; i < (int)physical_objects.size(); i++)
+    {
+        cgp::vec4 const sphere = {Object::scaleDownDistanceForDisplay(physical_objects[i]->getPhysicsPosition()), physical_objects[i]->getPhysicsRadius() * (float)PHYSICS_SCALE};
+        targets.push_back({sphere, -1, i});
+    }
+
+    for (int i = 0; i < (int)asteroid_belts.size(); i++)
+    {
+        asteroid_belts[i].appendProjectileTargets(center, range, i, targets);
+    }
+
+    return targets;
+}
+
+void SimulationHandler::applyProjectileHits(std::vector<ProjectileHit> const &hits)
+{
+    for (auto const &hit : hits)
+    {
+        if (hit.owner >= 0)
+            asteroid_belts[hit.owner].destroyAsteroid(hit.index);
+    }
+}
+
 void SimulationHandler::initialize()
 {
     galaxy.initialize();
@@ -100,6 +262,17 @@ void SimulationHandler::initialize()
     }
 }
 
+void SimulationHandler::clear()
+{
+    transparent_pass.clear();
+
+    for (auto *drawable : drawable_objects)
+    {
+        if (auto *planet = dynamic_cast<Planet *>(drawable))
+            planet->clearQuadtree();
+    }
+}
+
 void SimulationHandler::generateSolarSystem(SimulationHandler &handler)
 {
     // Add galaxy first (background)
@@ -184,6 +357,10 @@ void SimulationHandler::generateSolarSystem(SimulationHandler &handler)
     neptune.setRotationAxis(NEPTUNE_ROTATION_AXIS);
     neptune.setPhysicsRadius(NEPTUNE_RADIUS * DISPLAY_SCALE); // For player collisions
     handler.addObject(neptune);
+
+    // Add a gas cloud above the ecliptic, between Mars and Jupiter
+    Nebula nebula({-50, 30, 25}, 25, 20000);
+    handler.addObject(nebula);
 }
 
 void SimulationHandler::addAsteroidBelt(AsteroidBelt asteroid_belt)
@@ -2,10 +2,14 @@
 
 #include "background/galaxy.hpp"
 #include "celestial_bodies/asteroid_belt/asteroid_belt.hpp"
+#include "celestial_bodies/planet/planet_quadtree.hpp"
 #include "utils/display/base_drawable.hpp"
 #include "utils/display/billboard_drawable.hpp"
 #include "utils/display/drawable.hpp"
+#include "utils/display/sphere_occluders.hpp"
+#include "utils/opengl/render_queue.hpp"
 #include "utils/physics/object.hpp"
+#include "weapons/projectile_pool.hpp"
 #include <memory>
 
 class SimulationHandler
@@ -15,11 +19,16 @@ public:
     void addObject(TExtendsBaseDrawable drawable); // Do not use reference, as the object will be copied and moved to a unique_ptr
     void addAsteroidBelt(AsteroidBelt asteroid_belt);
     void initialize();
+    void clear(); // Free the GPU objects of the passes and of the planet terrain chunks (OpenGL thread)
 
     // Draw Functions
     void drawObjects(environment_structure const &environment, cgp::vec3 &position, cgp::rotation_transform &rotation, bool show_wireframe = true);
     void drawBillboards(environment_structure const &environment, cgp::vec3 &position, cgp::rotation_transform &rotation, bool show_wireframe = true);
 
+    // Submit the billboards to the transparent pass and start sorting them on a worker.
+    // Call it early in the frame : the sort runs while the opaque objects are drawn, drawBillboards waits for it
+    void gatherBillboards(cgp::vec3 const &position, cgp::rotation_transform const &rotation);
+
     // Simulation Functions
     virtual void simulateStep(float time_step);
 
@@ -31,6 +40,33 @@ public:
     // Get physics object (for camera intersection detection)
     std::vector<Object *> getPhysicalObjects() const;
 
+    // Obstacle spheres for the AI ships, in display coordinates (xyz = center, w = radius)
+    // Planets are always included, asteroids only closer than range to center
+    std::vector<cgp::vec4> getObstacleSpheres(cgp::vec3 const &center, float range) const;
+
+    // Same spheres for the projectiles : asteroids are tagged with their belt and index, planets with owner -1
+    std::vector<ProjectileTarget> getProjectileTargets(cgp::vec3 const &center, float range) const;
+
+    // Destroy the asteroids hit by projectiles
+    void applyProjectileHits(std::vector<ProjectileHit> const &hits);
+
+    // Render queue counters of the last drawObjects call (for the GUI)
+    RenderQueueStats const &getRenderQueueStats() const { return render_queue.getStats(); };
+
+    // Objects and asteroids culled behind the sun and planets in the last drawObjects call (for the GUI)
+    int getOccludedObjectCount() const { return occluded_object_count; };
+    int getOccludedAsteroidCount() const;
+
+    // Render limits of every asteroid belt (see AsteroidBelt::setRenderLimits), and the asteroids they skipped
+    void setAsteroidRenderLimits(float impostor_cutoff, int max_instances);
+    int getSkippedAsteroidCount() const;
+
+    // Quadtree terrain counters of the planets drawn as chunks, summed (for the GUI)
+    PlanetQuadtreeStats getPlanetQuadtreeStats() const;
+
+    // Transparent pass counters of the last drawBillboards call (for the GUI)
+    TransparentPassStats const &getTransparentPassStats() const { return transparent_pass.getStats(); };
+
 protected:
     // Drawable objects
     // Store all drawable instances here
@@ -44,4 +80,21 @@ protected:
     std::vector<AsteroidBelt> asteroid_belts; // Asteroid belts
 
     Galaxy galaxy;
+
+    // Opaque drawables submit their meshes here, flushed once per drawObjects call
+    RenderQueue render_queue;
+
+    // One command list per drawable object, then one per asteroid belt, recorded in parallel
+    std::vector<CommandList> command_lists;
+    std::vector<char> recorded; // Whether each command list was recorded, else the object is drawn directly
+
+    // Occlusion by the sun and planets, rebuilt for each drawObjects call
+    SphereOccluders occluders;
+    std::vector<int> occluder_of; // For each drawable object : its index in the occluder spheres (-1 : not a physical object)
+    std::vector<char> occluded;   // For each drawable object, in the last drawObjects call
+    int occluded_object_count = 0;
+
+    // Sorted translucent instances of the billboards
+    TransparentPass transparent_pass;
+    std::vector<char> billboard_gathered; // Whether each billboard was submitted to the pass, else it is drawn directly
 };
\ No newline at end of file
@@ -0,0 +1,312 @@
+#include "streaming_terrain.hpp"
+#include "cgp/geometry/shape/noise/noise.hpp"
+#include "utils/noise/noise_batch.hpp"
+#include "utils/threads/job_system.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+StreamingTerrain::StreamingTerrain(perlin_noise_parameters parameters, StreamingTerrainSettings settings) : parameters(parameters), settings(settings)
+{
+    // Position, normal, color and uv per vertex (grid + skirts), and the triangles
+    int const R = settings.tile_resolution;
+    size_t const vertices = (R + 1) * (R + 1) + 4 * (R + 1);
+    size_t const triangles = 2 * R * R + 8 * R;
+    tile_bytes = vertices * (3 + 3 + 3 + 2) * sizeof(float) + triangles * 3 * sizeof(unsigned int);
+}
+
+StreamingTerrain::~StreamingTerrain()
+{
+    // The jobs write into the tiles
+    for (auto &tile : lru)
+    {
+        if (tile->job.valid())
+            tile->job.wait();
+    }
+}
+
+void StreamingTerrain::initialize(cgp::vec3 const &camera_position)
+{
+    camera = camera_position - settings.center;
+    int const top = settings.levels - 1;
+    float const size = tileSize(top);
+    int const cx = (int)std::floor(camera.x / size);
+    int const cy = (int)std::floor(camera.y / size);
+
+    // Request the coarsest ring, then wait for it : there is no hole on the first frame
+    for (int ix = cx - settings.view_tiles; ix <= cx + settings.view_tiles; ix++)
+    {
+        for (int iy = cy - settings.view_tiles; iy <= cy + settings.view_tiles; iy++)
+        {
+            requests_this_frame = 0; // No request limit here
+            getReadyTile(top, ix, iy);
+        }
+    }
+    for (auto &tile : lru)
+    {
+        if (!tile->uploaded)
+            upload(*tile);
+    }
+}
+
+void StreamingTerrain::clear()
+{
+    for (auto &tile : lru)
+    {
+        if (tile->job.valid())
+            tile->job.wait();
+        if (tile->uploaded)
+            tile->drawable.clear();
+    }
+    lru.clear();
+    tiles.clear();
+    visible_tiles.clear();
+    pending_count = 0;
+    stats = StreamingTerrainStats();
+}
+
+uint64_t StreamingTerrain::tileKey(int level, int ix, int iy)
+{
+    // 28 bits per signed tile coordinate
+    uint64_t const x = (uint32_t)(ix + (1 << 27)) & 0xFFFFFFF;
+    uint64_t const y = (uint32_t)(iy + (1 << 27)) & 0xFFFFFFF;
+    return (uint64_t)level | (x << 8) | (y << 36);
+}
+
+float StreamingTerrain::tileSize(int level) const
+{
+    return settings.tile_length * (float)(1 << level);
+}
+
+float StreamingTerrain::getHeightAt(float x, float y) const
+{
+    return parameters.terrain_height * cgp::noise_perlin(cgp::vec2(x, y) * parameters.scale, parameters.octave, parameters.persistency, parameters.frequency_gain);
+}
+
+void StreamingTerrain::generateTile(perlin_noise_parameters parameters, StreamingTerrainSettings settings, int level, int ix, int iy, cgp::mesh &mesh)
+{
+    int const R = settings.tile_resolution;
+    int const E = R + 3; // Grid with a one vertex border, for the normals
+    float const size = settings.tile_length * (float)(1 << level);
+    float const step = size / R;
+    cgp::vec2 const origin = {ix * size, iy * size};
+
+    // Heights of the extended grid, in one batch
+    std::vector<cgp::vec2> noise_points(E * E);
+    std::vector<float> heights(E * E);
+    for (int j = -1; j <= R + 1; j++)
+    {
+        for (int i = -1; i <= R + 1; i++)
+            noise_points[(i + 1) + E * (j + 1)] = (origin + cgp::vec2(i * step, j * step)) * parameters.scale;
+    }
+    noise_perlin_batch(noise_points.data(), heights.data(), E * E, parameters.octave, parameters.persistency, parameters.frequency_gain);
+
+    int const grid_count = (R + 1) * (R + 1);
+    mesh.position.resize(grid_count);
+    mesh.normal.resize(grid_count);
+    mesh.uv.resize(grid_count);
+    for (int j = 0; j <= R; j++)
+    {
+        for (int i = 0; i <= R; i++)
+        {
+            int const g = (i + 1) + E * (j + 1);
+            int const k = i + (R + 1) * j;
+
+            mesh.position[k] = {i * step, j * step, parameters.terrain_height * heights[g]};
+            cgp::vec3 const du = {2 * step, 0, parameters.terrain_height * (heights[g + 1] - heights[g - 1])};
+            cgp::vec3 const dv = {0, 2 * step, parameters.terrain_height * (heights[g + E] - heights[g - E])};
+            mesh.normal[k] = cgp::normalize(cgp::cross(du, dv));
+            mesh.uv[k] = (origin + cgp::vec2(i * step, j * step)) / settings.tile_length;
+        }
+    }
+
+    for (int j = 0; j < R; j++)
+    {
+        for (int i = 0; i < R; i++)
+        {
+            unsigned int const k00 = i + (R + 1) * j;
+            unsigned int const k10 = k00 + 1;
+            unsigned int const k01 = k00 + (R + 1);
+            unsigned int const k11 = k01 + 1;
+            mesh.connectivity.push_back({k00, k10, k11});
+            mesh.connectivity.push_back({k00, k11, k01});
+        }
+    }
+
+    // Skirts : each border vertex is duplicated lower, and the strip between them fills the cracks
+    float const depth = STREAMING_SKIRT_DEPTH * size;
+    for (int edge = 0; edge < 4; edge++)
+    {
+        unsigned int const first_skirt = mesh.position.size();
+        for (int n = 0; n <= R; n++)
+        {
+            int const i = edge == 0 ? n : edge == 1 ? R : edge == 2 ? R - n : 0;
+            int const j = edge == 0 ? 0 : edge == 1 ? n : edge == 2 ? R : R - n;
+            int const k = i + (R + 1) * j;
+
+            mesh.position.push_back(mesh.position[k] - cgp::vec3(0, 0, depth));
+            mesh.normal.push_back(mesh.normal[k]);
+            mesh.uv.push_back(mesh.uv[k]);
+
+            if (n > 0)
+            {
+                int const i_previous = edge == 0 ? n - 1 : edge == 1 ? R : edge == 2 ? R - n + 1 : 0;
+                int const j_previous = edge == 0 ? 0 : edge == 1 ? n - 1 : edge == 2 ? R : R - n + 1;
+                unsigned int const top_previous = i_previous + (R + 1) * j_previous;
+                unsigned int const skirt = first_skirt + n;
+                mesh.connectivity.push_back({top_previous, (unsigned int)k, skirt});
+                mesh.connectivity.push_back({top_previous, skirt, skirt - 1});
+            }
+        }
+    }
+
+    mesh.fill_empty_field();
+}
+
+StreamingTerrain::Tile *StreamingTerrain::getReadyTile(int level, int ix, int iy)
+{
+    uint64_t const key = tileKey(level, ix, iy);
+    auto it = tiles.find(key);
+
+    // Unknown tile : generate it on a worker
+    if (it == tiles.end())
+    {
+        if (requests_this_frame >= STREAMING_TILE_REQUESTS_PER_FRAME)
+            return nullptr;
+        requests_this_frame++;
+        pending_count++;
+
+        auto tile = std::make_unique<Tile>();
+        Tile *target = tile.get();
+        target->key = key;
+        target->origin = {ix * tileSize(level), iy * tileSize(level), 0};
+        target->last_used_frame = frame;
+        target->job = global_job_system.submit([parameters = parameters, settings = settings, level, ix, iy, target]()
+                                               { generateTile(parameters, settings, level, ix, iy, target->mesh); });
+
+        lru.push_front(std::move(tile));
+        tiles[key] = lru.begin();
+        return nullptr;
+    }
+
+    // Most recently used
+    lru.splice(lru.begin(), lru, it->second);
+    Tile &tile = **it->second;
+    tile.last_used_frame = frame;
+    if (tile.uploaded)
+        return &tile;
+
+    // Upload the generated mesh, if the job is done
+    if (uploads_this_frame >= STREAMING_TILE_UPLOADS_PER_FRAME || tile.job.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return nullptr;
+    uploads_this_frame++;
+
+    upload(tile);
+    return &tile;
+}
+
+void StreamingTerrain::upload(Tile &tile)
+{
+    tile.job.get();
+    tile.drawable.initialize_data_on_gpu(tile.mesh);
+    tile.drawable.model.translation = settings.center + tile.origin;
+    tile.mesh = cgp::mesh();
+    tile.uploaded = true;
+
+    pending_count--;
+    stats.bytes += tile_bytes;
+}
+
+void StreamingTerrain::select(int level, int ix, int iy)
+{
+    Tile *tile = getReadyTile(level, ix, iy);
+    if (tile == nullptr)
+        return;
+
+    // Distance from the camera to the tile square (at height 0)
+    float const size = tileSize(level);
+    float const dx = std::max({tile->origin.x - camera.x, camera.x - (tile->origin.x + size), 0.0f});
+    float const dy = std::max({tile->origin.y - camera.y, camera.y - (tile->origin.y + size), 0.0f});
+    float const distance = std::sqrt(dx * dx + dy * dy + camera.z * camera.z);
+
+    if (level > 0 && distance < settings.split_distance * size)
+    {
+        // Swap in the children only once the 4 of them are ready (all of them are requested)
+        bool ready = true;
+        for (int k = 0; k < 4; k++)
+            ready = getReadyTile(level - 1, 2 * ix + (k & 1), 2 * iy + (k >> 1)) != nullptr && ready;
+
+        if (ready)
+        {
+            for (int k = 0; k < 4; k++)
+                select(level - 1, 2 * ix + (k & 1), 2 * iy + (k >> 1));
+            return;
+        }
+    }
+
+    visible_tiles.push_back(&tile->drawable);
+}
+
+void StreamingTerrain::update(cgp::vec3 const &camera_position)
+{
+    camera = camera_position - settings.center;
+    frame++;
+    requests_this_frame = 0;
+    uploads_this_frame = 0;
+    visible_tiles.clear();
+
+    // Coarsest tiles around the camera, refined near it
+    int const top = settings.levels - 1;
+    float const size = tileSize(top);
+    int const cx = (int)std::floor(camera.x / size);
+    int const cy = (int)std::floor(camera.y / size);
+    for (int ix = cx - settings.view_tiles; ix <= cx + settings.view_tiles; ix++)
+    {
+        for (int iy = cy - settings.view_tiles; iy <= cy + settings.view_tiles; iy++)
+            select(top, ix, iy);
+    }
+
+    evict();
+
+    stats.tiles = visible_tiles.size();
+    stats.pending = pending_count;
+    stats.cached = tiles.size() - pending_count;
+}
+
+void StreamingTerrain::evict()
+{
+    // Generated tiles no longer selected are dropped as soon as their job is done, whatever the GPU memory : their
+    // mesh is in RAM and out of the budget, so they would pile up behind a moving camera
+    for (auto it = lru.begin(); it != lru.end();)
+    {
+        Tile &tile = **it;
+        if (tile.uploaded || tile.last_used_frame == frame || tile.job.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            ++it;
+            continue;
+        }
+
+        pending_count--;
+        tiles.erase(tile.key);
+        it = lru.erase(it);
+    }
+
+    // Least recently used first. The tiles of this frame are at the front : stop there
+    auto it = lru.end();
+    while (stats.bytes > settings.cache_bytes && it != lru.begin())
+    {
+        --it;
+        Tile &tile = **it;
+        if (tile.last_used_frame == frame)
+            break;
+
+        // Still generating
+        if (!tile.uploaded)
+            continue;
+
+        tile.drawable.clear();
+        stats.bytes -= tile_bytes;
+        tiles.erase(tile.key);
+        it = lru.erase(it);
+    }
+}
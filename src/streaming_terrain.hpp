@@ -0,0 +1,110 @@
+#pragma once
+
+#include "cgp/geometry/shape/mesh/structure/mesh.hpp"
+#include "cgp/graphics/drawable/mesh_drawable/mesh_drawable.hpp"
+#include "utils/noise/perlin.hpp"
+#include <cstdint>
+#include <future>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// ************************************************** //
+//            STREAMING TERRAIN CONSTANTS             //
+// ************************************************** //
+constexpr int STREAMING_TILE_REQUESTS_PER_FRAME = 16; // Tile generations started per frame
+constexpr int STREAMING_TILE_UPLOADS_PER_FRAME = 4;   // Generated tiles sent to the GPU per frame
+constexpr float STREAMING_SKIRT_DEPTH = 0.05f;        // Skirt depth, relative to the tile size : hides the cracks between levels
+
+struct StreamingTerrainSettings
+{
+    float tile_length = 32.0f;              // Side of the finest tiles
+    int tile_resolution = 32;               // Quads per tile side, at every level
+    int levels = 6;                         // LOD rings : the tiles of level L are 2^L times larger
+    int view_tiles = 2;                     // Coarsest tiles kept around the camera, in each direction
+    float split_distance = 1.5f;            // A tile is split when the camera is closer than this many tile sizes
+    size_t cache_bytes = size_t(256) << 20; // GPU memory cap of the tile cache
+    cgp::vec3 center = {0, 0, 0};           // World position of the terrain frame origin
+};
+
+struct StreamingTerrainStats
+{
+    int tiles = 0;    // Drawn tiles
+    int pending = 0;  // Tiles being generated
+    int cached = 0;   // Tiles on the GPU
+    size_t bytes = 0; // GPU memory of the cached tiles
+};
+
+/**
+ * Open world terrain made of square tiles, streamed around the camera.
+ * The heights use the shared perlin_noise_parameters : terrain_height * noise_perlin(scale * (x, y)).
+ * Every frame, the coarsest tiles around the camera are split into 4 while the camera is close to them, which
+ * gives LOD rings. Tiles are generated on the job system and a tile is only split once its 4 children are on
+ * the GPU, so the swap never waits. Skirts hide the cracks between levels.
+ * The tiles live in an LRU cache : the least recently drawn ones are freed once the memory cap is reached, and the
+ * generated tiles no longer requested are dropped before their upload.
+ */
+class StreamingTerrain
+{
+public:
+    StreamingTerrain(perlin_noise_parameters parameters, StreamingTerrainSettings settings = {});
+    ~StreamingTerrain();
+
+    // Generate the coarsest ring around the camera synchronously (OpenGL thread)
+    void initialize(cgp::vec3 const &camera_position);
+
+    // Wait for the jobs and free every tile (OpenGL thread). initialize must be called again before update
+    void clear();
+
+    // Select the tiles for this camera position (world), start the missing ones and evict the old ones (OpenGL thread)
+    void update(cgp::vec3 const &camera_position);
+
+    // Tiles selected by the last update. Their shader, texture and material must be set by the caller
+    std::vector<cgp::mesh_drawable *> const &getVisibleTiles() const { return visible_tiles; };
+
+    // Terrain height at (x, y) in the terrain frame, for gameplay queries
+    float getHeightAt(float x, float y) const;
+
+    StreamingTerrainStats const &getStats() const { return stats; };
+
+private:
+    struct Tile
+    {
+        uint64_t key;
+        cgp::vec3 origin;      // Corner of the tile (the mesh is local)
+        std::future<void> job; // Mesh generation
+        cgp::mesh mesh;        // Written by the job, released after the upload
+        cgp::mesh_drawable drawable;
+        bool uploaded = false;
+        int last_used_frame = 0;
+    };
+
+    using TileList = std::list<std::unique_ptr<Tile>>;
+
+    static uint64_t tileKey(int level, int ix, int iy);
+    static void generateTile(perlin_noise_parameters parameters, StreamingTerrainSettings settings, int level, int ix, int iy, cgp::mesh &mesh);
+
+    float tileSize(int level) const;
+    Tile *getReadyTile(int level, int ix, int iy); // Request or upload the tile if needed. nullptr if it is not ready yet
+    void upload(Tile &tile);
+    void select(int level, int ix, int iy);
+    void evict();
+
+    perlin_noise_parameters parameters;
+    StreamingTerrainSettings settings;
+
+    // Most recently used first
+    TileList lru;
+    std::unordered_map<uint64_t, TileList::iterator> tiles;
+    size_t tile_bytes; // GPU memory of one tile
+
+    std::vector<cgp::mesh_drawable *> visible_tiles;
+    cgp::vec3 camera;
+    int frame = 0;
+    int requests_this_frame = 0;
+    int uploads_this_frame = 0;
+    int pending_count = 0;
+
+    StreamingTerrainStats stats;
+};
@@ -2,11 +2,17 @@
 #include "terrain.hpp"
 #include "cgp/core/base/rand/rand.hpp"
 #include "cgp/geometry/shape/noise/noise.hpp"
+#include "utils/noise/noise_batch.hpp"
+#include "utils/random/poisson_disk.hpp"
+#include "utils/threads/job_system.hpp"
+#include <algorithm>
 #include <cmath>
 
 using namespace cgp;
 #define TERRAIN_OFFSET -0.02
 #define CLIPPING_DISTANCE 0.8
+#define TERRAIN_ROWS_PER_JOB 16
+#define TERRAIN_SCATTER_PER_JOB 4096
 
 // Evaluate 3D position of the terrain for any (x,y)
 // float evaluate_terrain_height(float x, float y)
@@ -22,39 +28,155 @@ using namespace cgp;
 //     return z;
 // }
 
-// Idem mais avec des paramètres différents (utiliser default arguments)
-// TODO: stocker ces paramètres au préalable pour éviter de les instancier à nouveau?
-// Remarque : c'est juste pour la génération du terrain, donc c'est pas très grave pour l'instant
-float evaluate_terrain_height(float x, float y, perlin_noise_parameters const &parameters, float terrain_length)
-{
-    int length = 4;
-    vec2 p_i[] = {{-10, -10}, {5, 5}, {-3, 4}, {6, 4}};
-    float h_i[] = {3, -1.5, 1, 2};
-    float sigma_i[] = {10, 3, 4, 4};
+// Gaussian hills of the terrain : center, height and width
+static const int TERRAIN_HILL_COUNT = 4;
+static const vec2 TERRAIN_HILL_CENTERS[TERRAIN_HILL_COUNT] = {{-10, -10}, {5, 5}, {-3, 4}, {6, 4}};
+static const float TERRAIN_HILL_HEIGHTS[TERRAIN_HILL_COUNT] = {3, -1.5, 1, 2};
+static const float TERRAIN_HILL_SIGMAS[TERRAIN_HILL_COUNT] = {10, 3, 4, 4};
 
-    // Computations
+static float evaluate_terrain_gaussians(float x, float y)
+{
     // Sum of exponents
     float z = 0;
-    for (int i = 0; i < length; ++i)
+    for (int i = 0; i < TERRAIN_HILL_COUNT; ++i)
     {
-        z += h_i[i] * std::exp(-std::pow(norm(vec2(x, y) - p_i[i]) / sigma_i[i], 2));
+        vec2 const d = (vec2(x, y) - TERRAIN_HILL_CENTERS[i]) / TERRAIN_HILL_SIGMAS[i];
+        z += TERRAIN_HILL_HEIGHTS[i] * std::exp(-dot(d, d));
     }
 
+    return z;
+}
+
+float evaluate_terrain_height(float x, float y, perlin_noise_parameters const &parameters, float terrain_length)
+{
     float u = x / terrain_length + 0.5f;
     float v = y / terrain_length + 0.5f;
 
-    z += noise_perlin({u, v}, parameters.octave, parameters.persistency, parameters.frequency_gain);
+    return evaluate_terrain_gaussians(x, y) + noise_perlin({u, v}, parameters.octave, parameters.persistency, parameters.frequency_gain);
+}
 
-    return z;
+void evaluate_terrain_heights(vec2 const *positions, float *heights, int count, perlin_noise_parameters const &parameters, float terrain_length)
+{
+    std::vector<vec2> noise_points(count);
+    for (int k = 0; k < count; ++k)
+        noise_points[k] = {positions[k].x / terrain_length + 0.5f, positions[k].y / terrain_length + 0.5f};
+    noise_perlin_batch(noise_points.data(), heights, count, parameters.octave, parameters.persistency, parameters.frequency_gain);
+
+    for (int k = 0; k < count; ++k)
+        heights[k] = evaluate_terrain_gaussians(positions[k].x, positions[k].y) + heights[k];
+}
+
+terrain_cache create_terrain_cache(int N, float terrain_length)
+{
+    terrain_cache cache;
+    cache.N = N;
+    cache.terrain_length = terrain_length;
+    cache.tiles_per_side = (N + TERRAIN_TILE_SIZE - 1) / TERRAIN_TILE_SIZE;
+
+    // exp(-|p - c|^2 / sigma^2) = exp(-(x - cx)^2 / sigma^2) * exp(-(y - cy)^2 / sigma^2) : one factor per row and per column
+    cache.gaussian_x.resize(TERRAIN_HILL_COUNT * N);
+    cache.gaussian_y.resize(TERRAIN_HILL_COUNT * N);
+    for (int i = 0; i < TERRAIN_HILL_COUNT; ++i)
+    {
+        for (int k = 0; k < N; ++k)
+        {
+            float const coordinate = (k / (N - 1.0f) - 0.5f) * terrain_length;
+            float const dx = (coordinate - TERRAIN_HILL_CENTERS[i].x) / TERRAIN_HILL_SIGMAS[i];
+            float const dy = (coordinate - TERRAIN_HILL_CENTERS[i].y) / TERRAIN_HILL_SIGMAS[i];
+            cache.gaussian_x[i * N + k] = TERRAIN_HILL_HEIGHTS[i] * std::exp(-dx * dx);
+            cache.gaussian_y[i * N + k] = std::exp(-dy * dy);
+        }
+    }
+
+    cache.noise.assign(N * N, 0.0f);
+    cache.edits.assign(N * N, 0.0f);
+    cache.dirty_tiles.assign(cache.tiles_per_side * cache.tiles_per_side, 0);
+    return cache;
+}
+
+// Height of the vertex (ku, kv) from the cached terms
+static float cached_terrain_height(terrain_cache const &cache, int ku, int kv)
+{
+    int const N = cache.N;
+    float z = 0;
+    for (int i = 0; i < TERRAIN_HILL_COUNT; ++i)
+        z += cache.gaussian_x[i * N + ku] * cache.gaussian_y[i * N + kv];
+
+    return z + cache.noise[kv + N * ku] + cache.edits[kv + N * ku];
+}
+
+// Noise of the rows [ku_begin, ku_end[, batched per row
+static void compute_terrain_noise(terrain_cache &cache, perlin_noise_parameters const &parameters, int ku_begin, int ku_end)
+{
+    int const N = cache.N;
+    std::vector<vec2> noise_points(N);
+    for (int ku = ku_begin; ku < ku_end; ++ku)
+    {
+        for (int kv = 0; kv < N; ++kv)
+            noise_points[kv] = {ku / (N - 1.0f), kv / (N - 1.0f)};
+        noise_perlin_batch(noise_points.data(), &cache.noise[N * ku], N, parameters.octave, parameters.persistency, parameters.frequency_gain);
+    }
+}
+
+// Normals of the vertices in [ku_begin, ku_end[ x [kv_begin, kv_end[, from the height differences of the grid
+static void compute_terrain_normals(mesh &terrain, int N, int ku_begin, int ku_end, int kv_begin, int kv_end)
+{
+    for (int ku = ku_begin; ku < ku_end; ++ku)
+    {
+        int const u0 = std::max(ku - 1, 0);
+        int const u1 = std::min(ku + 1, N - 1);
+        for (int kv = kv_begin; kv < kv_end; ++kv)
+        {
+            int const v0 = std::max(kv - 1, 0);
+            int const v1 = std::min(kv + 1, N - 1);
+
+            vec3 const du = terrain.position[kv + N * u1] - terrain.position[kv + N * u0];
+            vec3 const dv = terrain.position[v1 + N * ku] - terrain.position[v0 + N * ku];
+            terrain.normal[kv + N * ku] = normalize(cross(du, dv));
+        }
+    }
+}
+
+// Recompute the noise, heights and normals of the whole grid, row blocks in parallel
+static void compute_terrain(mesh &terrain, terrain_cache &cache, perlin_noise_parameters const &parameters)
+{
+    int const N = cache.N;
+    global_job_system.parallelFor(
+        N, [&](int begin, int end)
+        {
+            compute_terrain_noise(cache, parameters, begin, end);
+            for (int ku = begin; ku < end; ++ku)
+            {
+                for (int kv = 0; kv < N; ++kv)
+                    terrain.position[kv + N * ku].z = cached_terrain_height(cache, ku, kv);
+            } },
+        TERRAIN_ROWS_PER_JOB);
+
+    // The normals read the neighbor rows : after all the heights
+    global_job_system.parallelFor(
+        N, [&](int begin, int end)
+        { compute_terrain_normals(terrain, N, begin, end, 0, N); },
+        TERRAIN_ROWS_PER_JOB);
+
+    std::fill(cache.dirty_tiles.begin(), cache.dirty_tiles.end(), 0);
 }
 
 mesh create_terrain_mesh(int N, float terrain_length, perlin_noise_parameters const &parameters)
 {
+    terrain_cache cache = create_terrain_cache(N, terrain_length);
+    return create_terrain_mesh(cache, parameters);
+}
+
+mesh create_terrain_mesh(terrain_cache &cache, perlin_noise_parameters const &parameters)
+{
+    int const N = cache.N;
+    float const terrain_length = cache.terrain_length;
 
     mesh terrain; // temporary terrain storage (CPU only)
 
     terrain.uv.resize(N * N); // Application d'une texture
     terrain.position.resize(N * N);
+    terrain.normal.resize(N * N);
 
     // Fill terrain geometry
     for (int ku = 0; ku < N; ++ku)
@@ -66,22 +188,19 @@ mesh create_terrain_mesh(int N, float terrain_length, perlin_noise_parameters co
             float v = kv / (N - 1.0f);
 
             // Compute the real coordinates (x,y) of the terrain in [-terrain_length/2, +terrain_length/2]
-            float x = (u - 0.5f) * terrain_length;
-            float y = (v - 0.5f) * terrain_length;
-
-            // Compute the surface height function at the given sampled coordinate
-            float z = evaluate_terrain_height(x, y, parameters, terrain_length);
-
-            // Store vertex coordinates + add perlin noise
-            terrain.position[kv + N * ku] = {x, y, z};
+            terrain.position[kv + N * ku] = {(u - 0.5f) * terrain_length, (v - 0.5f) * terrain_length, 0};
 
             // Store uv coordinates
             terrain.uv[kv + N * ku] = {u * 10, v * 10};
         }
     }
 
+    // Compute the surface height function and the normals
+    compute_terrain(terrain, cache, parameters);
+
     // Generate triangle organization
     //  Parametric surface with uniform grid sampling: generate 2 triangles for each grid cell
+    terrain.connectivity.resize(2 * (N - 1) * (N - 1));
     for (int ku = 0; ku < N - 1; ++ku)
     {
         for (int kv = 0; kv < N - 1; ++kv)
@@ -91,80 +210,217 @@ mesh create_terrain_mesh(int N, float terrain_length, perlin_noise_parameters co
             uint3 triangle_1 = {idx, idx + 1 + N, idx + 1};
             uint3 triangle_2 = {idx, idx + N, idx + 1 + N};
 
-            terrain.connectivity.push_back(triangle_1);
-            terrain.connectivity.push_back(triangle_2);
+            terrain.connectivity[2 * (kv + (N - 1) * ku)] = triangle_1;
+            terrain.connectivity[2 * (kv + (N - 1) * ku) + 1] = triangle_2;
         }
     }
 
-    // need to call this function to fill the other buffer with default values (normal, color, etc)
+    // need to call this function to fill the other buffer with default values (color, etc)
     terrain.fill_empty_field();
 
     return terrain;
 }
 
 // Crée des positions sur le terrain
-std::vector<cgp::vec3> generate_positions_on_terrain(int N, float terrain_length, perlin_noise_parameters const &parameters)
+// Deterministic value in [0, 1[ for the k-th object
+static float scatter_random(uint32_t seed, uint32_t k)
 {
-    std::vector<cgp::vec3> positions;
-    bool clip = true;
-    float x, y, z;
+    uint32_t h = seed ^ (k * 0x9E3779B9u);
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return (h >> 8) * (1.0f / 16777216.0f);
+}
 
-    for (int i = 0; i < N; ++i)
-    {
-        clip = true;
-        while (clip)
+std::vector<cgp::vec3> scatter_on_terrain(float min_distance, float terrain_length, perlin_noise_parameters const &parameters, terrain_density const &density, uint32_t seed)
+{
+    std::vector<vec2> const samples = poisson_disk_sampling({-terrain_length / 2, -terrain_length / 2}, {terrain_length / 2, terrain_length / 2}, min_distance, seed);
+    int const count = samples.size();
+
+    // Heights, and the slope from central differences, by blocks of samples in parallel
+    float const e = 0.01f * min_distance;
+    std::vector<float> heights(count);
+    std::vector<float> slopes(density ? count : 0);
+    global_job_system.parallelFor(count, [&](int begin, int end)
+                                  {
+        evaluate_terrain_heights(samples.data() + begin, heights.data() + begin, end - begin, parameters, terrain_length);
+        if (!density)
+            return;
+
+        std::vector<vec2> around(4 * (end - begin));
+        std::vector<float> around_heights(around.size());
+        for (int k = begin; k < end; ++k)
         {
-            // Generate random coordinates
-            x = (rand_interval() - 0.5) * terrain_length;
-            y = (rand_interval() - 0.5) * terrain_length;
-            z = evaluate_terrain_height(x, y, parameters, terrain_length) + TERRAIN_OFFSET;
-
-            // Check for clipping with other trees
-            clip = false;
-            for (int j = 0; j < positions.size(); ++j)
-            {
-                if (norm(positions[j] - vec3{x, y, z}) < CLIPPING_DISTANCE)
-                {
-                    clip = true;
-                }
-            }
+            int const a = 4 * (k - begin);
+            around[a + 0] = {samples[k].x + e, samples[k].y};
+            around[a + 1] = {samples[k].x - e, samples[k].y};
+            around[a + 2] = {samples[k].x, samples[k].y + e};
+            around[a + 3] = {samples[k].x, samples[k].y - e};
         }
+        evaluate_terrain_heights(around.data(), around_heights.data(), around.size(), parameters, terrain_length);
 
-        positions.push_back(vec3{x, y, z});
+        for (int k = begin; k < end; ++k)
+        {
+            int const a = 4 * (k - begin);
+            float const dx = (around_heights[a + 0] - around_heights[a + 1]) / (2 * e);
+            float const dy = (around_heights[a + 2] - around_heights[a + 3]) / (2 * e);
+            slopes[k] = std::sqrt(dx * dx + dy * dy);
+        } }, TERRAIN_SCATTER_PER_JOB);
+
+    std::vector<cgp::vec3> positions;
+    positions.reserve(count);
+    for (int k = 0; k < count; ++k)
+    {
+        if (density && scatter_random(seed, k) >= density(heights[k], slopes[k]))
+            continue;
+        positions.push_back({samples[k].x, samples[k].y, heights[k] + (float)TERRAIN_OFFSET});
     }
     return positions;
 }
 
+std::vector<cgp::vec3> generate_positions_on_terrain(int N, float terrain_length, perlin_noise_parameters const &parameters)
+{
+    // The Poisson disk fills the whole terrain : keep N of them, taken at random so that they are spread everywhere
+    uint32_t const seed = (uint32_t)(rand_interval() * 0xFFFFFF);
+    std::vector<cgp::vec3> positions = scatter_on_terrain(CLIPPING_DISTANCE, terrain_length, parameters, nullptr, seed);
+
+    int const kept = std::min(N, (int)positions.size());
+    for (int k = 0; k < kept; ++k)
+        std::swap(positions[k], positions[k + (int)(scatter_random(seed + 1, k) * (positions.size() - k))]);
+    positions.resize(kept);
+    return positions;
+}
+
 void update_terrain(mesh &terrain, mesh_drawable &terrain_visual, perlin_noise_parameters const &parameters, float terrain_length)
 {
     // Number of samples in each direction (assuming a square grid)
     int const N = std::sqrt(terrain.position.size());
 
-    // Recompute the new vertices
-    for (int ku = 0; ku < N; ++ku)
+    terrain_cache cache = create_terrain_cache(N, terrain_length);
+    update_terrain(terrain, terrain_visual, cache, parameters);
+}
+
+void update_terrain(mesh &terrain, mesh_drawable &terrain_visual, terrain_cache &cache, perlin_noise_parameters const &parameters)
+{
+    // Recompute the new vertices and normals
+    compute_terrain(terrain, cache, parameters);
+
+    // Update step: Allows to update a mesh_drawable without creating a new one
+    terrain_visual.vbo_position.update(terrain.position);
+    terrain_visual.vbo_normal.update(terrain.normal);
+}
+
+void edit_terrain(terrain_cache &cache, float x, float y, float radius, float height)
+{
+    int const N = cache.N;
+    float const step = cache.terrain_length / (N - 1);
+
+    // Vertices under the brush
+    int const ku_begin = std::max(0, (int)std::floor((x - radius) / step + (N - 1) * 0.5f));
+    int const ku_end = std::min(N, (int)std::ceil((x + radius) / step + (N - 1) * 0.5f) + 1);
+    int const kv_begin = std::max(0, (int)std::floor((y - radius) / step + (N - 1) * 0.5f));
+    int const kv_end = std::min(N, (int)std::ceil((y + radius) / step + (N - 1) * 0.5f) + 1);
+    if (ku_begin >= ku_end || kv_begin >= kv_end)
+        return;
+
+    for (int ku = ku_begin; ku < ku_end; ++ku)
     {
-        for (int kv = 0; kv < N; ++kv)
+        for (int kv = kv_begin; kv < kv_end; ++kv)
         {
+            vec2 const d = vec2((ku / (N - 1.0f) - 0.5f) * cache.terrain_length - x, (kv / (N - 1.0f) - 0.5f) * cache.terrain_length - y) / radius;
+            float const falloff = 1 - dot(d, d); // Smooth bump : (1 - d^2)^2
+            if (falloff > 0)
+                cache.edits[kv + N * ku] += height * falloff * falloff;
+        }
+    }
 
-            // Compute local parametric coordinates (u,v) \in [0,1]
-            const float u = ku / (N - 1.0f);
-            const float v = kv / (N - 1.0f);
+    for (int tu = ku_begin / TERRAIN_TILE_SIZE; tu <= (ku_end - 1) / TERRAIN_TILE_SIZE; ++tu)
+    {
+        for (int tv = kv_begin / TERRAIN_TILE_SIZE; tv <= (kv_end - 1) / TERRAIN_TILE_SIZE; ++tv)
+            cache.dirty_tiles[tv + cache.tiles_per_side * tu] = 1;
+    }
+}
 
-            int const idx = ku * N + kv;
+int update_terrain_dirty(mesh &terrain, mesh_drawable &terrain_visual, terrain_cache &cache)
+{
+    int const N = cache.N;
+    int const T = TERRAIN_TILE_SIZE;
 
-            // Update height with noise
-            float x = (u - 0.5f) * terrain_length;
-            float y = (v - 0.5f) * terrain_length;
+    std::vector<int> dirty;
+    for (int tile = 0; tile < (int)cache.dirty_tiles.size(); ++tile)
+    {
+        if (cache.dirty_tiles[tile])
+            dirty.push_back(tile);
+    }
+    if (dirty.empty())
+        return 0;
 
-            terrain.position[idx].z = evaluate_terrain_height(x, y, parameters, terrain_length);
+    // Heights of the dirty tiles (the noise is unchanged)
+    global_job_system.parallelFor(
+        dirty.size(), [&](int begin, int end)
+        {
+            for (int k = begin; k < end; ++k)
+            {
+                int const tu = dirty[k] / cache.tiles_per_side;
+                int const tv = dirty[k] % cache.tiles_per_side;
+                for (int ku = tu * T; ku < std::min(N, (tu + 1) * T); ++ku)
+                {
+                    for (int kv = tv * T; kv < std::min(N, (tv + 1) * T); ++kv)
+                        terrain.position[kv + N * ku].z = cached_terrain_height(cache, ku, kv);
+                }
+            } });
+
+    // Normals change one vertex around the tiles : columns to recompute in each row
+    std::vector<int> column_begin(N, N), column_end(N, 0);
+    for (int tile : dirty)
+    {
+        int const tu = tile / cache.tiles_per_side;
+        int const tv = tile % cache.tiles_per_side;
+        for (int ku = std::max(0, tu * T - 1); ku < std::min(N, (tu + 1) * T + 1); ++ku)
+        {
+            column_begin[ku] = std::min(column_begin[ku], std::max(0, tv * T - 1));
+            column_end[ku] = std::max(column_end[ku], std::min(N, (tv + 1) * T + 1));
         }
+        cache.dirty_tiles[tile] = 0;
     }
 
-    // Update the normal of the mesh structure
-    terrain.normal_update();
+    global_job_system.parallelFor(
+        N, [&](int begin, int end)
+        {
+            for (int ku = begin; ku < end; ++ku)
+            {
+                if (column_begin[ku] < column_end[ku])
+                    compute_terrain_normals(terrain, N, ku, ku + 1, column_begin[ku], column_end[ku]);
+            } },
+        TERRAIN_ROWS_PER_JOB);
+
+    // Upload the runs of changed rows only
+    int ku = 0;
+    while (ku < N)
+    {
+        if (column_begin[ku] >= column_end[ku])
+        {
+            ++ku;
+            continue;
+        }
 
-    // Update step: Allows to update a mesh_drawable without creating a new one
-    terrain_visual.vbo_position.update(terrain.position);
-    terrain_visual.vbo_normal.update(terrain.normal);
-    terrain_visual.vbo_color.update(terrain.color);
+        int run_end = ku + 1;
+        while (run_end < N && column_begin[run_end] < column_end[run_end])
+            ++run_end;
+
+        // First changed vertex of the first row to the last changed vertex of the last row
+        GLintptr const first = column_begin[ku] + N * ku;
+        GLsizeiptr const count = column_end[run_end - 1] + N * (run_end - 1) - first;
+        glBindBuffer(GL_ARRAY_BUFFER, terrain_visual.vbo_position.id);
+        glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(vec3), count * sizeof(vec3), &terrain.position[first]);
+        glBindBuffer(GL_ARRAY_BUFFER, terrain_visual.vbo_normal.id);
+        glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(vec3), count * sizeof(vec3), &terrain.normal[first]);
+
+        ku = run_end;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    return dirty.size();
 }
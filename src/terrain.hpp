@@ -2,6 +2,30 @@
 
 #include "cgp/graphics/drawable/mesh_drawable/mesh_drawable.hpp"
 #include "utils/noise/perlin.hpp" // for noise perlin parameters
+#include <functional>
+#include <vector>
+
+constexpr int TERRAIN_TILE_SIZE = 64; // Vertices per side of the tiles recomputed by the incremental updates
+
+/**
+ * Precomputed data of a terrain grid, for the parallel and incremental updates.
+ * The gaussian hills are separable on the grid : one factor per row and per column replaces the exponentials
+ * of every vertex. The noise is kept, so an edit only recomputes the heights and normals of the tiles it touches.
+ */
+struct terrain_cache
+{
+    int N = 0;
+    float terrain_length = 0;
+    int tiles_per_side = 0;
+
+    std::vector<float> gaussian_x; // [hill * N + ku] : height * exp(-(x - cx)^2 / sigma^2)
+    std::vector<float> gaussian_y; // [hill * N + kv] : exp(-(y - cy)^2 / sigma^2)
+    std::vector<float> noise;      // Perlin height of each vertex
+    std::vector<float> edits;      // Height added by edit_terrain to each vertex
+    std::vector<unsigned char> dirty_tiles;
+};
+
+terrain_cache create_terrain_cache(int N, float terrain_length);
 
 // struct perlin_noise_parameters
 // {
@@ -13,15 +37,34 @@
 
 float evaluate_terrain_height(float x, float y, perlin_noise_parameters const &parameters, float terrain_length);
 
+// Batched version of evaluate_terrain_height : heights[k] is the height at positions[k]
+void evaluate_terrain_heights(cgp::vec2 const *positions, float *heights, int count, perlin_noise_parameters const &parameters, float terrain_length);
+
 /** Compute a terrain mesh
     The (x,y) coordinates of the terrain are set in [-length/2, length/2].
     The z coordinates of the vertices are computed using evaluate_terrain_height(x,y).
     The vertices are sampled along a regular grid structure in (x,y) directions.
     The total number of vertices is N*N (N along each direction x/y) 	*/
 cgp::mesh create_terrain_mesh(int N, float length, perlin_noise_parameters const &parameters);
+cgp::mesh create_terrain_mesh(terrain_cache &cache, perlin_noise_parameters const &parameters);
 
+// Probability in [0, 1] to keep an object, from the terrain height and slope (tangent of the angle) under it
+using terrain_density = std::function<float(float height, float slope)>;
+
+// Objects on the terrain, at least min_distance apart (Poisson disk), thinned by the density if any.
+// The result only depends on the seed
+std::vector<cgp::vec3> scatter_on_terrain(float min_distance, float terrain_length, perlin_noise_parameters const &parameters, terrain_density const &density = nullptr, uint32_t seed = 0);
+
+// At most N objects on the terrain, apart from each other (fewer if the terrain is too small)
 std::vector<cgp::vec3> generate_positions_on_terrain(int N, float terrain_length, perlin_noise_parameters const &parameters);
 
 // Recompute the vertices of the terrain everytime a parameter is modified
 //  and update the mesh_drawable accordingly
 void update_terrain(cgp::mesh &terrain, cgp::mesh_drawable &terrain_visual, perlin_noise_parameters const &parameters, float terrain_length);
+void update_terrain(cgp::mesh &terrain, cgp::mesh_drawable &terrain_visual, terrain_cache &cache, perlin_noise_parameters const &parameters);
+
+// Add a smooth bump (or hole, for a negative height) of the given radius at (x,y), and mark the tiles it touches
+void edit_terrain(terrain_cache &cache, float x, float y, float radius, float height);
+
+// Recompute the dirty tiles and their normals, and upload the changed rows only. Returns the number of tiles updated
+int update_terrain_dirty(cgp::mesh &terrain, cgp::mesh_drawable &terrain_visual, terrain_cache &cache);
@@ -34,6 +34,7 @@ public:
         key_states[KEY_W] = KEY_RELEASED;
         key_states[KEY_E] = KEY_RELEASED;
         key_states[KEY_SPACE] = KEY_RELEASED;
+        key_states[KEY_R] = KEY_RELEASED;
         key_states[KEY_ARROW_UP] = KEY_RELEASED;
         key_states[KEY_ARROW_DOWN] = KEY_RELEASED;
         key_states[KEY_ARROW_LEFT] = KEY_RELEASED;
@@ -78,12 +79,16 @@ public:
     // Handle player actions based on current pressed keys
     void handlePlayerKeys();
 
+    // True while the fire key (R) is held
+    bool isFiring() { return key_states[KEY_R] == KEY_PRESSED || key_states[KEY_R] == KEY_REPEAT; };
+
     // Update the player object (simulate one step)
     void updatePlayer();
     void updateShip(); // Update the spaceship position according to the player object
 
     // For display and initialization
     Navion &getPlayerShip();
+    PlayerObject const &getPlayer() const { return player; };
     void initialize_sub_meshes();
 
     // For drawing
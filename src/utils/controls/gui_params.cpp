@@ -8,4 +8,5 @@ void GUIParams::update_values()
     enable_shield_atomic = enable_shield;
     camera_distance_atomic = camera_distance;
     trigger_laser_atomic = trigger_laser;
+    fleet_size_atomic = fleet_size;
 }
\ No newline at end of file
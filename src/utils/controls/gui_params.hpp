@@ -5,7 +5,7 @@
 // Class to manage global GUI params that can be accessed anywhere in a thread safe way
 struct GUIParams
 {
-    GUIParams() : display_ship(true), enable_shield(true), camera_distance(10), trigger_laser(0){};
+    GUIParams() : display_ship(true), enable_shield(true), camera_distance(10), trigger_laser(0), fleet_size(100){};
 
     // Update function
     void update_values();
@@ -15,12 +15,14 @@ struct GUIParams
     bool enable_shield;
     float camera_distance;
     bool trigger_laser;
+    int fleet_size;
 
     // Thread safe values
     std::atomic<bool> display_ship_atomic;
     std::atomic<bool> enable_shield_atomic;
     std::atomic<float> camera_distance_atomic;
     std::atomic<bool> trigger_laser_atomic;
+    std::atomic<int> fleet_size_atomic;
 };
 
 extern GUIParams global_gui_params;
@@ -172,4 +172,9 @@ cgp::vec3 PlayerObject::get_position() const
 cgp::vec3 PlayerObject::get_direction() const
 {
     return direction;
+}
+
+cgp::vec3 PlayerObject::get_velocity() const
+{
+    return velocity;
 }
\ No newline at end of file
@@ -144,6 +144,7 @@ public:
     cgp::rotation_transform orientation() const;
     cgp::vec3 get_position() const;
     cgp::vec3 get_direction() const;
+    cgp::vec3 get_velocity() const; // Physics distance per simulation second
 
 private:
     cgp::vec3 position;     // Display position, not the physics one
@@ -0,0 +1,240 @@
+#include "baked_hierarchy.hpp"
+#include "cgp/geometry/shape/mesh/optimization/mesh_optimization.hpp"
+#include <algorithm>
+#include <iostream>
+
+// Copy one vertex attribute back to the CPU (tightly packed or interleaved VBO)
+static void readBackAttribute(cgp::opengl_vbo_structure const &vbo, float *output)
+{
+    int const components = vbo.details.size_element;
+    glBindBuffer(GL_ARRAY_BUFFER, vbo.id);
+    if (vbo.details.stride == 0)
+    {
+        glGetBufferSubData(GL_ARRAY_BUFFER, 0, vbo.size * components * sizeof(float), output);
+    }
+    else
+    {
+        std::vector<float> vertices(vbo.details.size_byte / sizeof(float));
+        glGetBufferSubData(GL_ARRAY_BUFFER, 0, vbo.details.size_byte, vertices.data());
+
+        int const stride = vbo.details.stride / sizeof(float);
+        int const offset = vbo.details.offset / sizeof(float);
+        for (GLuint k = 0; k < vbo.size; k++)
+            std::copy_n(&vertices[k * stride + offset], components, output + k * components);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Copy the vertex and index buffers of a mesh_drawable back to the CPU
+static cgp::mesh readBackMesh(cgp::mesh_drawable const &drawable)
+{
+    cgp::mesh m;
+    m.position.resize(drawable.vbo_position.size);
+    m.normal.resize(drawable.vbo_normal.size);
+    m.color.resize(drawable.vbo_color.size);
+    m.uv.resize(drawable.vbo_uv.size);
+    m.connectivity.resize(drawable.ebo_connectivity.size);
+
+    readBackAttribute(drawable.vbo_position, &m.position.data.data()->x);
+    readBackAttribute(drawable.vbo_normal, &m.normal.data.data()->x);
+    readBackAttribute(drawable.vbo_color, &m.color.data.data()->x);
+    readBackAttribute(drawable.vbo_uv, &m.uv.data.data()->x);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, drawable.ebo_connectivity.id);
+    if (drawable.ebo_connectivity.details.type_element == GL_UNSIGNED_SHORT)
+    {
+        std::vector<GLushort> indices(3 * m.connectivity.size());
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, indices.size() * sizeof(GLushort), indices.data());
+        for (size_t k = 0; k < m.connectivity.size(); k++)
+            m.connectivity.data[k] = {indices[3 * k], indices[3 * k + 1], indices[3 * k + 2]};
+    }
+    else
+    {
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, m.connectivity.size() * sizeof(cgp::uint3), m.connectivity.data.data());
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    opengl_check;
+
+    return m;
+}
+
+// Two nodes can share a merged mesh if everything but the material color is identical
+static bool canMerge(cgp::mesh_drawable const &a, cgp::mesh_drawable const &b)
+{
+    cgp::material_mesh_drawable_phong const &ma = a.material;
+    cgp::material_mesh_drawable_phong const &mb = b.material;
+
+    return a.shader.id == b.shader.id && a.texture.id == b.texture.id &&
+           a.supplementary_texture.empty() && b.supplementary_texture.empty() &&
+           ma.alpha == mb.alpha &&
+           ma.phong.ambient == mb.phong.ambient && ma.phong.diffuse == mb.phong.diffuse &&
+           ma.phong.specular == mb.phong.specular && ma.phong.specular_exponent == mb.phong.specular_exponent &&
+           ma.texture_settings.active == mb.texture_settings.active &&
+           ma.texture_settings.inverse_v == mb.texture_settings.inverse_v &&
+           ma.texture_settings.two_sided == mb.texture_settings.two_sided;
+}
+
+void BakedHierarchy::bake(cgp::hierarchy_mesh_drawable const &hierarchy, std::vector<std::string> const &animated_nodes)
+{
+    clear();
+
+    int const N = hierarchy.elements.size();
+    source_node_count = N;
+
+    std::vector<int> bone_of(N);                // Bone carrying each node
+    std::vector<cgp::affine_rts> relative(N);   // Node transform relatively to its bone
+    std::vector<cgp::mesh> merged_meshes;       // One per batch
+    std::vector<cgp::mesh_drawable const *> batch_sources;
+
+    for (int k = 0; k < N; k++)
+    {
+        cgp::hierarchy_mesh_drawable_node const &node = hierarchy.elements[k];
+
+        auto parent_it = hierarchy.name_map.find(node.name_parent);
+        int parent = parent_it == hierarchy.name_map.end() ? -1 : parent_it->second;
+        bool is_animated = std::find(animated_nodes.begin(), animated_nodes.end(), node.name) != animated_nodes.end();
+
+        // Geometry transform of this node relatively to its bone
+        cgp::mat4 geometry_transform;
+        if (parent == -1 || is_animated)
+        {
+            BakedBone bone;
+            bone.name = node.name;
+            bone.parent = parent == -1 ? -1 : bone_of[parent];
+            bone.offset = parent == -1 ? cgp::affine_rts() : relative[parent];
+            bone.transform_local = node.transform_local;
+            bones.push_back(bone);
+
+            bone_of[k] = bones.size() - 1;
+            relative[k] = cgp::affine_rts();
+            geometry_transform = node.drawable.model.matrix();
+        }
+        else
+        {
+            bone_of[k] = bone_of[parent];
+            relative[k] = relative[parent] * node.transform_local;
+            geometry_transform = relative[k].matrix() * node.drawable.model.matrix();
+        }
+
+        sockets.push_back({node.name, bone_of[k], relative[k]});
+
+        if (node.drawable.vbo_position.size == 0 || node.drawable.ebo_connectivity.size == 0)
+            continue;
+
+        // Bake the transform and the material color in the vertices
+        cgp::mesh m = readBackMesh(node.drawable);
+        cgp::mat3 const normal_transform = cgp::transpose(cgp::inverse(geometry_transform.get_linear()));
+        for (auto &p : m.position)
+            p = (geometry_transform * cgp::vec4(p, 1.0f)).xyz();
+        for (auto &n : m.normal)
+            n = cgp::normalize(normal_transform * n);
+        for (auto &c : m.color)
+            c = c * node.drawable.material.color;
+
+        // Find a batch on the same bone with the same render state
+        int batch = -1;
+        for (int b = 0; b < (int)batches.size(); b++)
+        {
+            if (batches[b].bone == bone_of[k] && canMerge(*batch_sources[b], node.drawable))
+            {
+                batch = b;
+                break;
+            }
+        }
+        if (batch == -1)
+        {
+            batches.push_back({bone_of[k], 0, cgp::mesh_drawable()});
+            batch_sources.push_back(&node.drawable);
+            merged_meshes.push_back(cgp::mesh());
+            batch = batches.size() - 1;
+        }
+
+        merged_meshes[batch].push_back(m);
+        batches[batch].source_node_count++;
+    }
+
+    // Send the merged meshes to the GPU
+    for (int b = 0; b < (int)batches.size(); b++)
+    {
+        cgp::mesh_drawable const &source = *batch_sources[b];
+        cgp::mesh_drawable &drawable = batches[b].drawable;
+
+        cgp::mesh_optimize(merged_meshes[b]);
+        drawable.interleaved = true; // Static ship parts : one vertex stream
+        drawable.initialize_data_on_gpu(merged_meshes[b], source.shader, source.texture);
+        drawable.supplementary_texture = source.supplementary_texture;
+        drawable.material = source.material;
+        drawable.material.color = {1, 1, 1}; // Already in the vertex colors
+    }
+
+    update();
+}
+
+void BakedHierarchy::clear()
+{
+    // The textures are shared with the source hierarchy, mesh_drawable::clear only frees the buffers
+    for (auto &batch : batches)
+    {
+        batch.drawable.clear();
+    }
+    batches.clear();
+    bones.clear();
+    sockets.clear();
+    source_node_count = 0;
+}
+
+int BakedHierarchy::getHandle(std::string const &name) const
+{
+    for (int i = 0; i < (int)bones.size(); i++)
+    {
+        if (bones[i].name == name)
+            return i;
+    }
+
+    std::cerr << "Error: [" << name << "] is not a root or an animated node of the baked hierarchy" << std::endl;
+    abort();
+}
+
+int BakedHierarchy::getSocket(std::string const &name) const
+{
+    for (int i = 0; i < (int)sockets.size(); i++)
+    {
+        if (sockets[i].name == name)
+            return i;
+    }
+
+    std::cerr << "Error: [" << name << "] is not a node of the baked hierarchy" << std::endl;
+    abort();
+}
+
+void BakedHierarchy::update()
+{
+    for (auto &bone : bones)
+    {
+        if (bone.parent == -1)
+            bone.transform_global = bone.transform_local;
+        else
+            bone.transform_global = bones[bone.parent].transform_global * bone.offset * bone.transform_local;
+    }
+
+    for (auto &batch : batches)
+    {
+        batch.drawable.hierarchy_transform_model = bones[batch.bone].transform_global;
+    }
+}
+
+void BakedHierarchy::draw(environment_structure const &environment) const
+{
+    for (auto const &batch : batches)
+    {
+        cgp::draw(batch.drawable, environment);
+    }
+}
+
+void BakedHierarchy::record(CommandList &list) const
+{
+    for (auto const &batch : batches)
+    {
+        list.submit(batch.drawable);
+    }
+}
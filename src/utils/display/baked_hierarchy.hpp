@@ -0,0 +1,79 @@
+#pragma once
+
+#include "cgp/graphics/drawable/hierarchy_mesh_drawable/hierarchy_mesh_drawable.hpp"
+#include "environment.hpp"
+#include "utils/opengl/command_list.hpp"
+#include <string>
+#include <vector>
+
+// Moving node of a baked hierarchy. Static children are merged into the bone meshes
+struct BakedBone
+{
+    std::string name;
+    int parent;                       // Parent bone index, -1 for a root
+    cgp::affine_rts offset;           // Static transforms between the parent bone and this one
+    cgp::affine_rts transform_local;  // Animated transform (same meaning as hierarchy_mesh_drawable_node::transform_local)
+    cgp::affine_rts transform_global; // Computed by update()
+};
+
+// Node of the source hierarchy, kept after the merge to attach effects (engine exhaust...) to it
+struct BakedSocket
+{
+    std::string name;
+    int bone;                 // Bone carrying the node
+    cgp::affine_rts relative; // Node frame relatively to its bone
+};
+
+// One merged mesh : all the static nodes of a bone sharing the same shader, texture and phong parameters
+struct BakedBatch
+{
+    int bone;
+    int source_node_count;
+    cgp::mesh_drawable drawable;
+};
+
+/**
+ * Static version of a cgp::hierarchy_mesh_drawable.
+ * The nodes that never move relatively to their parent are merged in a few meshes (the material color is baked
+ * in the vertex colors), so the hierarchy is drawn with a handful of draw calls instead of one per node.
+ * Only the roots and the nodes listed as animated remain as bones, accessed by index handles.
+ */
+class BakedHierarchy
+{
+public:
+    // Merge the hierarchy. The source meshes are read back from the GPU, the source hierarchy is left untouched
+    void bake(cgp::hierarchy_mesh_drawable const &hierarchy, std::vector<std::string> const &animated_nodes = {});
+
+    // Free the merged meshes
+    void clear();
+
+    // Index of a bone (root or animated node). Aborts if the name is not a bone
+    int getHandle(std::string const &name) const;
+
+    // Index of a node of the source hierarchy (merged or not). Aborts if the name is unknown
+    int getSocket(std::string const &name) const;
+
+    // World frame of a socket, valid after update()
+    cgp::affine_rts socketTransform(int socket) const { return bones[sockets[socket].bone].transform_global * sockets[socket].relative; };
+
+    // Animated local transform of a bone
+    cgp::affine_rts &operator[](int handle) { return bones[handle].transform_local; };
+    cgp::affine_rts const &operator[](int handle) const { return bones[handle].transform_local; };
+
+    // Propagate the bone transforms. Must be called after modifying a local transform
+    void update();
+
+    void draw(environment_structure const &environment) const;
+    void record(CommandList &list) const;
+
+    int getDrawCallCount() const { return (int)batches.size(); };
+    std::vector<BakedBone> const &getBones() const { return bones; };
+    std::vector<BakedBatch> const &getBatches() const { return batches; };
+    int getSourceNodeCount() const { return source_node_count; };
+
+private:
+    std::vector<BakedBone> bones; // Parents are always stored before their children
+    std::vector<BakedBatch> batches;
+    std::vector<BakedSocket> sockets; // One per source node
+    int source_node_count = 0;
+};
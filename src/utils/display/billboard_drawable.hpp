@@ -3,6 +3,7 @@
 #include "cgp/geometry/vec/vec3/vec3.hpp"
 #include "environment.hpp"
 #include "utils/display/base_drawable.hpp"
+#include "utils/opengl/transparent_pass.hpp"
 
 /**
  * Abstract base drawable class for billboards
@@ -18,4 +19,8 @@ public:
 
     // Draw function
     virtual void drawBillboards(environment_structure const &environment, cgp::vec3 &position, cgp::rotation_transform &rotation, bool show_wireframe = true) = 0;
+
+    // Submit the billboard instances to the sorted transparent pass instead of drawing them.
+    // Returns false if this billboard does not support it : drawBillboards is then called
+    virtual bool gatherBillboards(TransparentPass &, cgp::vec3 const &, cgp::rotation_transform const &) { return false; };
 };
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include "environment.hpp"
 #include "utils/display/base_drawable.hpp"
+#include "utils/opengl/render_queue.hpp"
 
 /**
  * Abstract base drawable class
@@ -15,9 +16,28 @@ public:
     // Draw function
     virtual void draw(environment_structure const &environment, cgp::vec3 &position, cgp::rotation_transform &rotation, bool show_wireframe = true) = 0;
 
+    // Record the draw commands without calling OpenGL (may run on a worker thread)
+    // Returns false if the object cannot be recorded : draw() is then called on the OpenGL thread
+    virtual bool record(CommandList &, cgp::vec3 const &, cgp::rotation_transform const &) { return false; };
+
     // Setters
     virtual void setPosition(cgp::vec3 position) = 0;
 
+    // If set, opaque meshes are submitted to this queue instead of being drawn immediately
+    void setRenderQueue(RenderQueue *queue) { render_queue = queue; };
+
     // Getters
     virtual cgp::vec3 getPosition() const = 0;
-};
\ No newline at end of file
+
+protected:
+    // Draw a mesh through the render queue if there is one, else directly
+    void drawMesh(cgp::mesh_drawable const &drawable, environment_structure const &environment)
+    {
+        if (render_queue)
+            render_queue->submit(drawable);
+        else
+            cgp::draw(drawable, environment);
+    }
+
+    RenderQueue *render_queue = nullptr;
+};
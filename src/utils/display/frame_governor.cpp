@@ -0,0 +1,99 @@
+#include "frame_governor.hpp"
+#include <algorithm>
+#include <cmath>
+
+FrameGovernor global_frame_governor;
+
+void FrameGovernor::initialize()
+{
+    glGenQueries(GOVERNOR_QUERY_COUNT, queries);
+    opengl_check;
+}
+
+void FrameGovernor::clear()
+{
+    if (queries[0] != 0)
+        glDeleteQueries(GOVERNOR_QUERY_COUNT, queries);
+    std::fill(queries, queries + GOVERNOR_QUERY_COUNT, 0);
+    std::fill(query_pending, query_pending + GOVERNOR_QUERY_COUNT, false);
+}
+
+void FrameGovernor::beginFrame()
+{
+    frame_start = std::chrono::high_resolution_clock::now();
+
+    if (queries[0] == 0)
+        return;
+
+    // The oldest query is reused : read its result if it is ready, else it is dropped (never stall the pipeline)
+    if (query_pending[query_index])
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(queries[query_index], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available)
+        {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(queries[query_index], GL_QUERY_RESULT, &elapsed);
+            gpu_ms = elapsed / 1e6f;
+        }
+    }
+
+    glBeginQuery(GL_TIME_ELAPSED, queries[query_index]);
+}
+
+void FrameGovernor::endFrame()
+{
+    if (queries[0] != 0)
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        query_pending[query_index] = true;
+        query_index = (query_index + 1) % GOVERNOR_QUERY_COUNT;
+    }
+
+    auto const end = std::chrono::high_resolution_clock::now();
+    cpu_ms = std::chrono::duration<float, std::milli>(end - frame_start).count();
+
+    // The slowest of both processors limits the frame rate
+    updateQuality(std::max(cpu_ms, gpu_ms));
+}
+
+void FrameGovernor::updateQuality(float frame_ms)
+{
+    smoothed_ms = smoothed_ms == 0 ? frame_ms : smoothed_ms + settings.smoothing * (frame_ms - smoothed_ms);
+
+    if (!settings.enabled)
+    {
+        quality = 1;
+        return;
+    }
+
+    // Proportional step toward the quality that would hold the target, bounded per frame
+    float const load = smoothed_ms / settings.target_ms;
+    if (load > 1 || load < 1 - settings.dead_band)
+    {
+        float const wanted = quality / std::max(load, 1e-3f);
+        quality += std::clamp(wanted - quality, -settings.max_step, settings.max_step);
+    }
+    quality = std::clamp(quality, std::max(settings.min_quality, 0.0f), 1.0f);
+}
+
+float FrameGovernor::getAsteroidErrorScale() const
+{
+    return 1 + (GOVERNOR_MAX_ERROR_SCALE - 1) * (1 - quality);
+}
+
+float FrameGovernor::getTerrainErrorScale() const
+{
+    return 1 + (GOVERNOR_MAX_TERRAIN_SCALE - 1) * (1 - quality);
+}
+
+float FrameGovernor::getImpostorCutoff() const
+{
+    return GOVERNOR_MAX_IMPOSTOR_CUTOFF * (1 - quality);
+}
+
+int FrameGovernor::getMaxAsteroidInstances() const
+{
+    // Square root : the instance count is the last output to drop
+    return GOVERNOR_MIN_ASTEROID_INSTANCES + (int)(std::sqrt(quality) * (GOVERNOR_MAX_ASTEROID_INSTANCES - GOVERNOR_MIN_ASTEROID_INSTANCES));
+}
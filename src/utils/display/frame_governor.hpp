@@ -0,0 +1,71 @@
+#pragma once
+
+#include "cgp/graphics/opengl/opengl.hpp"
+#include <chrono>
+
+// ************************************************** //
+//                 GOVERNOR CONSTANTS                 //
+// ************************************************** //
+constexpr int GOVERNOR_QUERY_COUNT = 4;                 // GPU timer queries in flight : results are read a few frames late, without stalling
+constexpr float GOVERNOR_MAX_ERROR_SCALE = 6.0f;        // Asteroid pixel error multiplier at the lowest quality
+constexpr float GOVERNOR_MAX_TERRAIN_SCALE = 3.0f;      // Planet terrain pixel error multiplier at the lowest quality
+constexpr float GOVERNOR_MAX_IMPOSTOR_CUTOFF = 3.0f;    // Disk impostors smaller than this (radius in pixels) are skipped at the lowest quality
+constexpr int GOVERNOR_MIN_ASTEROID_INSTANCES = 5000;   // Rendered asteroids per belt at the lowest quality
+constexpr int GOVERNOR_MAX_ASTEROID_INSTANCES = 250000; // Rendered asteroids per belt at full quality
+
+struct FrameGovernorSettings
+{
+    bool enabled = true;
+    float target_ms = 1000.0f / 60; // Frame time to hold
+    float smoothing = 0.1f;         // Weight of the new measure in the moving average
+    float dead_band = 0.15f;        // No change while the load is in [1 - dead_band, 1]
+    float max_step = 0.02f;         // Max quality change per frame
+    float min_quality = 0.0f;       // Lower limit of the quality
+};
+
+/**
+ * Feedback loop on the frame time.
+ * The CPU time of the frame is measured with a clock and the GPU time with timer queries. Their smoothed maximum
+ * drives a quality factor in [min_quality, 1], which sets the asteroid and terrain LOD pixel errors, the size under which far
+ * away impostors are skipped and the max number of rendered asteroids per belt.
+ */
+class FrameGovernor
+{
+public:
+    void initialize(); // Create the timer queries (OpenGL thread)
+    void clear();      // Delete them (OpenGL thread). The GPU time is no longer measured
+
+    // Surround the rendering of a frame (before the buffer swap, which may wait for vsync)
+    void beginFrame();
+    void endFrame();
+
+    // Outputs
+    float getQuality() const { return quality; };
+    float getAsteroidErrorScale() const;
+    float getTerrainErrorScale() const;
+    float getImpostorCutoff() const; // Radius in pixels
+    int getMaxAsteroidInstances() const;
+
+    // Measures
+    float getCpuMs() const { return cpu_ms; };
+    float getGpuMs() const { return gpu_ms; };
+    float getSmoothedMs() const { return smoothed_ms; };
+
+    FrameGovernorSettings settings;
+
+private:
+    void updateQuality(float frame_ms);
+
+    GLuint queries[GOVERNOR_QUERY_COUNT] = {0};
+    bool query_pending[GOVERNOR_QUERY_COUNT] = {false};
+    int query_index = 0;
+
+    std::chrono::high_resolution_clock::time_point frame_start;
+
+    float cpu_ms = 0;
+    float gpu_ms = 0;
+    float smoothed_ms = 0;
+    float quality = 1;
+};
+
+extern FrameGovernor global_frame_governor;
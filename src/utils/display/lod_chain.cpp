@@ -0,0 +1,41 @@
+#include "lod_chain.hpp"
+#include "cgp/geometry/shape/mesh/simplification/mesh_simplification.hpp"
+#include "utils/threads/job_system.hpp"
+#include <algorithm>
+#include <cmath>
+
+// Radius of the sphere around the bounding box center that contains the mesh
+static float bounding_radius(cgp::mesh const &mesh)
+{
+    if (mesh.position.size() == 0)
+        return 0;
+
+    cgp::vec3 p_min, p_max;
+    mesh.get_bounding_box_position(p_min, p_max);
+    cgp::vec3 const center = (p_min + p_max) / 2;
+
+    float radius2 = 0;
+    for (auto const &p : mesh.position)
+        radius2 = std::max(radius2, cgp::dot(p - center, p - center));
+    return std::sqrt(radius2);
+}
+
+std::vector<LodChain> generate_lod_chains(std::vector<cgp::mesh> const &meshes, int level_count, float ratio)
+{
+    std::vector<LodChain> chains(meshes.size());
+    global_job_system.parallelFor(meshes.size(), [&](int begin, int end)
+                                  {
+        for (int k = begin; k < end; k++)
+        {
+            cgp::numarray<float> errors;
+            cgp::numarray<cgp::mesh> const levels = cgp::mesh_lod_chain(meshes[k], level_count, ratio, &errors);
+
+            float const radius = bounding_radius(meshes[k]);
+            for (int level = 0; level < (int)levels.size(); level++)
+            {
+                chains[k].levels.push_back(levels[level]);
+                chains[k].errors.push_back(radius > 0 ? errors[level] / radius : 0);
+            }
+        } });
+    return chains;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "cgp/geometry/shape/mesh/structure/mesh.hpp"
+#include <vector>
+
+// ************************************************** //
+//                 LOD CHAIN CONSTANTS                //
+// ************************************************** //
+constexpr int LOD_CHAIN_DEFAULT_LEVELS = 3;
+constexpr float LOD_CHAIN_DEFAULT_RATIO = 0.25f; // Triangles kept from one level to the next
+
+/**
+ * Levels of detail of a mesh, by quadric simplification (cgp::mesh_lod_chain).
+ * The errors are relative to the bounding radius of the mesh, like the level errors given to the LodManager.
+ */
+struct LodChain
+{
+    std::vector<cgp::mesh> levels; // levels[0] is the source mesh
+    std::vector<float> errors;     // Increasing, errors[0] = 0
+};
+
+// Simplify every mesh, one job per mesh on the job system (loading time)
+std::vector<LodChain> generate_lod_chains(std::vector<cgp::mesh> const &meshes, int level_count = LOD_CHAIN_DEFAULT_LEVELS, float ratio = LOD_CHAIN_DEFAULT_RATIO);
@@ -0,0 +1,48 @@
+#include "lod_manager.hpp"
+#include <algorithm>
+#include <cmath>
+
+LodManager global_lod_manager;
+
+void LodManager::beginFrame(float field_of_view, float viewport_height, float pixel_error, float hysteresis)
+{
+    pixels_per_unit = viewport_height / (2 * std::tan(field_of_view / 2));
+    this->pixel_error = pixel_error;
+    this->hysteresis = hysteresis;
+
+    stats.total = 0;
+    for (int c = 0; c < LOD_CATEGORY_COUNT; c++)
+    {
+        stats.switches[c] = switches[c].exchange(0);
+        stats.total += stats.switches[c];
+    }
+}
+
+float LodManager::projectedSize(float length, float distance) const
+{
+    return length * pixels_per_unit / std::max(distance, 1e-6f);
+}
+
+int LodManager::select(LodCategory category, float radius, float distance, float const *level_errors, int level_count, int current) const
+{
+    float const radius_pixels = projectedSize(radius, distance);
+    float const error = pixel_error * error_scales[category];
+    float const band = hysteresis;
+
+    // Coarsest acceptable level. Coarser than the current one : stricter, else keep it while it stays in the band
+    for (int level = level_count - 1; level > 0; level--)
+    {
+        float const threshold = level > current ? error * (1 - band) : error * (1 + band);
+        if (level_errors[level] * radius_pixels <= threshold)
+            return level;
+    }
+    return 0;
+}
+
+void LodManager::update(LodCategory category, float radius, float distance, float const *level_errors, int level_count, int &level)
+{
+    int const selected = select(category, radius, distance, level_errors, level_count, level);
+    if (level != LOD_UNSET && selected != level)
+        switches[category]++;
+    level = selected;
+}
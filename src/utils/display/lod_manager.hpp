@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+
+// ************************************************** //
+//                    LOD CONSTANTS                   //
+// ************************************************** //
+constexpr float LOD_DEFAULT_PIXEL_ERROR = 1.0f; // Max projected geometric error, in pixels
+constexpr float LOD_DEFAULT_HYSTERESIS = 0.2f;  // Relative band around the pixel error : switch to a coarser level below 1 - h, back above 1 + h
+constexpr int LOD_UNSET = -1;                   // Level of an object that was never selected (its first selection is not counted as a switch)
+
+// Switch counters are kept per category
+enum LodCategory
+{
+    LOD_PLANET = 0, // Planet sphere or low poly disk
+    LOD_RING,       // Planet ring shown or hidden
+    LOD_ASTEROID,   // High poly, low poly or disk asteroids
+    LOD_TERRAIN,    // Planet quadtree chunks (split threshold only, no switch count)
+    LOD_CATEGORY_COUNT,
+};
+
+struct LodStats
+{
+    int switches[LOD_CATEGORY_COUNT] = {0}; // Level changes during the last frame
+    int total = 0;
+};
+
+/**
+ * Central level of detail selection.
+ * Each level of an object has a geometric error, relative to the object radius (0 for the full mesh). The coarsest
+ * level whose error projected on the screen stays under the pixel error is selected, with a hysteresis band around
+ * the current level so that objects at a boundary do not switch back and forth every frame.
+ * The view settings are atomics : selection can run on any thread (render recording, asteroid workers).
+ */
+class LodManager
+{
+public:
+    // Set the view for the new frame and publish the switch counters of the previous one (main thread)
+    void beginFrame(float field_of_view, float viewport_height, float pixel_error, float hysteresis);
+
+    // Projected size of a length at this distance, in pixels
+    float projectedSize(float length, float distance) const;
+
+    // Level for an object currently at level current (or LOD_UNSET). level_errors are increasing, level_errors[0] = 0
+    int select(LodCategory category, float radius, float distance, float const *level_errors, int level_count, int current) const;
+
+    // Select and count the switch. level is updated
+    void update(LodCategory category, float radius, float distance, float const *level_errors, int level_count, int &level);
+
+    // Add switches counted by the caller (batched updates from worker threads)
+    void countSwitches(LodCategory category, int count) { switches[category] += count; };
+
+    // Multiply the pixel error of a category (frame time governor). 1 by default
+    void setErrorScale(LodCategory category, float scale) { error_scales[category] = scale; };
+
+    // Pixel error of a category, scale included
+    float getPixelError(LodCategory category) const { return pixel_error * error_scales[category]; };
+
+    LodStats const &getStats() const { return stats; };
+
+private:
+    std::atomic<float> pixels_per_unit{1000}; // Viewport pixels for a length of 1 at distance 1
+    std::atomic<float> pixel_error{LOD_DEFAULT_PIXEL_ERROR};
+    std::atomic<float> hysteresis{LOD_DEFAULT_HYSTERESIS};
+
+    std::atomic<float> error_scales[LOD_CATEGORY_COUNT] = {1, 1, 1, 1};
+
+    std::atomic<int> switches[LOD_CATEGORY_COUNT] = {};
+    LodStats stats; // Last complete frame
+};
+
+extern LodManager global_lod_manager;
@@ -46,7 +46,18 @@ void LowPolyDrawable::draw_low_poly(environment_structure const &environment, cg
     low_poly_drawable.model.rotation = rotation;
 
     // Draw low poly
-    cgp::draw(low_poly_drawable, environment);
+    drawMesh(low_poly_drawable, environment);
+}
+
+bool LowPolyDrawable::record(CommandList &list, cgp::vec3 const &position, cgp::rotation_transform const &rotation)
+{
+    if (!shouldDrawLowPoly(position))
+        return record_real(list, position, rotation);
+
+    // Set disk orientation facing camera
+    low_poly_drawable.model.rotation = rotation;
+    list.submit(low_poly_drawable);
+    return true;
 }
 
 void LowPolyDrawable::setPosition(cgp::vec3 position)
@@ -58,9 +69,10 @@ cgp::vec3 LowPolyDrawable::getPosition() const
 {
     return low_poly_drawable.model.translation;
 }
-bool LowPolyDrawable::shouldDrawLowPoly(const cgp::vec3 &position) const
+bool LowPolyDrawable::shouldDrawLowPoly(const cgp::vec3 &position)
 {
-    double distance = cgp::norm(position - getPosition());
+    float distance = cgp::norm(position - getPosition());
+    global_lod_manager.update(LOD_PLANET, low_poly_radius, distance, LOW_POLY_LOD_ERRORS, 2, lod_level);
 
-    return distance > LOW_POLY_DISTANCE_RATIO * low_poly_radius;
+    return lod_level == 1;
 }
\ No newline at end of file
@@ -3,10 +3,14 @@
 #include "cgp/geometry/shape/mesh/structure/mesh.hpp"
 #include "drawable.hpp"
 #include "environment.hpp"
+#include "utils/display/lod_manager.hpp"
 
-const double LOW_POLY_DISTANCE_RATIO = 300;
 const int LOW_POLY_RESOLUTION = 10;
 
+// Relative geometric error of the real object and of the low poly disk.
+// At 1080p with a 50 degrees field of view and a 1 pixel error, the disk is used beyond 300 radii
+constexpr float LOW_POLY_LOD_ERRORS[] = {0, 0.26f};
+
 /**
  * Low poly abstract drawable object. If the distance if too big,
  * we use this low poly object instead of the real one.
@@ -23,6 +27,12 @@ public:
     // Draw the real object
     virtual void draw_real(environment_structure const &environment, cgp::vec3 &position, cgp::rotation_transform &rotation, bool show_wireframe = true) = 0;
 
+    // Record the low poly or the real object
+    virtual bool record(CommandList &list, cgp::vec3 const &position, cgp::rotation_transform const &rotation) override;
+
+    // Record the real object. Not recordable by default
+    virtual bool record_real(CommandList &, cgp::vec3 const &, cgp::rotation_transform const &) { return false; };
+
     // Draw the low poly object
     void draw_low_poly(environment_structure const &environment, cgp::vec3 &position, cgp::rotation_transform &rotation, bool show_wireframe = true);
 
@@ -34,7 +44,7 @@ public:
 
     // Getters
     cgp::vec3 getPosition() const override;
-    bool shouldDrawLowPoly(const cgp::vec3 &position) const;
+    bool shouldDrawLowPoly(const cgp::vec3 &position); // Selects the level through the LOD manager (counts the switches)
 
 private:
     // Private : the low poly members do not need to be accessed from children classes
@@ -43,4 +53,5 @@ private:
     cgp::mesh low_poly_mesh;
     cgp::mesh_drawable low_poly_drawable;
     cgp::vec3 low_poly_color;
+    int lod_level = LOD_UNSET;
 };
\ No newline at end of file
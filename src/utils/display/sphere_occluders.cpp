@@ -0,0 +1,53 @@
+#include "sphere_occluders.hpp"
+#include <algorithm>
+#include <cmath>
+
+void SphereOccluders::setup(cgp::vec3 const &camera_position, std::vector<cgp::vec4> const &spheres)
+{
+    this->camera_position = camera_position;
+    occluders.clear();
+
+    for (int i = 0; i < (int)spheres.size(); i++)
+    {
+        cgp::vec3 const center = {spheres[i].x, spheres[i].y, spheres[i].z};
+        float const radius = spheres[i].w * OCCLUDER_RADIUS_MARGIN;
+        float const distance = cgp::norm(center - camera_position);
+
+        // The camera is inside the occluder (or the occluder is too small to hide anything)
+        if (distance <= radius || radius / distance < OCCLUDER_MIN_ANGULAR_SIZE)
+            continue;
+
+        float const sin_angle = radius / distance;
+        occluders.push_back({(center - camera_position) / distance, distance, std::sqrt(1 - sin_angle * sin_angle), i});
+    }
+}
+
+bool SphereOccluders::isOccluded(cgp::vec3 const &center, float radius, int ignore) const
+{
+    cgp::vec3 const to_center = center - camera_position;
+    float const distance = cgp::norm(to_center);
+    if (distance <= radius)
+        return false;
+
+    // Cone of the tested sphere
+    float const sin_size = radius / distance;
+    float const cos_size = std::sqrt(1 - sin_size * sin_size);
+
+    for (auto const &occluder : occluders)
+    {
+        // Must be entirely behind the occluder center
+        if (occluder.index == ignore || distance - radius < occluder.distance)
+            continue;
+
+        float const cos_offset = cgp::dot(to_center, occluder.direction) / distance;
+        if (cos_offset <= 0)
+            continue;
+        float const sin_offset = std::sqrt(std::max(0.0f, 1 - cos_offset * cos_offset));
+
+        // offset + size <= occluder angle, compared with cosines (all angles are below 90 degrees)
+        if (cos_offset * cos_size - sin_offset * sin_size >= occluder.cos_angle)
+            return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "cgp/geometry/vec/vec3/vec3.hpp"
+#include "cgp/geometry/vec/vec4/vec4.hpp"
+#include <vector>
+
+// ************************************************** //
+//                OCCLUSION CONSTANTS                 //
+// ************************************************** //
+constexpr float OCCLUDER_RADIUS_MARGIN = 0.95f;  // Shrink the occluders : noisy surfaces dig below the radius
+constexpr float OCCLUDEE_RADIUS_MARGIN = 1.25f;  // Grow the culled bodies : their halos and bumps exceed the radius
+constexpr float OCCLUDER_MIN_ANGULAR_SIZE = 1e-3; // Occluders smaller than this on screen (sin of the half angle) are ignored
+
+/**
+ * Analytic occlusion by opaque spheres (sun, planets).
+ * Each occluder casts a cone from the camera. A sphere is hidden if its own cone lies inside the occluder cone
+ * and it is entirely farther from the camera than the occluder center : the view ray then enters the occluder
+ * before reaching it. The test is conservative and read only after setup, so it can run on any thread.
+ */
+class SphereOccluders
+{
+public:
+    // Rebuild the occluder cones for a new camera position. Spheres are (xyz = display center, w = radius)
+    void setup(cgp::vec3 const &camera_position, std::vector<cgp::vec4> const &spheres);
+
+    // Whether the sphere (center, radius) is completely hidden. The occluder with index ignore (the body itself) is skipped
+    bool isOccluded(cgp::vec3 const &center, float radius, int ignore = -1) const;
+
+    int size() const { return occluders.size(); };
+
+private:
+    struct OccluderCone
+    {
+        cgp::vec3 direction; // Unit vector from the camera to the occluder center
+        float distance;      // Camera to occluder center
+        float cos_angle;     // Cone half angle
+        int index; // Index in the setup spheres
+    };
+
+    cgp::vec3 camera_position;
+    std::vector<OccluderCone> occluders;
+};
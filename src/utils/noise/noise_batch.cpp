@@ -0,0 +1,346 @@
+#include "noise_batch.hpp"
+#include "cgp/geometry/shape/noise/noise.hpp"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define NOISE_BATCH_USE_AVX2
+#define NOISE_AVX2 __attribute__((target("avx2")))
+#endif
+
+#ifdef NOISE_BATCH_USE_AVX2
+
+// Permutation table of simplexnoise1234.cpp
+extern unsigned char perm[512];
+
+// ****************************************************** //
+//        SIMPLEX CONSTANTS (see simplexnoise1234.cpp)     //
+// ****************************************************** //
+// Every operation below is the one of snoise2 / snoise3, in the same order and in double precision : the lanes
+// round exactly like the scalar code. No FMA is enabled, it would change the rounding.
+constexpr double F2 = 0.366025403;
+constexpr double G2 = 0.211324865;
+constexpr double F3 = 0.333333333;
+constexpr double G3 = 0.166666667;
+
+// Same permutation table, widened for the gathers
+static int const *permutationTable()
+{
+    static int const *const table = []
+    {
+        static int widened[512];
+        for (int k = 0; k < 512; k++)
+            widened[k] = perm[k];
+        return widened;
+    }();
+    return table;
+}
+
+// 32 bit lane mask to 64 bit lane mask
+NOISE_AVX2 static inline __m256d wideMask(__m128i mask)
+{
+    return _mm256_castsi256_pd(_mm256_cvtepi32_epi64(mask));
+}
+
+// -value where the mask is set
+NOISE_AVX2 static inline __m256d negateWhere(__m256d value, __m256d mask)
+{
+    return _mm256_xor_pd(value, _mm256_and_pd(mask, _mm256_set1_pd(-0.0)));
+}
+
+// FASTFLOOR : (x > 0) ? (int)x : (int)x - 1, as a double
+NOISE_AVX2 static inline __m256d fastFloor(__m256d x)
+{
+    __m256d const truncated = _mm256_round_pd(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    __m256d const positive = _mm256_cmp_pd(x, _mm256_setzero_pd(), _CMP_GT_OQ);
+    return _mm256_sub_pd(truncated, _mm256_andnot_pd(positive, _mm256_set1_pd(1.0)));
+}
+
+NOISE_AVX2 static inline __m128i hashOf(int const *table, __m128i index)
+{
+    return _mm_i32gather_epi32(table, index, 4);
+}
+
+NOISE_AVX2 static inline __m256d gradient2(__m128i hash, __m256d x, __m256d y)
+{
+    __m128i const h = _mm_and_si128(hash, _mm_set1_epi32(7));
+    __m256d const low = wideMask(_mm_cmplt_epi32(h, _mm_set1_epi32(4)));
+    __m256d const u = _mm256_blendv_pd(y, x, low);
+    __m256d const v = _mm256_mul_pd(_mm256_set1_pd(2.0), _mm256_blendv_pd(x, y, low));
+
+    __m256d const negate_u = wideMask(_mm_cmpeq_epi32(_mm_and_si128(h, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+    __m256d const negate_v = wideMask(_mm_cmpeq_epi32(_mm_and_si128(h, _mm_set1_epi32(2)), _mm_set1_epi32(2)));
+    return _mm256_add_pd(negateWhere(u, negate_u), negateWhere(v, negate_v));
+}
+
+NOISE_AVX2 static inline __m256d gradient3(__m128i hash, __m256d x, __m256d y, __m256d z)
+{
+    __m128i const h = _mm_and_si128(hash, _mm_set1_epi32(15));
+    __m256d const u = _mm256_blendv_pd(y, x, wideMask(_mm_cmplt_epi32(h, _mm_set1_epi32(8))));
+    __m256d const x_or_z = _mm256_blendv_pd(z, x, wideMask(_mm_or_si128(_mm_cmpeq_epi32(h, _mm_set1_epi32(12)), _mm_cmpeq_epi32(h, _mm_set1_epi32(14)))));
+    __m256d const v = _mm256_blendv_pd(x_or_z, y, wideMask(_mm_cmplt_epi32(h, _mm_set1_epi32(4))));
+
+    __m256d const negate_u = wideMask(_mm_cmpeq_epi32(_mm_and_si128(h, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+    __m256d const negate_v = wideMask(_mm_cmpeq_epi32(_mm_and_si128(h, _mm_set1_epi32(2)), _mm_set1_epi32(2)));
+    return _mm256_add_pd(negateWhere(u, negate_u), negateWhere(v, negate_v));
+}
+
+// Contribution of a simplex corner : 0 if t < 0, else t^4 * gradient
+NOISE_AVX2 static inline __m256d cornerContribution(__m256d t, __m256d gradient)
+{
+    __m256d const outside = _mm256_cmp_pd(t, _mm256_setzero_pd(), _CMP_LT_OQ);
+    __m256d const t2 = _mm256_mul_pd(t, t);
+    return _mm256_andnot_pd(outside, _mm256_mul_pd(_mm256_mul_pd(t2, t2), gradient));
+}
+
+// snoise2 on 4 lanes
+NOISE_AVX2 static __m256d simplex2(int const *table, __m256d x, __m256d y)
+{
+    __m256d const one = _mm256_set1_pd(1.0);
+
+    __m256d const s = _mm256_mul_pd(_mm256_add_pd(x, y), _mm256_set1_pd(F2));
+    __m256d const i = fastFloor(_mm256_add_pd(x, s));
+    __m256d const j = fastFloor(_mm256_add_pd(y, s));
+
+    __m256d const t = _mm256_mul_pd(_mm256_add_pd(i, j), _mm256_set1_pd(G2));
+    __m256d const x0 = _mm256_sub_pd(x, _mm256_sub_pd(i, t));
+    __m256d const y0 = _mm256_sub_pd(y, _mm256_sub_pd(j, t));
+
+    __m256d const lower = _mm256_cmp_pd(x0, y0, _CMP_GT_OQ);
+    __m256d const i1 = _mm256_and_pd(lower, one);
+    __m256d const j1 = _mm256_andnot_pd(lower, one);
+
+    __m256d const x1 = _mm256_add_pd(_mm256_sub_pd(x0, i1), _mm256_set1_pd(G2));
+    __m256d const y1 = _mm256_add_pd(_mm256_sub_pd(y0, j1), _mm256_set1_pd(G2));
+    __m256d const x2 = _mm256_add_pd(_mm256_sub_pd(x0, one), _mm256_set1_pd(2.0f * G2));
+    __m256d const y2 = _mm256_add_pd(_mm256_sub_pd(y0, one), _mm256_set1_pd(2.0f * G2));
+
+    __m128i const byte = _mm_set1_epi32(255);
+    __m128i const ii = _mm_and_si128(_mm256_cvttpd_epi32(i), byte);
+    __m128i const jj = _mm_and_si128(_mm256_cvttpd_epi32(j), byte);
+    __m128i const i1i = _mm256_cvttpd_epi32(i1);
+    __m128i const j1i = _mm256_cvttpd_epi32(j1);
+    __m128i const unit = _mm_set1_epi32(1);
+
+    __m128i const h0 = hashOf(table, _mm_add_epi32(ii, hashOf(table, jj)));
+    __m128i const h1 = hashOf(table, _mm_add_epi32(_mm_add_epi32(ii, i1i), hashOf(table, _mm_add_epi32(jj, j1i))));
+    __m128i const h2 = hashOf(table, _mm_add_epi32(_mm_add_epi32(ii, unit), hashOf(table, _mm_add_epi32(jj, unit))));
+
+    __m256d const half = _mm256_set1_pd(0.5f);
+    __m256d const t0 = _mm256_sub_pd(_mm256_sub_pd(half, _mm256_mul_pd(x0, x0)), _mm256_mul_pd(y0, y0));
+    __m256d const t1 = _mm256_sub_pd(_mm256_sub_pd(half, _mm256_mul_pd(x1, x1)), _mm256_mul_pd(y1, y1));
+    __m256d const t2 = _mm256_sub_pd(_mm256_sub_pd(half, _mm256_mul_pd(x2, x2)), _mm256_mul_pd(y2, y2));
+
+    __m256d const n0 = cornerContribution(t0, gradient2(h0, x0, y0));
+    __m256d const n1 = cornerContribution(t1, gradient2(h1, x1, y1));
+    __m256d const n2 = cornerContribution(t2, gradient2(h2, x2, y2));
+
+    return _mm256_mul_pd(_mm256_set1_pd(40.0f), _mm256_add_pd(_mm256_add_pd(n0, n1), n2));
+}
+
+// perm[ii + di + perm[jj + dj + perm[kk + dk]]]
+NOISE_AVX2 static inline __m128i hash3(int const *table, __m128i ii, __m128i jj, __m128i kk, __m128i di, __m128i dj, __m128i dk)
+{
+    __m128i const hk = hashOf(table, _mm_add_epi32(kk, dk));
+    __m128i const hj = hashOf(table, _mm_add_epi32(_mm_add_epi32(jj, dj), hk));
+    return hashOf(table, _mm_add_epi32(_mm_add_epi32(ii, di), hj));
+}
+
+// 0.6f - x*x - y*y - z*z
+NOISE_AVX2 static inline __m256d falloff3(__m256d x, __m256d y, __m256d z)
+{
+    __m256d const radius = _mm256_set1_pd(0.6f);
+    return _mm256_sub_pd(_mm256_sub_pd(_mm256_sub_pd(radius, _mm256_mul_pd(x, x)), _mm256_mul_pd(y, y)), _mm256_mul_pd(z, z));
+}
+
+// snoise3 on 4 lanes
+NOISE_AVX2 static __m256d simplex3(int const *table, __m256d x, __m256d y, __m256d z)
+{
+    __m256d const one = _mm256_set1_pd(1.0);
+    __m256d const all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+
+    __m256d const s = _mm256_mul_pd(_mm256_add_pd(_mm256_add_pd(x, y), z), _mm256_set1_pd(F3));
+    __m256d const i = fastFloor(_mm256_add_pd(x, s));
+    __m256d const j = fastFloor(_mm256_add_pd(y, s));
+    __m256d const k = fastFloor(_mm256_add_pd(z, s));
+
+    __m256d const t = _mm256_mul_pd(_mm256_add_pd(_mm256_add_pd(i, j), k), _mm256_set1_pd(G3));
+    __m256d const x0 = _mm256_sub_pd(x, _mm256_sub_pd(i, t));
+    __m256d const y0 = _mm256_sub_pd(y, _mm256_sub_pd(j, t));
+    __m256d const z0 = _mm256_sub_pd(z, _mm256_sub_pd(k, t));
+
+    // Corner offsets of the 6 branches of snoise3, from the 3 comparisons
+    __m256d const xy = _mm256_cmp_pd(x0, y0, _CMP_GE_OQ);
+    __m256d const yz = _mm256_cmp_pd(y0, z0, _CMP_GE_OQ);
+    __m256d const xz = _mm256_cmp_pd(x0, z0, _CMP_GE_OQ);
+    __m256d const i1 = _mm256_and_pd(_mm256_and_pd(xy, xz), one);
+    __m256d const j1 = _mm256_and_pd(_mm256_andnot_pd(xy, yz), one);
+    __m256d const k1 = _mm256_andnot_pd(_mm256_or_pd(xz, yz), one);
+    __m256d const i2 = _mm256_and_pd(_mm256_or_pd(xy, xz), one);
+    __m256d const j2 = _mm256_and_pd(_mm256_or_pd(_mm256_xor_pd(xy, all), yz), one);
+    __m256d const k2 = _mm256_andnot_pd(_mm256_and_pd(yz, xz), one);
+
+    __m256d const g1 = _mm256_set1_pd(G3);
+    __m256d const g2 = _mm256_set1_pd(2.0f * G3);
+    __m256d const g3 = _mm256_set1_pd(3.0f * G3);
+    __m256d const x1 = _mm256_add_pd(_mm256_sub_pd(x0, i1), g1);
+    __m256d const y1 = _mm256_add_pd(_mm256_sub_pd(y0, j1), g1);
+    __m256d const z1 = _mm256_add_pd(_mm256_sub_pd(z0, k1), g1);
+    __m256d const x2 = _mm256_add_pd(_mm256_sub_pd(x0, i2), g2);
+    __m256d const y2 = _mm256_add_pd(_mm256_sub_pd(y0, j2), g2);
+    __m256d const z2 = _mm256_add_pd(_mm256_sub_pd(z0, k2), g2);
+    __m256d const x3 = _mm256_add_pd(_mm256_sub_pd(x0, one), g3);
+    __m256d const y3 = _mm256_add_pd(_mm256_sub_pd(y0, one), g3);
+    __m256d const z3 = _mm256_add_pd(_mm256_sub_pd(z0, one), g3);
+
+    __m128i const byte = _mm_set1_epi32(255);
+    __m128i const ii = _mm_and_si128(_mm256_cvttpd_epi32(i), byte);
+    __m128i const jj = _mm_and_si128(_mm256_cvttpd_epi32(j), byte);
+    __m128i const kk = _mm_and_si128(_mm256_cvttpd_epi32(k), byte);
+
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const unit = _mm_set1_epi32(1);
+    __m128i const h0 = hash3(table, ii, jj, kk, zero, zero, zero);
+    __m128i const h1 = hash3(table, ii, jj, kk, _mm256_cvttpd_epi32(i1), _mm256_cvttpd_epi32(j1), _mm256_cvttpd_epi32(k1));
+    __m128i const h2 = hash3(table, ii, jj, kk, _mm256_cvttpd_epi32(i2), _mm256_cvttpd_epi32(j2), _mm256_cvttpd_epi32(k2));
+    __m128i const h3 = hash3(table, ii, jj, kk, unit, unit, unit);
+
+    __m256d const n0 = cornerContribution(falloff3(x0, y0, z0), gradient3(h0, x0, y0, z0));
+    __m256d const n1 = cornerContribution(falloff3(x1, y1, z1), gradient3(h1, x1, y1, z1));
+    __m256d const n2 = cornerContribution(falloff3(x2, y2, z2), gradient3(h2, x2, y2, z2));
+    __m256d const n3 = cornerContribution(falloff3(x3, y3, z3), gradient3(h3, x3, y3, z3));
+
+    return _mm256_mul_pd(_mm256_set1_pd(32.0f), _mm256_add_pd(_mm256_add_pd(_mm256_add_pd(n0, n1), n2), n3));
+}
+
+// Noise of 4 + 4 lanes, rounded to float like the static_cast of noise_perlin
+NOISE_AVX2 static inline __m256 simplex2x8(int const *table, __m256 x, __m256 y)
+{
+    __m256d const low = simplex2(table, _mm256_cvtps_pd(_mm256_castps256_ps128(x)), _mm256_cvtps_pd(_mm256_castps256_ps128(y)));
+    __m256d const high = simplex2(table, _mm256_cvtps_pd(_mm256_extractf128_ps(x, 1)), _mm256_cvtps_pd(_mm256_extractf128_ps(y, 1)));
+    return _mm256_set_m128(_mm256_cvtpd_ps(high), _mm256_cvtpd_ps(low));
+}
+
+NOISE_AVX2 static inline __m256 simplex3x8(int const *table, __m256 x, __m256 y, __m256 z)
+{
+    __m256d const low = simplex3(table, _mm256_cvtps_pd(_mm256_castps256_ps128(x)), _mm256_cvtps_pd(_mm256_castps256_ps128(y)), _mm256_cvtps_pd(_mm256_castps256_ps128(z)));
+    __m256d const high = simplex3(table, _mm256_cvtps_pd(_mm256_extractf128_ps(x, 1)), _mm256_cvtps_pd(_mm256_extractf128_ps(y, 1)), _mm256_cvtps_pd(_mm256_extractf128_ps(z, 1)));
+    return _mm256_set_m128(_mm256_cvtpd_ps(high), _mm256_cvtpd_ps(low));
+}
+
+// Octave sum of noise_perlin, 8 points at a time. OCTAVES > 0 fixes the octave count at compile time
+template <int OCTAVES>
+NOISE_AVX2 static void perlin2Avx2(cgp::vec2 const *points, float *output, int count, int octave, float persistency, float frequency_gain)
+{
+    int const octaves = OCTAVES > 0 ? OCTAVES : octave;
+    int const *table = permutationTable();
+    __m256 const half = _mm256_set1_ps(0.5f);
+
+    int k = 0;
+    for (; k + 8 <= count; k += 8)
+    {
+        cgp::vec2 const *p = points + k;
+        __m256 const px = _mm256_setr_ps(p[0].x, p[1].x, p[2].x, p[3].x, p[4].x, p[5].x, p[6].x, p[7].x);
+        __m256 const py = _mm256_setr_ps(p[0].y, p[1].y, p[2].y, p[3].y, p[4].y, p[5].y, p[6].y, p[7].y);
+
+        __m256 value = _mm256_setzero_ps();
+        float a = 1.0f;
+        float f = 1.0f;
+        for (int o = 0; o < octaves; o++)
+        {
+            __m256 const frequency = _mm256_set1_ps(f);
+            __m256 const n = simplex2x8(table, _mm256_mul_ps(px, frequency), _mm256_mul_ps(py, frequency));
+            value = _mm256_add_ps(value, _mm256_mul_ps(_mm256_set1_ps(a), _mm256_add_ps(half, _mm256_mul_ps(half, n))));
+            f *= frequency_gain;
+            a *= persistency;
+        }
+        _mm256_storeu_ps(output + k, value);
+    }
+
+    for (; k < count; k++)
+        output[k] = cgp::noise_perlin(points[k], octave, persistency, frequency_gain);
+}
+
+template <int OCTAVES>
+NOISE_AVX2 static void perlin3Avx2(cgp::vec3 const *points, float *output, int count, int octave, float persistency, float frequency_gain)
+{
+    int const octaves = OCTAVES > 0 ? OCTAVES : octave;
+    int const *table = permutationTable();
+    __m256 const half = _mm256_set1_ps(0.5f);
+
+    int k = 0;
+    for (; k + 8 <= count; k += 8)
+    {
+        cgp::vec3 const *p = points + k;
+        __m256 const px = _mm256_setr_ps(p[0].x, p[1].x, p[2].x, p[3].x, p[4].x, p[5].x, p[6].x, p[7].x);
+        __m256 const py = _mm256_setr_ps(p[0].y, p[1].y, p[2].y, p[3].y, p[4].y, p[5].y, p[6].y, p[7].y);
+        __m256 const pz = _mm256_setr_ps(p[0].z, p[1].z, p[2].z, p[3].z, p[4].z, p[5].z, p[6].z, p[7].z);
+
+        __m256 value = _mm256_setzero_ps();
+        float a = 1.0f;
+        float f = 1.0f;
+        for (int o = 0; o < octaves; o++)
+        {
+            __m256 const frequency = _mm256_set1_ps(f);
+            __m256 const n = simplex3x8(table, _mm256_mul_ps(px, frequency), _mm256_mul_ps(py, frequency), _mm256_mul_ps(pz, frequency));
+            value = _mm256_add_ps(value, _mm256_mul_ps(_mm256_set1_ps(a), _mm256_add_ps(half, _mm256_mul_ps(half, n))));
+            f *= frequency_gain;
+            a *= persistency;
+        }
+        _mm256_storeu_ps(output + k, value);
+    }
+
+    for (; k < count; k++)
+        output[k] = cgp::noise_perlin(points[k], octave, persistency, frequency_gain);
+}
+
+// Specialized loops for 1 to 8 octaves, index 0 is the generic one
+template <typename TPoint>
+using BatchFunction = void (*)(TPoint const *, float *, int, int, float, float);
+
+static BatchFunction<cgp::vec2> const PERLIN_2_AVX2[] = {perlin2Avx2<0>, perlin2Avx2<1>, perlin2Avx2<2>, perlin2Avx2<3>, perlin2Avx2<4>, perlin2Avx2<5>, perlin2Avx2<6>, perlin2Avx2<7>, perlin2Avx2<8>};
+static BatchFunction<cgp::vec3> const PERLIN_3_AVX2[] = {perlin3Avx2<0>, perlin3Avx2<1>, perlin3Avx2<2>, perlin3Avx2<3>, perlin3Avx2<4>, perlin3Avx2<5>, perlin3Avx2<6>, perlin3Avx2<7>, perlin3Avx2<8>};
+
+static int specializationIndex(int octave)
+{
+    return (octave >= 1 && octave <= 8) ? octave : 0;
+}
+
+#endif
+
+bool noise_batch_uses_simd()
+{
+#ifdef NOISE_BATCH_USE_AVX2
+    static bool const avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+#else
+    return false;
+#endif
+}
+
+void noise_perlin_batch(cgp::vec2 const *points, float *output, int count, int octave, float persistency, float frequency_gain)
+{
+#ifdef NOISE_BATCH_USE_AVX2
+    if (noise_batch_uses_simd())
+    {
+        PERLIN_2_AVX2[specializationIndex(octave)](points, output, count, octave, persistency, frequency_gain);
+        return;
+    }
+#endif
+
+    for (int k = 0; k < count; k++)
+        output[k] = cgp::noise_perlin(points[k], octave, persistency, frequency_gain);
+}
+
+void noise_perlin_batch(cgp::vec3 const *points, float *output, int count, int octave, float persistency, float frequency_gain)
+{
+#ifdef NOISE_BATCH_USE_AVX2
+    if (noise_batch_uses_simd())
+    {
+        PERLIN_3_AVX2[specializationIndex(octave)](points, output, count, octave, persistency, frequency_gain);
+        return;
+    }
+#endif
+
+    for (int k = 0; k < count; k++)
+        output[k] = cgp::noise_perlin(points[k], octave, persistency, frequency_gain);
+}
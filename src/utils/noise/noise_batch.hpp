@@ -0,0 +1,15 @@
+#pragma once
+
+#include "cgp/geometry/vec/vec.hpp"
+
+/**
+ * Batched versions of cgp::noise_perlin : fill output[k] with the noise of points[k], for k in [0, count).
+ * With AVX2, 8 points are evaluated at once (simplex noise in double precision, like snoise2 and snoise3),
+ * and the usual octave counts (1 to 8) are compiled as separate loops. The results are bit for bit the ones
+ * of cgp::noise_perlin, which is also the fallback when AVX2 is not available.
+ */
+void noise_perlin_batch(cgp::vec2 const *points, float *output, int count, int octave = 5, float persistency = 0.3f, float frequency_gain = 2.0f);
+void noise_perlin_batch(cgp::vec3 const *points, float *output, int count, int octave = 5, float persistency = 0.3f, float frequency_gain = 2.0f);
+
+// Whether the batches use AVX2 on this CPU
+bool noise_batch_uses_simd();
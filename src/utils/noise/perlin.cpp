@@ -1,5 +1,5 @@
 #include "perlin.hpp"
-#include "cgp/geometry/shape/noise/noise.hpp"
+#include "noise_batch.hpp"
 #include <iostream>
 
 /*
@@ -75,26 +75,35 @@ cgp::mesh mesh_primitive_perlin_sphere(float radius, cgp::vec3 const &center, in
                 std::cos(phi) * std::cos(theta),
                 std::cos(phi) * std::sin(theta),
                 std::sin(phi)};
-
-            // Using 3D perlin noise
-            cgp::vec3 p;
-            if (useNoise)
-            {
-                float perlin_noise_value = cgp::noise_perlin(n * parameters.scale, parameters.octave, parameters.persistency, parameters.frequency_gain) - 0.5f;
-                p = (radius * (1 + perlin_noise_value / 3)) * n + center;
-            }
-            else
-            {
-                p = radius * n + center;
-            }
             cgp::vec2 const uv = {u, v};
 
-            shape.position.push_back(p);
             shape.normal.push_back(n);
             shape.uv.push_back(uv);
         }
     }
 
+    // Using 3D perlin noise, evaluated for the whole grid at once
+    shape.position.resize(Nu * Nv);
+    if (useNoise)
+    {
+        std::vector<cgp::vec3> noise_points(Nu * Nv);
+        std::vector<float> noise_values(Nu * Nv);
+        for (int k = 0; k < Nu * Nv; ++k)
+            noise_points[k] = shape.normal[k] * parameters.scale;
+        noise_perlin_batch(noise_points.data(), noise_values.data(), Nu * Nv, parameters.octave, parameters.persistency, parameters.frequency_gain);
+
+        for (int k = 0; k < Nu * Nv; ++k)
+        {
+            float perlin_noise_value = noise_values[k] - 0.5f;
+            shape.position[k] = (radius * (1 + perlin_noise_value / 3)) * shape.normal[k] + center;
+        }
+    }
+    else
+    {
+        for (int k = 0; k < Nu * Nv; ++k)
+            shape.position[k] = radius * shape.normal[k] + center;
+    }
+
     shape.connectivity = connectivity_grid(Nu, Nv);
 
     // poles
@@ -0,0 +1,60 @@
+#include "command_list.hpp"
+
+DrawPacket makeDrawPacket(cgp::mesh_drawable const &drawable)
+{
+    DrawPacket packet;
+    packet.sort_key = 0;
+    packet.source = &drawable;
+
+    // Same matrices as mesh_drawable::send_opengl_uniform, computed once here
+    packet.model = drawable.hierarchy_transform_model.matrix() * drawable.model.matrix();
+    packet.model_normal = cgp::transpose(cgp::inverse(drawable.model).matrix() * cgp::inverse(drawable.hierarchy_transform_model).matrix());
+    packet.material = drawable.material;
+
+    return packet;
+}
+
+void CommandList::submit(cgp::mesh_drawable const &drawable, cgp::uniform_generic_structure const *uniforms)
+{
+    // Same early exit as cgp::draw : nothing to display
+    if (drawable.vbo_position.size == 0 || drawable.ebo_connectivity.size == 0)
+        return;
+
+    packets.push_back(makeDrawPacket(drawable));
+    packets.back().uniforms = uniforms;
+}
+
+void CommandList::submitInstanced(cgp::mesh_drawable const &drawable, std::vector<cgp::vec3> const &positions, std::vector<cgp::mat3> const &rotations, std::vector<float> const &scales, int instance_count, bool do_bump_mapping, cgp::uniform_generic_structure const *uniforms)
+{
+    if (instance_count <= 0 || drawable.vbo_position.size == 0 || drawable.ebo_connectivity.size == 0)
+        return;
+
+    DrawPacket packet = makeDrawPacket(drawable);
+
+    InstanceBatch batch;
+    batch.source = &drawable;
+    batch.model = packet.model;
+    batch.model_normal = packet.model_normal;
+    batch.material = packet.material;
+    batch.positions = &positions;
+    batch.rotations = &rotations;
+    batch.scales = &scales;
+    batch.instance_count = instance_count;
+    batch.do_bump_mapping = do_bump_mapping;
+    batch.uniforms = uniforms;
+
+    instance_batches.push_back(batch);
+}
+
+cgp::uniform_generic_structure const *CommandList::addUniformBlock(cgp::uniform_generic_structure const &uniforms)
+{
+    uniform_blocks.push_back(uniforms);
+    return &uniform_blocks.back();
+}
+
+void CommandList::clear()
+{
+    packets.clear();
+    instance_batches.clear();
+    uniform_blocks.clear();
+}
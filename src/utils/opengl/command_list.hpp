@@ -0,0 +1,75 @@
+#pragma once
+
+#include "cgp/graphics/drawable/mesh_drawable/mesh_drawable.hpp"
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+/**
+ * One deferred mesh draw call.
+ * The matrices and material are copied at submission time, so the same mesh_drawable
+ * can be submitted several times with different transforms in a single frame.
+ * The GPU resources (shader, textures, VAO, EBO) are read from the source drawable at replay time.
+ */
+struct DrawPacket
+{
+    uint64_t sort_key;                // Packed state key, see RenderQueue::computeSortKey
+    cgp::mesh_drawable const *source; // Must stay alive until the queue is flushed
+    cgp::mat4 model;
+    cgp::mat4 model_normal;
+    cgp::material_mesh_drawable_phong material;
+    cgp::uniform_generic_structure const *uniforms = nullptr; // Optional uniform block, owned by the command list
+};
+
+/**
+ * One deferred instanced draw call (see cgp::draw_instanced).
+ * The instance arrays are not copied : they belong to the recording object and must not change before replay.
+ */
+struct InstanceBatch
+{
+    cgp::mesh_drawable const *source;
+    cgp::mat4 model;
+    cgp::mat4 model_normal;
+    cgp::material_mesh_drawable_phong material;
+
+    std::vector<cgp::vec3> const *positions;
+    std::vector<cgp::mat3> const *rotations;
+    std::vector<float> const *scales;
+    int instance_count;
+    bool do_bump_mapping;
+    cgp::uniform_generic_structure const *uniforms = nullptr;
+};
+
+// Compute the packet data from the current state of a mesh_drawable (no OpenGL call)
+DrawPacket makeDrawPacket(cgp::mesh_drawable const &drawable);
+
+/**
+ * Backend agnostic list of draw commands.
+ * Recording does not touch OpenGL, so several lists can be filled at the same time by worker threads
+ * (one list per thread / per object). The OpenGL thread then replays them through a RenderQueue.
+ */
+class CommandList
+{
+public:
+    // Record a mesh draw with its current model and material
+    void submit(cgp::mesh_drawable const &drawable, cgp::uniform_generic_structure const *uniforms = nullptr);
+
+    // Record an instanced draw
+    void submitInstanced(cgp::mesh_drawable const &drawable, std::vector<cgp::vec3> const &positions, std::vector<cgp::mat3> const &rotations, std::vector<float> const &scales, int instance_count, bool do_bump_mapping = false, cgp::uniform_generic_structure const *uniforms = nullptr);
+
+    // Store a uniform block for this frame. The returned pointer stays valid until clear()
+    cgp::uniform_generic_structure const *addUniformBlock(cgp::uniform_generic_structure const &uniforms);
+
+    // Reset the list before recording a new frame (keeps the allocated memory)
+    void clear();
+
+    bool empty() const { return packets.empty() && instance_batches.empty(); };
+
+    std::vector<DrawPacket> const &getPackets() const { return packets; };
+    std::vector<InstanceBatch> const &getInstanceBatches() const { return instance_batches; };
+
+private:
+    std::vector<DrawPacket> packets;
+    std::vector<InstanceBatch> instance_batches;
+    std::deque<cgp::uniform_generic_structure> uniform_blocks; // deque : stable addresses
+};
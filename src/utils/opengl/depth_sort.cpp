@@ -0,0 +1,51 @@
+#include "depth_sort.hpp"
+#include <cstring>
+
+// Map a float to an unsigned integer with the same ordering
+static uint32_t sortableFloat(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+void sort_back_to_front(float const *depths, int n, std::vector<uint32_t> &order, DepthSortBuffers &buffers)
+{
+    std::vector<uint32_t> &keys = buffers.keys;
+    std::vector<uint32_t> &keys_swap = buffers.keys_swap;
+    std::vector<uint32_t> &order_swap = buffers.order_swap;
+    keys.resize(n);
+    keys_swap.resize(n);
+    order.resize(n);
+    order_swap.resize(n);
+
+    // Farthest first : invert the depth ordering
+    for (int i = 0; i < n; i++)
+    {
+        keys[i] = ~sortableFloat(depths[i]);
+        order[i] = i;
+    }
+
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+        uint32_t count[257] = {0};
+        for (int i = 0; i < n; i++)
+            count[((keys[i] >> shift) & 0xFF) + 1]++;
+
+        // Every key has the same byte : nothing to move
+        if (n == 0 || count[((keys[0] >> shift) & 0xFF) + 1] == (uint32_t)n)
+            continue;
+
+        for (int b = 0; b < 256; b++)
+            count[b + 1] += count[b];
+
+        for (int i = 0; i < n; i++)
+        {
+            uint32_t const destination = count[(keys[i] >> shift) & 0xFF]++;
+            keys_swap[destination] = keys[i];
+            order_swap[destination] = order[i];
+        }
+        keys.swap(keys_swap);
+        order.swap(order_swap);
+    }
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+// Back to front ordering of translucent items, shared by the transparent pass and the particles
+
+#include <cstdint>
+#include <vector>
+
+// Scratch buffers of the sort, kept between frames to avoid allocations
+struct DepthSortBuffers
+{
+    std::vector<uint32_t> keys, keys_swap;
+    std::vector<uint32_t> order_swap;
+};
+
+// Indices of the n items from the largest depth to the smallest (LSD radix sort, 8 bits per pass)
+// Stable : equal depths keep their order. order is resized to n
+void sort_back_to_front(float const *depths, int n, std::vector<uint32_t> &order, DepthSortBuffers &buffers);
@@ -1,11 +1,26 @@
 #include "instancing.hpp"
 #include "cgp/core/containers/matrix_stack/special_types/definition/special_types.hpp"
 #include "cgp/graphics/opengl/uniform/uniform.hpp"
+#include <cstddef>
 #include <iostream>
 
 namespace cgp
 {
+    static_assert(sizeof(InstanceAttributes) == 13 * sizeof(float), "The instance attributes are read as tightly packed floats");
+
     void draw_instanced(mesh_drawable const &drawable, environment_generic_structure const &environment, const std::vector<vec3> &positions, const std::vector<mat3> &orientations, const std::vector<float> &scales, int n_instances, bool do_bump_mapping, uniform_generic_structure const &additional_uniforms, GLenum draw_mode)
+    {
+        // Final model matrix in the shader is: hierarchy_transform_model * model
+        mat4 const model_shader = drawable.hierarchy_transform_model.matrix() * drawable.model.matrix();
+
+        // The normal matrix is transpose( (hierarchy_transform_model * model)^{-1} )
+        mat4 const model_normal_shader = transpose(inverse(drawable.model).matrix() * inverse(drawable.hierarchy_transform_model).matrix());
+
+        draw_instanced_prepared(drawable, environment, model_shader, model_normal_shader, drawable.material, positions, orientations, scales, n_instances, do_bump_mapping, additional_uniforms, draw_mode);
+    }
+
+    // Shader, uniforms, textures and VAO of an instanced draw. Returns false if there is nothing to draw
+    static bool bind_instanced_drawable(mesh_drawable const &drawable, environment_generic_structure const &environment, mat4 const &model_shader, mat4 const &model_normal_shader, material_mesh_drawable_phong const &material, bool do_bump_mapping, uniform_generic_structure const &additional_uniforms)
     {
         opengl_check;
         // Initial clean check
@@ -13,7 +28,7 @@ namespace cgp
         // If there is not vertices or not triangles, returns
         //  (no error + does not display anything)
         if (drawable.vbo_position.size == 0 || drawable.ebo_connectivity.size == 0)
-            return;
+            return false;
 
         assert_cgp(drawable.shader.id != 0, "Try to draw mesh_drawable without shader ");
         assert_cgp(!glIsShader(drawable.shader.id), "Try to draw mesh_drawable with incorrect shader ");
@@ -30,19 +45,14 @@ namespace cgp
         // send the uniform values for the model and material of the mesh_drawable
         // Note : uniform values are heavy, do not send asteroid position with this means.
 
-        // Final model matrix in the shader is: hierarchy_transform_model * model
-        mat4 const model_shader = drawable.hierarchy_transform_model.matrix() * drawable.model.matrix();
-
-        // The normal matrix is transpose( (hierarchy_transform_model * model)^{-1} )
-        mat4 const model_normal_shader = transpose(inverse(drawable.model).matrix() * inverse(drawable.hierarchy_transform_model).matrix());
-
+        // Matrices are precomputed by the caller (possibly on a worker thread)
         // set the Model matrix
         // Note : with instancing, we will not use the default position set in those matrices, only the model meshes
         opengl_uniform(drawable.shader, "model", model_shader, false);
         opengl_uniform(drawable.shader, "modelNormal", model_normal_shader, false);
 
         // set the material
-        drawable.material.send_opengl_uniform(drawable.shader, false);
+        material.send_opengl_uniform(drawable.shader, false);
 
         // send the uniform values for the environment
         environment.send_opengl_uniform(drawable.shader, false);
@@ -85,6 +95,21 @@ namespace cgp
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, drawable.ebo_connectivity.id);
         opengl_check;
 
+        return true;
+    }
+
+    static void unbind_instanced_drawable(mesh_drawable const &drawable)
+    {
+        glBindVertexArray(0);
+        drawable.texture.unbind();
+        glUseProgram(0);
+    }
+
+    void draw_instanced_prepared(mesh_drawable const &drawable, environment_generic_structure const &environment, mat4 const &model_shader, mat4 const &model_normal_shader, material_mesh_drawable_phong const &material, const std::vector<vec3> &positions, const std::vector<mat3> &orientations, const std::vector<float> &scales, int n_instances, bool do_bump_mapping, uniform_generic_structure const &additional_uniforms, GLenum draw_mode)
+    {
+        if (!bind_instanced_drawable(drawable, environment, model_shader, model_normal_shader, material, do_bump_mapping, additional_uniforms))
+            return;
+
         // ********************************** //
         //     Custom instancing OpenGL code  //
         // ********************************** //
@@ -130,19 +155,48 @@ namespace cgp
         // Draw call
         // ********************************** //
         // glDrawElements(draw_mode, GLsizei(drawable.ebo_connectivity.size * 3), GL_UNSIGNED_INT, nullptr);
-        glDrawElementsInstanced(draw_mode, GLsizei(drawable.ebo_connectivity.size * 3), GL_UNSIGNED_INT, nullptr, GLsizei(n_instances));
+        glDrawElementsInstanced(draw_mode, GLsizei(drawable.ebo_connectivity.size * 3), drawable.ebo_connectivity.details.type_element, nullptr, GLsizei(n_instances));
 
         opengl_check;
 
-        // Clean state
-        // ********************************** //
-        glBindVertexArray(0);
-        drawable.texture.unbind();
-        glUseProgram(0);
+        unbind_instanced_drawable(drawable);
 
         // Delete buffers to avoid memory leak, see if this resolves the memory leak issue
         glDeleteBuffers(1, &custom_vbo);
         glDeleteBuffers(1, &rotations_vbo);
         glDeleteBuffers(1, &scales_vbo);
     }
+
+    void draw_instanced_buffer(mesh_drawable const &drawable, environment_generic_structure const &environment, GLuint instance_vbo, int n_instances, bool do_bump_mapping, uniform_generic_structure const &additional_uniforms, GLenum draw_mode)
+    {
+        if (n_instances <= 0)
+            return;
+
+        mat4 const model_shader = drawable.hierarchy_transform_model.matrix() * drawable.model.matrix();
+        mat4 const model_normal_shader = transpose(inverse(drawable.model).matrix() * inverse(drawable.hierarchy_transform_model).matrix());
+        if (!bind_instanced_drawable(drawable, environment, model_shader, model_normal_shader, drawable.material, do_bump_mapping, additional_uniforms))
+            return;
+
+        // Same locations as draw_instanced, interleaved in a single buffer owned by the caller
+        GLsizei const stride = sizeof(InstanceAttributes);
+        glBindBuffer(GL_ARRAY_BUFFER, instance_vbo);
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, stride, (void *)offsetof(InstanceAttributes, position));
+        glVertexAttribDivisor(4, 1);
+        for (int row = 0; row < 3; row++)
+        {
+            glEnableVertexAttribArray(5 + row);
+            glVertexAttribPointer(5 + row, 3, GL_FLOAT, GL_FALSE, stride, (void *)(offsetof(InstanceAttributes, rotation) + row * 3 * sizeof(float)));
+            glVertexAttribDivisor(5 + row, 1);
+        }
+        glEnableVertexAttribArray(8);
+        glVertexAttribPointer(8, 1, GL_FLOAT, GL_FALSE, stride, (void *)offsetof(InstanceAttributes, scale));
+        glVertexAttribDivisor(8, 1);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        glDrawElementsInstanced(draw_mode, GLsizei(drawable.ebo_connectivity.size * 3), drawable.ebo_connectivity.details.type_element, nullptr, GLsizei(n_instances));
+        opengl_check;
+
+        unbind_instanced_drawable(drawable);
+    }
 }
\ No newline at end of file
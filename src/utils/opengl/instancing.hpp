@@ -7,4 +7,18 @@
 namespace cgp
 {
     void draw_instanced(mesh_drawable const &drawable, environment_generic_structure const &environment = environment_generic_structure(), const std::vector<vec3> &positions = {}, const std::vector<mat3> &orientations = {}, const std::vector<float> &scales = {}, int n_instances = 1, bool do_bump_mapping = false, uniform_generic_structure const &additional_uniforms = uniform_generic_structure(), GLenum draw_mode = GL_TRIANGLES);
+
+    // Same as draw_instanced, with the model / normal matrices and material already computed (see CommandList)
+    void draw_instanced_prepared(mesh_drawable const &drawable, environment_generic_structure const &environment, mat4 const &model_shader, mat4 const &model_normal_shader, material_mesh_drawable_phong const &material, const std::vector<vec3> &positions, const std::vector<mat3> &orientations, const std::vector<float> &scales, int n_instances, bool do_bump_mapping = false, uniform_generic_structure const &additional_uniforms = uniform_generic_structure(), GLenum draw_mode = GL_TRIANGLES);
+
+    // One instance as read by the instanced shader (locations 4 to 8), for instance buffers kept on the GPU
+    struct InstanceAttributes
+    {
+        vec3 position;
+        mat3 rotation;
+        float scale;
+    };
+
+    // Same as draw_instanced, with the instances already in a buffer of InstanceAttributes (owned by the caller)
+    void draw_instanced_buffer(mesh_drawable const &drawable, environment_generic_structure const &environment, GLuint instance_vbo, int n_instances, bool do_bump_mapping = false, uniform_generic_structure const &additional_uniforms = uniform_generic_structure(), GLenum draw_mode = GL_TRIANGLES);
 }
\ No newline at end of file
@@ -0,0 +1,145 @@
+#include "render_queue.hpp"
+#include "cgp/graphics/opengl/uniform/uniform.hpp"
+#include "utils/opengl/instancing.hpp"
+#include <algorithm>
+
+void RenderQueue::submit(cgp::mesh_drawable const &drawable)
+{
+    // Same early exit as cgp::draw : nothing to display
+    if (drawable.vbo_position.size == 0 || drawable.ebo_connectivity.size == 0)
+        return;
+
+    assert_cgp(drawable.shader.id != 0, "Try to submit mesh_drawable without shader ");
+    assert_cgp(drawable.texture.id != 0, "Try to submit mesh_drawable without texture ");
+
+    DrawPacket packet = makeDrawPacket(drawable);
+    packet.sort_key = computeSortKey(drawable, (uint32_t)packets.size());
+    packets.push_back(packet);
+}
+
+void RenderQueue::replay(CommandList const &list)
+{
+    for (auto const &packet : list.getPackets())
+    {
+        packets.push_back(packet);
+        packets.back().sort_key = computeSortKey(*packet.source, (uint32_t)packets.size() - 1);
+    }
+
+    for (auto const &batch : list.getInstanceBatches())
+    {
+        instance_batches.push_back(&batch);
+    }
+}
+
+void RenderQueue::flush(environment_structure const &environment)
+{
+    stats = RenderQueueStats();
+    stats.packets = (int)packets.size();
+    stats.instance_batches = (int)instance_batches.size();
+
+    // The submission index in the low bits keeps the order stable for identical states
+    std::sort(packets.begin(), packets.end(), [](DrawPacket const &a, DrawPacket const &b)
+              { return a.sort_key < b.sort_key; });
+
+    GLuint current_program = 0;
+    GLuint current_texture = 0;
+    GLuint current_vao = 0;
+
+    glActiveTexture(GL_TEXTURE0);
+    opengl_check;
+
+    for (auto const &packet : packets)
+    {
+        cgp::mesh_drawable const &drawable = *packet.source;
+        cgp::opengl_shader_structure const &shader = drawable.shader;
+
+        // Shader program : environment uniforms are shared by all the packets using it
+        if (shader.id != current_program)
+        {
+            glUseProgram(shader.id);
+            opengl_check;
+            environment.send_opengl_uniform(shader, false);
+            cgp::opengl_uniform(shader, "image_texture", 0, false);
+
+            current_program = shader.id;
+            current_texture = 0; // Texture unit bindings survive, but force the rebind to keep the logic simple
+            stats.program_binds++;
+        }
+
+        // Main texture
+        if (drawable.texture.id != current_texture)
+        {
+            glActiveTexture(GL_TEXTURE0);
+            drawable.texture.bind();
+            current_texture = drawable.texture.id;
+            stats.texture_binds++;
+        }
+
+        // Supplementary textures are rare (asteroid normal maps), bind them each time
+        int texture_count = 1;
+        for (auto const &element : drawable.supplementary_texture)
+        {
+            glActiveTexture(GL_TEXTURE0 + texture_count);
+            element.second.bind();
+            cgp::opengl_uniform(shader, element.first, texture_count, false);
+            texture_count++;
+        }
+        if (texture_count > 1)
+        {
+            glActiveTexture(GL_TEXTURE0);
+            current_texture = 0;
+        }
+
+        // Per packet uniforms
+        cgp::opengl_uniform(shader, "model", packet.model, false);
+        cgp::opengl_uniform(shader, "modelNormal", packet.model_normal, false);
+        packet.material.send_opengl_uniform(shader, false);
+        if (packet.uniforms)
+            packet.uniforms->send_opengl_uniform(shader, false);
+
+        if (drawable.vao != current_vao)
+        {
+            glBindVertexArray(drawable.vao);
+            opengl_check;
+            current_vao = drawable.vao;
+            stats.vao_binds++;
+        }
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, drawable.ebo_connectivity.id);
+
+        glDrawElements(GL_TRIANGLES, GLsizei(drawable.ebo_connectivity.size * 3), drawable.ebo_connectivity.details.type_element, nullptr);
+        opengl_check;
+    }
+
+    // Restore the state expected by the immediate cgp::draw calls
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+
+    stats.avoided_binds = 3 * stats.packets - (stats.program_binds + stats.texture_binds + stats.vao_binds);
+
+    // Instanced batches : one full state setup each, but the matrices were computed at record time
+    for (auto const *batch : instance_batches)
+    {
+        cgp::draw_instanced_prepared(*batch->source, environment, batch->model, batch->model_normal, batch->material,
+                                     *batch->positions, *batch->rotations, *batch->scales, batch->instance_count, batch->do_bump_mapping,
+                                     batch->uniforms ? *batch->uniforms : cgp::uniform_generic_structure());
+    }
+
+    packets.clear();
+    instance_batches.clear();
+}
+
+void RenderQueue::clear()
+{
+    packets.clear();
+    instance_batches.clear();
+}
+
+uint64_t RenderQueue::computeSortKey(cgp::mesh_drawable const &drawable, uint32_t submission_index)
+{
+    // OpenGL names are small integers : truncating them to 16 bits only matters for grouping, not for correctness
+    return ((uint64_t)(drawable.shader.id & 0xFFFF) << 48) |
+           ((uint64_t)(drawable.texture.id & 0xFFFF) << 32) |
+           ((uint64_t)(drawable.vao & 0xFFFF) << 16) |
+           (uint64_t)(submission_index & 0xFFFF);
+}
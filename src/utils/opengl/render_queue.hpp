@@ -0,0 +1,53 @@
+#pragma once
+
+#include "cgp/graphics/drawable/mesh_drawable/mesh_drawable.hpp"
+#include "environment.hpp"
+#include "utils/opengl/command_list.hpp"
+#include <cstdint>
+#include <vector>
+
+// Per-frame render queue counters (reset on each flush)
+struct RenderQueueStats
+{
+    int packets = 0;
+    int program_binds = 0;
+    int texture_binds = 0;
+    int vao_binds = 0;
+    int instance_batches = 0;
+    int avoided_binds = 0; // State changes saved compared to drawing every packet with cgp::draw
+};
+
+/**
+ * State-sorted render queue.
+ * Drawables submit packets during the frame instead of calling cgp::draw directly.
+ * On flush, the packets are sorted by (shader, texture, vao) and drawn in that order,
+ * skipping redundant glUseProgram / texture / VAO binds, and sending the environment
+ * uniforms only once per shader program.
+ * Command lists recorded on worker threads are replayed into the queue on the OpenGL thread.
+ * Instanced batches are drawn after the sorted packets, in replay order.
+ */
+class RenderQueue
+{
+public:
+    // Queue a draw call for the given drawable, using its current model and material
+    void submit(cgp::mesh_drawable const &drawable);
+
+    // Append the content of a recorded command list. The list must not be cleared before flush
+    void replay(CommandList const &list);
+
+    // Sort and draw all queued packets, then empty the queue
+    void flush(environment_structure const &environment);
+
+    // Drop queued packets without drawing them
+    void clear();
+
+    RenderQueueStats const &getStats() const { return stats; };
+
+    // Key layout (most significant first) : 16 bits shader | 16 bits texture | 16 bits vao | 16 bits submission order
+    static uint64_t computeSortKey(cgp::mesh_drawable const &drawable, uint32_t submission_index);
+
+private:
+    std::vector<DrawPacket> packets;
+    std::vector<InstanceBatch const *> instance_batches;
+    RenderQueueStats stats;
+};
@@ -98,7 +98,7 @@ void ShieldUBO::draw(cgp::mesh_drawable const &drawable, cgp::environment_generi
 
     // Draw call
     // ********************************** //
-    glDrawElements(draw_mode, GLsizei(drawable.ebo_connectivity.size * 3), GL_UNSIGNED_INT, nullptr);
+    glDrawElements(draw_mode, GLsizei(drawable.ebo_connectivity.size * 3), drawable.ebo_connectivity.details.type_element, nullptr);
     opengl_check;
 
     // Clean state
@@ -0,0 +1,152 @@
+#include "transparent_pass.hpp"
+#include "cgp/graphics/opengl/uniform/uniform.hpp"
+#include "utils/shaders/shader_loader.hpp"
+#include "utils/threads/job_system.hpp"
+#include <chrono>
+#include <cstddef>
+
+void TransparentPass::beginFrame()
+{
+    if (sort_job.valid())
+        sort_job.wait();
+
+    instances.clear();
+    mesh_of.clear();
+    meshes.clear();
+    mesh_index.clear();
+}
+
+void TransparentPass::submit(cgp::mesh_drawable const &drawable, cgp::vec3 const &position, cgp::mat3 const &rotation, float scale)
+{
+    auto it = mesh_index.find(&drawable);
+    if (it == mesh_index.end())
+    {
+        it = mesh_index.insert({&drawable, (uint32_t)meshes.size()}).first;
+        meshes.push_back(&drawable);
+    }
+
+    instances.push_back({position, rotation, scale});
+    mesh_of.push_back(it->second);
+}
+
+void TransparentPass::sortAsync(cgp::vec3 const &camera_position, cgp::vec3 const &camera_direction)
+{
+    sort_job = global_job_system.submit([this, camera_position, camera_direction]()
+                                        { sort(camera_position, camera_direction); });
+}
+
+void TransparentPass::sort(cgp::vec3 camera_position, cgp::vec3 camera_direction)
+{
+    auto const start = std::chrono::high_resolution_clock::now();
+
+    int const n = instances.size();
+    depths.resize(n);
+    for (int i = 0; i < n; i++)
+        depths[i] = cgp::dot(instances[i].position - camera_position, camera_direction);
+    sort_back_to_front(depths.data(), n, order, sort_buffers);
+
+    // Gather the instance data in draw order
+    sorted_instances.resize(n);
+    sorted_meshes.resize(n);
+    for (int i = 0; i < n; i++)
+    {
+        sorted_instances[i] = instances[order[i]];
+        sorted_meshes[i] = mesh_of[order[i]];
+    }
+
+    auto const end = std::chrono::high_resolution_clock::now();
+    stats.sort_ms = std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+void TransparentPass::flush(environment_structure const &environment)
+{
+    if (sort_job.valid())
+        sort_job.wait();
+
+    int const n = sorted_instances.size();
+    stats.instances = n;
+    stats.draw_calls = 0;
+    if (n == 0)
+        return;
+
+    // One instance buffer for the whole pass, grown when needed and orphaned every frame
+    if (instance_vbo == 0)
+        glGenBuffers(1, &instance_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, instance_vbo);
+    if ((size_t)n > instance_vbo_capacity)
+        instance_vbo_capacity = n + n / 2;
+    glBufferData(GL_ARRAY_BUFFER, sizeof(TransparentInstance) * instance_vbo_capacity, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(TransparentInstance) * n, sorted_instances.data());
+
+    cgp::opengl_shader_structure const &shader = ShaderLoader::getShader("instanced");
+    glUseProgram(shader.id);
+    environment.send_opengl_uniform(shader, false);
+
+    // Instances carry the whole transform
+    cgp::mat4 const identity = cgp::mat4::build_identity();
+    cgp::opengl_uniform(shader, "model", identity, false);
+    cgp::opengl_uniform(shader, "modelNormal", identity, false);
+    cgp::opengl_uniform(shader, "do_bump_mapping", false);
+    glActiveTexture(GL_TEXTURE0);
+    cgp::opengl_uniform(shader, "image_texture", 0);
+
+    int run_start = 0;
+    while (run_start < n)
+    {
+        // Consecutive instances of the same mesh
+        int run_end = run_start + 1;
+        while (run_end < n && sorted_meshes[run_end] == sorted_meshes[run_start])
+            run_end++;
+
+        cgp::mesh_drawable const &drawable = *meshes[sorted_meshes[run_start]];
+        if (drawable.vbo_position.size != 0 && drawable.ebo_connectivity.size != 0)
+        {
+            drawable.material.send_opengl_uniform(shader, false);
+            drawable.texture.bind();
+
+            glBindVertexArray(drawable.vao);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, drawable.ebo_connectivity.id);
+
+            // No base instance in OpenGL 3.3 : point the instance attributes at the start of the run
+            char const *base = (char const *)(sizeof(TransparentInstance) * run_start);
+            GLsizei const stride = sizeof(TransparentInstance);
+            glEnableVertexAttribArray(4);
+            glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, stride, base + offsetof(TransparentInstance, position));
+            glVertexAttribDivisor(4, 1);
+            for (int row = 0; row < 3; row++)
+            {
+                glEnableVertexAttribArray(5 + row);
+                glVertexAttribPointer(5 + row, 3, GL_FLOAT, GL_FALSE, stride, base + offsetof(TransparentInstance, rotation) + 3 * row * sizeof(float));
+                glVertexAttribDivisor(5 + row, 1);
+            }
+            glEnableVertexAttribArray(8);
+            glVertexAttribPointer(8, 1, GL_FLOAT, GL_FALSE, stride, base + offsetof(TransparentInstance, scale));
+            glVertexAttribDivisor(8, 1);
+
+            glDrawElementsInstanced(GL_TRIANGLES, GLsizei(drawable.ebo_connectivity.size * 3), drawable.ebo_connectivity.details.type_element, nullptr, run_end - run_start);
+            stats.draw_calls++;
+
+            // The mesh VAO is also used by non instanced shaders
+            for (int location = 4; location <= 8; location++)
+                glDisableVertexAttribArray(location);
+        }
+
+        run_start = run_end;
+    }
+
+    // Clean state
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+    opengl_check;
+}
+
+void TransparentPass::clear()
+{
+    beginFrame();
+
+    glDeleteBuffers(1, &instance_vbo);
+    instance_vbo = 0;
+    instance_vbo_capacity = 0;
+}
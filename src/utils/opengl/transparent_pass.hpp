@@ -0,0 +1,75 @@
+#pragma once
+
+#include "cgp/graphics/drawable/mesh_drawable/mesh_drawable.hpp"
+#include "depth_sort.hpp"
+#include "environment.hpp"
+#include <cstdint>
+#include <future>
+#include <unordered_map>
+#include <vector>
+
+// Per instance data, laid out as the attributes of the "instanced" shader (locations 4, 5-7 and 8)
+struct TransparentInstance
+{
+    cgp::vec3 position;
+    cgp::mat3 rotation;
+    float scale;
+};
+
+struct TransparentPassStats
+{
+    int instances = 0;
+    int draw_calls = 0;
+    float sort_ms = 0; // Time spent sorting on the worker
+};
+
+/**
+ * Back to front pass for translucent meshes (billboards, rings, halos...).
+ * Instances are gathered once per frame, then radix sorted by view depth on a job system worker while the
+ * opaque objects are drawn. The sorted instances are uploaded in a single instance buffer and consecutive
+ * instances of the same mesh are drawn with one instanced call, using the "instanced" shader.
+ */
+class TransparentPass
+{
+public:
+    // Start a new frame. Waits for a sort that would still be running
+    void beginFrame();
+
+    // The drawable must stay alive until flush. Its model transform is ignored : use position, rotation and scale
+    void submit(cgp::mesh_drawable const &drawable, cgp::vec3 const &position, cgp::mat3 const &rotation = cgp::mat3::build_identity(), float scale = 1.0f);
+
+    // Sort the submitted instances back to front on a worker thread
+    void sortAsync(cgp::vec3 const &camera_position, cgp::vec3 const &camera_direction);
+
+    // Wait for the sort and draw. Blending must be enabled and depth writes disabled by the caller
+    void flush(environment_structure const &environment);
+
+    // Wait for the sort and free the instance buffer (OpenGL thread)
+    void clear();
+
+    TransparentPassStats const &getStats() const { return stats; };
+
+private:
+    void sort(cgp::vec3 camera_position, cgp::vec3 camera_direction);
+
+    // Gathered instances, and the mesh of each one
+    std::vector<TransparentInstance> instances;
+    std::vector<uint32_t> mesh_of;
+    std::vector<cgp::mesh_drawable const *> meshes;
+    std::unordered_map<cgp::mesh_drawable const *, uint32_t> mesh_index;
+
+    // Camera depth of each instance, and the instance indices from back to front
+    std::vector<float> depths;
+    std::vector<uint32_t> order;
+    DepthSortBuffers sort_buffers;
+
+    // Written by the sort job
+    std::vector<TransparentInstance> sorted_instances;
+    std::vector<uint32_t> sorted_meshes;
+    std::future<void> sort_job;
+
+    GLuint instance_vbo = 0;
+    size_t instance_vbo_capacity = 0;
+
+    TransparentPassStats stats;
+};
@@ -0,0 +1,253 @@
+#include "particle_system.hpp"
+#include "cgp/graphics/opengl/uniform/uniform.hpp"
+#include "utils/shaders/shader_loader.hpp"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PARTICLES_USE_SSE
+#endif
+
+ParticleSystem global_particle_system;
+
+ParticleSystem::ParticleSystem()
+{
+    for (auto *array : {&px, &py, &pz, &vx, &vy, &vz, &life, &life_rate, &damping})
+        array->resize(PARTICLE_CAPACITY);
+    material.resize(PARTICLE_CAPACITY);
+    vertices.resize(PARTICLE_CAPACITY);
+
+    // Default materials
+    materials[PARTICLE_ENGINE] = {{0.6f, 0.8f, 1.0f}, {0.1f, 0.2f, 1.0f}, 0.12f, 0.02f, 0.35f, 2.0f, 1.0f, true};
+    materials[PARTICLE_IMPACT] = {{1.0f, 0.9f, 0.5f}, {1.0f, 0.3f, 0.0f}, 0.08f, 0.01f, 0.5f, 1.0f, 0.2f, true};
+    materials[PARTICLE_DEBRIS] = {{0.5f, 0.45f, 0.4f}, {0.3f, 0.3f, 0.3f}, 0.15f, 0.6f, 1.5f, 0.5f, 1.0f, false};
+}
+
+void ParticleSystem::initialize()
+{
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(ParticleVertex) * PARTICLE_CAPACITY, nullptr, GL_STREAM_DRAW);
+
+    // Location 0 : position + size, location 1 : color + alpha
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(ParticleVertex), (void *)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(ParticleVertex), (void *)(4 * sizeof(float)));
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    opengl_check;
+}
+
+float ParticleSystem::random01()
+{
+    // xorshift32
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return (random_state >> 8) * (1.0f / 16777216.0f);
+}
+
+void ParticleSystem::emit(ParticleMaterial material_index, cgp::vec3 const &position, cgp::vec3 const &velocity, float spread, float count)
+{
+    int n = (int)count;
+    if (random01() < count - n)
+        n++;
+
+    ParticleMaterialSettings const &settings = materials[material_index];
+
+    for (int k = 0; k < n; k++)
+    {
+        if (alive == PARTICLE_CAPACITY)
+        {
+            dropped += n - k;
+            return;
+        }
+
+        // Random direction in the unit ball (rejection sampling)
+        cgp::vec3 direction;
+        do
+        {
+            direction = {2 * random01() - 1, 2 * random01() - 1, 2 * random01() - 1};
+        } while (cgp::dot(direction, direction) > 1);
+
+        cgp::vec3 const v = velocity + spread * direction;
+        px[alive] = position.x;
+        py[alive] = position.y;
+        pz[alive] = position.z;
+        vx[alive] = v.x;
+        vy[alive] = v.y;
+        vz[alive] = v.z;
+        life[alive] = 0;
+        life_rate[alive] = 1.0f / (settings.lifetime * (0.75f + 0.5f * random01())); // Desynchronize the deaths
+        damping[alive] = settings.drag;
+        material[alive] = material_index;
+        alive++;
+    }
+}
+
+void ParticleSystem::update(float dt)
+{
+    // Integrate. The arrays are padded to a multiple of 4 : the lanes past the last live particle are garbage, never read
+    int i = 0;
+#ifdef PARTICLES_USE_SSE
+    __m128 const dt4 = _mm_set1_ps(dt);
+    __m128 const one = _mm_set1_ps(1.0f);
+    __m128 const zero = _mm_setzero_ps();
+    for (; i < alive; i += 4)
+    {
+        __m128 const slow = _mm_max_ps(zero, _mm_sub_ps(one, _mm_mul_ps(_mm_loadu_ps(&damping[i]), dt4)));
+
+        __m128 const x_velocity = _mm_mul_ps(_mm_loadu_ps(&vx[i]), slow);
+        __m128 const y_velocity = _mm_mul_ps(_mm_loadu_ps(&vy[i]), slow);
+        __m128 const z_velocity = _mm_mul_ps(_mm_loadu_ps(&vz[i]), slow);
+        _mm_storeu_ps(&vx[i], x_velocity);
+        _mm_storeu_ps(&vy[i], y_velocity);
+        _mm_storeu_ps(&vz[i], z_velocity);
+
+        _mm_storeu_ps(&px[i], _mm_add_ps(_mm_loadu_ps(&px[i]), _mm_mul_ps(x_velocity, dt4)));
+        _mm_storeu_ps(&py[i], _mm_add_ps(_mm_loadu_ps(&py[i]), _mm_mul_ps(y_velocity, dt4)));
+        _mm_storeu_ps(&pz[i], _mm_add_ps(_mm_loadu_ps(&pz[i]), _mm_mul_ps(z_velocity, dt4)));
+
+        _mm_storeu_ps(&life[i], _mm_add_ps(_mm_loadu_ps(&life[i]), _mm_mul_ps(_mm_loadu_ps(&life_rate[i]), dt4)));
+    }
+#else
+    for (; i < alive; i++)
+    {
+        float const slow = std::max(0.0f, 1.0f - damping[i] * dt);
+        vx[i] *= slow;
+        vy[i] *= slow;
+        vz[i] *= slow;
+        px[i] += vx[i] * dt;
+        py[i] += vy[i] * dt;
+        pz[i] += vz[i] * dt;
+        life[i] += life_rate[i] * dt;
+    }
+#endif
+
+    // Remove the dead particles : swap with the last live one
+    i = 0;
+    while (i < alive)
+    {
+        if (life[i] < 1)
+        {
+            i++;
+            continue;
+        }
+
+        int const last = --alive;
+        px[i] = px[last];
+        py[i] = py[last];
+        pz[i] = pz[last];
+        vx[i] = vx[last];
+        vy[i] = vy[last];
+        vz[i] = vz[last];
+        life[i] = life[last];
+        life_rate[i] = life_rate[last];
+        damping[i] = damping[last];
+        material[i] = material[last];
+    }
+}
+
+void ParticleSystem::draw(environment_structure const &environment)
+{
+    draw_calls = 0;
+    dropped = 0;
+    if (alive == 0 || vao == 0)
+        return;
+
+    // Bucket the particles by material (counting sort) while building the vertices
+    int offsets[PARTICLE_MATERIAL_COUNT + 1] = {0};
+    for (int i = 0; i < alive; i++)
+        offsets[material[i] + 1]++;
+    for (int m = 0; m < PARTICLE_MATERIAL_COUNT; m++)
+        offsets[m + 1] += offsets[m];
+
+    int fill[PARTICLE_MATERIAL_COUNT];
+    std::copy(offsets, offsets + PARTICLE_MATERIAL_COUNT, fill);
+
+    for (int i = 0; i < alive; i++)
+    {
+        ParticleMaterialSettings const &settings = materials[material[i]];
+        float const t = std::min(life[i], 1.0f);
+        cgp::vec3 const color = (1 - t) * settings.color_start + t * settings.color_end;
+
+        vertices[fill[material[i]]++] = {px[i], py[i], pz[i], (1 - t) * settings.size_start + t * settings.size_end, color.x, color.y, color.z, 1 - t};
+    }
+
+    // Alpha blended materials are order dependent : sort their bucket back to front (view space depth)
+    cgp::mat4 const &view = environment.camera_view;
+    for (int m = 0; m < PARTICLE_MATERIAL_COUNT; m++)
+    {
+        int const count = offsets[m + 1] - offsets[m];
+        if (materials[m].additive || count < 2)
+            continue;
+
+        ParticleVertex *bucket = vertices.data() + offsets[m];
+        depths.resize(count);
+        for (int k = 0; k < count; k++)
+            depths[k] = -(view(2, 0) * bucket[k].x + view(2, 1) * bucket[k].y + view(2, 2) * bucket[k].z + view(2, 3));
+        sort_back_to_front(depths.data(), count, draw_order, sort_buffers);
+
+        sorted_vertices.resize(count);
+        for (int k = 0; k < count; k++)
+            sorted_vertices[k] = bucket[draw_order[k]];
+        std::copy(sorted_vertices.begin(), sorted_vertices.end(), bucket);
+    }
+
+    // Orphan the previous storage, then upload this frame vertices
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(ParticleVertex) * PARTICLE_CAPACITY, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(ParticleVertex) * alive, vertices.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    cgp::opengl_shader_structure const &shader = ShaderLoader::getShader("particle");
+    glUseProgram(shader.id);
+    environment.send_opengl_uniform(shader, false);
+
+    // Point sprite size : world size projected on the viewport
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    cgp::opengl_uniform(shader, "viewport_height", (float)viewport[3]);
+
+    glEnable(GL_PROGRAM_POINT_SIZE);
+    glEnable(GL_BLEND);
+    glDepthMask(false);
+    glBindVertexArray(vao);
+
+    for (int m = 0; m < PARTICLE_MATERIAL_COUNT; m++)
+    {
+        int const count = offsets[m + 1] - offsets[m];
+        if (count == 0)
+            continue;
+
+        ParticleMaterialSettings const &settings = materials[m];
+        glBlendFunc(GL_SRC_ALPHA, settings.additive ? GL_ONE : GL_ONE_MINUS_SRC_ALPHA);
+        cgp::opengl_uniform(shader, "softness", settings.softness);
+
+        glDrawArrays(GL_POINTS, offsets[m], count);
+        draw_calls++;
+    }
+
+    // Clean state
+    glBindVertexArray(0);
+    glDepthMask(true);
+    glDisable(GL_BLEND);
+    glDisable(GL_PROGRAM_POINT_SIZE);
+    glUseProgram(0);
+    opengl_check;
+}
+
+void ParticleSystem::clear()
+{
+    glDeleteBuffers(1, &vbo);
+    glDeleteVertexArrays(1, &vao);
+    vbo = 0;
+    vao = 0;
+    alive = 0;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "cgp/geometry/vec/vec3/vec3.hpp"
+#include "environment.hpp"
+#include "utils/opengl/depth_sort.hpp"
+#include <cstdint>
+#include <vector>
+
+// ************************************************** //
+//                  PARTICLE CONSTANTS                //
+// ************************************************** //
+constexpr int PARTICLE_CAPACITY = 65536; // Multiple of 4 : the update processes 4 particles at a time
+
+// Each material is drawn with a single draw call
+enum ParticleMaterial
+{
+    PARTICLE_ENGINE = 0, // Engine exhaust (additive)
+    PARTICLE_IMPACT,     // Projectile impact sparks (additive)
+    PARTICLE_DEBRIS,     // Impact dust (alpha blended)
+    PARTICLE_MATERIAL_COUNT,
+};
+
+struct ParticleMaterialSettings
+{
+    cgp::vec3 color_start;
+    cgp::vec3 color_end;
+    float size_start; // World size (display units)
+    float size_end;
+    float lifetime; // Seconds
+    float drag;     // Velocity damping per second
+    float softness; // 0 : hard disc, 1 : gaussian-like blob
+    bool additive;
+};
+
+/**
+ * CPU particle system.
+ * Particles are stored as structure of arrays and updated with SSE, 4 at a time. Every frame, the live
+ * particles are bucketed by material into one streaming vertex buffer (one point sprite per particle), so each
+ * material costs one draw call whatever the number of emitters. Materials are either additive (no sorting
+ * needed) or alpha blended, sorted back to front within their bucket. Particles never write depth.
+ */
+class ParticleSystem
+{
+public:
+    ParticleSystem();
+
+    void initialize(); // Create the GPU buffers. Needs the "particle" shader
+
+    // Spawn count particles (the fractional part is spawned randomly, so emitters can run at any frame rate).
+    // velocity is the mean velocity, spread the random velocity added in a random direction
+    void emit(ParticleMaterial material, cgp::vec3 const &position, cgp::vec3 const &velocity, float spread, float count);
+
+    void update(float dt);
+    void draw(environment_structure const &environment);
+
+    // Free the GPU buffers (OpenGL thread)
+    void clear();
+
+    int size() const { return alive; };
+    int getDrawCallCount() const { return draw_calls; };
+    int getDroppedCount() const { return dropped; }; // Particles refused since the last draw because the pool was full
+
+    ParticleMaterialSettings materials[PARTICLE_MATERIAL_COUNT];
+
+private:
+    float random01(); // Cheap generator : emission runs for thousands of particles per frame
+
+    int alive = 0;
+    int dropped = 0;
+    int draw_calls = 0;
+    uint32_t random_state = 0x9E3779B9u;
+
+    // Particle state (SoA)
+    std::vector<float> px, py, pz;
+    std::vector<float> vx, vy, vz;
+    std::vector<float> life;      // Normalized age in [0, 1]
+    std::vector<float> life_rate; // 1 / lifetime
+    std::vector<float> damping;   // Material drag
+    std::vector<uint8_t> material;
+
+    // Streaming vertex data : position + size, color + alpha
+    struct ParticleVertex
+    {
+        float x, y, z, size;
+        float r, g, b, a;
+    };
+    std::vector<ParticleVertex> vertices;
+
+    // Back to front sort of the alpha blended buckets
+    std::vector<float> depths;
+    std::vector<uint32_t> draw_order;
+    std::vector<ParticleVertex> sorted_vertices;
+    DepthSortBuffers sort_buffers;
+
+    GLuint vao = 0;
+    GLuint vbo = 0;
+};
+
+extern ParticleSystem global_particle_system;
@@ -0,0 +1,165 @@
+#include "poisson_disk.hpp"
+#include "utils/threads/job_system.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Small deterministic generator, one per tile : the result does not depend on the thread scheduling
+    struct TileRandom
+    {
+        uint32_t state;
+
+        float next()
+        {
+            // xorshift32
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return (state >> 8) * (1.0f / 16777216.0f);
+        }
+    };
+
+    // Background grid : at most one sample per cell (cell diagonal = radius)
+    struct PoissonGrid
+    {
+        cgp::vec2 min;
+        float radius;
+        float radius2;
+        float cell;
+        int width, height;
+        std::vector<cgp::vec2> points;
+        std::vector<unsigned char> filled;
+
+        bool isFree(cgp::vec2 const &p, int cx, int cy) const
+        {
+            for (int y = std::max(cy - 2, 0); y <= std::min(cy + 2, height - 1); y++)
+            {
+                for (int x = std::max(cx - 2, 0); x <= std::min(cx + 2, width - 1); x++)
+                {
+                    // The corner cells are always at least radius away
+                    if ((x == cx - 2 || x == cx + 2) && (y == cy - 2 || y == cy + 2))
+                        continue;
+
+                    int const index = x + width * y;
+                    if (filled[index])
+                    {
+                        // Component wise : the cgp vector operators check their bounds
+                        float const dx = points[index].x - p.x;
+                        float const dy = points[index].y - p.y;
+                        if (dx * dx + dy * dy < radius2)
+                            return false;
+                    }
+                }
+            }
+            return true;
+        }
+    };
+}
+
+// Bridson sampling restricted to the cells [x0, x1[ x [y0, y1[. Only these cells are written
+static void sampleTile(PoissonGrid &grid, int x0, int x1, int y0, int y1, uint32_t seed, std::vector<cgp::vec2> &samples)
+{
+    TileRandom random = {(seed * 2654435761u) | 1}; // Never 0
+    std::vector<cgp::vec2> active;
+
+    auto tryAdd = [&](cgp::vec2 const &p)
+    {
+        int const cx = (int)((p.x - grid.min.x) / grid.cell);
+        int const cy = (int)((p.y - grid.min.y) / grid.cell);
+        if (p.x < grid.min.x || p.y < grid.min.y || cx < x0 || cx >= x1 || cy < y0 || cy >= y1)
+            return false;
+        if (grid.filled[cx + grid.width * cy] || !grid.isFree(p, cx, cy))
+            return false;
+
+        grid.points[cx + grid.width * cy] = p;
+        grid.filled[cx + grid.width * cy] = 1;
+        samples.push_back(p);
+        active.push_back(p);
+        return true;
+    };
+
+    // Seed every empty cell once (a random point inside it), then grow from the active samples
+    for (int cy = y0; cy < y1; cy++)
+    {
+        for (int cx = x0; cx < x1; cx++)
+        {
+            if (grid.filled[cx + grid.width * cy])
+                continue;
+
+            cgp::vec2 const seed_point = {grid.min.x + grid.cell * (cx + random.next()), grid.min.y + grid.cell * (cy + random.next())};
+            if (!tryAdd(seed_point))
+                continue;
+
+            while (!active.empty())
+            {
+                int const index = std::min((int)(random.next() * active.size()), (int)active.size() - 1);
+                cgp::vec2 const center = active[index];
+
+                bool added = false;
+                for (int attempt = 0; attempt < POISSON_DISK_ATTEMPTS && !added; attempt++)
+                {
+                    // Uniform in the annulus [radius, 2 radius]
+                    float const angle = 2 * 3.14159265f * random.next();
+                    float const distance = grid.radius * std::sqrt(1 + 3 * random.next());
+                    added = tryAdd({center.x + distance * std::cos(angle), center.y + distance * std::sin(angle)});
+                }
+
+                if (!added)
+                {
+                    active[index] = active.back();
+                    active.pop_back();
+                }
+            }
+        }
+    }
+}
+
+std::vector<cgp::vec2> poisson_disk_sampling(cgp::vec2 const &min, cgp::vec2 const &max, float radius, uint32_t seed)
+{
+    PoissonGrid grid;
+    grid.min = min;
+    grid.radius = radius;
+    grid.radius2 = radius * radius;
+    grid.cell = radius / std::sqrt(2.0f);
+    grid.width = std::max(1, (int)std::ceil((max.x - min.x) / grid.cell));
+    grid.height = std::max(1, (int)std::ceil((max.y - min.y) / grid.cell));
+    grid.points.resize(grid.width * grid.height);
+    grid.filled.assign(grid.width * grid.height, 0);
+
+    int const tiles_x = (grid.width + POISSON_DISK_TILE_CELLS - 1) / POISSON_DISK_TILE_CELLS;
+    int const tiles_y = (grid.height + POISSON_DISK_TILE_CELLS - 1) / POISSON_DISK_TILE_CELLS;
+    std::vector<std::vector<cgp::vec2>> tile_samples(tiles_x * tiles_y);
+
+    // 4 batches of tiles (even/odd in x and y) : a sample reads the cells 2 cells around it, always in a tile
+    // of another batch, already done. Tiles of the same batch run in parallel
+    for (int batch = 0; batch < 4; batch++)
+    {
+        int const offset_x = batch & 1;
+        int const offset_y = batch >> 1;
+        int const batch_x = (tiles_x - offset_x + 1) / 2;
+        int const batch_y = (tiles_y - offset_y + 1) / 2;
+
+        global_job_system.parallelFor(batch_x * batch_y, [&](int begin, int end)
+                                      {
+            for (int k = begin; k < end; k++)
+            {
+                int const tx = offset_x + 2 * (k % batch_x);
+                int const ty = offset_y + 2 * (k / batch_x);
+                int const tile = tx + tiles_x * ty;
+                sampleTile(grid, tx * POISSON_DISK_TILE_CELLS, std::min((tx + 1) * POISSON_DISK_TILE_CELLS, grid.width),
+                           ty * POISSON_DISK_TILE_CELLS, std::min((ty + 1) * POISSON_DISK_TILE_CELLS, grid.height),
+                           seed ^ (uint32_t)tile * 0x9E3779B9u, tile_samples[tile]);
+            } });
+    }
+
+    std::vector<cgp::vec2> samples;
+    for (auto const &tile : tile_samples)
+        samples.insert(samples.end(), tile.begin(), tile.end());
+
+    // The last cells may go past max
+    samples.erase(std::remove_if(samples.begin(), samples.end(), [&](cgp::vec2 const &p)
+                                 { return p.x > max.x || p.y > max.y; }),
+                  samples.end());
+    return samples;
+}
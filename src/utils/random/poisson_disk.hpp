@@ -0,0 +1,15 @@
+#pragma once
+
+// Poisson disk sampling (Bridson) of a rectangle
+// Used to scatter objects on the terrain
+
+#include "cgp/geometry/vec/vec2/vec2.hpp"
+#include <cstdint>
+#include <vector>
+
+constexpr int POISSON_DISK_ATTEMPTS = 30;   // Candidates tried around each active sample
+constexpr int POISSON_DISK_TILE_CELLS = 32; // Tile side in grid cells : tiles are sampled in parallel
+
+// Points of [min, max] at least radius apart, filling the rectangle. The result only depends on the seed
+// The rectangle is split in tiles, sampled 4 batches at a time so that tiles of a batch never touch
+std::vector<cgp::vec2> poisson_disk_sampling(cgp::vec2 const &min, cgp::vec2 const &max, float radius, uint32_t seed = 0);
@@ -0,0 +1,134 @@
+#include "job_system.hpp"
+#include <algorithm>
+
+JobSystem global_job_system;
+
+namespace
+{
+    // Progress of one parallelFor, shared with its helper jobs
+    struct ParallelForState
+    {
+        std::atomic<int> next_chunk{0};
+        int remaining; // Chunks not done yet (under done_mutex)
+        std::mutex done_mutex;
+        std::condition_variable done_cv;
+    };
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::unique_lock<std::mutex> lock(jobs_mutex);
+        stopping = true;
+    }
+    jobs_cv.notify_all();
+
+    for (auto &worker : workers)
+    {
+        if (worker.joinable())
+            worker.join();
+    }
+}
+
+void JobSystem::start()
+{
+    std::call_once(started, [this]
+                   {
+        // Keep one core for the main (OpenGL) thread
+        int worker_count = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+        for (int i = 0; i < worker_count; i++)
+        {
+            workers.emplace_back(&JobSystem::workerLoop, this);
+        } });
+}
+
+int JobSystem::getWorkerCount()
+{
+    start();
+    return (int)workers.size();
+}
+
+void JobSystem::workerLoop()
+{
+    while (true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(jobs_mutex);
+            jobs_cv.wait(lock, [this]
+                         { return stopping || !jobs.empty(); });
+
+            if (stopping && jobs.empty())
+                return;
+
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
+
+std::future<void> JobSystem::submit(std::function<void()> job)
+{
+    start();
+
+    auto task = std::make_shared<std::packaged_task<void()>>(std::move(job));
+    std::future<void> future = task->get_future();
+    {
+        std::unique_lock<std::mutex> lock(jobs_mutex);
+        jobs.push_back([task]
+                       { (*task)(); });
+    }
+    jobs_cv.notify_one();
+
+    return future;
+}
+
+void JobSystem::parallelFor(int count, std::function<void(int, int)> const &func, int min_chunk_size)
+{
+    if (count <= 0)
+        return;
+
+    // Around 4 chunks per thread to balance uneven workloads
+    int thread_count = getWorkerCount() + 1;
+    int chunk_size = std::max(min_chunk_size, (count + 4 * thread_count - 1) / (4 * thread_count));
+    int chunk_count = (count + chunk_size - 1) / chunk_size;
+
+    if (chunk_count == 1)
+    {
+        func(0, count);
+        return;
+    }
+
+    // Chunks are claimed from a counter by the caller and by helper jobs. A helper run after the last chunk was
+    // claimed returns at once : it only keeps the state alive, never func
+    auto state = std::make_shared<ParallelForState>();
+    state->remaining = chunk_count;
+
+    auto run_chunks = [state, &func, count, chunk_size, chunk_count]
+    {
+        for (int chunk = state->next_chunk++; chunk < chunk_count; chunk = state->next_chunk++)
+        {
+            func(chunk * chunk_size, std::min(count, (chunk + 1) * chunk_size));
+
+            // Decrement under the lock : the caller cannot return (and destroy func) before we are done with it
+            std::unique_lock<std::mutex> done_lock(state->done_mutex);
+            if (--state->remaining == 0)
+                state->done_cv.notify_all();
+        }
+    };
+
+    int const helper_count = std::min(chunk_count - 1, (int)workers.size());
+    {
+        std::unique_lock<std::mutex> lock(jobs_mutex);
+        for (int k = 0; k < helper_count; k++)
+            jobs.push_back(run_chunks);
+    }
+    jobs_cv.notify_all();
+
+    // The calling thread works on its own chunks only, then waits for the ones the workers took
+    run_chunks();
+    std::unique_lock<std::mutex> lock(state->done_mutex);
+    state->done_cv.wait(lock, [&state]
+                        { return state->remaining == 0; });
+}
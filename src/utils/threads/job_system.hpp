@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Shared worker pool for short frame jobs (render recording, fleet simulation, mesh generation...).
+ * The asteroid belts keep their own long-running AsteroidThreadPool.
+ *
+ * Workers are started on first use. The thread calling parallelFor runs the chunks no worker has taken yet,
+ * but never other queued jobs : parallelFor can be called from inside a job without deadlocking, and a frame
+ * never ends up running a long submit() job.
+ */
+class JobSystem
+{
+public:
+    JobSystem() = default;
+    ~JobSystem();
+
+    // Call func(begin, end) on contiguous chunks covering [0, count[ and wait for all of them
+    // min_chunk_size avoids splitting small workloads into too many jobs
+    void parallelFor(int count, std::function<void(int, int)> const &func, int min_chunk_size = 1);
+
+    // Run a job asynchronously. The future is ready when the job is done
+    std::future<void> submit(std::function<void()> job);
+
+    // Number of worker threads (the calling thread is not counted)
+    int getWorkerCount();
+
+private:
+    void start();
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex jobs_mutex;
+    std::condition_variable jobs_cv;
+    std::once_flag started;
+    bool stopping = false;
+};
+
+extern JobSystem global_job_system;
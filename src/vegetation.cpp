@@ -0,0 +1,245 @@
+#include "vegetation.hpp"
+#include "cgp/geometry/transform/rotation_transform/rotation_transform.hpp"
+#include "utils/opengl/instancing.hpp"
+#include "utils/shaders/shader_loader.hpp"
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+// Deterministic value for the k-th plant
+static uint32_t plant_hash(uint32_t seed, uint32_t k)
+{
+    uint32_t h = seed ^ (k * 0x9E3779B9u);
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+// 2 crossed vertical quads (planes x = 0 and y = 0), stacked in bands with the width and mean color of the mesh there
+static cgp::mesh create_impostor_mesh(cgp::mesh const &source, float height)
+{
+    float radii[VEGETATION_IMPOSTOR_BANDS] = {0};
+    cgp::vec3 colors[VEGETATION_IMPOSTOR_BANDS];
+    int counts[VEGETATION_IMPOSTOR_BANDS] = {0};
+    for (size_t k = 0; k < source.position.size(); k++)
+    {
+        cgp::vec3 const &p = source.position[k];
+        int const band = std::clamp((int)(p.z / height * VEGETATION_IMPOSTOR_BANDS), 0, VEGETATION_IMPOSTOR_BANDS - 1);
+        radii[band] = std::max(radii[band], std::sqrt(p.x * p.x + p.y * p.y));
+        colors[band] += k < source.color.size() ? source.color[k] : cgp::vec3(1, 1, 1); // White, as fill_empty_field
+        counts[band]++;
+    }
+
+    cgp::mesh impostor;
+    for (int band = 0; band < VEGETATION_IMPOSTOR_BANDS; band++)
+    {
+        // An empty band takes the color of the band below
+        cgp::vec3 const color = counts[band] > 0 ? colors[band] / counts[band] : band > 0 ? impostor.color.data.back() : cgp::vec3(1, 1, 1);
+        float const z0 = height * band / VEGETATION_IMPOSTOR_BANDS;
+        float const z1 = height * (band + 1) / VEGETATION_IMPOSTOR_BANDS;
+        float const r = radii[band];
+
+        for (int plane = 0; plane < 2; plane++)
+        {
+            cgp::vec3 const side = plane == 0 ? cgp::vec3(r, 0, 0) : cgp::vec3(0, r, 0);
+            unsigned int const first = impostor.position.size();
+            impostor.position.push_back(-side + cgp::vec3(0, 0, z0));
+            impostor.position.push_back(side + cgp::vec3(0, 0, z0));
+            impostor.position.push_back(side + cgp::vec3(0, 0, z1));
+            impostor.position.push_back(-side + cgp::vec3(0, 0, z1));
+            for (int v = 0; v < 4; v++)
+            {
+                impostor.color.push_back(color);
+                impostor.normal.push_back({0, 0, 1}); // Lit like the ground under it, from both sides
+            }
+            impostor.connectivity.push_back({first, first + 1, first + 2});
+            impostor.connectivity.push_back({first, first + 2, first + 3});
+        }
+    }
+
+    impostor.fill_empty_field();
+    return impostor;
+}
+
+int Vegetation::addSpecies(cgp::mesh const &mesh)
+{
+    Species plant;
+    plant.height = 0;
+    plant.radius = 0;
+    for (auto const &p : mesh.position)
+    {
+        plant.height = std::max(plant.height, p.z);
+        plant.radius = std::max(plant.radius, std::sqrt(p.x * p.x + p.y * p.y));
+    }
+
+    plant.mesh.initialize_data_on_gpu(mesh);
+    plant.mesh.shader = ShaderLoader::getShader("instanced");
+    plant.mesh.material.phong.specular = 0;
+
+    plant.impostor.initialize_data_on_gpu(create_impostor_mesh(mesh, plant.height));
+    plant.impostor.shader = ShaderLoader::getShader("instanced");
+    plant.impostor.material.phong.specular = 0;
+
+    species.push_back(plant);
+    return species.size() - 1;
+}
+
+void Vegetation::addPlants(int index, std::vector<cgp::vec3> const &positions, float min_scale, float max_scale, uint32_t seed)
+{
+    std::vector<Plant> &plants = species[index].plants;
+    plants.reserve(plants.size() + positions.size());
+    for (size_t k = 0; k < positions.size(); k++)
+    {
+        float const yaw = plant_hash(seed, 3 * k) * (2 * 3.14159265f / 4294967296.0f);
+        float const scale = min_scale + (max_scale - min_scale) * (plant_hash(seed, 3 * k + 1) * (1.0f / 4294967296.0f));
+        plants.push_back({positions[k], yaw, scale, plant_hash(seed, 3 * k + 2)});
+    }
+}
+
+void Vegetation::upload()
+{
+    for (auto &plant : species)
+    {
+        // Tile of each plant, then sort by tile and random rank
+        std::vector<std::pair<int64_t, int>> order(plant.plants.size());
+        for (size_t k = 0; k < plant.plants.size(); k++)
+        {
+            int64_t const ix = (int64_t)std::floor(plant.plants[k].position.x / settings.tile_length);
+            int64_t const iy = (int64_t)std::floor(plant.plants[k].position.y / settings.tile_length);
+            order[k] = {(ix << 32) + iy, (int)k};
+        }
+        std::sort(order.begin(), order.end(), [&](auto const &a, auto const &b)
+                  { return a.first != b.first ? a.first < b.first : plant.plants[a.second].rank < plant.plants[b.second].rank; });
+
+        std::vector<Plant> sorted(plant.plants.size());
+        std::vector<cgp::InstanceAttributes> instances(plant.plants.size());
+        plant.tiles.clear();
+        for (size_t k = 0; k < order.size(); k++)
+        {
+            Plant const &p = plant.plants[order[k].second];
+            sorted[k] = p;
+            instances[k] = {p.position, cgp::rotation_transform::from_axis_angle({0, 0, 1}, p.yaw).matrix(), p.scale};
+
+            if (k == 0 || order[k].first != order[k - 1].first)
+                plant.tiles.push_back({(int)k, 0, p.position, p.position});
+
+            Tile &tile = plant.tiles.back();
+            cgp::vec3 const extent = {plant.radius * p.scale, plant.radius * p.scale, plant.height * p.scale};
+            tile.count++;
+            tile.min = {std::min(tile.min.x, p.position.x - extent.x), std::min(tile.min.y, p.position.y - extent.y), std::min(tile.min.z, p.position.z)};
+            tile.max = {std::max(tile.max.x, p.position.x + extent.x), std::max(tile.max.y, p.position.y + extent.y), std::max(tile.max.z, p.position.z + extent.z)};
+        }
+        plant.plants = std::move(sorted);
+
+        if (plant.instances == 0)
+        {
+            glGenBuffers(1, &plant.instances);
+            glGenBuffers(1, &plant.near_instances);
+            glGenBuffers(1, &plant.far_instances);
+        }
+
+        GLsizeiptr const size = instances.size() * sizeof(cgp::InstanceAttributes);
+        glBindBuffer(GL_ARRAY_BUFFER, plant.instances);
+        glBufferData(GL_ARRAY_BUFFER, size, instances.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, plant.near_instances);
+        glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, plant.far_instances);
+        glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        plant.uploaded_count = instances.size();
+    }
+}
+
+void Vegetation::draw(environment_structure const &environment)
+{
+    stats = VegetationStats();
+
+    // Camera position from the view matrix : view = [R t], position = -R^T t
+    mat4 const &view = environment.camera_view;
+    cgp::vec3 camera;
+    for (int i = 0; i < 3; i++)
+        camera[i] = -(view(0, i) * view(0, 3) + view(1, i) * view(1, 3) + view(2, i) * view(2, 3));
+
+    // Frustum planes (normal, offset) from the rows of projection * view, pointing inside
+    mat4 const clip = environment.camera_projection * view;
+    cgp::vec4 planes[6];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        for (int side = 0; side < 2; side++)
+        {
+            float const sign = side == 0 ? 1.0f : -1.0f;
+            for (int j = 0; j < 4; j++)
+                planes[2 * axis + side][j] = clip(3, j) + sign * clip(axis, j);
+        }
+    }
+
+    float const impostor_distance2 = settings.impostor_distance * settings.impostor_distance;
+    for (auto &plant : species)
+    {
+        if (plant.uploaded_count == 0)
+            continue;
+
+        int near_count = 0;
+        int far_count = 0;
+        glBindBuffer(GL_COPY_READ_BUFFER, plant.instances);
+        for (Tile const &tile : plant.tiles)
+        {
+            // Outside of a plane if the corner of the box the farthest along the plane normal is
+            bool visible = true;
+            for (int k = 0; k < 6 && visible; k++)
+            {
+                cgp::vec4 const &plane = planes[k];
+                float const x = plane.x > 0 ? tile.max.x : tile.min.x;
+                float const y = plane.y > 0 ? tile.max.y : tile.min.y;
+                float const z = plane.z > 0 ? tile.max.z : tile.min.z;
+                visible = plane.x * x + plane.y * y + plane.z * z + plane.w >= 0;
+            }
+
+            float const dx = std::max({tile.min.x - camera.x, camera.x - tile.max.x, 0.0f});
+            float const dy = std::max({tile.min.y - camera.y, camera.y - tile.max.y, 0.0f});
+            float const dz = std::max({tile.min.z - camera.z, camera.z - tile.max.z, 0.0f});
+            float const distance2 = dx * dx + dy * dy + dz * dz;
+            if (!visible || distance2 > settings.max_distance * settings.max_distance)
+            {
+                stats.culled_tiles++;
+                continue;
+            }
+
+            // The plants of a tile are in a random order : the first ones are an even subset
+            float const distance = std::sqrt(distance2);
+            float const t = std::clamp((distance - settings.full_density_distance) / (settings.max_distance - settings.full_density_distance), 0.0f, 1.0f);
+            int const count = std::max(1, (int)std::ceil(tile.count * (1 + t * (settings.min_density - 1))));
+
+            bool const is_near = distance2 < impostor_distance2;
+            int &destination_count = is_near ? near_count : far_count;
+            glBindBuffer(GL_COPY_WRITE_BUFFER, is_near ? plant.near_instances : plant.far_instances);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, tile.first * sizeof(cgp::InstanceAttributes), destination_count * sizeof(cgp::InstanceAttributes), count * sizeof(cgp::InstanceAttributes));
+            destination_count += count;
+            stats.tiles++;
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        cgp::draw_instanced_buffer(plant.mesh, environment, plant.near_instances, near_count);
+        cgp::draw_instanced_buffer(plant.impostor, environment, plant.far_instances, far_count);
+        stats.meshes += near_count;
+        stats.impostors += far_count;
+        stats.draw_calls += (near_count > 0) + (far_count > 0);
+    }
+}
+
+void Vegetation::clear()
+{
+    for (auto &plant : species)
+    {
+        glDeleteBuffers(1, &plant.instances);
+        glDeleteBuffers(1, &plant.near_instances);
+        glDeleteBuffers(1, &plant.far_instances);
+        plant.mesh.clear();
+        plant.impostor.clear();
+    }
+    species.clear();
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "cgp/geometry/shape/mesh/structure/mesh.hpp"
+#include "cgp/graphics/drawable/mesh_drawable/mesh_drawable.hpp"
+#include "environment.hpp"
+#include <cstdint>
+#include <vector>
+
+// ************************************************** //
+//                VEGETATION CONSTANTS                //
+// ************************************************** //
+constexpr int VEGETATION_IMPOSTOR_BANDS = 4; // Horizontal bands of the impostors, each with the width and color of the mesh at that height
+
+struct VegetationSettings
+{
+    float tile_length = 8.0f;            // Side of the culling tiles
+    float full_density_distance = 15.0f; // Every plant of the closer tiles is drawn
+    float impostor_distance = 30.0f;     // Farther tiles are drawn with the impostors
+    float max_distance = 80.0f;          // Farther tiles are not drawn
+    float min_density = 0.25f;           // Fraction of the plants of a tile drawn at max_distance
+};
+
+struct VegetationStats
+{
+    int tiles = 0;        // Drawn tiles
+    int culled_tiles = 0; // Tiles out of the frustum or too far
+    int meshes = 0;       // Plants drawn with their mesh
+    int impostors = 0;    // Plants drawn with their impostor
+    int draw_calls = 0;
+};
+
+/**
+ * Instanced plants (trees, mushrooms...) scattered on a terrain.
+ * The plants of each species are sorted by square tile and sent once to the GPU, in a random order inside a tile :
+ * drawing the first plants of a tile thins it evenly. Each frame, the tiles are culled against the frustum, thinned
+ * with the distance, and their plants are copied on the GPU into a near buffer (mesh) or a far buffer (impostor made
+ * of 2 crossed quads). Each species is then drawn with 2 instanced calls, whatever the number of plants.
+ * The meshes use the instanced shader, so they must stand on z = 0 with z up.
+ */
+class Vegetation
+{
+public:
+    Vegetation(VegetationSettings settings = {}) : settings(settings){};
+
+    // Add a kind of plant. Returns its index (OpenGL thread)
+    int addSpecies(cgp::mesh const &mesh);
+
+    // Plants of a species at these positions, with a random yaw and a random scale in [min_scale, max_scale]
+    // They are drawn after the next upload()
+    void addPlants(int species, std::vector<cgp::vec3> const &positions, float min_scale = 1, float max_scale = 1, uint32_t seed = 0);
+
+    // Sort the added plants by tile and send them to the GPU (OpenGL thread)
+    void upload();
+
+    // Cull, thin and draw every species (OpenGL thread)
+    void draw(environment_structure const &environment);
+
+    // Free the GPU buffers (OpenGL thread)
+    void clear();
+
+    VegetationStats const &getStats() const { return stats; };
+
+private:
+    struct Plant
+    {
+        cgp::vec3 position;
+        float yaw;
+        float scale;
+        uint32_t rank; // Random order inside the tile
+    };
+
+    struct Tile
+    {
+        int first; // Range in the instance buffer of the species
+        int count;
+        cgp::vec3 min; // Bounding box of the plants
+        cgp::vec3 max;
+    };
+
+    struct Species
+    {
+        cgp::mesh_drawable mesh;
+        cgp::mesh_drawable impostor;
+        float height; // Of the mesh, at scale 1
+        float radius; // Horizontal extent of the mesh, at scale 1
+
+        std::vector<Plant> plants; // Every plant, sorted by tile after upload
+        std::vector<Tile> tiles;
+
+        GLuint instances = 0;      // Every plant, grouped by tile
+        GLuint near_instances = 0; // Plants drawn with the mesh this frame
+        GLuint far_instances = 0;  // Plants drawn with the impostor this frame
+        int uploaded_count = 0;
+    };
+
+    VegetationSettings settings;
+    std::vector<Species> species;
+
+    VegetationStats stats;
+};
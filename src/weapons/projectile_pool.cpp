@@ -0,0 +1,240 @@
+#include "projectile_pool.hpp"
+#include "cgp/geometry/shape/mesh/primitive/mesh_primitive.hpp"
+#include "cgp/geometry/transform/rotation_transform/rotation_transform.hpp"
+#include "utils/opengl/instancing.hpp"
+#include "utils/shaders/shader_loader.hpp"
+#include "utils/threads/job_system.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+constexpr float LARGE_TARGET_RADIUS = 5.0f; // Planets and stars are tested linearly
+
+// Earliest time t in [0, 1] at which the segment start + t * delta enters the sphere (center, radius).
+// Returns a negative value if the segment does not touch the sphere
+static float sweptSphereHit(cgp::vec3 const &start, cgp::vec3 const &delta, cgp::vec3 const &center, float radius)
+{
+    cgp::vec3 const m = start - center;
+    float const c = cgp::dot(m, m) - radius * radius;
+    if (c <= 0)
+        return 0; // Already inside
+
+    float const b = cgp::dot(m, delta);
+    if (b >= 0)
+        return -1; // Moving away
+
+    float const a = cgp::dot(delta, delta);
+    float const discriminant = b * b - a * c;
+    if (discriminant < 0)
+        return -1;
+
+    float const t = (-b - std::sqrt(discriminant)) / a;
+    return t <= 1 ? t : -1;
+}
+
+ProjectilePool::ProjectilePool()
+{
+    for (auto *array : {&px, &py, &pz, &vx, &vy, &vz, &age, &hit_time})
+        array->resize(PROJECTILE_CAPACITY);
+    hit_target.resize(PROJECTILE_CAPACITY);
+
+    instance_positions.resize(PROJECTILE_CAPACITY);
+    instance_rotations.resize(PROJECTILE_CAPACITY);
+    instance_scales.resize(PROJECTILE_CAPACITY, 1.0f);
+}
+
+void ProjectilePool::initialize()
+{
+    // Bolt along the z axis, centered on the projectile position
+    cgp::mesh bolt_mesh = cgp::mesh_primitive_cylinder(PROJECTILE_RADIUS, {0, 0, -PROJECTILE_LENGTH / 2}, {0, 0, PROJECTILE_LENGTH / 2}, 2, 6, true);
+    bolt_mesh_drawable.initialize_data_on_gpu(bolt_mesh);
+    bolt_mesh_drawable.material.color = {1.0f, 0.3f, 0.2f};
+    bolt_mesh_drawable.material.phong.ambient = 1; // Glowing : ignore the light direction
+    bolt_mesh_drawable.material.phong.diffuse = 0;
+    bolt_mesh_drawable.material.phong.specular = 0;
+    bolt_mesh_drawable.shader = ShaderLoader::getShader("instanced");
+}
+
+bool ProjectilePool::fire(cgp::vec3 const &position, cgp::vec3 const &velocity)
+{
+    if (alive == PROJECTILE_CAPACITY)
+    {
+        stats.dropped++;
+        return false;
+    }
+
+    px[alive] = position.x;
+    py[alive] = position.y;
+    pz[alive] = position.z;
+    vx[alive] = velocity.x;
+    vy[alive] = velocity.y;
+    vz[alive] = velocity.z;
+    age[alive] = 0;
+    alive++;
+    stats.fired++;
+    return true;
+}
+
+void ProjectilePool::setTargets(std::vector<ProjectileTarget> const &targets)
+{
+    this->targets = targets;
+    target_x.clear();
+    target_y.clear();
+    target_z.clear();
+    small_targets.clear();
+    large_targets.clear();
+    max_small_target_radius = 0;
+
+    for (int i = 0; i < (int)targets.size(); i++)
+    {
+        cgp::vec4 const &sphere = targets[i].sphere;
+        if (sphere.w > LARGE_TARGET_RADIUS)
+        {
+            large_targets.push_back(i);
+        }
+        else
+        {
+            target_x.push_back(sphere.x);
+            target_y.push_back(sphere.y);
+            target_z.push_back(sphere.z);
+            small_targets.push_back(i);
+            max_small_target_radius = std::max(max_small_target_radius, sphere.w);
+        }
+    }
+
+    // A cell holds about one frame of bolt travel, so most queries visit a handful of cells
+    float const cell_size = 2 * (max_small_target_radius + PROJECTILE_RADIUS) + PROJECTILE_SPEED / 30;
+    target_grid.build(target_x.data(), target_y.data(), target_z.data(), small_targets.size(), cell_size);
+    stats.targets = targets.size();
+}
+
+void ProjectilePool::update(float dt)
+{
+    auto const start = std::chrono::high_resolution_clock::now();
+
+    // Integrate and find the first target crossed by each segment
+    global_job_system.parallelFor(
+        alive, [&](int begin, int end)
+        {
+            for (int i = begin; i < end; i++)
+            {
+                cgp::vec3 const from = {px[i], py[i], pz[i]};
+                cgp::vec3 const delta = cgp::vec3{vx[i], vy[i], vz[i]} * dt;
+
+                int best_target = -1;
+                float best_time = 2;
+                auto test = [&](int target)
+                {
+                    cgp::vec4 const &sphere = targets[target].sphere;
+                    float const t = sweptSphereHit(from, delta, {sphere.x, sphere.y, sphere.z}, sphere.w + PROJECTILE_RADIUS);
+                    if (t >= 0 && t < best_time)
+                    {
+                        best_time = t;
+                        best_target = target;
+                    }
+                };
+
+                for (int target : large_targets)
+                    test(target);
+
+                // Query spheres enclosing pieces of the segment, so each one stays within a cell size (a fast shooter
+                // would make a single sphere visit a cube of cells). A target found by 2 pieces is tested twice, same result
+                float const margin = PROJECTILE_RADIUS + max_small_target_radius;
+                float const max_piece = target_grid.getCellSize() - 2 * margin;
+                int const pieces = std::max(1, (int)std::ceil(cgp::norm(delta) / max_piece));
+                float const half_length = cgp::norm(delta) / (2 * pieces);
+                if (8 * pieces >= (int)small_targets.size())
+                {
+                    // A piece visits up to 8 cells : with few targets or a very long step, the linear test is cheaper
+                    for (int target : small_targets)
+                        test(target);
+                }
+                else
+                {
+                    for (int piece = 0; piece < pieces; piece++)
+                    {
+                        target_grid.forEachNear(from + delta * ((piece + 0.5f) / pieces), half_length + margin, [&](int k)
+                                                { test(small_targets[k]); });
+                    }
+                }
+
+                hit_target[i] = best_target;
+                hit_time[i] = best_time;
+
+                px[i] += delta.x;
+                py[i] += delta.y;
+                pz[i] += delta.z;
+                age[i] += dt;
+            }
+        },
+        PROJECTILE_MIN_CHUNK);
+
+    // Collect the hits and compact the pool (serial, the order of the hits does not matter)
+    hits.clear();
+    int i = 0;
+    while (i < alive)
+    {
+        if (hit_target[i] >= 0)
+        {
+            ProjectileTarget const &target = targets[hit_target[i]];
+            cgp::vec3 const velocity = {vx[i], vy[i], vz[i]};
+            cgp::vec3 const impact = cgp::vec3{px[i], py[i], pz[i]} - velocity * dt * (1 - hit_time[i]);
+            hits.push_back({impact, velocity, target.sphere.w, target.owner, target.index});
+            kill(i);
+        }
+        else if (age[i] > PROJECTILE_LIFETIME)
+        {
+            kill(i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    auto const end = std::chrono::high_resolution_clock::now();
+
+    stats.alive = alive;
+    stats.hits = hits.size();
+    stats.update_ms = std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+void ProjectilePool::kill(int i)
+{
+    int const last = alive - 1;
+    px[i] = px[last];
+    py[i] = py[last];
+    pz[i] = pz[last];
+    vx[i] = vx[last];
+    vy[i] = vy[last];
+    vz[i] = vz[last];
+    age[i] = age[last];
+    hit_target[i] = hit_target[last];
+    hit_time[i] = hit_time[last];
+    alive = last;
+}
+
+void ProjectilePool::draw(environment_structure const &environment)
+{
+    if (alive > 0)
+    {
+        // Bolts are aligned with their velocity
+        global_job_system.parallelFor(
+            alive, [&](int begin, int end)
+            {
+                for (int i = begin; i < end; i++)
+                {
+                    cgp::vec3 const velocity = {vx[i], vy[i], vz[i]};
+                    instance_positions[i] = {px[i], py[i], pz[i]};
+                    instance_rotations[i] = cgp::rotation_transform::from_vector_transform({0, 0, 1}, cgp::normalize(velocity)).matrix();
+                }
+            },
+            PROJECTILE_MIN_CHUNK);
+
+        cgp::draw_instanced(bolt_mesh_drawable, environment, instance_positions, instance_rotations, instance_scales, alive);
+    }
+
+    // Per frame counters
+    stats.fired = 0;
+    stats.dropped = 0;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "ai/spatial_grid.hpp"
+#include "cgp/graphics/drawable/mesh_drawable/mesh_drawable.hpp"
+#include "cgp/geometry/vec/vec3/vec3.hpp"
+#include "cgp/geometry/vec/vec4/vec4.hpp"
+#include "environment.hpp"
+#include <vector>
+
+// ************************************************** //
+//                 PROJECTILE CONSTANTS               //
+// ************************************************** //
+constexpr int PROJECTILE_CAPACITY = 16384;        // Fixed pool size : no allocation once initialized
+constexpr float PROJECTILE_SPEED = 150.0f;        // Display units per second, added to the shooter velocity
+constexpr float PROJECTILE_LIFETIME = 4.0f;       // Seconds
+constexpr float PROJECTILE_RADIUS = 0.05f;        // Collision radius (display units)
+constexpr float PROJECTILE_LENGTH = 0.8f;         // Visual length of a bolt
+constexpr float PROJECTILE_FIRE_RATE = 20.0f;     // Volleys per second while the fire key is held
+constexpr float PROJECTILE_TARGET_RANGE = 800.0f; // Targets farther than this from the shooter are ignored (> speed * lifetime)
+constexpr int PROJECTILE_MIN_CHUNK = 256;         // Minimum projectiles per job
+
+// Sphere that projectiles collide with. owner and index identify it for the caller (asteroid belt and asteroid index),
+// owner is -1 for solid bodies that only absorb projectiles (planets, stars)
+struct ProjectileTarget
+{
+    cgp::vec4 sphere; // xyz = display position, w = display radius
+    int owner;
+    int index;
+};
+
+// A projectile that hit a target during the last update
+struct ProjectileHit
+{
+    cgp::vec3 position; // Impact point
+    cgp::vec3 velocity; // Projectile velocity at impact
+    float target_radius;
+    int owner;
+    int index;
+};
+
+struct ProjectileStats
+{
+    int alive = 0;
+    int fired = 0;   // Spawned during the last frame
+    int dropped = 0; // Spawn requests refused because the pool was full, last frame
+    int hits = 0;
+    int targets = 0;
+    float update_ms = 0; // Integration + collision time
+};
+
+/**
+ * Fixed capacity projectile pool, stored as structure of arrays.
+ * Live projectiles are kept packed in [0, alive) : dead ones are swapped with the last live one, so the
+ * update never scans free slots. Each step integrates the projectiles in parallel and tests the swept segment
+ * of every projectile against the target spheres (continuous collision : fast bolts cannot tunnel through
+ * small asteroids). Small targets are looked up in a uniform grid, large ones are tested linearly.
+ */
+class ProjectilePool
+{
+public:
+    ProjectilePool();
+
+    void initialize(); // Create the bolt mesh
+
+    // Spawn a projectile. Returns false if the pool is full
+    bool fire(cgp::vec3 const &position, cgp::vec3 const &velocity);
+
+    // Targets for the next update
+    void setTargets(std::vector<ProjectileTarget> const &targets);
+
+    // Move the projectiles, remove expired ones and collect the hits
+    void update(float dt);
+
+    void draw(environment_structure const &environment);
+
+    std::vector<ProjectileHit> const &getHits() const { return hits; };
+    ProjectileStats const &getStats() const { return stats; };
+    int size() const { return alive; };
+
+private:
+    void kill(int i); // Swap the last live projectile into slot i
+
+    int alive = 0;
+
+    // Projectile state (SoA, PROJECTILE_CAPACITY each)
+    std::vector<float> px, py, pz;
+    std::vector<float> vx, vy, vz;
+    std::vector<float> age;
+
+    // Per projectile result of the parallel collision pass : target index or -1, and impact time in [0, 1]
+    std::vector<int> hit_target;
+    std::vector<float> hit_time;
+
+    // Targets : small ones in a grid, large ones linearly
+    std::vector<ProjectileTarget> targets;
+    std::vector<float> target_x, target_y, target_z;
+    std::vector<int> small_targets; // Grid index -> target index
+    std::vector<int> large_targets;
+    SpatialGrid target_grid;
+    float max_small_target_radius = 0;
+
+    std::vector<ProjectileHit> hits;
+    ProjectileStats stats;
+
+    // Instancing data for the draw call
+    cgp::mesh_drawable bolt_mesh_drawable;
+    std::vector<cgp::vec3> instance_positions;
+    std::vector<cgp::mat3> instance_rotations;
+    std::vector<float> instance_scales;
+};